@@ -14,17 +14,34 @@
 
 #include "cpu_instructions/base/cleanup_instruction_set.h"
 
+#include <stdint.h>
 #include <algorithm>
+#include <chrono>  // NOLINT
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <functional>
 #include <map>
+#include <mutex>  // NOLINT
+#include <unordered_map>
+#include <utility>
 #include <vector>
 #include "strings/string.h"
 
+#include "base/stringprintf.h"
+#include "cpu_instructions/proto/transform_profile.pb.h"
+#include "cpu_instructions/util/parallel.h"
+#include "cpu_instructions/util/proto_fingerprint.h"
+#include "cpu_instructions/util/proto_util.h"
 #include "gflags/gflags.h"
 #include "glog/logging.h"
 #include "src/google/protobuf/descriptor.h"
 #include "src/google/protobuf/io/zero_copy_stream_impl_lite.h"
 #include "src/google/protobuf/repeated_field.h"
 #include "src/google/protobuf/util/message_differencer.h"
+#include "strings/str_cat.h"
+#include "strings/str_join.h"
+#include "strings/string_view.h"
 #include "util/gtl/map_util.h"
 #include "util/task/status.h"
 #include "util/task/status_macros.h"
@@ -36,6 +53,26 @@ DEFINE_bool(cpu_instructions_print_transform_names_to_log, true,
 DEFINE_bool(cpu_instructions_print_transform_diffs_to_log, false,
             "Print the names and the diffs of the instruction set before and "
             "after running each transform to the log.");
+DEFINE_string(cpu_instructions_transform_checkpoint_dir, "",
+              "A directory where RunTransformPipeline stores the state of the "
+              "instruction set after each transform, and from where it resumes "
+              "the pipeline after the longest prefix that was already "
+              "computed for the same input. The checkpoints are identified "
+              "only by the input and the names of the transforms, so they must "
+              "be deleted after changing the code of the transforms. When "
+              "empty, no checkpoints are used.");
+DEFINE_bool(cpu_instructions_profile_transforms, false,
+            "Measure the time spent in each transform executed by the "
+            "transform pipeline and the changes it made to the instruction "
+            "set, and print a report sorted by the wall time to the log at "
+            "the end of the pipeline.");
+DEFINE_string(cpu_instructions_transform_profile_file, "",
+              "When --cpu_instructions_profile_transforms is set, also write "
+              "the profile of the pipeline as a TransformPipelineProfile proto "
+              "in text format to this file.");
+DEFINE_int32(cpu_instructions_transform_num_threads, 0,
+             "The number of threads used to run per-instruction transforms. "
+             "When zero, uses one thread per hardware thread.");
 
 namespace cpu_instructions {
 
@@ -46,12 +83,214 @@ using ::cpu_instructions::util::OkStatus;
 using ::cpu_instructions::util::Status;
 using ::cpu_instructions::util::StatusOr;
 
-using InstructionSetTransformOrder =
-    std::multimap<int, InstructionSetTransform>;
+namespace {
+
+// Returns the fingerprints of all instructions in the instruction set. The
+// fingerprints are used to quickly find instructions that were not changed by a
+// transform: two instructions with the same fingerprint are equal with a very
+// high probability.
+std::vector<Fingerprint128> GetInstructionFingerprints(
+    const InstructionSetProto& instruction_set) {
+  std::vector<Fingerprint128> fingerprints;
+  fingerprints.reserve(instruction_set.instructions_size());
+  for (const InstructionProto& instruction : instruction_set.instructions()) {
+    fingerprints.push_back(GetProtoFingerprint(instruction));
+  }
+  return fingerprints;
+}
+
+// Finds the instructions changed by a transform, given the fingerprints of the
+// instructions before and after the transform. The instructions that have the
+// same fingerprint before and after the transform were not changed, though they
+// might have been moved. Of the remaining instructions, an instruction that
+// stayed at the same index is considered modified, and all other instructions
+// were removed or added by the transform.
+//
+// Returns the list of changes as pairs (original index, new index), where the
+// original index is -1 for added instructions, and the new index is -1 for
+// removed instructions. The modified and removed instructions come first,
+// sorted by their original index, followed by the added instructions sorted by
+// their new index.
+std::vector<std::pair<int, int>> FindChangedInstructions(
+    const std::vector<Fingerprint128>& original_fingerprints,
+    const std::vector<Fingerprint128>& fingerprints) {
+  const int num_original_instructions = original_fingerprints.size();
+  const int num_instructions = fingerprints.size();
+
+  // Match the instructions that have the same fingerprint before and after the
+  // transform. This replaces the expensive matching of the instructions by
+  // MessageDifferencer::TreatAsSet.
+  std::unordered_multimap<Fingerprint128, int, Fingerprint128Hash>
+      unmatched_original_instructions;
+  unmatched_original_instructions.reserve(num_original_instructions);
+  for (int i = 0; i < num_original_instructions; ++i) {
+    unmatched_original_instructions.emplace(original_fingerprints[i], i);
+  }
+  std::vector<bool> original_instruction_matched(num_original_instructions,
+                                                 false);
+  std::vector<bool> instruction_matched(num_instructions, false);
+  for (int i = 0; i < num_instructions; ++i) {
+    const auto it = unmatched_original_instructions.find(fingerprints[i]);
+    if (it == unmatched_original_instructions.end()) continue;
+    original_instruction_matched[it->second] = true;
+    instruction_matched[i] = true;
+    unmatched_original_instructions.erase(it);
+  }
+
+  std::vector<std::pair<int, int>> changes;
+  for (int i = 0; i < num_original_instructions; ++i) {
+    if (original_instruction_matched[i]) continue;
+    if (i < num_instructions && !instruction_matched[i]) {
+      changes.emplace_back(i, i);
+      instruction_matched[i] = true;
+    } else {
+      changes.emplace_back(i, -1);
+    }
+  }
+  for (int i = 0; i < num_instructions; ++i) {
+    if (!instruction_matched[i]) changes.emplace_back(-1, i);
+  }
+  return changes;
+}
+
+// The profiles of the transforms collected since the start of the current run
+// of RunTransformPipeline, and the profile of the last finished run.
+struct TransformProfiles {
+  std::mutex mutex;
+  TransformPipelineProfile current_pipeline;
+  TransformPipelineProfile last_pipeline;
+};
+
+TransformProfiles* GetTransformProfiles() {
+  static TransformProfiles* const profiles = new TransformProfiles();
+  return profiles;
+}
+
+// Calls 'run_transform' that runs the transform 'transform_name' on
+// 'instruction_set', and returns its status. When
+// --cpu_instructions_profile_transforms is set, also records the profile of the
+// transform.
+Status RunAndProfileTransform(const string& transform_name,
+                              const InstructionSetProto& instruction_set,
+                              const std::function<Status()>& run_transform) {
+  if (!FLAGS_cpu_instructions_profile_transforms) return run_transform();
+
+  TransformProfile profile;
+  profile.set_transform_name(transform_name);
+  profile.set_space_used_before_bytes(instruction_set.SpaceUsed());
+  const std::vector<Fingerprint128> original_fingerprints =
+      GetInstructionFingerprints(instruction_set);
+
+  const auto wall_time_start = std::chrono::steady_clock::now();
+  const std::clock_t cpu_time_start = std::clock();
+  const Status status = run_transform();
+  const std::clock_t cpu_time_end = std::clock();
+  const auto wall_time_end = std::chrono::steady_clock::now();
+
+  profile.set_wall_time_seconds(
+      std::chrono::duration<double>(wall_time_end - wall_time_start).count());
+  profile.set_cpu_time_seconds(static_cast<double>(cpu_time_end -
+                                                   cpu_time_start) /
+                               CLOCKS_PER_SEC);
+  profile.set_space_used_after_bytes(instruction_set.SpaceUsed());
+  const std::vector<std::pair<int, int>> changes = FindChangedInstructions(
+      original_fingerprints, GetInstructionFingerprints(instruction_set));
+  for (const auto& change : changes) {
+    if (change.first < 0) {
+      profile.set_num_added_instructions(profile.num_added_instructions() + 1);
+    } else if (change.second < 0) {
+      profile.set_num_removed_instructions(profile.num_removed_instructions() +
+                                           1);
+    } else {
+      profile.set_num_modified_instructions(
+          profile.num_modified_instructions() + 1);
+    }
+  }
+
+  TransformProfiles* const profiles = GetTransformProfiles();
+  std::lock_guard<std::mutex> lock(profiles->mutex);
+  *profiles->current_pipeline.add_transforms() = profile;
+  return status;
+}
+
+// Sorts the transforms in 'profile' by their wall time in descending order, and
+// prints them to the log as a table.
+void SortAndLogTransformPipelineProfile(TransformPipelineProfile* profile) {
+  CHECK(profile != nullptr);
+  auto* const transforms = profile->mutable_transforms();
+  std::stable_sort(transforms->begin(), transforms->end(),
+                   [](const TransformProfile& a, const TransformProfile& b) {
+                     return a.wall_time_seconds() > b.wall_time_seconds();
+                   });
+  string table = StringPrintf("%10s %10s %8s %8s %8s %12s  %s\n", "wall [s]",
+                              "cpu [s]", "added", "removed", "modified",
+                              "growth [B]", "transform");
+  for (const TransformProfile& transform : *transforms) {
+    StringAppendF(&table, "%10.3f %10.3f %8d %8d %8d %12lld  %s\n",
+                  transform.wall_time_seconds(), transform.cpu_time_seconds(),
+                  transform.num_added_instructions(),
+                  transform.num_removed_instructions(),
+                  transform.num_modified_instructions(),
+                  static_cast<long long>(  // NOLINT
+                      transform.space_used_after_bytes() -
+                      transform.space_used_before_bytes()),
+                  transform.transform_name().c_str());
+  }
+  StringAppendF(&table, "%10.3f %10s %8s %8s %8s %12s  %s\n",
+                profile->total_wall_time_seconds(), "", "", "", "", "",
+                "(total)");
+  LOG(INFO) << "Transform profile:\n" << table;
+}
+
+}  // namespace
 
 namespace internal {
 namespace {
 
+// A transform together with its name. The transforms returned by
+// GetTransformsByName() and GetDefaultTransformPipeline() are stored in
+// InstructionSetTransform as objects of this type, so that GetTransformName()
+// can recover their names.
+struct NamedTransform {
+  Status operator()(InstructionSetProto* instruction_set) const {
+    return transform(instruction_set);
+  }
+
+  string name;
+  InstructionSetTransform transform;
+
+  // For indexed transforms, a version of 'transform' that uses an existing
+  // index of the instruction set instead of building its own; this is used by
+  // RunTransformPipeline to share one index by all the transforms in the
+  // pipeline. For all other transforms, this is empty.
+  std::function<Status(InstructionSetIndex*, InstructionSetProto*)>
+      indexed_transform;
+};
+
+// An entry in the default pipeline.
+struct DefaultPipelineEntry {
+  // The name of the transform.
+  string name;
+
+  // The transform, wrapped by RunSingleTransform.
+  InstructionSetTransform transform;
+
+  // For per-instruction transforms, the per-instruction function. For all
+  // other transforms, this is nullptr.
+  InstructionTransformRawFunction* instruction_transform;
+
+  // For removal transforms, the removal predicate. For all other transforms,
+  // this is nullptr.
+  InstructionRemovalPredicate* removal_predicate;
+
+  // For indexed transforms, the indexed function. For all other transforms,
+  // this is nullptr.
+  IndexedInstructionSetTransformRawFunction* indexed_transform;
+};
+
+using InstructionSetTransformOrder =
+    std::multimap<int, DefaultPipelineEntry>;
+
 InstructionSetTransformsByName* GetMutableTransformsByName() {
   static InstructionSetTransformsByName* const transforms_by_name =
       new InstructionSetTransformsByName();
@@ -64,32 +303,33 @@ InstructionSetTransformOrder* GetMutableDefaultTransformOrder() {
   return transforms_order;
 }
 
-Status RunSingleTransform(
-    const string& transform_name,
-    InstructionSetTransformRawFunction* transform_function,
-    InstructionSetProto* instruction_set) {
+Status RunSingleTransform(const string& transform_name,
+                          const InstructionSetTransform& transform_function,
+                          InstructionSetProto* instruction_set) {
   CHECK(transform_function != nullptr);
   CHECK(instruction_set != nullptr);
   if (FLAGS_cpu_instructions_print_transform_names_to_log ||
       FLAGS_cpu_instructions_print_transform_diffs_to_log) {
     LOG(INFO) << "Running: " << transform_name;
   }
-  Status transform_status = OkStatus();
-  if (FLAGS_cpu_instructions_print_transform_diffs_to_log) {
-    const StatusOr<string> diff_or_status =
-        RunTransformWithDiff(transform_function, instruction_set);
-    if (diff_or_status.ok()) {
-      const string& diff = diff_or_status.ValueOrDie();
-      // TODO(ondrasej): Consider trimming the output, so that we don't flood
-      // the output when there are too many diffs.
-      if (!diff.empty()) {
-        LOG(INFO) << "Difference:\n" << diff;
-      }
-    }
-    transform_status = diff_or_status.status();
-  } else {
-    transform_status = transform_function(instruction_set);
-  }
+  const Status transform_status = RunAndProfileTransform(
+      transform_name, *instruction_set, [&transform_function,
+                                         instruction_set]() {
+        if (!FLAGS_cpu_instructions_print_transform_diffs_to_log) {
+          return transform_function(instruction_set);
+        }
+        const StatusOr<string> diff_or_status =
+            RunTransformWithDiff(transform_function, instruction_set);
+        if (diff_or_status.ok()) {
+          const string& diff = diff_or_status.ValueOrDie();
+          // TODO(ondrasej): Consider trimming the output, so that we don't
+          // flood the output when there are too many diffs.
+          if (!diff.empty()) {
+            LOG(INFO) << "Difference:\n" << diff;
+          }
+        }
+        return diff_or_status.status();
+      });
   if (FLAGS_cpu_instructions_print_transform_names_to_log ||
       FLAGS_cpu_instructions_print_transform_diffs_to_log) {
     const char* const status = transform_status.ok() ? "Success: " : "Failed: ";
@@ -98,23 +338,223 @@ Status RunSingleTransform(
   return transform_status;
 }
 
+// Runs the per-instruction transforms 'transforms' in a single sweep over the
+// instruction set, and prints the names, the statuses, and the diffs of the
+// individual transforms to the log, as if they ran separately.
+Status RunFusedTransforms(
+    const std::vector<string>& transform_names,
+    const std::vector<InstructionTransformRawFunction*>& transforms,
+    InstructionSetProto* instruction_set) {
+  CHECK_EQ(transform_names.size(), transforms.size());
+  CHECK(instruction_set != nullptr);
+  const bool print_names =
+      FLAGS_cpu_instructions_print_transform_names_to_log ||
+      FLAGS_cpu_instructions_print_transform_diffs_to_log;
+  if (print_names) {
+    LOG(INFO) << "Running fused: " << strings::Join(transform_names, ", ");
+  }
+  std::vector<Status> transform_statuses;
+  std::vector<string> transform_diffs;
+  const Status status = RunAndProfileTransform(
+      strings::Join(transform_names, "+"), *instruction_set, [&]() {
+        return RunFusedInstructionTransforms(
+            transforms, FLAGS_cpu_instructions_transform_num_threads,
+            instruction_set, &transform_statuses,
+            FLAGS_cpu_instructions_print_transform_diffs_to_log
+                ? &transform_diffs
+                : nullptr);
+      });
+  for (size_t i = 0; i < transform_names.size(); ++i) {
+    if (i < transform_diffs.size() && !transform_diffs[i].empty()) {
+      LOG(INFO) << "Difference (" << transform_names[i] << "):\n"
+                << transform_diffs[i];
+    }
+    if (print_names) {
+      const char* const result =
+          transform_statuses[i].ok() ? "Success: " : "Failed: ";
+      LOG(INFO) << result << transform_names[i];
+    }
+  }
+  return status;
+}
+
+// Removes the instructions matching any of 'predicates' in a single pass over
+// the instruction set, and prints the names, the number of removed
+// instructions, and the diffs of the individual removals to the log, as if they
+// ran separately.
+Status RunFusedRemovals(
+    const std::vector<string>& transform_names,
+    const std::vector<InstructionRemovalPredicate*>& predicates,
+    InstructionSetProto* instruction_set) {
+  CHECK_EQ(transform_names.size(), predicates.size());
+  CHECK(instruction_set != nullptr);
+  const bool print_names =
+      FLAGS_cpu_instructions_print_transform_names_to_log ||
+      FLAGS_cpu_instructions_print_transform_diffs_to_log;
+  if (print_names) {
+    LOG(INFO) << "Running fused: " << strings::Join(transform_names, ", ");
+  }
+  std::vector<int> num_removed_instructions;
+  std::vector<string> predicate_diffs;
+  const Status status = RunAndProfileTransform(
+      strings::Join(transform_names, "+"), *instruction_set, [&]() {
+        RemoveInstructionsIf(
+            predicates, instruction_set, &num_removed_instructions,
+            FLAGS_cpu_instructions_print_transform_diffs_to_log
+                ? &predicate_diffs
+                : nullptr);
+        return OkStatus();
+      });
+  for (size_t i = 0; i < transform_names.size(); ++i) {
+    if (i < predicate_diffs.size() && !predicate_diffs[i].empty()) {
+      LOG(INFO) << "Difference (" << transform_names[i] << "):\n"
+                << predicate_diffs[i];
+    }
+    if (print_names) {
+      LOG(INFO) << "Success: " << transform_names[i] << " (removed "
+                << num_removed_instructions[i] << " instructions)";
+    }
+  }
+  return status;
+}
+
+// Runs the indexed transforms 'transforms' one by one, as if they were separate
+// elements of the pipeline, but with the index 'index' of the instruction set
+// that is shared by all of them.
+Status RunIndexedTransforms(
+    const std::vector<string>& transform_names,
+    const std::vector<IndexedInstructionSetTransformRawFunction*>& transforms,
+    InstructionSetIndex* index, InstructionSetProto* instruction_set) {
+  CHECK_EQ(transform_names.size(), transforms.size());
+  CHECK(index != nullptr);
+  CHECK(instruction_set != nullptr);
+  for (size_t i = 0; i < transforms.size(); ++i) {
+    IndexedInstructionSetTransformRawFunction* const transform = transforms[i];
+    RETURN_IF_ERROR(RunSingleTransform(
+        transform_names[i],
+        [transform, index](InstructionSetProto* instruction_set) {
+          return transform(index, instruction_set);
+        },
+        instruction_set));
+    DCHECK(index->IsUpToDate())
+        << transform_names[i] << " did not keep the index up to date";
+  }
+  return OkStatus();
+}
+
+// Returns a transform that runs the indexed transforms 'transforms' using
+// RunIndexedTransforms. When the transform is called directly, it builds its
+// own index of the instruction set; RunTransformPipeline passes it the index
+// shared by the whole pipeline.
+NamedTransform MakeIndexedTransform(
+    const std::vector<string>& transform_names,
+    const std::vector<IndexedInstructionSetTransformRawFunction*>& transforms) {
+  NamedTransform named_transform;
+  named_transform.name = strings::Join(transform_names, "+");
+  named_transform.indexed_transform = [transform_names, transforms](
+      InstructionSetIndex* index, InstructionSetProto* instruction_set) {
+    return RunIndexedTransforms(transform_names, transforms, index,
+                                instruction_set);
+  };
+  named_transform.transform = [transform_names, transforms](
+      InstructionSetProto* instruction_set) {
+    InstructionSetIndex index(instruction_set);
+    return RunIndexedTransforms(transform_names, transforms, &index,
+                                instruction_set);
+  };
+  return named_transform;
+}
+
+// Appends the transforms 'entries' of the same kind to 'pipeline'. A single
+// transform is appended as is; two or more transforms are appended as a single
+// fused element created by 'fuse', that receives the names and the entries of
+// the fused transforms.
+void AppendFusedTransforms(
+    const std::vector<const DefaultPipelineEntry*>& entries,
+    const std::function<NamedTransform(
+        const std::vector<string>&,
+        const std::vector<const DefaultPipelineEntry*>&)>& fuse,
+    std::vector<InstructionSetTransform>* pipeline) {
+  CHECK(pipeline != nullptr);
+  if (entries.empty()) return;
+  if (entries.size() == 1) {
+    pipeline->push_back(entries.front()->transform);
+    return;
+  }
+  std::vector<string> names;
+  for (const DefaultPipelineEntry* const entry : entries) {
+    names.push_back(entry->name);
+  }
+  pipeline->push_back(fuse(names, entries));
+}
+
 }  // namespace
 
 RegisterInstructionSetTransform::RegisterInstructionSetTransform(
     const string& transform_name, int rank_in_default_pipeline,
     InstructionSetTransformRawFunction transform) {
+  Register(transform_name, rank_in_default_pipeline, transform, nullptr,
+           nullptr, nullptr);
+}
+
+RegisterInstructionSetTransform::RegisterInstructionSetTransform(
+    const string& transform_name, int rank_in_default_pipeline,
+    InstructionTransformRawFunction transform) {
+  Register(transform_name, rank_in_default_pipeline,
+           [transform](InstructionSetProto* instruction_set) {
+             return RunInstructionTransform(
+                 transform, FLAGS_cpu_instructions_transform_num_threads,
+                 instruction_set);
+           },
+           transform, nullptr, nullptr);
+}
+
+RegisterInstructionSetTransform::RegisterInstructionSetTransform(
+    const string& transform_name, int rank_in_default_pipeline,
+    InstructionRemovalPredicate predicate) {
+  Register(transform_name, rank_in_default_pipeline,
+           [predicate](InstructionSetProto* instruction_set) {
+             RemoveInstructionsIf({predicate}, instruction_set, nullptr,
+                                  nullptr);
+             return OkStatus();
+           },
+           nullptr, predicate, nullptr);
+}
+
+RegisterInstructionSetTransform::RegisterInstructionSetTransform(
+    const string& transform_name, int rank_in_default_pipeline,
+    IndexedInstructionSetTransformRawFunction transform) {
+  // The transform function is created by Register using MakeIndexedTransform.
+  Register(transform_name, rank_in_default_pipeline, nullptr, nullptr, nullptr,
+           transform);
+}
+
+void RegisterInstructionSetTransform::Register(
+    const string& transform_name, int rank_in_default_pipeline,
+    const InstructionSetTransform& transform,
+    InstructionTransformRawFunction* instruction_transform,
+    InstructionRemovalPredicate* removal_predicate,
+    IndexedInstructionSetTransformRawFunction* indexed_transform) {
   InstructionSetTransformsByName& transforms_by_name =
       *GetMutableTransformsByName();
   CHECK(!ContainsKey(transforms_by_name, transform_name))
       << "Transform name '" << transform_name << "' is already used!";
-  InstructionSetTransform transform_wrapper =
-      [transform_name, transform](InstructionSetProto* instruction_set) {
-        return RunSingleTransform(transform_name, transform, instruction_set);
-      };
+  const InstructionSetTransform transform_wrapper =
+      indexed_transform != nullptr
+          ? MakeIndexedTransform({transform_name}, {indexed_transform})
+          : NamedTransform{transform_name,
+                           [transform_name,
+                            transform](InstructionSetProto* instruction_set) {
+                             return RunSingleTransform(
+                                 transform_name, transform, instruction_set);
+                           }};
   transforms_by_name[transform_name] = transform_wrapper;
   if (rank_in_default_pipeline != kNotInDefaultPipeline) {
+    const DefaultPipelineEntry entry = {transform_name, transform_wrapper,
+                                        instruction_transform,
+                                        removal_predicate, indexed_transform};
     GetMutableDefaultTransformOrder()->emplace(rank_in_default_pipeline,
-                                               transform_wrapper);
+                                               entry);
   }
 }
 
@@ -125,59 +565,573 @@ const InstructionSetTransformsByName& GetTransformsByName() {
 }
 
 std::vector<InstructionSetTransform> GetDefaultTransformPipeline() {
-  const InstructionSetTransformOrder& default_pipeline_transforms_order =
-      *internal::GetMutableDefaultTransformOrder();
+  using internal::DefaultPipelineEntry;
+  const internal::InstructionSetTransformOrder&
+      default_pipeline_transforms_order =
+          *internal::GetMutableDefaultTransformOrder();
   std::vector<InstructionSetTransform> transforms;
   transforms.reserve(default_pipeline_transforms_order.size());
-  for (const auto& element : default_pipeline_transforms_order) {
-    transforms.push_back(element.second);
+  auto it = default_pipeline_transforms_order.begin();
+  while (it != default_pipeline_transforms_order.end()) {
+    // The order of the transforms with the same rank is not defined, so they
+    // are grouped by their kind to make the runs that can be fused as long as
+    // possible: first the removals, then the indexed transforms, then the
+    // other instruction set transforms, and finally the per-instruction
+    // transforms. Within each kind, the transforms keep the order in which they
+    // were registered.
+    const int rank = it->first;
+    std::vector<const DefaultPipelineEntry*> removals;
+    std::vector<const DefaultPipelineEntry*> indexed_transforms;
+    std::vector<const DefaultPipelineEntry*> other_transforms;
+    std::vector<const DefaultPipelineEntry*> instruction_transforms;
+    for (; it != default_pipeline_transforms_order.end() && it->first == rank;
+         ++it) {
+      const DefaultPipelineEntry& entry = it->second;
+      if (entry.removal_predicate != nullptr) {
+        removals.push_back(&entry);
+      } else if (entry.indexed_transform != nullptr) {
+        indexed_transforms.push_back(&entry);
+      } else if (entry.instruction_transform != nullptr) {
+        instruction_transforms.push_back(&entry);
+      } else {
+        other_transforms.push_back(&entry);
+      }
+    }
+    internal::AppendFusedTransforms(
+        removals,
+        [](const std::vector<string>& names,
+           const std::vector<const DefaultPipelineEntry*>& entries) {
+          std::vector<InstructionRemovalPredicate*> predicates;
+          for (const DefaultPipelineEntry* const entry : entries) {
+            predicates.push_back(entry->removal_predicate);
+          }
+          return internal::NamedTransform{
+              strings::Join(names, "+"),
+              [names, predicates](InstructionSetProto* instruction_set) {
+                return internal::RunFusedRemovals(names, predicates,
+                                                  instruction_set);
+              }};
+        },
+        &transforms);
+    internal::AppendFusedTransforms(
+        indexed_transforms,
+        [](const std::vector<string>& names,
+           const std::vector<const DefaultPipelineEntry*>& entries) {
+          std::vector<IndexedInstructionSetTransformRawFunction*> functions;
+          for (const DefaultPipelineEntry* const entry : entries) {
+            functions.push_back(entry->indexed_transform);
+          }
+          return internal::MakeIndexedTransform(names, functions);
+        },
+        &transforms);
+    for (const DefaultPipelineEntry* const entry : other_transforms) {
+      transforms.push_back(entry->transform);
+    }
+    internal::AppendFusedTransforms(
+        instruction_transforms,
+        [](const std::vector<string>& names,
+           const std::vector<const DefaultPipelineEntry*>& entries) {
+          std::vector<InstructionTransformRawFunction*> functions;
+          for (const DefaultPipelineEntry* const entry : entries) {
+            functions.push_back(entry->instruction_transform);
+          }
+          return internal::NamedTransform{
+              strings::Join(names, "+"),
+              [names, functions](InstructionSetProto* instruction_set) {
+                return internal::RunFusedTransforms(names, functions,
+                                                    instruction_set);
+              }};
+        },
+        &transforms);
   }
   return transforms;
 }
 
+string GetTransformName(const InstructionSetTransform& transform) {
+  const internal::NamedTransform* const named_transform =
+      transform.target<internal::NamedTransform>();
+  return named_transform == nullptr ? string() : named_transform->name;
+}
+
+namespace {
+
+// Updates a 64-bit FNV-1a hash 'hash' with the bytes of 'data'. Unlike
+// std::hash, the result is the same in all runs and builds of the program, so
+// it can be used for naming files.
+uint64_t UpdateFnv1aHash(StringPiece data, uint64_t hash) {
+  constexpr uint64_t kFnvPrime = 0x100000001b3ULL;
+  for (const char c : data) {
+    hash ^= static_cast<unsigned char>(c);
+    hash *= kFnvPrime;
+  }
+  return hash;
+}
+
+// Returns the paths of the checkpoint files of the pipeline when it runs on
+// 'instruction_set'. The i-th element is the checkpoint of the state after
+// running the first i + 1 transforms; it is named by a hash of the input
+// instruction set and the names of these transforms. Only prefixes of the
+// pipeline where all transforms have names can be checkpointed; the returned
+// vector ends before the first transform that does not have a name.
+std::vector<string> GetCheckpointFilenames(
+    const std::vector<InstructionSetTransform>& pipeline,
+    const InstructionSetProto& instruction_set) {
+  constexpr uint64_t kFnvOffsetBasis = 0xcbf29ce484222325ULL;
+  uint64_t hash =
+      UpdateFnv1aHash(instruction_set.SerializeAsString(), kFnvOffsetBasis);
+  std::vector<string> filenames;
+  for (const InstructionSetTransform& transform : pipeline) {
+    const string name = GetTransformName(transform);
+    if (name.empty()) break;
+    // The terminating null character separates the names in the hash.
+    hash = UpdateFnv1aHash(StringPiece(name.c_str(), name.size() + 1), hash);
+    filenames.push_back(
+        StrCat(FLAGS_cpu_instructions_transform_checkpoint_dir, "/",
+               StringPrintf("%016llx",
+                            static_cast<unsigned long long>(hash)),  // NOLINT
+               ".pb"));
+  }
+  return filenames;
+}
+
+// Restores the longest prefix of the pipeline that has a checkpoint in
+// 'checkpoint_filenames' into 'instruction_set'. Returns the number of
+// transforms of the pipeline covered by the checkpoint, or 0 if there is no
+// checkpoint.
+int RestoreLongestCheckpoint(const std::vector<string>& checkpoint_filenames,
+                             InstructionSetProto* instruction_set) {
+  CHECK(instruction_set != nullptr);
+  for (int i = checkpoint_filenames.size() - 1; i >= 0; --i) {
+    std::ifstream checkpoint(checkpoint_filenames[i], std::ios::binary);
+    if (!checkpoint.is_open()) continue;
+    InstructionSetProto checkpointed_instruction_set;
+    if (!checkpointed_instruction_set.ParseFromIstream(&checkpoint)) {
+      LOG(WARNING) << "Could not parse checkpoint " << checkpoint_filenames[i];
+      continue;
+    }
+    LOG(INFO) << "Resuming the pipeline after " << i + 1
+              << " transforms from checkpoint " << checkpoint_filenames[i];
+    instruction_set->Swap(&checkpointed_instruction_set);
+    return i + 1;
+  }
+  return 0;
+}
+
+// Writes 'instruction_set' to the checkpoint file 'filename'. The checkpoint
+// is written to a temporary file first and then renamed, so that a partially
+// written checkpoint is never used. Failures to write the checkpoint are
+// logged, but they do not stop the pipeline.
+void WriteCheckpoint(const string& filename,
+                     const InstructionSetProto& instruction_set) {
+  const string temporary_filename = StrCat(filename, ".tmp");
+  {
+    std::ofstream checkpoint(temporary_filename,
+                             std::ios::binary | std::ios::trunc);
+    if (!checkpoint.is_open() ||
+        !instruction_set.SerializeToOstream(&checkpoint)) {
+      LOG(WARNING) << "Could not write checkpoint " << temporary_filename;
+      return;
+    }
+  }
+  if (std::rename(temporary_filename.c_str(), filename.c_str()) != 0) {
+    LOG(WARNING) << "Could not rename checkpoint " << temporary_filename;
+  }
+}
+
+}  // namespace
+
 Status RunTransformPipeline(
     const std::vector<InstructionSetTransform>& pipeline,
     InstructionSetProto* instruction_set) {
   CHECK(instruction_set != nullptr);
-  for (const InstructionSetTransform& transform : pipeline) {
+  const auto wall_time_start = std::chrono::steady_clock::now();
+  if (FLAGS_cpu_instructions_profile_transforms) {
+    TransformProfiles* const profiles = GetTransformProfiles();
+    std::lock_guard<std::mutex> lock(profiles->mutex);
+    profiles->current_pipeline.Clear();
+  }
+  std::vector<string> checkpoint_filenames;
+  int first_transform = 0;
+  if (!FLAGS_cpu_instructions_transform_checkpoint_dir.empty()) {
+    checkpoint_filenames = GetCheckpointFilenames(pipeline, *instruction_set);
+    first_transform =
+        RestoreLongestCheckpoint(checkpoint_filenames, instruction_set);
+  }
+  // A single index of the instruction set is shared by all indexed transforms
+  // in the pipeline. The indexed transforms keep it up to date, and it is
+  // rebuilt only after the other transforms; the index of each field is built
+  // lazily, so rebuilding it is cheap when no indexed transform follows.
+  InstructionSetIndex index(instruction_set);
+  Status status = OkStatus();
+  for (size_t i = first_transform; status.ok() && i < pipeline.size(); ++i) {
+    const InstructionSetTransform& transform = pipeline[i];
     CHECK(transform != nullptr);
-    RETURN_IF_ERROR(transform(instruction_set));
+    const internal::NamedTransform* const named_transform =
+        transform.target<internal::NamedTransform>();
+    if (named_transform != nullptr && named_transform->indexed_transform) {
+      status = named_transform->indexed_transform(&index, instruction_set);
+    } else {
+      status = transform(instruction_set);
+      index.Rebuild();
+    }
+    if (status.ok() && i < checkpoint_filenames.size()) {
+      WriteCheckpoint(checkpoint_filenames[i], *instruction_set);
+    }
   }
-  return OkStatus();
+
+  if (FLAGS_cpu_instructions_profile_transforms) {
+    TransformProfiles* const profiles = GetTransformProfiles();
+    std::lock_guard<std::mutex> lock(profiles->mutex);
+    profiles->last_pipeline.Swap(&profiles->current_pipeline);
+    profiles->current_pipeline.Clear();
+    profiles->last_pipeline.set_total_wall_time_seconds(
+        std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                      wall_time_start)
+            .count());
+    SortAndLogTransformPipelineProfile(&profiles->last_pipeline);
+    if (!FLAGS_cpu_instructions_transform_profile_file.empty()) {
+      WriteTextProtoOrDie(FLAGS_cpu_instructions_transform_profile_file,
+                          profiles->last_pipeline);
+    }
+  }
+  return status;
 }
 
+TransformPipelineProfile GetLastTransformPipelineProfile() {
+  TransformProfiles* const profiles = GetTransformProfiles();
+  std::lock_guard<std::mutex> lock(profiles->mutex);
+  return profiles->last_pipeline;
+}
+
+Status RunInstructionTransform(InstructionTransformRawFunction* transform,
+                               int num_threads,
+                               InstructionSetProto* instruction_set) {
+  return RunFusedInstructionTransforms({transform}, num_threads,
+                                       instruction_set, nullptr, nullptr);
+}
+
+namespace {
+
 // A message difference reporter that reports the differences to a string, and
-// ignores all matched & moved items.
+// ignores all matched & moved items. When 'field_path_prefix' is not empty, it
+// is prepended to the paths of all reported fields; this is used to report the
+// differences between two instructions as differences in the instruction set
+// that contains them.
 class ConciseDifferenceReporter : public MessageDifferencer::Reporter {
  public:
   explicit ConciseDifferenceReporter(string* output_string)
-      : stream_(output_string), base_reporter_(&stream_) {}
+      : ConciseDifferenceReporter(
+            output_string, std::vector<MessageDifferencer::SpecificField>()) {}
+  ConciseDifferenceReporter(
+      string* output_string,
+      std::vector<MessageDifferencer::SpecificField> field_path_prefix)
+      : stream_(output_string),
+        base_reporter_(&stream_),
+        field_path_prefix_(std::move(field_path_prefix)) {}
 
   void ReportAdded(const Message& message1, const Message& message2,
                    const std::vector<MessageDifferencer::SpecificField>&
                        field_path) override {
-    base_reporter_.ReportAdded(message1, message2, field_path);
+    base_reporter_.ReportAdded(message1, message2, GetFullPath(field_path));
   }
   void ReportDeleted(const Message& message1, const Message& message2,
                      const std::vector<MessageDifferencer::SpecificField>&
                          field_path) override {
-    base_reporter_.ReportDeleted(message1, message2, field_path);
+    base_reporter_.ReportDeleted(message1, message2, GetFullPath(field_path));
   }
   void ReportModified(const Message& message1, const Message& message2,
                       const std::vector<MessageDifferencer::SpecificField>&
                           field_path) override {
-    base_reporter_.ReportModified(message1, message2, field_path);
+    base_reporter_.ReportModified(message1, message2, GetFullPath(field_path));
   }
 
  private:
+  std::vector<MessageDifferencer::SpecificField> GetFullPath(
+      const std::vector<MessageDifferencer::SpecificField>& field_path) const {
+    std::vector<MessageDifferencer::SpecificField> full_path =
+        field_path_prefix_;
+    full_path.insert(full_path.end(), field_path.begin(), field_path.end());
+    return full_path;
+  }
+
   ::google::protobuf::io::StringOutputStream stream_;
   MessageDifferencer::StreamReporter base_reporter_;
+  const std::vector<MessageDifferencer::SpecificField> field_path_prefix_;
 };
 
+// Returns the field descriptor of InstructionSetProto.instructions.
+const FieldDescriptor* GetInstructionsField() {
+  static const FieldDescriptor* const instructions_field =
+      InstructionSetProto::descriptor()->FindFieldByName("instructions");
+  CHECK(instructions_field != nullptr);
+  return instructions_field;
+}
+
+// Returns the path to an instruction in the instruction set, for use with the
+// difference reporters. 'original_index' is the index of the instruction before
+// the transform, and 'new_index' is its index after the transform; -1 is used
+// for instructions that were added or removed by the transform.
+std::vector<MessageDifferencer::SpecificField> GetInstructionPath(
+    int original_index, int new_index) {
+  MessageDifferencer::SpecificField instruction_field;
+  instruction_field.field = GetInstructionsField();
+  instruction_field.index = original_index;
+  instruction_field.new_index = new_index;
+  return {instruction_field};
+}
+
+// Returns a human-readable diff between 'original_instruction' and
+// 'instruction', reported as changes of the instruction at 'original_index' in
+// the original instruction set that is at 'new_index' in the transformed
+// instruction set. Returns an empty string if the instructions are equal.
+string DiffInstructions(const InstructionProto& original_instruction,
+                        const InstructionProto& instruction,
+                        int original_index, int new_index) {
+  string differences;
+  {
+    // NOTE(ondrasej): The reporter flushes the changes in its destructor; see
+    // the comment in RunTransformWithDiff.
+    MessageDifferencer differencer;
+    ConciseDifferenceReporter reporter(
+        &differences, GetInstructionPath(original_index, new_index));
+    differencer.ReportDifferencesTo(&reporter);
+    differencer.Compare(original_instruction, instruction);
+  }
+  return differences;
+}
+
+// Returns a human-readable report of an instruction that was removed by the
+// transform (when 'new_index' is -1), or added by the transform (when
+// 'original_index' is -1).
+string ReportAddedOrRemovedInstruction(
+    const InstructionSetProto& original_instruction_set,
+    const InstructionSetProto& instruction_set, int original_index,
+    int new_index) {
+  string report;
+  {
+    ConciseDifferenceReporter reporter(&report);
+    const std::vector<MessageDifferencer::SpecificField> path =
+        GetInstructionPath(original_index, new_index);
+    if (new_index < 0) {
+      reporter.ReportDeleted(original_instruction_set, instruction_set, path);
+    } else {
+      reporter.ReportAdded(original_instruction_set, instruction_set, path);
+    }
+  }
+  return report;
+}
+
+// Returns a human-readable report of an instruction at 'original_index' that
+// was removed by a transform. Unlike ReportAddedOrRemovedInstruction, this does
+// not need the original instruction set; the format of the report is the same.
+string ReportRemovedInstruction(const InstructionProto& instruction,
+                                int original_index) {
+  const string value = instruction.ShortDebugString();
+  return StrCat("deleted: instructions[", original_index, "]: {",
+                value.empty() ? "" : " ", value, " }\n");
+}
+
+// Returns a copy of 'instruction_set' without the instructions. The
+// instructions are temporarily moved out of 'instruction_set', so that they are
+// not copied; 'instruction_set' is unchanged when the function returns.
+InstructionSetProto CopyWithoutInstructions(
+    InstructionSetProto* instruction_set) {
+  ::google::protobuf::RepeatedPtrField<InstructionProto> instructions;
+  instructions.Swap(instruction_set->mutable_instructions());
+  InstructionSetProto copy = *instruction_set;
+  instructions.Swap(instruction_set->mutable_instructions());
+  return copy;
+}
+
+// A snapshot of the instructions of an instruction set, taken before running a
+// transform so that the changes done by the transform can be reported. The
+// snapshot stores the fingerprints of the instructions, and the instructions
+// serialized into a single buffer. An instruction is parsed back only when the
+// transform changed it and it is compared in detail, so the snapshot is much
+// cheaper than a copy of the instruction set that allocates all the
+// submessages of all the instructions.
+class InstructionSetSnapshot {
+ public:
+  explicit InstructionSetSnapshot(const InstructionSetProto& instruction_set)
+      : fingerprints_(GetInstructionFingerprints(instruction_set)) {
+    instruction_offsets_.reserve(instruction_set.instructions_size() + 1);
+    instruction_offsets_.push_back(0);
+    for (const InstructionProto& instruction : instruction_set.instructions()) {
+      CHECK(instruction.AppendToString(&serialized_instructions_));
+      instruction_offsets_.push_back(serialized_instructions_.size());
+    }
+  }
+
+  const std::vector<Fingerprint128>& fingerprints() const {
+    return fingerprints_;
+  }
+
+  // Returns the instruction at 'index' in the instruction set at the time when
+  // the snapshot was taken.
+  InstructionProto GetInstruction(int index) const {
+    CHECK_GE(index, 0);
+    CHECK_LT(index, static_cast<int>(fingerprints_.size()));
+    const size_t begin = instruction_offsets_[index];
+    InstructionProto instruction;
+    CHECK(instruction.ParseFromArray(serialized_instructions_.data() + begin,
+                                     instruction_offsets_[index + 1] - begin));
+    return instruction;
+  }
+
+ private:
+  const std::vector<Fingerprint128> fingerprints_;
+  string serialized_instructions_;
+  std::vector<size_t> instruction_offsets_;
+};
+
+}  // namespace
+
+Status RunFusedInstructionTransforms(
+    const std::vector<InstructionTransformRawFunction*>& transforms,
+    int num_threads, InstructionSetProto* instruction_set,
+    std::vector<Status>* transform_statuses,
+    std::vector<string>* transform_diffs) {
+  CHECK(instruction_set != nullptr);
+  for (InstructionTransformRawFunction* const transform : transforms) {
+    CHECK(transform != nullptr);
+  }
+  // Each thread gets several shards, so that the threads stay busy even when
+  // some shards take longer to process than others.
+  constexpr int kShardsPerThread = 4;
+  if (num_threads <= 0) num_threads = GetDefaultNumThreads();
+  const int num_transforms = transforms.size();
+  const int num_instructions = instruction_set->instructions_size();
+  const int num_shards =
+      std::max(1, std::min(num_instructions, num_threads * kShardsPerThread));
+  const int shard_size = (num_instructions + num_shards - 1) / num_shards;
+  // The first error of each transform found in each shard, indexed by
+  // shard * num_transforms + transform. Keeping the errors per shard makes the
+  // returned status independent of the order in which the threads finish.
+  std::vector<Status> shard_statuses(num_shards * num_transforms);
+  // The diffs of each transform on each instruction, indexed by
+  // transform * num_instructions + instruction. Only used when diffs are
+  // requested.
+  std::vector<string> instruction_diffs;
+  if (transform_diffs != nullptr) {
+    instruction_diffs.resize(num_transforms * num_instructions);
+  }
+  ParallelFor(num_shards, num_threads, [&](int shard) {
+    const int begin = shard * shard_size;
+    const int end = std::min(num_instructions, begin + shard_size);
+    // In the diff mode, the instruction is copied before each transform. The
+    // copy is compared with the transformed instruction in detail only when
+    // the fingerprint of the instruction changes.
+    InstructionProto original_instruction;
+    for (int i = begin; i < end; ++i) {
+      InstructionProto* const instruction =
+          instruction_set->mutable_instructions(i);
+      for (int t = 0; t < num_transforms; ++t) {
+        Fingerprint128 original_fingerprint;
+        if (transform_diffs != nullptr) {
+          original_instruction = *instruction;
+          original_fingerprint = GetProtoFingerprint(original_instruction);
+        }
+        const Status status = transforms[t](instruction);
+        Status& shard_status = shard_statuses[shard * num_transforms + t];
+        if (!status.ok() && shard_status.ok()) shard_status = status;
+        if (transform_diffs != nullptr) {
+          if (GetProtoFingerprint(*instruction) != original_fingerprint) {
+            instruction_diffs[t * num_instructions + i] =
+                DiffInstructions(original_instruction, *instruction, i, i);
+          }
+        }
+      }
+    }
+  });
+
+  if (transform_statuses != nullptr) {
+    transform_statuses->assign(num_transforms, OkStatus());
+  }
+  if (transform_diffs != nullptr) {
+    transform_diffs->assign(num_transforms, string());
+  }
+  Status first_error = OkStatus();
+  for (int t = 0; t < num_transforms; ++t) {
+    Status transform_status = OkStatus();
+    for (int shard = 0; shard < num_shards && transform_status.ok(); ++shard) {
+      transform_status = shard_statuses[shard * num_transforms + t];
+    }
+    if (first_error.ok()) first_error = transform_status;
+    if (transform_statuses != nullptr) {
+      (*transform_statuses)[t] = transform_status;
+    }
+    if (transform_diffs != nullptr) {
+      string& diff = (*transform_diffs)[t];
+      for (int i = 0; i < num_instructions; ++i) {
+        diff += instruction_diffs[t * num_instructions + i];
+      }
+    }
+  }
+  return first_error;
+}
+
+void RemoveInstructionsIf(
+    const std::vector<InstructionRemovalPredicate*>& predicates,
+    InstructionSetProto* instruction_set,
+    std::vector<int>* num_removed_instructions,
+    std::vector<string>* predicate_diffs) {
+  CHECK(instruction_set != nullptr);
+  for (InstructionRemovalPredicate* const predicate : predicates) {
+    CHECK(predicate != nullptr);
+  }
+  const int num_predicates = predicates.size();
+  if (num_removed_instructions != nullptr) {
+    num_removed_instructions->assign(num_predicates, 0);
+  }
+  if (predicate_diffs != nullptr) {
+    predicate_diffs->assign(num_predicates, string());
+  }
+  ::google::protobuf::RepeatedPtrField<InstructionProto>* const instructions =
+      instruction_set->mutable_instructions();
+  const int num_instructions = instructions->size();
+  // The instructions that are kept are moved to the beginning of the list by
+  // swapping the pointers, and the removed instructions end up at its end,
+  // where they are deleted all at once. The elements at positions [i, end) are
+  // not touched before the instruction at position i is evaluated, so the
+  // removed instructions can be reported using their original index.
+  int num_kept_instructions = 0;
+  for (int i = 0; i < num_instructions; ++i) {
+    const InstructionProto& instruction = instructions->Get(i);
+    int removing_predicate = -1;
+    for (int p = 0; p < num_predicates; ++p) {
+      if (predicates[p](instruction)) {
+        removing_predicate = p;
+        break;
+      }
+    }
+    if (removing_predicate < 0) {
+      if (num_kept_instructions != i) {
+        instructions->SwapElements(num_kept_instructions, i);
+      }
+      ++num_kept_instructions;
+      continue;
+    }
+    if (num_removed_instructions != nullptr) {
+      ++(*num_removed_instructions)[removing_predicate];
+    }
+    if (predicate_diffs != nullptr) {
+      (*predicate_diffs)[removing_predicate] += ReportAddedOrRemovedInstruction(
+          *instruction_set, *instruction_set, i, -1);
+    }
+  }
+  instructions->DeleteSubrange(num_kept_instructions,
+                               num_instructions - num_kept_instructions);
+}
+
 StatusOr<string> RunTransformWithDiff(const InstructionSetTransform& transform,
                                       InstructionSetProto* instruction_set) {
   CHECK(instruction_set != nullptr);
-  InstructionSetProto original_instruction_set = *instruction_set;
+  // Only the fields outside of the instructions are copied. The instructions
+  // are stored in a compact snapshot, and only the instructions changed by the
+  // transform are restored from it.
+  const InstructionSetProto original_instruction_set =
+      CopyWithoutInstructions(instruction_set);
+  const InstructionSetSnapshot original_instructions(*instruction_set);
 
   RETURN_IF_ERROR(transform(instruction_set));
 
@@ -193,56 +1147,89 @@ StatusOr<string> RunTransformWithDiff(const InstructionSetTransform& transform,
     ConciseDifferenceReporter reporter(&differences);
     differencer.ReportDifferencesTo(&reporter);
 
-    const FieldDescriptor* const instructions_field =
-        instruction_set->GetDescriptor()->FindFieldByName("instructions");
-    CHECK(instructions_field != nullptr);
-    differencer.TreatAsSet(instructions_field);
+    // The instructions are compared separately below.
+    differencer.IgnoreField(GetInstructionsField());
 
     // NOTE(ondrasej): We are only interested in the string diff; we can safely
     // ignore the return value saying whether the two are equivalent or not.
     differencer.Compare(original_instruction_set, *instruction_set);
   }
 
+  // Only the instructions changed by the transform are compared in detail.
+  const std::vector<std::pair<int, int>> changes =
+      FindChangedInstructions(original_instructions.fingerprints(),
+                              GetInstructionFingerprints(*instruction_set));
+  for (const auto& change : changes) {
+    const int original_index = change.first;
+    const int new_index = change.second;
+    if (original_index < 0) {
+      differences += ReportAddedOrRemovedInstruction(
+          original_instruction_set, *instruction_set, original_index,
+          new_index);
+    } else if (new_index < 0) {
+      differences += ReportRemovedInstruction(
+          original_instructions.GetInstruction(original_index),
+          original_index);
+    } else {
+      differences += DiffInstructions(
+          original_instructions.GetInstruction(original_index),
+          instruction_set->instructions(new_index), original_index, new_index);
+    }
+  }
+
   return differences;
 }
 
 namespace {
 
-bool LessOrEqual(const InstructionProto& instruction_a,
-                 const InstructionProto& instruction_b) {
-  const InstructionFormat& vendor_syntax_a = instruction_a.vendor_syntax();
-  const InstructionFormat& vendor_syntax_b = instruction_b.vendor_syntax();
-
-  int comparison = 0;
-
-  // 1. Compare mnemonics.
-  comparison = vendor_syntax_a.mnemonic().compare(vendor_syntax_b.mnemonic());
-
-  // 2. Compare the number of operands.
-  if (comparison == 0) {
-    comparison =
-        vendor_syntax_b.operands_size() - vendor_syntax_a.operands_size();
+// Appends 'str' to 'key' so that comparing the keys of two strings gives the
+// same result as comparing the strings, and so that the encoding of a string is
+// never a proper prefix of the encoding of another string: NUL bytes are
+// escaped as "\0\1" and the encoded string is terminated by "\0\0".
+void AppendOrderPreservingString(const string& str, string* key) {
+  for (const char c : str) {
+    key->push_back(c);
+    if (c == '\0') key->push_back('\1');
   }
+  key->append(2, '\0');
+}
 
-  // 3. Compare the operands.
-  if (comparison == 0) {
-    const int num_operands = vendor_syntax_a.operands_size();
-    for (int operand_index = 0; comparison == 0 && operand_index < num_operands;
-         ++operand_index) {
-      const string& operand_a = vendor_syntax_a.operands(operand_index).name();
-      const string& operand_b = vendor_syntax_b.operands(operand_index).name();
-      comparison = operand_a.compare(operand_b);
-    }
+// Returns the sort key of 'instruction'. Comparing the sort keys of two
+// instructions orders them by:
+// 1. the mnemonic,
+// 2. the number of operands, from the instructions with most operands,
+// 3. the names of the operands,
+// 4. the raw encoding specification.
+string GetVendorSyntaxSortKey(const InstructionProto& instruction) {
+  const InstructionFormat& vendor_syntax = instruction.vendor_syntax();
+  string key;
+  AppendOrderPreservingString(vendor_syntax.mnemonic(), &key);
+  // The number of operands is stored inverted and in the big endian order, so
+  // that the byte order of the keys is the decreasing order of the counts.
+  const uint32_t inverted_num_operands =
+      ~static_cast<uint32_t>(vendor_syntax.operands_size());
+  for (int shift = 24; shift >= 0; shift -= 8) {
+    key.push_back(static_cast<char>((inverted_num_operands >> shift) & 0xff));
   }
-
-  // 4. Compare binary encodings.
-  if (comparison == 0) {
-    const string& specification_a = instruction_a.raw_encoding_specification();
-    const string& specification_b = instruction_b.raw_encoding_specification();
-    comparison = specification_a.compare(specification_b);
+  for (const InstructionOperand& operand : vendor_syntax.operands()) {
+    AppendOrderPreservingString(operand.name(), &key);
   }
+  AppendOrderPreservingString(instruction.raw_encoding_specification(), &key);
+  return key;
+}
 
-  return comparison < 0;
+// An instruction in SortByVendorSyntax: its sort key, and its index in the
+// instruction set before sorting.
+struct InstructionSortKey {
+  string key;
+  int index;
+};
+
+// Orders the instructions by their keys. Instructions with the same key keep
+// their original relative order.
+bool operator<(const InstructionSortKey& a, const InstructionSortKey& b) {
+  const int comparison = a.key.compare(b.key);
+  return comparison < 0 || (comparison == 0 && a.index < b.index);
 }
 
 }  // namespace
@@ -251,7 +1238,25 @@ Status SortByVendorSyntax(InstructionSetProto* instruction_set) {
   CHECK(instruction_set != nullptr);
   google::protobuf::RepeatedPtrField<InstructionProto>* const instructions =
       instruction_set->mutable_instructions();
-  std::sort(instructions->begin(), instructions->end(), LessOrEqual);
+  const int num_instructions = instructions->size();
+  // The sort keys are computed once per instruction, so that the comparisons
+  // done by the sort compare just two strings.
+  std::vector<InstructionSortKey> sort_keys(num_instructions);
+  ParallelFor(num_instructions, FLAGS_cpu_instructions_transform_num_threads,
+              [instructions, &sort_keys](int i) {
+                sort_keys[i].key = GetVendorSyntaxSortKey(instructions->Get(i));
+                sort_keys[i].index = i;
+              });
+  ParallelSort(&sort_keys, FLAGS_cpu_instructions_transform_num_threads,
+               std::less<InstructionSortKey>());
+  // Reorder the instructions by moving the pointers in the repeated field; the
+  // instruction protos themselves are neither copied nor swapped.
+  const std::vector<InstructionProto*> original_order(
+      instructions->pointer_begin(), instructions->pointer_end());
+  InstructionProto** const sorted_order = instructions->mutable_data();
+  for (int i = 0; i < num_instructions; ++i) {
+    sorted_order[i] = original_order[sort_keys[i].index];
+  }
   return OkStatus();
 }
 REGISTER_INSTRUCTION_SET_TRANSFORM(SortByVendorSyntax, 7000);
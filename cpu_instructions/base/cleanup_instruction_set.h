@@ -24,10 +24,16 @@
 #include <vector>
 #include "strings/string.h"
 
+#include "cpu_instructions/base/instruction_set_index.h"
 #include "cpu_instructions/proto/instructions.pb.h"
+#include "cpu_instructions/proto/transform_profile.pb.h"
+#include "gflags/gflags.h"
 #include "util/task/status.h"
 #include "util/task/statusor.h"
 
+DECLARE_string(cpu_instructions_transform_checkpoint_dir);
+DECLARE_bool(cpu_instructions_profile_transforms);
+
 namespace cpu_instructions {
 
 using ::cpu_instructions::util::Status;
@@ -40,6 +46,30 @@ using ::cpu_instructions::util::StatusOr;
 using InstructionSetTransformRawFunction = Status(InstructionSetProto*);
 using InstructionSetTransform = std::function<Status(InstructionSetProto*)>;
 
+// The type of per-instruction transforms. These are transforms that modify each
+// instruction independently of all other instructions in the instruction set,
+// and they can be registered using REGISTER_INSTRUCTION_TRANSFORM. The pipeline
+// runs them on the instructions of the instruction set in parallel, so they
+// must be thread-safe.
+using InstructionTransformRawFunction = Status(InstructionProto*);
+
+// The type of instruction removal predicates. A removal predicate returns true
+// for instructions that should be removed from the instruction set, and it
+// decides for each instruction independently of all other instructions. The
+// predicates can be registered as transforms using
+// REGISTER_INSTRUCTION_REMOVAL.
+using InstructionRemovalPredicate = bool(const InstructionProto&);
+
+// The type of indexed transforms. These are transforms that modify only a small
+// number of instructions, and that find them using an InstructionSetIndex
+// instead of scanning the whole instruction set. They can be registered using
+// REGISTER_INDEXED_INSTRUCTION_SET_TRANSFORM. The index passed to the transform
+// is up to date when the transform starts, and the transform must keep it up to
+// date when it modifies the instruction set (see InstructionSetIndex for the
+// details).
+using IndexedInstructionSetTransformRawFunction =
+    Status(InstructionSetIndex*, InstructionSetProto*);
+
 // The list of instruction database transforms indexed by their names.
 using InstructionSetTransformsByName =
     std::unordered_map<string, InstructionSetTransform>;
@@ -55,23 +85,130 @@ const InstructionSetTransformsByName& GetTransformsByName();
 // Note that some of the transforms expect that another transform was already
 // executed, and they might not function correctly if this assumption is
 // violated. The vector contains the transforms in the correct order.
+//
+// The order of transforms with the same rank is not defined. The pipeline
+// groups them by their kind: removals first, then indexed transforms, then the
+// other instruction set transforms, and finally per-instruction transforms.
+// The per-instruction transforms of each group are fused into a single element
+// of the pipeline, that applies all of them to each instruction in a single
+// sweep over the instruction set (see RunFusedInstructionTransforms).
+// Similarly, the removals of each group are fused into a single element that
+// removes the instructions in a single pass over the instruction set (see
+// RemoveInstructionsIf). The names, the statuses and the diffs of the fused
+// transforms are still logged separately for each transform; for removals, the
+// log also contains the number of instructions removed by each of them. The
+// indexed transforms of each group still run one by one; when they run in
+// RunTransformPipeline, they share a single InstructionSetIndex (see below).
 std::vector<InstructionSetTransform> GetDefaultTransformPipeline();
 
 // Runs the given transform on the given instruction set proto, and computes a
 // diff of the changes made by the transform. The changes are returned as a
 // human-readable string; the returned string is empty if and only if the
-// transform did not make any changes to the proto.
+// transform did not make any changes to the proto, ignoring the order of the
+// instructions.
+//
+// The instructions before and after the transform are matched using their
+// fingerprints, and only the instructions that were not matched are compared in
+// detail: an unmatched instruction that stays at the same index is reported as
+// modified, and all other unmatched instructions are reported as removed or
+// added. The instruction set is not copied before the transform: only the
+// fingerprints and a serialized snapshot of the instructions are stored, and
+// only the original instructions changed by the transform are restored from the
+// snapshot. Thus, the cost of the diff is linear in the size of the instruction
+// set plus the size of the changes.
 StatusOr<string> RunTransformWithDiff(const InstructionSetTransform& transform,
                                       InstructionSetProto* instruction_set);
 
+// Returns the name of the transform, if it was obtained from
+// GetTransformsByName() or GetDefaultTransformPipeline(); the name of a fused
+// element of the default pipeline is the names of its transforms joined by '+'.
+// Returns an empty string for all other transforms.
+string GetTransformName(const InstructionSetTransform& transform);
+
 // Runs all transforms from 'pipeline' on the given instruction set proto.
 // Returns Status::OK if all transform succeeds; otherwise, stops on the first
 // transform that fails. The state of the instruction set proto after a failure
 // is undefined.
+//
+// When --cpu_instructions_transform_checkpoint_dir is set, the state of the
+// instruction set after each transform is stored in that directory, identified
+// by the input instruction set and the names of the transforms that were
+// executed (see GetTransformName). The pipeline then starts after the longest
+// prefix of the pipeline that has a checkpoint for the same input. Only
+// prefixes where all transforms have names are checkpointed.
+//
+// All the indexed transforms in the pipeline share a single index of the
+// instruction set. The index is rebuilt after each transform that is not an
+// indexed transform; the indexed transforms keep it up to date themselves.
+//
+// When --cpu_instructions_profile_transforms is set, the function measures the
+// time spent in each registered transform and the changes it made to the
+// instruction set, and at the end of the pipeline, it prints the profile to the
+// log and stores it in a TransformPipelineProfile proto; see
+// GetLastTransformPipelineProfile.
 Status RunTransformPipeline(
     const std::vector<InstructionSetTransform>& pipeline,
     InstructionSetProto* instruction_set);
 
+// Returns the profile collected by the last call to RunTransformPipeline with
+// --cpu_instructions_profile_transforms. The transforms in the profile are
+// sorted by their wall time in descending order.
+TransformPipelineProfile GetLastTransformPipelineProfile();
+
+// Runs the per-instruction transform 'transform' on all instructions in the
+// given instruction set proto. The instructions are split into contiguous
+// shards that are processed using up to 'num_threads' threads; when
+// 'num_threads' is smaller or equal to zero, the number of threads is chosen
+// automatically. The transform is applied to all instructions even if it fails
+// on some of them. Returns Status::OK if the transform succeeded on all
+// instructions; otherwise, returns the error of the first instruction (in the
+// order of the instructions in the instruction set) on which it failed, so that
+// the result does not depend on the number of threads.
+Status RunInstructionTransform(InstructionTransformRawFunction* transform,
+                               int num_threads,
+                               InstructionSetProto* instruction_set);
+
+// Runs a sequence of per-instruction transforms on all instructions in the
+// given instruction set proto in a single sweep: all the transforms are applied
+// to an instruction, in the order in which they appear in 'transforms', before
+// moving to the next instruction. Because each transform depends only on the
+// instruction it modifies, the result is the same as running the transforms
+// one by one using RunInstructionTransform, but each instruction is loaded to
+// the cache only once.
+//
+// When 'transform_statuses' is not nullptr, it receives the status of each
+// transform, with the same semantics as the status of RunInstructionTransform.
+// When 'transform_diffs' is not nullptr, it receives a human-readable diff of
+// the changes done by each transform; the string is empty if and only if the
+// transform did not change any instruction. Returns Status::OK if all
+// transforms succeeded; otherwise, returns the status of the first transform in
+// 'transforms' that failed.
+Status RunFusedInstructionTransforms(
+    const std::vector<InstructionTransformRawFunction*>& transforms,
+    int num_threads, InstructionSetProto* instruction_set,
+    std::vector<Status>* transform_statuses,
+    std::vector<string>* transform_diffs);
+
+// Removes from the given instruction set proto all instructions for which at
+// least one of 'predicates' returns true. The instructions are removed in a
+// single pass over the instruction set that only moves pointers to the
+// instructions, and the remaining instructions keep their relative order. The
+// predicates are evaluated in the order in which they appear in 'predicates',
+// and each removed instruction is attributed to the first predicate that
+// returned true for it; this gives the same attribution as removing the
+// instructions using one predicate at a time.
+//
+// When 'num_removed_instructions' is not nullptr, it receives the number of
+// instructions removed by each predicate. When 'predicate_diffs' is not
+// nullptr, it receives a human-readable diff listing the instructions removed
+// by each predicate; the string is empty if and only if the predicate did not
+// remove any instruction.
+void RemoveInstructionsIf(
+    const std::vector<InstructionRemovalPredicate*>& predicates,
+    InstructionSetProto* instruction_set,
+    std::vector<int>* num_removed_instructions,
+    std::vector<string>* predicate_diffs);
+
 // Sorts the instructions by their vendor syntax. The sorting criteria are:
 // 1. The mnemonic (lexicographical order),
 // 2. The number of operands (instructions with less operands come first),
@@ -95,6 +232,34 @@ Status SortByVendorSyntax(InstructionSetProto* instruction_set);
       register_transform_##transform(#transform, rank_in_default_pipeline, \
                                      transform)
 
+// A registration mechanism for per-instruction transforms. The transform is
+// registered the same way as with REGISTER_INSTRUCTION_SET_TRANSFORM, and it is
+// run on the instructions using RunInstructionTransform with the number of
+// threads given by --cpu_instructions_transform_num_threads.
+#define REGISTER_INSTRUCTION_TRANSFORM(transform, rank_in_default_pipeline)  \
+  ::cpu_instructions::internal::RegisterInstructionSetTransform            \
+      register_transform_##transform(#transform, rank_in_default_pipeline, \
+                                     transform)
+
+// A registration mechanism for transforms that remove instructions. Registers a
+// transform named 'transform' that removes all instructions for which
+// 'predicate' returns true using RemoveInstructionsIf. The transform is
+// registered the same way as with REGISTER_INSTRUCTION_SET_TRANSFORM.
+#define REGISTER_INSTRUCTION_REMOVAL(transform, predicate,                 \
+                                     rank_in_default_pipeline)             \
+  ::cpu_instructions::internal::RegisterInstructionSetTransform            \
+      register_transform_##transform(#transform, rank_in_default_pipeline, \
+                                     predicate)
+
+// A registration mechanism for indexed transforms. The transform is registered
+// the same way as with REGISTER_INSTRUCTION_SET_TRANSFORM; when it is not fused
+// with other indexed transforms, it gets an index created just for it.
+#define REGISTER_INDEXED_INSTRUCTION_SET_TRANSFORM(transform,              \
+                                                   rank_in_default_pipeline) \
+  ::cpu_instructions::internal::RegisterInstructionSetTransform            \
+      register_transform_##transform(#transform, rank_in_default_pipeline, \
+                                     transform)
+
 // A special value passed to REGISTER_INSTRUCTION_SET_TRANSFORM for transforms
 // that are not included in the default pipeline.
 constexpr int kNotInDefaultPipeline = std::numeric_limits<int>::max();
@@ -108,6 +273,31 @@ class RegisterInstructionSetTransform {
   RegisterInstructionSetTransform(const string& transform_name,
                                   int rank_in_default_pipeline,
                                   InstructionSetTransformRawFunction transform);
+  RegisterInstructionSetTransform(const string& transform_name,
+                                  int rank_in_default_pipeline,
+                                  InstructionTransformRawFunction transform);
+  RegisterInstructionSetTransform(const string& transform_name,
+                                  int rank_in_default_pipeline,
+                                  InstructionRemovalPredicate predicate);
+  RegisterInstructionSetTransform(
+      const string& transform_name, int rank_in_default_pipeline,
+      IndexedInstructionSetTransformRawFunction transform);
+
+ private:
+  // Registers 'transform' under the given name. The name is also used when
+  // logging the progress of the pipeline. For per-instruction transforms,
+  // 'instruction_transform' is the per-instruction function wrapped by
+  // 'transform', and it is used to fuse the transform with its neighbors in the
+  // default pipeline; for all other transforms, it is nullptr. Similarly, for
+  // removal transforms, 'removal_predicate' is the predicate used by
+  // 'transform', and for indexed transforms, 'indexed_transform' is the
+  // function wrapped by 'transform'; they are nullptr for all other transforms.
+  static void Register(
+      const string& transform_name, int rank_in_default_pipeline,
+      const InstructionSetTransform& transform,
+      InstructionTransformRawFunction* instruction_transform,
+      InstructionRemovalPredicate* removal_predicate,
+      IndexedInstructionSetTransformRawFunction* indexed_transform);
 };
 
 }  // namespace internal
@@ -14,13 +14,16 @@
 
 #include "cpu_instructions/base/cleanup_instruction_set.h"
 
+#include <stdlib.h>
 #include <functional>
+#include <map>
 
 #include "cpu_instructions/base/cleanup_instruction_set_test_utils.h"
 #include "glog/logging.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "src/google/protobuf/text_format.h"
+#include "strings/str_cat.h"
 #include "util/task/canonical_errors.h"
 #include "util/task/status.h"
 
@@ -49,6 +52,103 @@ TEST(GetDefaultTransformPipelineTest, ReturnedVectorIsNotEmpty) {
   EXPECT_GT(transforms.size(), 0);
 }
 
+// Two dummy per-instruction transforms registered with the same rank. The
+// second one depends on the changes done by the first one.
+Status AddTestedFeatureName(InstructionProto* instruction) {
+  instruction->set_feature_name("TESTED");
+  return OkStatus();
+}
+REGISTER_INSTRUCTION_TRANSFORM(AddTestedFeatureName, 100);
+
+// A dummy instruction set transform registered with the same rank as the
+// per-instruction transforms, and between them. The per-instruction transforms
+// are still fused, and they run after this transform.
+Status AddUntestedFeatureName(InstructionSetProto* instruction_set) {
+  for (InstructionProto& instruction :
+       *instruction_set->mutable_instructions()) {
+    instruction.set_feature_name("UNTESTED");
+  }
+  return OkStatus();
+}
+REGISTER_INSTRUCTION_SET_TRANSFORM(AddUntestedFeatureName, 100);
+
+Status CopyFeatureNameToLlvmMnemonic(InstructionProto* instruction) {
+  instruction->set_llvm_mnemonic(instruction->feature_name());
+  return OkStatus();
+}
+REGISTER_INSTRUCTION_TRANSFORM(CopyFeatureNameToLlvmMnemonic, 100);
+
+// Two dummy removal predicates registered with the same rank.
+bool IsHltInstruction(const InstructionProto& instruction) {
+  return instruction.vendor_syntax().mnemonic() == "HLT";
+}
+REGISTER_INSTRUCTION_REMOVAL(RemoveHltInstructions, IsHltInstruction, 50);
+
+bool IsUd2Instruction(const InstructionProto& instruction) {
+  return instruction.vendor_syntax().mnemonic() == "UD2";
+}
+REGISTER_INSTRUCTION_REMOVAL(RemoveUd2Instructions, IsUd2Instruction, 50);
+
+// Two dummy indexed transforms registered with the same rank. The second one
+// depends on the changes done by the first one, and it finds them through the
+// shared index.
+Status RenameCldInstructions(InstructionSetIndex* index,
+                             InstructionSetProto* instruction_set) {
+  for (const int position : index->FindByMnemonic("CLD")) {
+    instruction_set->mutable_instructions(position)
+        ->mutable_vendor_syntax()
+        ->set_mnemonic("CLD2");
+    index->UpdateInstruction(position);
+  }
+  return OkStatus();
+}
+REGISTER_INDEXED_INSTRUCTION_SET_TRANSFORM(RenameCldInstructions, 150);
+
+Status DuplicateRenamedCldInstructions(InstructionSetIndex* index,
+                                       InstructionSetProto* instruction_set) {
+  for (const int position : index->FindByMnemonic("CLD2")) {
+    InstructionProto* const new_instruction =
+        instruction_set->add_instructions();
+    *new_instruction = instruction_set->instructions(position);
+    new_instruction->mutable_vendor_syntax()->set_mnemonic("CLD3");
+  }
+  index->UpdateAddedInstructions();
+  return OkStatus();
+}
+REGISTER_INDEXED_INSTRUCTION_SET_TRANSFORM(DuplicateRenamedCldInstructions,
+                                           150);
+
+TEST(GetDefaultTransformPipelineTest, FusesTransforms) {
+  // The default pipeline of the test contains the two removals, the two
+  // per-instruction transforms, the instruction set transform and the two
+  // indexed transforms above, and SortByVendorSyntax. The transforms in each
+  // pair have the same rank, and each pair is fused into a single element.
+  const std::vector<InstructionSetTransform> transforms =
+      GetDefaultTransformPipeline();
+  EXPECT_EQ(transforms.size(), 5);
+
+  constexpr char kInstructionSetProto[] = R"(
+      instructions { vendor_syntax { mnemonic: 'HLT' }}
+      instructions { vendor_syntax { mnemonic: 'STD' }}
+      instructions { vendor_syntax { mnemonic: 'UD2' }}
+      instructions { vendor_syntax { mnemonic: 'CLD' }})";
+  constexpr char kExpectedInstructionSetProto[] = R"(
+      instructions {
+        vendor_syntax { mnemonic: 'CLD2' }
+        feature_name: 'TESTED' llvm_mnemonic: 'TESTED' }
+      instructions {
+        vendor_syntax { mnemonic: 'CLD3' }
+        feature_name: 'TESTED' llvm_mnemonic: 'TESTED' }
+      instructions {
+        vendor_syntax { mnemonic: 'STD' }
+        feature_name: 'TESTED' llvm_mnemonic: 'TESTED' })";
+  TestTransform(
+      [&transforms](InstructionSetProto* instruction_set) {
+        return RunTransformPipeline(transforms, instruction_set);
+      },
+      kInstructionSetProto, kExpectedInstructionSetProto);
+}
+
 TEST(RunTransformWithDiffTest, NoDifference) {
   constexpr char kInstructionSetProto[] = R"(
       instructions {
@@ -77,6 +177,8 @@ Status DeleteSecondInstruction(InstructionSetProto* instruction_set) {
   instructions->erase(instructions->begin() + 1);
   return OkStatus();
 }
+REGISTER_INSTRUCTION_SET_TRANSFORM(DeleteSecondInstruction,
+                                   kNotInDefaultPipeline);
 
 TEST(RunTransformWithDiffTest, WithDifference) {
   constexpr char kInstructionSetProto[] = R"(
@@ -105,6 +207,72 @@ TEST(RunTransformWithDiffTest, WithDifference) {
   EXPECT_EQ(diff_or_status.ValueOrDie(), kExpectedDiff);
 }
 
+// A dummy transform that modifies the first instruction, adds a new instruction
+// and swaps the remaining instructions.
+Status ModifyAddAndSwapInstructions(InstructionSetProto* instruction_set) {
+  CHECK(instruction_set != nullptr);
+  RepeatedPtrField<InstructionProto>* const instructions =
+      instruction_set->mutable_instructions();
+  instructions->Mutable(0)->set_feature_name("X87");
+  instructions->SwapElements(1, 2);
+  instructions->Add()->mutable_vendor_syntax()->set_mnemonic("NOP");
+  return OkStatus();
+}
+
+TEST(RunTransformWithDiffTest, ModifiedAddedAndMovedInstructions) {
+  constexpr char kInstructionSetProto[] = R"(
+      instructions {
+        vendor_syntax { mnemonic: 'FLD1' } feature_name: 'X86'
+        raw_encoding_specification: 'D9 E8' }
+      instructions {
+        vendor_syntax { mnemonic: 'INS' operands { name: 'm8' }
+                        operands { name: 'DX' }}
+        encoding_scheme: 'NP' raw_encoding_specification: '6C' }
+      instructions {
+        vendor_syntax { mnemonic: 'INS' operands { name: 'm16' }
+                        operands { name: 'DX' }}
+        encoding_scheme: 'NP' raw_encoding_specification: '6D' })";
+  // The swapped instructions are not reported.
+  constexpr char kExpectedDiff[] =
+      "modified: instructions[0].feature_name: \"X86\" -> \"X87\"\n"
+      "added: instructions[3]: { vendor_syntax { mnemonic: \"NOP\" } }\n";
+  InstructionSetProto instruction_set;
+  ASSERT_TRUE(
+      TextFormat::ParseFromString(kInstructionSetProto, &instruction_set));
+  const StatusOr<string> diff_or_status =
+      RunTransformWithDiff(ModifyAddAndSwapInstructions, &instruction_set);
+  ASSERT_OK(diff_or_status.status());
+  EXPECT_EQ(diff_or_status.ValueOrDie(), kExpectedDiff);
+}
+
+// A dummy transform that removes the first instruction and adds a source info
+// to the instruction set.
+Status RemoveFirstInstructionAndAddSource(
+    InstructionSetProto* instruction_set) {
+  CHECK(instruction_set != nullptr);
+  RepeatedPtrField<InstructionProto>* const instructions =
+      instruction_set->mutable_instructions();
+  instructions->erase(instructions->begin());
+  instruction_set->add_source_infos()->set_source_name("test");
+  return OkStatus();
+}
+
+TEST(RunTransformWithDiffTest, RemovedEmptyInstructionAndChangedSources) {
+  constexpr char kInstructionSetProto[] = R"(
+      instructions {}
+      instructions { vendor_syntax { mnemonic: 'NOP' }})";
+  constexpr char kExpectedDiff[] =
+      "added: source_infos[0]: { source_name: \"test\" }\n"
+      "deleted: instructions[0]: { }\n";
+  InstructionSetProto instruction_set;
+  ASSERT_TRUE(
+      TextFormat::ParseFromString(kInstructionSetProto, &instruction_set));
+  const StatusOr<string> diff_or_status = RunTransformWithDiff(
+      RemoveFirstInstructionAndAddSource, &instruction_set);
+  ASSERT_OK(diff_or_status.status());
+  EXPECT_EQ(diff_or_status.ValueOrDie(), kExpectedDiff);
+}
+
 // A dummy transform that immediately returns an error.
 Status ReturnErrorInsteadOfTransforming(InstructionSetProto* instruction_set) {
   return InvalidArgumentError("I do not transform!");
@@ -127,6 +295,261 @@ TEST(RunTransformWithDiffTest, WithError) {
   EXPECT_EQ(diff_or_status.status().error_message(), "I do not transform!");
 }
 
+// A dummy per-instruction transform that sets the feature name of the
+// instruction, and fails on instructions whose mnemonic starts with "FAIL".
+Status SetFeatureNameOrFail(InstructionProto* instruction) {
+  CHECK(instruction != nullptr);
+  instruction->set_feature_name("TESTED");
+  const string& mnemonic = instruction->vendor_syntax().mnemonic();
+  if (mnemonic.compare(0, 4, "FAIL") == 0) {
+    return InvalidArgumentError(mnemonic);
+  }
+  return OkStatus();
+}
+
+TEST(RunInstructionTransformTest, TransformsAllInstructions) {
+  constexpr int kNumInstructions = 1000;
+  for (const int num_threads : {0, 1, 4}) {
+    SCOPED_TRACE(num_threads);
+    InstructionSetProto instruction_set;
+    for (int i = 0; i < kNumInstructions; ++i) {
+      instruction_set.add_instructions()->mutable_vendor_syntax()->set_mnemonic(
+          "NOP");
+    }
+    ASSERT_OK(RunInstructionTransform(SetFeatureNameOrFail, num_threads,
+                                      &instruction_set));
+    for (const InstructionProto& instruction : instruction_set.instructions()) {
+      EXPECT_EQ(instruction.feature_name(), "TESTED");
+    }
+  }
+}
+
+TEST(RunInstructionTransformTest, ReturnsErrorOfFirstFailedInstruction) {
+  constexpr int kNumInstructions = 1000;
+  for (const int num_threads : {1, 2, 8}) {
+    SCOPED_TRACE(num_threads);
+    InstructionSetProto instruction_set;
+    for (int i = 0; i < kNumInstructions; ++i) {
+      instruction_set.add_instructions()->mutable_vendor_syntax()->set_mnemonic(
+          i % 300 == 299 ? StrCat("FAIL", i) : "NOP");
+    }
+    const Status status = RunInstructionTransform(
+        SetFeatureNameOrFail, num_threads, &instruction_set);
+    EXPECT_EQ(status.error_code(), INVALID_ARGUMENT);
+    EXPECT_EQ(status.error_message(), "FAIL299");
+    // The transform is applied also to the instructions after the first
+    // failure.
+    for (const InstructionProto& instruction : instruction_set.instructions()) {
+      EXPECT_EQ(instruction.feature_name(), "TESTED");
+    }
+  }
+}
+
+// A dummy transform that counts how many times it was called.
+int num_counted_transform_calls = 0;
+Status CountedTransform(InstructionSetProto* instruction_set) {
+  ++num_counted_transform_calls;
+  return OkStatus();
+}
+REGISTER_INSTRUCTION_SET_TRANSFORM(CountedTransform, kNotInDefaultPipeline);
+
+TEST(GetTransformNameTest, RegisteredAndUnregisteredTransforms) {
+  const InstructionSetTransformsByName& transforms = GetTransformsByName();
+  EXPECT_EQ(GetTransformName(transforms.at("CountedTransform")),
+            "CountedTransform");
+  EXPECT_EQ(GetTransformName(CountedTransform), "");
+  const std::vector<InstructionSetTransform> pipeline =
+      GetDefaultTransformPipeline();
+  EXPECT_EQ(GetTransformName(pipeline[0]),
+            "RemoveHltInstructions+RemoveUd2Instructions");
+  EXPECT_EQ(GetTransformName(pipeline[1]), "AddUntestedFeatureName");
+  EXPECT_EQ(GetTransformName(pipeline[2]),
+            "AddTestedFeatureName+CopyFeatureNameToLlvmMnemonic");
+  EXPECT_EQ(GetTransformName(pipeline[3]),
+            "RenameCldInstructions+DuplicateRenamedCldInstructions");
+}
+
+TEST(RunTransformPipelineTest, ResumesFromCheckpoint) {
+  FLAGS_cpu_instructions_transform_checkpoint_dir = getenv("TEST_TMPDIR");
+  const InstructionSetTransformsByName& transforms = GetTransformsByName();
+  int num_unnamed_transform_calls = 0;
+  // The last transform does not have a name, and it is never checkpointed.
+  const std::vector<InstructionSetTransform> pipeline = {
+      transforms.at("CountedTransform"), transforms.at("AddTestedFeatureName"),
+      [&num_unnamed_transform_calls](InstructionSetProto*) {
+        ++num_unnamed_transform_calls;
+        return OkStatus();
+      }};
+  constexpr char kInstructionSetProto[] = R"(
+      instructions { vendor_syntax { mnemonic: 'CHECKPOINTED' }})";
+  constexpr char kExpectedInstructionSetProto[] = R"(
+      instructions {
+        vendor_syntax { mnemonic: 'CHECKPOINTED' }
+        feature_name: 'TESTED' })";
+  num_counted_transform_calls = 0;
+  for (int i = 0; i < 2; ++i) {
+    TestTransform(
+        [&pipeline](InstructionSetProto* instruction_set) {
+          return RunTransformPipeline(pipeline, instruction_set);
+        },
+        kInstructionSetProto, kExpectedInstructionSetProto);
+  }
+  // The second run resumed after the second transform.
+  EXPECT_EQ(num_counted_transform_calls, 1);
+  EXPECT_EQ(num_unnamed_transform_calls, 2);
+
+  // A different input does not use the checkpoints.
+  constexpr char kOtherInstructionSetProto[] = R"(
+      instructions { vendor_syntax { mnemonic: 'NOT_CHECKPOINTED' }})";
+  constexpr char kOtherExpectedInstructionSetProto[] = R"(
+      instructions {
+        vendor_syntax { mnemonic: 'NOT_CHECKPOINTED' }
+        feature_name: 'TESTED' })";
+  TestTransform(
+      [&pipeline](InstructionSetProto* instruction_set) {
+        return RunTransformPipeline(pipeline, instruction_set);
+      },
+      kOtherInstructionSetProto, kOtherExpectedInstructionSetProto);
+  EXPECT_EQ(num_counted_transform_calls, 2);
+  EXPECT_EQ(num_unnamed_transform_calls, 3);
+  FLAGS_cpu_instructions_transform_checkpoint_dir = "";
+}
+
+TEST(RunTransformPipelineTest, SharesIndexBetweenIndexedTransforms) {
+  // The indexed transforms share the index of the pipeline. The transform
+  // between them moves the instructions, and the index must be rebuilt after
+  // it, otherwise the second indexed transform would use stale positions.
+  const InstructionSetTransformsByName& transforms = GetTransformsByName();
+  const std::vector<InstructionSetTransform> pipeline = {
+      transforms.at("RenameCldInstructions"),
+      transforms.at("DeleteSecondInstruction"),
+      transforms.at("DuplicateRenamedCldInstructions")};
+  constexpr char kInstructionSetProto[] = R"(
+      instructions { vendor_syntax { mnemonic: 'HLT' }}
+      instructions { vendor_syntax { mnemonic: 'STD' }}
+      instructions { vendor_syntax { mnemonic: 'CLD' }})";
+  constexpr char kExpectedInstructionSetProto[] = R"(
+      instructions { vendor_syntax { mnemonic: 'HLT' }}
+      instructions { vendor_syntax { mnemonic: 'CLD2' }}
+      instructions { vendor_syntax { mnemonic: 'CLD3' }})";
+  TestTransform(
+      [&pipeline](InstructionSetProto* instruction_set) {
+        return RunTransformPipeline(pipeline, instruction_set);
+      },
+      kInstructionSetProto, kExpectedInstructionSetProto);
+}
+
+TEST(RunTransformPipelineTest, ProfilesTransforms) {
+  FLAGS_cpu_instructions_profile_transforms = true;
+  const InstructionSetTransformsByName& transforms = GetTransformsByName();
+  const std::vector<InstructionSetTransform> pipeline = {
+      transforms.at("DeleteSecondInstruction"),
+      transforms.at("AddTestedFeatureName")};
+  constexpr char kInstructionSetProto[] = R"(
+      instructions { vendor_syntax { mnemonic: 'FIRST' }}
+      instructions { vendor_syntax { mnemonic: 'SECOND' }})";
+  constexpr char kExpectedInstructionSetProto[] = R"(
+      instructions {
+        vendor_syntax { mnemonic: 'FIRST' }
+        feature_name: 'TESTED' })";
+  TestTransform(
+      [&pipeline](InstructionSetProto* instruction_set) {
+        return RunTransformPipeline(pipeline, instruction_set);
+      },
+      kInstructionSetProto, kExpectedInstructionSetProto);
+  FLAGS_cpu_instructions_profile_transforms = false;
+
+  const TransformPipelineProfile profile = GetLastTransformPipelineProfile();
+  ASSERT_EQ(profile.transforms_size(), 2);
+  std::map<string, const TransformProfile*> profiles_by_name;
+  for (const TransformProfile& transform : profile.transforms()) {
+    profiles_by_name[transform.transform_name()] = &transform;
+    EXPECT_GE(transform.wall_time_seconds(), 0.0);
+    EXPECT_GE(transform.cpu_time_seconds(), 0.0);
+    EXPECT_GT(transform.space_used_before_bytes(), 0);
+    EXPECT_GT(transform.space_used_after_bytes(), 0);
+  }
+  EXPECT_GE(profile.transforms(0).wall_time_seconds(),
+            profile.transforms(1).wall_time_seconds());
+  EXPECT_GE(profile.total_wall_time_seconds(),
+            profile.transforms(0).wall_time_seconds());
+
+  const TransformProfile* const delete_profile =
+      profiles_by_name.at("DeleteSecondInstruction");
+  EXPECT_EQ(delete_profile->num_added_instructions(), 0);
+  EXPECT_EQ(delete_profile->num_removed_instructions(), 1);
+  EXPECT_EQ(delete_profile->num_modified_instructions(), 0);
+
+  const TransformProfile* const add_feature_name_profile =
+      profiles_by_name.at("AddTestedFeatureName");
+  EXPECT_EQ(add_feature_name_profile->num_added_instructions(), 0);
+  EXPECT_EQ(add_feature_name_profile->num_removed_instructions(), 0);
+  EXPECT_EQ(add_feature_name_profile->num_modified_instructions(), 1);
+}
+
+TEST(RemoveInstructionsIfTest, CountsAndDiffs) {
+  constexpr char kInstructionSetProto[] = R"(
+      instructions { vendor_syntax { mnemonic: 'UD2' }}
+      instructions { vendor_syntax { mnemonic: 'STD' }}
+      instructions { vendor_syntax { mnemonic: 'HLT' }}
+      instructions { vendor_syntax { mnemonic: 'UD2' }}
+      instructions { vendor_syntax { mnemonic: 'CLD' }})";
+  constexpr char kExpectedInstructionSetProto[] = R"(
+      instructions { vendor_syntax { mnemonic: 'STD' }}
+      instructions { vendor_syntax { mnemonic: 'CLD' }})";
+  constexpr char kExpectedHltDiff[] =
+      "deleted: instructions[2]: { vendor_syntax { mnemonic: \"HLT\" } }\n";
+  constexpr char kExpectedUd2Diff[] =
+      "deleted: instructions[0]: { vendor_syntax { mnemonic: \"UD2\" } }\n"
+      "deleted: instructions[3]: { vendor_syntax { mnemonic: \"UD2\" } }\n";
+  std::vector<int> num_removed_instructions;
+  std::vector<string> diffs;
+  TestTransform(
+      [&num_removed_instructions,
+       &diffs](InstructionSetProto* instruction_set) {
+        RemoveInstructionsIf({IsHltInstruction, IsUd2Instruction},
+                             instruction_set, &num_removed_instructions,
+                             &diffs);
+        return OkStatus();
+      },
+      kInstructionSetProto, kExpectedInstructionSetProto);
+  EXPECT_THAT(num_removed_instructions, ::testing::ElementsAre(1, 2));
+  EXPECT_THAT(diffs,
+              ::testing::ElementsAre(kExpectedHltDiff, kExpectedUd2Diff));
+}
+
+TEST(RunFusedInstructionTransformsTest, StatusesAndDiffs) {
+  constexpr char kInstructionSetProto[] = R"(
+      instructions { vendor_syntax { mnemonic: 'FAIL1' }}
+      instructions {
+        vendor_syntax { mnemonic: 'NOP' }
+        feature_name: 'TESTED' })";
+  constexpr char kExpectedAddTestedFeatureNameDiff[] =
+      "added: instructions[0].feature_name: \"TESTED\"\n";
+  constexpr char kExpectedCopyFeatureNameToLlvmMnemonicDiff[] =
+      "added: instructions[0].llvm_mnemonic: \"TESTED\"\n"
+      "added: instructions[1].llvm_mnemonic: \"TESTED\"\n";
+  InstructionSetProto instruction_set;
+  ASSERT_TRUE(
+      TextFormat::ParseFromString(kInstructionSetProto, &instruction_set));
+  std::vector<Status> statuses;
+  std::vector<string> diffs;
+  const Status status = RunFusedInstructionTransforms(
+      {AddTestedFeatureName, SetFeatureNameOrFail,
+       CopyFeatureNameToLlvmMnemonic},
+      0, &instruction_set, &statuses, &diffs);
+  EXPECT_EQ(status.error_code(), INVALID_ARGUMENT);
+  EXPECT_EQ(status.error_message(), "FAIL1");
+  ASSERT_EQ(statuses.size(), 3);
+  EXPECT_OK(statuses[0]);
+  EXPECT_EQ(statuses[1].error_message(), "FAIL1");
+  EXPECT_OK(statuses[2]);
+  ASSERT_EQ(diffs.size(), 3);
+  EXPECT_EQ(diffs[0], kExpectedAddTestedFeatureNameDiff);
+  EXPECT_EQ(diffs[1], "");
+  EXPECT_EQ(diffs[2], kExpectedCopyFeatureNameToLlvmMnemonicDiff);
+}
+
 TEST(SortByVendorSyntaxTest, Sort) {
   constexpr char kInstructionSetProto[] =
       R"(instructions {
@@ -158,5 +581,44 @@ TEST(SortByVendorSyntaxTest, Sort) {
                 kExpectedInstructionSetProto);
 }
 
+TEST(SortByVendorSyntaxTest, MoreOperandsFirstAndEqualKeysKeepOrder) {
+  constexpr char kInstructionSetProto[] =
+      R"(instructions {
+           vendor_syntax { mnemonic: 'PUSH' operands { name: 'r64' }}
+           encoding_scheme: 'O' raw_encoding_specification: '50+rd' }
+         instructions {
+           vendor_syntax { mnemonic: 'PUSHF' }
+           raw_encoding_specification: '9C' }
+         instructions {
+           vendor_syntax { mnemonic: 'PUSH' operands { name: 'r64' }}
+           encoding_scheme: 'M' raw_encoding_specification: '50+rd' }
+         instructions {
+           vendor_syntax { mnemonic: 'PUSH' }
+           raw_encoding_specification: '0F A0' }
+         instructions {
+           vendor_syntax { mnemonic: 'PUSH' operands { name: 'imm8' }
+                           operands { name: 'imm8' }}
+           raw_encoding_specification: '6A ib' })";
+  constexpr char kExpectedInstructionSetProto[] =
+      R"(instructions {
+           vendor_syntax { mnemonic: 'PUSH' operands { name: 'imm8' }
+                           operands { name: 'imm8' }}
+           raw_encoding_specification: '6A ib' }
+         instructions {
+           vendor_syntax { mnemonic: 'PUSH' operands { name: 'r64' }}
+           encoding_scheme: 'O' raw_encoding_specification: '50+rd' }
+         instructions {
+           vendor_syntax { mnemonic: 'PUSH' operands { name: 'r64' }}
+           encoding_scheme: 'M' raw_encoding_specification: '50+rd' }
+         instructions {
+           vendor_syntax { mnemonic: 'PUSH' }
+           raw_encoding_specification: '0F A0' }
+         instructions {
+           vendor_syntax { mnemonic: 'PUSHF' }
+           raw_encoding_specification: '9C' })";
+  TestTransform(SortByVendorSyntax, kInstructionSetProto,
+                kExpectedInstructionSetProto);
+}
+
 }  // namespace
 }  // namespace cpu_instructions
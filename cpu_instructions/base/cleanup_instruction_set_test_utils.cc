@@ -33,4 +33,25 @@ void TestTransform(const InstructionSetTransform& transform,
   EXPECT_THAT(instruction_set, EqualsProto(expected_output));
 }
 
+void TestTransform(InstructionTransformRawFunction* transform,
+                   const string& input_proto, const string& expected_output) {
+  TestTransform(
+      [transform](InstructionSetProto* instruction_set) {
+        return RunInstructionTransform(transform, 0, instruction_set);
+      },
+      input_proto, expected_output);
+}
+
+void TestTransform(IndexedInstructionSetTransformRawFunction* transform,
+                   const string& input_proto, const string& expected_output) {
+  TestTransform(
+      [transform](InstructionSetProto* instruction_set) {
+        InstructionSetIndex index(instruction_set);
+        const Status status = transform(&index, instruction_set);
+        EXPECT_TRUE(index.IsUpToDate());
+        return status;
+      },
+      input_proto, expected_output);
+}
+
 }  // namespace cpu_instructions
@@ -29,6 +29,20 @@ void TestTransform(const InstructionSetTransform& transform,
                    const string& input_proto,
                    const string& expected_output_proto);
 
+// Tests the per-instruction transform 'transform' by running it on all
+// instructions of 'input_proto', and comparing the modified proto with
+// 'expected_output_proto'.
+void TestTransform(InstructionTransformRawFunction* transform,
+                   const string& input_proto,
+                   const string& expected_output_proto);
+
+// Tests the indexed transform 'transform' by running it on 'input_proto', and
+// comparing the modified proto with 'expected_output_proto'. Also checks that
+// the transform kept the index up to date.
+void TestTransform(IndexedInstructionSetTransformRawFunction* transform,
+                   const string& input_proto,
+                   const string& expected_output_proto);
+
 }  // namespace cpu_instructions
 
 #endif  // CPU_INSTRUCTIONS_BASE_CLEANUP_INSTRUCTION_SET_TEST_UTILS_H_
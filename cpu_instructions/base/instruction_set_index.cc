@@ -0,0 +1,276 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cpu_instructions/base/instruction_set_index.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+#include "glog/logging.h"
+#include "strings/str_cat.h"
+
+namespace cpu_instructions {
+
+// The index of a single field.
+struct InstructionSetIndex::FieldIndex {
+  explicit FieldIndex(Field field) : field(field), key_function(nullptr) {}
+  explicit FieldIndex(CustomKeyFunction* key_function)
+      : field(NUM_FIELDS), key_function(key_function) {
+    CHECK(key_function != nullptr);
+  }
+
+  // Sets 'key' to the value of the indexed field in 'instruction'. The opcode
+  // is converted to a string, so that all fields can use the same type of
+  // index.
+  // Returns false if the instruction does not have a value for the field.
+  bool GetKey(const InstructionProto& instruction, string* key) const {
+    CHECK(key != nullptr);
+    if (key_function != nullptr) return key_function(instruction, key);
+    switch (field) {
+      case MNEMONIC:
+        *key = instruction.vendor_syntax().mnemonic();
+        return true;
+      case RAW_ENCODING_SPECIFICATION:
+        *key = instruction.raw_encoding_specification();
+        return true;
+      case OPCODE:
+        if (!instruction.has_x86_encoding_specification()) return false;
+        *key = StrCat(instruction.x86_encoding_specification().opcode());
+        return true;
+      case FEATURE_NAME:
+        *key = instruction.feature_name();
+        return true;
+      case GROUP_ID:
+        *key = instruction.group_id();
+        return true;
+      case NUM_FIELDS:
+        break;
+    }
+    LOG(FATAL) << "Unexpected field: " << field;
+    return false;
+  }
+
+  // Adds the instruction at 'position' to the index. Instructions must be added
+  // in the order of their positions.
+  void AddInstruction(const InstructionProto& instruction) {
+    const int position = static_cast<int>(has_key.size());
+    string key;
+    has_key.push_back(GetKey(instruction, &key));
+    keys.push_back(key);
+    if (has_key.back()) positions[key].push_back(position);
+  }
+
+  // Removes the position from the list of positions of its current key.
+  void RemovePosition(int position) {
+    if (!has_key[position]) return;
+    const auto it = positions.find(keys[position]);
+    CHECK(it != positions.end());
+    std::vector<int>& key_positions = it->second;
+    const auto position_it =
+        std::lower_bound(key_positions.begin(), key_positions.end(), position);
+    CHECK(position_it != key_positions.end() && *position_it == position);
+    key_positions.erase(position_it);
+    if (key_positions.empty()) positions.erase(it);
+  }
+
+  // Updates the key of the instruction at 'position'.
+  void UpdateInstruction(int position, const InstructionProto& instruction) {
+    RemovePosition(position);
+    string& key = keys[position];
+    has_key[position] = GetKey(instruction, &key);
+    if (has_key[position]) {
+      std::vector<int>& key_positions = positions[key];
+      key_positions.insert(std::lower_bound(key_positions.begin(),
+                                            key_positions.end(), position),
+                           position);
+    }
+  }
+
+  // The indexed field, or NUM_FIELDS for an index of a custom key.
+  const Field field;
+
+  // The function that computes the custom key, or nullptr for an index of a
+  // field.
+  CustomKeyFunction* const key_function;
+
+  // The key of each instruction, indexed by the position of the instruction;
+  // has_key[i] is false if the instruction at position i does not have the
+  // field.
+  std::vector<string> keys;
+  std::vector<bool> has_key;
+
+  // The sorted positions of the instructions with each key.
+  std::unordered_map<string, std::vector<int>> positions;
+};
+
+InstructionSetIndex::InstructionSetIndex(
+    const InstructionSetProto* instruction_set)
+    : instruction_set_(instruction_set) {
+  CHECK(instruction_set_ != nullptr);
+}
+
+InstructionSetIndex::~InstructionSetIndex() {}
+
+std::vector<int> InstructionSetIndex::FindByMnemonic(const string& mnemonic) {
+  return Find(MNEMONIC, mnemonic);
+}
+
+std::vector<int> InstructionSetIndex::FindByRawEncodingSpecification(
+    const string& raw_encoding_specification) {
+  return Find(RAW_ENCODING_SPECIFICATION, raw_encoding_specification);
+}
+
+std::vector<int> InstructionSetIndex::FindByOpcode(uint32_t opcode) {
+  return Find(OPCODE, StrCat(opcode));
+}
+
+std::vector<int> InstructionSetIndex::FindByFeatureName(
+    const string& feature_name) {
+  return Find(FEATURE_NAME, feature_name);
+}
+
+std::vector<int> InstructionSetIndex::FindByGroupId(const string& group_id) {
+  return Find(GROUP_ID, group_id);
+}
+
+std::vector<int> InstructionSetIndex::FindByMnemonics(
+    const std::vector<string>& mnemonics) {
+  return Find(MNEMONIC, mnemonics);
+}
+
+std::vector<int> InstructionSetIndex::FindByRawEncodingSpecifications(
+    const std::vector<string>& raw_encoding_specifications) {
+  return Find(RAW_ENCODING_SPECIFICATION, raw_encoding_specifications);
+}
+
+std::vector<int> InstructionSetIndex::FindByCustomKey(
+    CustomKeyFunction* key_function, const string& key) {
+  const FieldIndex* const field_index = GetCustomKeyIndex(key_function);
+  const auto it = field_index->positions.find(key);
+  return it == field_index->positions.end() ? std::vector<int>() : it->second;
+}
+
+void InstructionSetIndex::UpdateInstruction(int position) {
+  CHECK_GE(position, 0);
+  CHECK_LT(position, instruction_set_->instructions_size());
+  const InstructionProto& instruction =
+      instruction_set_->instructions(position);
+  for (FieldIndex* const field_index : GetBuiltIndexes()) {
+    CHECK_LT(position, static_cast<int>(field_index->keys.size()));
+    field_index->UpdateInstruction(position, instruction);
+  }
+}
+
+void InstructionSetIndex::UpdateAddedInstructions() {
+  const int num_instructions = instruction_set_->instructions_size();
+  for (FieldIndex* const field_index : GetBuiltIndexes()) {
+    const int num_keys = static_cast<int>(field_index->keys.size());
+    CHECK_LE(num_keys, num_instructions);
+    for (int i = num_keys; i < num_instructions; ++i) {
+      field_index->AddInstruction(instruction_set_->instructions(i));
+    }
+  }
+}
+
+void InstructionSetIndex::Rebuild() {
+  // The indexes of the fields are built again on the next lookup.
+  for (std::unique_ptr<FieldIndex>& field_index : field_indexes_) {
+    field_index.reset();
+  }
+  custom_key_indexes_.clear();
+}
+
+bool InstructionSetIndex::IsUpToDate() const {
+  const int num_instructions = instruction_set_->instructions_size();
+  string key;
+  for (FieldIndex* const field_index : GetBuiltIndexes()) {
+    const int num_keys = static_cast<int>(field_index->keys.size());
+    if (num_keys != num_instructions) return false;
+    for (int i = 0; i < num_instructions; ++i) {
+      const bool has_key =
+          field_index->GetKey(instruction_set_->instructions(i), &key);
+      if (has_key != field_index->has_key[i]) return false;
+      if (has_key && key != field_index->keys[i]) return false;
+    }
+  }
+  return true;
+}
+
+std::vector<int> InstructionSetIndex::Find(Field field, const string& key) {
+  const FieldIndex* const field_index = GetFieldIndex(field);
+  const auto it = field_index->positions.find(key);
+  return it == field_index->positions.end() ? std::vector<int>() : it->second;
+}
+
+std::vector<int> InstructionSetIndex::Find(Field field,
+                                           const std::vector<string>& keys) {
+  const FieldIndex* const field_index = GetFieldIndex(field);
+  std::vector<int> positions;
+  for (const string& key : keys) {
+    const auto it = field_index->positions.find(key);
+    if (it == field_index->positions.end()) continue;
+    positions.insert(positions.end(), it->second.begin(), it->second.end());
+  }
+  // The positions of different keys are disjoint, but duplicate keys in 'keys'
+  // would add the same positions more than once.
+  std::sort(positions.begin(), positions.end());
+  positions.erase(std::unique(positions.begin(), positions.end()),
+                  positions.end());
+  return positions;
+}
+
+InstructionSetIndex::FieldIndex* InstructionSetIndex::GetFieldIndex(
+    Field field) {
+  std::unique_ptr<FieldIndex>& field_index = field_indexes_[field];
+  if (field_index == nullptr) {
+    field_index.reset(new FieldIndex(field));
+    AddAllInstructions(field_index.get());
+  }
+  return field_index.get();
+}
+
+InstructionSetIndex::FieldIndex* InstructionSetIndex::GetCustomKeyIndex(
+    CustomKeyFunction* key_function) {
+  CHECK(key_function != nullptr);
+  std::unique_ptr<FieldIndex>& field_index = custom_key_indexes_[key_function];
+  if (field_index == nullptr) {
+    field_index.reset(new FieldIndex(key_function));
+    AddAllInstructions(field_index.get());
+  }
+  return field_index.get();
+}
+
+void InstructionSetIndex::AddAllInstructions(FieldIndex* field_index) const {
+  CHECK(field_index != nullptr);
+  const int num_instructions = instruction_set_->instructions_size();
+  field_index->keys.reserve(num_instructions);
+  field_index->has_key.reserve(num_instructions);
+  for (const InstructionProto& instruction : instruction_set_->instructions()) {
+    field_index->AddInstruction(instruction);
+  }
+}
+
+std::vector<InstructionSetIndex::FieldIndex*>
+InstructionSetIndex::GetBuiltIndexes() const {
+  std::vector<FieldIndex*> indexes;
+  for (const std::unique_ptr<FieldIndex>& field_index : field_indexes_) {
+    if (field_index != nullptr) indexes.push_back(field_index.get());
+  }
+  for (const auto& key_function_and_index : custom_key_indexes_) {
+    indexes.push_back(key_function_and_index.second.get());
+  }
+  return indexes;
+}
+
+}  // namespace cpu_instructions
@@ -0,0 +1,149 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Contains InstructionSetIndex, a secondary index of an instruction set that
+// maps the values of selected fields of the instructions to the positions of
+// the instructions in the instruction set. It is used by transforms that modify
+// only a handful of instructions, so that they do not need to scan the whole
+// instruction set to find them.
+
+#ifndef CPU_INSTRUCTIONS_BASE_INSTRUCTION_SET_INDEX_H_
+#define CPU_INSTRUCTIONS_BASE_INSTRUCTION_SET_INDEX_H_
+
+#include <stdint.h>
+#include <map>
+#include <memory>
+#include <vector>
+#include "strings/string.h"
+
+#include "cpu_instructions/proto/instructions.pb.h"
+
+namespace cpu_instructions {
+
+// An index of the instructions of an instruction set by their mnemonic (in the
+// vendor syntax), raw encoding specification, opcode (from the parsed x86
+// encoding specification), feature name, and group id. The instructions can
+// also be indexed by custom keys computed by a function provided by the caller.
+// The index of each field is built on the first lookup by this field, so that
+// the index does not spend time on fields that are not used.
+//
+// The index does not observe the instruction set. Code that modifies the
+// instruction set must keep the index up to date by calling UpdateInstruction
+// after modifying an instruction in place, UpdateAddedInstructions after adding
+// new instructions to the end of the instruction set, and Rebuild after
+// removing or reordering instructions.
+//
+// The class is not thread-safe, and the lookups may modify the index.
+class InstructionSetIndex {
+ public:
+  // Creates an index of 'instruction_set'. The index keeps a pointer to the
+  // instruction set, and the instruction set must outlive the index.
+  explicit InstructionSetIndex(const InstructionSetProto* instruction_set);
+  ~InstructionSetIndex();
+
+  InstructionSetIndex(const InstructionSetIndex&) = delete;
+  InstructionSetIndex& operator=(const InstructionSetIndex&) = delete;
+
+  // A function that computes a custom key of an instruction. Sets 'key' to the
+  // key of 'instruction' and returns true, or returns false if the instruction
+  // does not have a key. The function must depend only on the instruction.
+  using CustomKeyFunction = bool(const InstructionProto& instruction,
+                                 string* key);
+
+  // Return the positions of the instructions with the given value of the
+  // field, in increasing order. Return an empty vector if there are no such
+  // instructions.
+  std::vector<int> FindByMnemonic(const string& mnemonic);
+  std::vector<int> FindByRawEncodingSpecification(
+      const string& raw_encoding_specification);
+  std::vector<int> FindByOpcode(uint32_t opcode);
+  std::vector<int> FindByFeatureName(const string& feature_name);
+  std::vector<int> FindByGroupId(const string& group_id);
+
+  // Return the positions of the instructions that have any of the given values
+  // of the field, in increasing order.
+  std::vector<int> FindByMnemonics(const std::vector<string>& mnemonics);
+  std::vector<int> FindByRawEncodingSpecifications(
+      const std::vector<string>& raw_encoding_specifications);
+
+  // Returns the positions of the instructions for which 'key_function' returns
+  // 'key', in increasing order. The instructions are indexed by each key
+  // function on the first lookup with this function, and the index is kept up
+  // to date in the same way as the indexes of the fields. This allows indexing
+  // the instructions by values that are computed outside of base/, e.g. by
+  // the parsed encoding specification of the instruction.
+  std::vector<int> FindByCustomKey(CustomKeyFunction* key_function,
+                                   const string& key);
+
+  // Updates the index after the instruction at 'position' was modified in
+  // place.
+  void UpdateInstruction(int position);
+
+  // Updates the index after new instructions were added to the end of the
+  // instruction set.
+  void UpdateAddedInstructions();
+
+  // Updates the index after an arbitrary change of the instruction set, e.g.
+  // after instructions were removed or reordered.
+  void Rebuild();
+
+  // Returns true if the index matches the current state of the instruction
+  // set. Runs in linear time in the size of the instruction set; it is meant
+  // for tests and debug checks.
+  bool IsUpToDate() const;
+
+ private:
+  enum Field {
+    MNEMONIC,
+    RAW_ENCODING_SPECIFICATION,
+    OPCODE,
+    FEATURE_NAME,
+    GROUP_ID,
+    NUM_FIELDS
+  };
+  struct FieldIndex;
+
+  // Returns the positions of the instructions whose value of 'field' is 'key';
+  // builds the index of the field if it was not built yet.
+  std::vector<int> Find(Field field, const string& key);
+
+  // Returns the positions of the instructions whose value of 'field' is any of
+  // 'keys', in increasing order.
+  std::vector<int> Find(Field field, const std::vector<string>& keys);
+
+  // Returns the index of 'field'; builds it if it was not built yet.
+  FieldIndex* GetFieldIndex(Field field);
+
+  // Returns the index of the custom key computed by 'key_function'; builds it
+  // if it was not built yet.
+  FieldIndex* GetCustomKeyIndex(CustomKeyFunction* key_function);
+
+  // Adds all instructions of the instruction set to 'field_index'.
+  void AddAllInstructions(FieldIndex* field_index) const;
+
+  // Returns all the indexes of fields and custom keys that were built.
+  std::vector<FieldIndex*> GetBuiltIndexes() const;
+
+  const InstructionSetProto* const instruction_set_;
+
+  // The indexes of the fields, or nullptr for fields that were not built yet.
+  std::unique_ptr<FieldIndex> field_indexes_[NUM_FIELDS];
+
+  // The indexes of the custom keys, indexed by the key function.
+  std::map<CustomKeyFunction*, std::unique_ptr<FieldIndex>> custom_key_indexes_;
+};
+
+}  // namespace cpu_instructions
+
+#endif  // CPU_INSTRUCTIONS_BASE_INSTRUCTION_SET_INDEX_H_
@@ -0,0 +1,173 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cpu_instructions/base/instruction_set_index.h"
+
+#include "strings/string.h"
+
+#include "cpu_instructions/proto/instructions.pb.h"
+#include "cpu_instructions/util/proto_util.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace cpu_instructions {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::IsEmpty;
+
+constexpr char kInstructionSetProto[] = R"(
+    instructions {
+      vendor_syntax { mnemonic: 'POP' }
+      feature_name: 'X86'
+      raw_encoding_specification: '0F A1'
+      x86_encoding_specification { opcode: 0x0fa1 }
+    }
+    instructions {
+      vendor_syntax { mnemonic: 'PUSH' }
+      feature_name: 'X86'
+      raw_encoding_specification: '0F A0'
+      x86_encoding_specification { opcode: 0x0fa0 }
+    }
+    instructions {
+      vendor_syntax { mnemonic: 'POP' }
+      feature_name: 'X86'
+      group_id: 'POP-Pop a Value from the Stack'
+      raw_encoding_specification: '0F A9'
+    }
+    instructions {
+      vendor_syntax { mnemonic: 'VMOVQ' }
+      feature_name: 'AVX'
+      raw_encoding_specification: 'VEX.128.F3.0F.WIG 7E /r'
+    })";
+
+TEST(InstructionSetIndexTest, FindsInstructions) {
+  const InstructionSetProto instruction_set =
+      ParseProtoFromStringOrDie<InstructionSetProto>(kInstructionSetProto);
+  InstructionSetIndex index(&instruction_set);
+  EXPECT_THAT(index.FindByMnemonic("POP"), ElementsAre(0, 2));
+  EXPECT_THAT(index.FindByMnemonic("VMOVQ"), ElementsAre(3));
+  EXPECT_THAT(index.FindByMnemonic("ADD"), IsEmpty());
+  EXPECT_THAT(index.FindByRawEncodingSpecification("0F A0"), ElementsAre(1));
+  EXPECT_THAT(index.FindByOpcode(0x0fa1), ElementsAre(0));
+  EXPECT_THAT(index.FindByOpcode(0x0fa9), IsEmpty());
+  EXPECT_THAT(index.FindByFeatureName("X86"), ElementsAre(0, 1, 2));
+  EXPECT_THAT(index.FindByGroupId("POP-Pop a Value from the Stack"),
+              ElementsAre(2));
+  EXPECT_THAT(index.FindByMnemonics({"VMOVQ", "ADD", "POP", "POP"}),
+              ElementsAre(0, 2, 3));
+  EXPECT_THAT(index.FindByRawEncodingSpecifications({"0F A9", "0F A0"}),
+              ElementsAre(1, 2));
+  EXPECT_TRUE(index.IsUpToDate());
+}
+
+// A custom key: the number of operands of the instruction in the vendor syntax.
+// Instructions without operands do not have a key.
+bool GetNumOperandsKey(const InstructionProto& instruction, string* key) {
+  const int num_operands = instruction.vendor_syntax().operands_size();
+  if (num_operands == 0) return false;
+  *key = string(1, '0' + num_operands);
+  return true;
+}
+
+TEST(InstructionSetIndexTest, FindsInstructionsByCustomKey) {
+  InstructionSetProto instruction_set =
+      ParseProtoFromStringOrDie<InstructionSetProto>(kInstructionSetProto);
+  instruction_set.mutable_instructions(0)
+      ->mutable_vendor_syntax()
+      ->add_operands()
+      ->set_name("FS");
+  instruction_set.mutable_instructions(3)
+      ->mutable_vendor_syntax()
+      ->add_operands()
+      ->set_name("xmm1");
+  InstructionSetIndex index(&instruction_set);
+  EXPECT_THAT(index.FindByCustomKey(GetNumOperandsKey, "1"), ElementsAre(0, 3));
+  EXPECT_THAT(index.FindByCustomKey(GetNumOperandsKey, "2"), IsEmpty());
+  EXPECT_TRUE(index.IsUpToDate());
+
+  // The index of the custom key is updated along with the indexes of fields.
+  instruction_set.mutable_instructions(3)
+      ->mutable_vendor_syntax()
+      ->add_operands()
+      ->set_name("xmm2/m64");
+  EXPECT_FALSE(index.IsUpToDate());
+  index.UpdateInstruction(3);
+  EXPECT_TRUE(index.IsUpToDate());
+  EXPECT_THAT(index.FindByCustomKey(GetNumOperandsKey, "1"), ElementsAre(0));
+  EXPECT_THAT(index.FindByCustomKey(GetNumOperandsKey, "2"), ElementsAre(3));
+
+  *instruction_set.add_instructions() = instruction_set.instructions(0);
+  index.UpdateAddedInstructions();
+  EXPECT_TRUE(index.IsUpToDate());
+  EXPECT_THAT(index.FindByCustomKey(GetNumOperandsKey, "1"), ElementsAre(0, 4));
+
+  instruction_set.mutable_instructions()->DeleteSubrange(0, 1);
+  index.Rebuild();
+  EXPECT_THAT(index.FindByCustomKey(GetNumOperandsKey, "1"), ElementsAre(3));
+  EXPECT_TRUE(index.IsUpToDate());
+}
+
+TEST(InstructionSetIndexTest, UpdatesModifiedInstruction) {
+  InstructionSetProto instruction_set =
+      ParseProtoFromStringOrDie<InstructionSetProto>(kInstructionSetProto);
+  InstructionSetIndex index(&instruction_set);
+  EXPECT_THAT(index.FindByMnemonic("POP"), ElementsAre(0, 2));
+  EXPECT_THAT(index.FindByOpcode(0x0fa1), ElementsAre(0));
+
+  InstructionProto* const instruction = instruction_set.mutable_instructions(1);
+  instruction->mutable_vendor_syntax()->set_mnemonic("POP");
+  instruction->clear_x86_encoding_specification();
+  EXPECT_FALSE(index.IsUpToDate());
+  index.UpdateInstruction(1);
+  EXPECT_TRUE(index.IsUpToDate());
+
+  EXPECT_THAT(index.FindByMnemonic("POP"), ElementsAre(0, 1, 2));
+  EXPECT_THAT(index.FindByMnemonic("PUSH"), IsEmpty());
+  EXPECT_THAT(index.FindByOpcode(0x0fa0), IsEmpty());
+}
+
+TEST(InstructionSetIndexTest, UpdatesAddedInstructions) {
+  InstructionSetProto instruction_set =
+      ParseProtoFromStringOrDie<InstructionSetProto>(kInstructionSetProto);
+  InstructionSetIndex index(&instruction_set);
+  EXPECT_THAT(index.FindByMnemonic("PUSH"), ElementsAre(1));
+
+  *instruction_set.add_instructions() = instruction_set.instructions(1);
+  *instruction_set.add_instructions() = instruction_set.instructions(0);
+  EXPECT_FALSE(index.IsUpToDate());
+  index.UpdateAddedInstructions();
+  EXPECT_TRUE(index.IsUpToDate());
+
+  EXPECT_THAT(index.FindByMnemonic("PUSH"), ElementsAre(1, 4));
+  EXPECT_THAT(index.FindByMnemonic("POP"), ElementsAre(0, 2, 5));
+}
+
+TEST(InstructionSetIndexTest, RebuildsAfterRemoval) {
+  InstructionSetProto instruction_set =
+      ParseProtoFromStringOrDie<InstructionSetProto>(kInstructionSetProto);
+  InstructionSetIndex index(&instruction_set);
+  EXPECT_THAT(index.FindByMnemonic("POP"), ElementsAre(0, 2));
+
+  instruction_set.mutable_instructions()->DeleteSubrange(0, 1);
+  EXPECT_FALSE(index.IsUpToDate());
+  index.Rebuild();
+  EXPECT_TRUE(index.IsUpToDate());
+
+  EXPECT_THAT(index.FindByMnemonic("POP"), ElementsAre(1));
+  EXPECT_THAT(index.FindByMnemonic("VMOVQ"), ElementsAre(2));
+}
+
+}  // namespace
+}  // namespace cpu_instructions
@@ -0,0 +1,56 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cpu_instructions/util/parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "glog/logging.h"
+
+namespace cpu_instructions {
+
+int GetDefaultNumThreads() {
+  const int num_hardware_threads = std::thread::hardware_concurrency();
+  return std::max(num_hardware_threads, 1);
+}
+
+void ParallelFor(int num_items, int num_threads,
+                 const std::function<void(int)>& function) {
+  CHECK(function != nullptr);
+  if (num_threads <= 0) num_threads = GetDefaultNumThreads();
+  num_threads = std::min(num_threads, num_items);
+  if (num_threads <= 1) {
+    for (int item = 0; item < num_items; ++item) function(item);
+    return;
+  }
+
+  std::atomic<int> next_item(0);
+  const auto process_items = [num_items, &function, &next_item]() {
+    for (int item = next_item++; item < num_items; item = next_item++) {
+      function(item);
+    }
+  };
+  std::vector<std::thread> threads;
+  threads.reserve(num_threads - 1);
+  for (int i = 1; i < num_threads; ++i) {
+    threads.emplace_back(process_items);
+  }
+  process_items();
+  for (std::thread& thread : threads) thread.join();
+}
+
+}  // namespace cpu_instructions
@@ -0,0 +1,91 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Helpers for running independent pieces of work on several threads.
+
+#ifndef CPU_INSTRUCTIONS_UTIL_PARALLEL_H_
+#define CPU_INSTRUCTIONS_UTIL_PARALLEL_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace cpu_instructions {
+
+// Returns the number of threads to use when the caller does not request a
+// specific number: the number of hardware threads, or 1 if it is not known.
+int GetDefaultNumThreads();
+
+// Calls function(i) for all i in [0, num_items), using a pool of at most
+// 'num_threads' threads, and returns when all calls have finished. The calling
+// thread is one of the threads of the pool. Items are handed out to the threads
+// dynamically, in increasing order, so that items that take longer to process
+// do not leave the other threads idle. When 'num_threads' is smaller or equal
+// to zero, GetDefaultNumThreads() threads are used.
+//
+// Calls to 'function' for different items may run concurrently, so it must be
+// thread-safe, and the calls for different items must not write to shared
+// state without synchronization. Typically, function(i) writes only to the
+// i-th element of a pre-allocated output vector.
+void ParallelFor(int num_items, int num_threads,
+                 const std::function<void(int)>& function);
+
+// Sorts 'elements' using a pool of at most 'num_threads' threads. The vector is
+// split into chunks that are sorted in parallel, and the sorted chunks are then
+// merged pairwise, with the merges of each round running in parallel. As with
+// std::sort, the order of elements that are equivalent under 'less' is not
+// specified; callers that need a deterministic order must use a 'less' that
+// defines a strict total order. When 'num_threads' is smaller or equal to zero,
+// GetDefaultNumThreads() threads are used.
+template <typename ElementType, typename LessThan>
+void ParallelSort(std::vector<ElementType>* elements, int num_threads,
+                  const LessThan& less) {
+  // Chunks smaller than this are not worth the overhead of the threads.
+  constexpr int kMinChunkSize = 1024;
+  if (num_threads <= 0) num_threads = GetDefaultNumThreads();
+  const int num_elements = elements->size();
+  const int num_chunks =
+      std::max(1, std::min(num_threads, num_elements / kMinChunkSize));
+  const auto begin = elements->begin();
+  if (num_chunks == 1) {
+    std::sort(begin, elements->end(), less);
+    return;
+  }
+  std::vector<int> chunk_begins(num_chunks + 1);
+  for (int chunk = 0; chunk <= num_chunks; ++chunk) {
+    chunk_begins[chunk] =
+        static_cast<int64_t>(chunk) * num_elements / num_chunks;
+  }
+  ParallelFor(num_chunks, num_threads, [&](int chunk) {
+    std::sort(begin + chunk_begins[chunk], begin + chunk_begins[chunk + 1],
+              less);
+  });
+  // In each round, the sorted runs of 'run_size' chunks are merged pairwise.
+  for (int run_size = 1; run_size < num_chunks; run_size *= 2) {
+    const int num_merges = (num_chunks + 2 * run_size - 1) / (2 * run_size);
+    ParallelFor(num_merges, num_threads, [&](int merge) {
+      const int first = 2 * run_size * merge;
+      const int middle = std::min(first + run_size, num_chunks);
+      const int last = std::min(first + 2 * run_size, num_chunks);
+      std::inplace_merge(begin + chunk_begins[first],
+                         begin + chunk_begins[middle],
+                         begin + chunk_begins[last], less);
+    });
+  }
+}
+
+}  // namespace cpu_instructions
+
+#endif  // CPU_INSTRUCTIONS_UTIL_PARALLEL_H_
@@ -0,0 +1,89 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cpu_instructions/util/parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace cpu_instructions {
+namespace {
+
+using ::testing::Each;
+
+TEST(GetDefaultNumThreadsTest, IsPositive) {
+  EXPECT_GT(GetDefaultNumThreads(), 0);
+}
+
+TEST(ParallelForTest, NoItems) {
+  bool called = false;
+  ParallelFor(0, 4, [&called](int item) { called = true; });
+  EXPECT_FALSE(called);
+}
+
+TEST(ParallelForTest, SingleThread) {
+  std::vector<int> items;
+  ParallelFor(5, 1, [&items](int item) { items.push_back(item); });
+  EXPECT_THAT(items, ::testing::ElementsAre(0, 1, 2, 3, 4));
+}
+
+TEST(ParallelForTest, CallsFunctionOncePerItem) {
+  constexpr int kNumItems = 1000;
+  for (const int num_threads : {0, 2, 8, 2 * kNumItems}) {
+    std::vector<std::atomic<int>> num_calls(kNumItems);
+    for (auto& calls : num_calls) calls = 0;
+    ParallelFor(kNumItems, num_threads,
+                [&num_calls](int item) { ++num_calls[item]; });
+    std::vector<int> num_calls_values(num_calls.begin(), num_calls.end());
+    EXPECT_THAT(num_calls_values, Each(1)) << "num_threads = " << num_threads;
+  }
+}
+
+TEST(ParallelSortTest, EmptyVector) {
+  std::vector<int> elements;
+  ParallelSort(&elements, 4, std::less<int>());
+  EXPECT_TRUE(elements.empty());
+}
+
+TEST(ParallelSortTest, SameResultAsStdSort) {
+  std::mt19937 random_generator(1234);
+  for (const int num_elements : {10, 1023, 1024, 5000, 33333}) {
+    // The pairs are ordered by both components, so the sorted order is unique
+    // even though the first components have many duplicates.
+    std::vector<std::pair<int, int>> elements(num_elements);
+    for (int i = 0; i < num_elements; ++i) {
+      elements[i] = {static_cast<int>(random_generator() % 100), i};
+    }
+    std::shuffle(elements.begin(), elements.end(), random_generator);
+    std::vector<std::pair<int, int>> expected_elements = elements;
+    std::sort(expected_elements.begin(), expected_elements.end());
+    for (const int num_threads : {0, 1, 3, 8}) {
+      std::vector<std::pair<int, int>> sorted_elements = elements;
+      ParallelSort(&sorted_elements, num_threads,
+                   std::less<std::pair<int, int>>());
+      EXPECT_EQ(sorted_elements, expected_elements)
+          << "num_elements = " << num_elements
+          << ", num_threads = " << num_threads;
+    }
+  }
+}
+
+}  // namespace
+}  // namespace cpu_instructions
@@ -0,0 +1,281 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cpu_instructions/util/proto_fingerprint.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "base/stringprintf.h"
+#include "glog/logging.h"
+#include "src/google/protobuf/descriptor.h"
+
+namespace cpu_instructions {
+
+using ::google::protobuf::FieldDescriptor;
+using ::google::protobuf::Message;
+using ::google::protobuf::Reflection;
+
+namespace {
+
+inline uint64_t RotateLeft(uint64_t value, int bits) {
+  return (value << bits) | (value >> (64 - bits));
+}
+
+inline uint64_t FinalMix(uint64_t value) {
+  value ^= value >> 33;
+  value *= 0xff51afd7ed558ccdULL;
+  value ^= value >> 33;
+  value *= 0xc4ceb9fe1a85ec53ULL;
+  value ^= value >> 33;
+  return value;
+}
+
+// Reads a 64-bit little-endian value from 'bytes'. The value is assembled byte
+// by byte, so that the fingerprints do not depend on the endianness of the
+// host.
+inline uint64_t ReadLittleEndian64(const uint8_t* bytes) {
+  uint64_t value = 0;
+  for (int i = 7; i >= 0; --i) value = (value << 8) | bytes[i];
+  return value;
+}
+
+// An incremental implementation of the 128-bit variant of MurmurHash3 for
+// 64-bit platforms (MurmurHash3_x64_128 with seed 0). The input is processed in
+// blocks of 16 bytes; the bytes that do not fill a whole block yet are kept in
+// 'tail_'.
+class Murmur3Hasher128 {
+ public:
+  Murmur3Hasher128() {}
+
+  // Adds 'size' bytes starting at 'data' to the hashed input.
+  void Update(const void* data, size_t size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    total_size_ += size;
+    if (tail_size_ > 0) {
+      const size_t num_copied = std::min(size, kBlockSize - tail_size_);
+      memcpy(tail_ + tail_size_, bytes, num_copied);
+      tail_size_ += num_copied;
+      bytes += num_copied;
+      size -= num_copied;
+      if (tail_size_ < kBlockSize) return;
+      ProcessBlock(tail_);
+      tail_size_ = 0;
+    }
+    for (; size >= kBlockSize; size -= kBlockSize, bytes += kBlockSize) {
+      ProcessBlock(bytes);
+    }
+    memcpy(tail_, bytes, size);
+    tail_size_ = size;
+  }
+
+  // Adds a 64-bit value to the hashed input, in the little-endian byte order.
+  void UpdateWithUint64(uint64_t value) {
+    uint8_t bytes[sizeof(value)];
+    for (size_t i = 0; i < sizeof(value); ++i) {
+      bytes[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+    Update(bytes, sizeof(bytes));
+  }
+
+  // Returns the hash of the input added so far. The hasher must not be used
+  // after calling this method.
+  Fingerprint128 Finish() {
+    uint64_t k1 = 0;
+    uint64_t k2 = 0;
+    for (int i = tail_size_ - 1; i >= 8; --i) k2 = (k2 << 8) | tail_[i];
+    for (int i = std::min<int>(tail_size_, 8) - 1; i >= 0; --i) {
+      k1 = (k1 << 8) | tail_[i];
+    }
+    if (tail_size_ > 8) h2_ ^= MixK2(k2);
+    if (tail_size_ > 0) h1_ ^= MixK1(k1);
+
+    h1_ ^= total_size_;
+    h2_ ^= total_size_;
+    h1_ += h2_;
+    h2_ += h1_;
+    h1_ = FinalMix(h1_);
+    h2_ = FinalMix(h2_);
+    h1_ += h2_;
+    h2_ += h1_;
+
+    Fingerprint128 fingerprint;
+    fingerprint.low = h1_;
+    fingerprint.high = h2_;
+    return fingerprint;
+  }
+
+ private:
+  static constexpr size_t kBlockSize = 16;
+  static constexpr uint64_t kC1 = 0x87c37b91114253d5ULL;
+  static constexpr uint64_t kC2 = 0x4cf5ad432745937fULL;
+
+  static uint64_t MixK1(uint64_t k1) {
+    return RotateLeft(k1 * kC1, 31) * kC2;
+  }
+  static uint64_t MixK2(uint64_t k2) {
+    return RotateLeft(k2 * kC2, 33) * kC1;
+  }
+
+  void ProcessBlock(const uint8_t* block) {
+    h1_ ^= MixK1(ReadLittleEndian64(block));
+    h1_ = RotateLeft(h1_, 27) + h2_;
+    h1_ = h1_ * 5 + 0x52dce729;
+    h2_ ^= MixK2(ReadLittleEndian64(block + 8));
+    h2_ = RotateLeft(h2_, 31) + h1_;
+    h2_ = h2_ * 5 + 0x38495ab5;
+  }
+
+  uint64_t h1_ = 0;
+  uint64_t h2_ = 0;
+  uint64_t total_size_ = 0;
+  uint8_t tail_[kBlockSize];
+  size_t tail_size_ = 0;
+};
+
+constexpr size_t Murmur3Hasher128::kBlockSize;
+constexpr uint64_t Murmur3Hasher128::kC1;
+constexpr uint64_t Murmur3Hasher128::kC2;
+
+// Field number 0 is not a valid field number in protos; it is used to mark the
+// end of a message in the canonical encoding.
+constexpr uint64_t kEndOfMessage = 0;
+
+void AddMessageToHash(const Message& message, Murmur3Hasher128* hasher);
+
+// Adds the value of a non-repeated field, or of the element at 'index' of a
+// repeated field when 'index' is non-negative, to the hash. All integral values
+// are added as 64-bit integers, and floating point values are added as the bits
+// of a double.
+void AddFieldValueToHash(const Message& message, const FieldDescriptor* field,
+                         int index, Murmur3Hasher128* hasher) {
+  const Reflection* const reflection = message.GetReflection();
+  const bool repeated = index >= 0;
+  switch (field->cpp_type()) {
+#define CPU_INSTRUCTIONS_ADD_INTEGER_VALUE(CPPTYPE, Name)                \
+  case FieldDescriptor::CPPTYPE_##CPPTYPE:                               \
+    hasher->UpdateWithUint64(static_cast<uint64_t>(                      \
+        repeated ? reflection->GetRepeated##Name(message, field, index)  \
+                 : reflection->Get##Name(message, field)));              \
+    break;
+    CPU_INSTRUCTIONS_ADD_INTEGER_VALUE(INT32, Int32)
+    CPU_INSTRUCTIONS_ADD_INTEGER_VALUE(INT64, Int64)
+    CPU_INSTRUCTIONS_ADD_INTEGER_VALUE(UINT32, UInt32)
+    CPU_INSTRUCTIONS_ADD_INTEGER_VALUE(UINT64, UInt64)
+    CPU_INSTRUCTIONS_ADD_INTEGER_VALUE(BOOL, Bool)
+    CPU_INSTRUCTIONS_ADD_INTEGER_VALUE(ENUM, EnumValue)
+#undef CPU_INSTRUCTIONS_ADD_INTEGER_VALUE
+    case FieldDescriptor::CPPTYPE_FLOAT:
+    case FieldDescriptor::CPPTYPE_DOUBLE: {
+      double value = 0.0;
+      if (field->cpp_type() == FieldDescriptor::CPPTYPE_FLOAT) {
+        value = repeated ? reflection->GetRepeatedFloat(message, field, index)
+                         : reflection->GetFloat(message, field);
+      } else {
+        value = repeated ? reflection->GetRepeatedDouble(message, field, index)
+                         : reflection->GetDouble(message, field);
+      }
+      uint64_t bits = 0;
+      static_assert(sizeof(bits) == sizeof(value), "Unexpected double size");
+      memcpy(&bits, &value, sizeof(bits));
+      hasher->UpdateWithUint64(bits);
+      break;
+    }
+    case FieldDescriptor::CPPTYPE_STRING: {
+      string buffer;
+      const string& value =
+          repeated
+              ? reflection->GetRepeatedStringReference(message, field, index,
+                                                       &buffer)
+              : reflection->GetStringReference(message, field, &buffer);
+      hasher->UpdateWithUint64(value.size());
+      hasher->Update(value.data(), value.size());
+      break;
+    }
+    case FieldDescriptor::CPPTYPE_MESSAGE:
+      AddMessageToHash(
+          repeated ? reflection->GetRepeatedMessage(message, field, index)
+                   : reflection->GetMessage(message, field),
+          hasher);
+      break;
+  }
+}
+
+// Adds the fingerprints of the entries of a map field to the hash. The order of
+// the entries of a map field is not defined, so the entries are sorted by their
+// fingerprints first.
+void AddMapFieldToHash(const Message& message, const FieldDescriptor* field,
+                       Murmur3Hasher128* hasher) {
+  const Reflection* const reflection = message.GetReflection();
+  const int num_entries = reflection->FieldSize(message, field);
+  std::vector<Fingerprint128> entry_fingerprints;
+  entry_fingerprints.reserve(num_entries);
+  for (int i = 0; i < num_entries; ++i) {
+    entry_fingerprints.push_back(
+        GetProtoFingerprint(reflection->GetRepeatedMessage(message, field, i)));
+  }
+  std::sort(entry_fingerprints.begin(), entry_fingerprints.end());
+  for (const Fingerprint128& entry_fingerprint : entry_fingerprints) {
+    hasher->UpdateWithUint64(entry_fingerprint.low);
+    hasher->UpdateWithUint64(entry_fingerprint.high);
+  }
+}
+
+// Adds the canonical encoding of 'message' to the hash. Each field that is set
+// is encoded as its field number followed by its value; repeated fields are
+// encoded as the field number, the number of elements, and the values of the
+// elements. The fields are encoded in the order of their field numbers, and the
+// end of the message is marked by kEndOfMessage.
+void AddMessageToHash(const Message& message, Murmur3Hasher128* hasher) {
+  const Reflection* const reflection = message.GetReflection();
+  std::vector<const FieldDescriptor*> fields;
+  // ListFields returns the fields sorted by their field numbers, and it does
+  // not return unknown fields.
+  reflection->ListFields(message, &fields);
+  for (const FieldDescriptor* const field : fields) {
+    hasher->UpdateWithUint64(field->number());
+    if (field->is_repeated()) {
+      const int num_elements = reflection->FieldSize(message, field);
+      hasher->UpdateWithUint64(num_elements);
+      if (field->is_map()) {
+        AddMapFieldToHash(message, field, hasher);
+      } else {
+        for (int i = 0; i < num_elements; ++i) {
+          AddFieldValueToHash(message, field, i, hasher);
+        }
+      }
+    } else {
+      AddFieldValueToHash(message, field, -1, hasher);
+    }
+  }
+  hasher->UpdateWithUint64(kEndOfMessage);
+}
+
+}  // namespace
+
+string Fingerprint128ToString(const Fingerprint128& fingerprint) {
+  using ULongLong = unsigned long long;  // NOLINT
+  return StringPrintf("%016llx%016llx",
+                      static_cast<ULongLong>(fingerprint.high),
+                      static_cast<ULongLong>(fingerprint.low));
+}
+
+Fingerprint128 GetProtoFingerprint(const Message& message) {
+  Murmur3Hasher128 hasher;
+  AddMessageToHash(message, &hasher);
+  return hasher.Finish();
+}
+
+}  // namespace cpu_instructions
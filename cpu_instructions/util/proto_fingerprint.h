@@ -0,0 +1,73 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Contains a library for computing stable 128-bit fingerprints of protos.
+//
+// Unlike hashes of the serialized proto, the fingerprint depends only on the
+// known fields of the proto and their values: it does not depend on the order
+// in which the fields were serialized or parsed, on the order of the entries in
+// map fields, or on unknown fields. The fingerprint is the same in all runs and
+// builds of the program, so it can be used for deduplication, for caching, and
+// for comparing protos across runs.
+
+#ifndef CPU_INSTRUCTIONS_UTIL_PROTO_FINGERPRINT_H_
+#define CPU_INSTRUCTIONS_UTIL_PROTO_FINGERPRINT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "strings/string.h"
+
+#include "src/google/protobuf/message.h"
+
+namespace cpu_instructions {
+
+// A 128-bit fingerprint of a proto.
+struct Fingerprint128 {
+  uint64_t low = 0;
+  uint64_t high = 0;
+};
+
+inline bool operator==(const Fingerprint128& a, const Fingerprint128& b) {
+  return a.low == b.low && a.high == b.high;
+}
+
+inline bool operator!=(const Fingerprint128& a, const Fingerprint128& b) {
+  return !(a == b);
+}
+
+inline bool operator<(const Fingerprint128& a, const Fingerprint128& b) {
+  return a.high < b.high || (a.high == b.high && a.low < b.low);
+}
+
+// A hash function for using Fingerprint128 as a key of std::unordered_set and
+// std::unordered_map.
+struct Fingerprint128Hash {
+  size_t operator()(const Fingerprint128& fingerprint) const {
+    return static_cast<size_t>(fingerprint.low);
+  }
+};
+
+// Returns the fingerprint as a string of 32 hexadecimal digits.
+string Fingerprint128ToString(const Fingerprint128& fingerprint);
+
+// Computes the fingerprint of 'message'. Two messages of the same type that are
+// equal according to MessageDifferencer::Equals have the same fingerprint, and
+// two messages with the same fingerprint are equal with a very high
+// probability. Note that for proto2 messages, a field that is explicitly set to
+// its default value is different from a field that is not set.
+Fingerprint128 GetProtoFingerprint(const google::protobuf::Message& message);
+
+}  // namespace cpu_instructions
+
+#endif  // CPU_INSTRUCTIONS_UTIL_PROTO_FINGERPRINT_H_
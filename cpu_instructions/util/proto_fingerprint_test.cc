@@ -0,0 +1,130 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cpu_instructions/util/proto_fingerprint.h"
+
+#include "strings/string.h"
+
+#include "cpu_instructions/proto/instructions.pb.h"
+#include "cpu_instructions/util/proto_util.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "src/google/protobuf/struct.pb.h"
+
+namespace cpu_instructions {
+namespace {
+
+using ::google::protobuf::Struct;
+
+constexpr char kInstructionProto[] = R"(
+    llvm_mnemonic: 'ADD32mr'
+    vendor_syntax {
+      mnemonic: 'ADD'
+      operands { name: 'r/m32' }
+      operands { name: 'r32' }
+    }
+    feature_name: 'X86'
+    available_in_64_bit: true
+    implicit_output_operands: 'EFLAGS')";
+
+TEST(GetProtoFingerprintTest, EqualProtosHaveEqualFingerprints) {
+  const InstructionProto instruction =
+      ParseProtoFromStringOrDie<InstructionProto>(kInstructionProto);
+  const InstructionProto copy = instruction;
+  EXPECT_EQ(GetProtoFingerprint(instruction), GetProtoFingerprint(copy));
+}
+
+TEST(GetProtoFingerprintTest, DifferentProtosHaveDifferentFingerprints) {
+  const InstructionProto instruction =
+      ParseProtoFromStringOrDie<InstructionProto>(kInstructionProto);
+  const Fingerprint128 fingerprint = GetProtoFingerprint(instruction);
+
+  InstructionProto changed_value = instruction;
+  changed_value.set_feature_name("X87");
+  EXPECT_NE(GetProtoFingerprint(changed_value), fingerprint);
+
+  InstructionProto added_element = instruction;
+  added_element.add_implicit_output_operands("");
+  EXPECT_NE(GetProtoFingerprint(added_element), fingerprint);
+
+  InstructionProto cleared_field = instruction;
+  cleared_field.clear_available_in_64_bit();
+  EXPECT_NE(GetProtoFingerprint(cleared_field), fingerprint);
+
+  // The values of the two operands are swapped.
+  InstructionProto swapped_operands = instruction;
+  swapped_operands.mutable_vendor_syntax()->mutable_operands()->SwapElements(
+      0, 1);
+  EXPECT_NE(GetProtoFingerprint(swapped_operands), fingerprint);
+
+  // The string is moved from one field to another.
+  const InstructionProto first = ParseProtoFromStringOrDie<InstructionProto>(
+      "implicit_input_operands: 'EFLAGS'");
+  const InstructionProto second = ParseProtoFromStringOrDie<InstructionProto>(
+      "implicit_output_operands: 'EFLAGS'");
+  EXPECT_NE(GetProtoFingerprint(first), GetProtoFingerprint(second));
+}
+
+TEST(GetProtoFingerprintTest, DoesNotDependOnSerializationOrder) {
+  InstructionProto mnemonic_only;
+  mnemonic_only.set_llvm_mnemonic("ADD32mr");
+  InstructionProto feature_name_only;
+  feature_name_only.set_feature_name("X86");
+
+  InstructionProto in_order;
+  ASSERT_TRUE(in_order.ParseFromString(mnemonic_only.SerializeAsString() +
+                                       feature_name_only.SerializeAsString()));
+  InstructionProto reversed;
+  ASSERT_TRUE(reversed.ParseFromString(feature_name_only.SerializeAsString() +
+                                       mnemonic_only.SerializeAsString()));
+  EXPECT_EQ(GetProtoFingerprint(in_order), GetProtoFingerprint(reversed));
+}
+
+TEST(GetProtoFingerprintTest, IgnoresUnknownFields) {
+  const InstructionProto instruction =
+      ParseProtoFromStringOrDie<InstructionProto>(kInstructionProto);
+  // The tag of a varint field with the field number 1000, and the value 1.
+  constexpr char kUnknownField[] = "\xc0\x3e\x01";
+  InstructionProto with_unknown_field;
+  ASSERT_TRUE(with_unknown_field.ParseFromString(
+      instruction.SerializeAsString() + kUnknownField));
+  EXPECT_EQ(GetProtoFingerprint(with_unknown_field),
+            GetProtoFingerprint(instruction));
+}
+
+TEST(GetProtoFingerprintTest, DoesNotDependOnOrderOfMapEntries) {
+  Struct first;
+  (*first.mutable_fields())["a"].set_number_value(1.0);
+  (*first.mutable_fields())["b"].set_string_value("foo");
+  Struct second;
+  (*second.mutable_fields())["b"].set_string_value("foo");
+  (*second.mutable_fields())["a"].set_number_value(1.0);
+  EXPECT_EQ(GetProtoFingerprint(first), GetProtoFingerprint(second));
+
+  (*second.mutable_fields())["a"].set_number_value(2.0);
+  EXPECT_NE(GetProtoFingerprint(first), GetProtoFingerprint(second));
+}
+
+TEST(GetProtoFingerprintTest, IsStable) {
+  // The fingerprints must not change between runs and builds of the program.
+  EXPECT_EQ(Fingerprint128ToString(GetProtoFingerprint(InstructionProto())),
+            "f2557dfcc4e8fe5228df63b7cc57c3cb");
+  const InstructionProto instruction =
+      ParseProtoFromStringOrDie<InstructionProto>(kInstructionProto);
+  EXPECT_EQ(Fingerprint128ToString(GetProtoFingerprint(instruction)),
+            "85e187591a77608005e124ed1379802b");
+}
+
+}  // namespace
+}  // namespace cpu_instructions
@@ -0,0 +1,94 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Tests the structure of the default pipeline that contains all the x86
+// cleanups.
+
+#include <algorithm>
+#include <vector>
+
+#include "cpu_instructions/base/cleanup_instruction_set.h"
+#include "gtest/gtest.h"
+#include "strings/str_split.h"
+#include "strings/string.h"
+
+namespace cpu_instructions {
+namespace x86 {
+namespace {
+
+// Returns the position of the element of the default pipeline that runs the
+// transform 'transform_name', or -1 if there is no such element. Each element
+// is either a single transform, or a group of transforms with the same rank
+// that were fused into a single pass over the instruction set.
+int FindPipelineElement(const std::vector<InstructionSetTransform>& pipeline,
+                        const string& transform_name) {
+  for (int i = 0; i < static_cast<int>(pipeline.size()); ++i) {
+    const std::vector<string> names =
+        strings::Split(GetTransformName(pipeline[i]), "+");
+    if (std::find(names.begin(), names.end(), transform_name) != names.end()) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+TEST(DefaultTransformPipelineTest, NumberOfFusedPasses) {
+  // Adding a transform to the default pipeline may add a pass over the
+  // instruction set. If this test fails because a transform was added, check
+  // whether it can be a per-instruction, removal or indexed transform with the
+  // same rank as another transform of the same kind before updating it.
+  EXPECT_EQ(GetDefaultTransformPipeline().size(), 15);
+}
+
+TEST(DefaultTransformPipelineTest, FusesTransformsWithTheSameRank) {
+  // The per-instruction transforms are registered with the same rank as other
+  // kinds of transforms, but they are still fused into a single pass.
+  const std::vector<InstructionSetTransform> pipeline =
+      GetDefaultTransformPipeline();
+  const int fix_encoding_specifications =
+      FindPipelineElement(pipeline, "FixEncodingSpecifications");
+  ASSERT_NE(fix_encoding_specifications, -1);
+  EXPECT_EQ(FindPipelineElement(pipeline,
+                                "AddMissingModRmAndImmediateSpecification"),
+            fix_encoding_specifications);
+  EXPECT_EQ(FindPipelineElement(pipeline, "AddMissingCpuFlags"),
+            fix_encoding_specifications);
+  EXPECT_EQ(FindPipelineElement(pipeline, "AddProtectionModes"),
+            fix_encoding_specifications);
+
+  const int rename_operands = FindPipelineElement(pipeline, "RenameOperands");
+  ASSERT_NE(rename_operands, -1);
+  EXPECT_EQ(FindPipelineElement(pipeline, "RemoveImplicitST0Operand"),
+            rename_operands);
+  EXPECT_EQ(FindPipelineElement(pipeline, "RemoveImplicitXmm0Operand"),
+            rename_operands);
+
+  // The indexed transforms with the same rank share a single element.
+  const int fix_xbegin =
+      FindPipelineElement(pipeline, "FixEncodingSpecificationOfXBegin");
+  ASSERT_NE(fix_xbegin, -1);
+  EXPECT_EQ(
+      FindPipelineElement(
+          pipeline, "FixAndCleanUpEncodingSpecificationsOfSetInstructions"),
+      fix_xbegin);
+
+  // The removals with rank 0 are all fused into the first element.
+  EXPECT_EQ(FindPipelineElement(pipeline, "RemoveUndefinedInstructions"), 0);
+  EXPECT_EQ(FindPipelineElement(pipeline, "RemoveNonEncodableInstructions"),
+            0);
+}
+
+}  // namespace
+}  // namespace x86
+}  // namespace cpu_instructions
@@ -15,15 +15,16 @@
 #include "cpu_instructions/x86/cleanup_instruction_set_alternatives.h"
 
 #include <cstdint>
-#include <unordered_map>
+#include <utility>
 #include <vector>
 #include "strings/string.h"
 
 #include "cpu_instructions/base/cleanup_instruction_set.h"
 #include "cpu_instructions/proto/instructions.pb.h"
+#include "cpu_instructions/x86/operand_names.h"
 #include "glog/logging.h"
+#include "src/google/protobuf/repeated_field.h"
 #include "strings/str_cat.h"
-#include "util/gtl/map_util.h"
 #include "util/task/canonical_errors.h"
 #include "util/task/status.h"
 
@@ -47,8 +48,9 @@ struct OperandAlternative {
   // The new value of the operand.
   uint32_t value_size;
 };
-using OperandAlternativeMap =
-    std::unordered_map<string, std::vector<OperandAlternative>>;
+using OperandAlternativeList =
+    std::vector<std::pair<const char*, std::vector<OperandAlternative>>>;
+using OperandAlternativeMap = OperandNameMap<std::vector<OperandAlternative>>;
 
 // Returns the list of operand alternatives indexed by the name of the operand.
 // TODO(ondrasej): Re-enable broadcasted arguments when we have a way to
@@ -59,7 +61,7 @@ const OperandAlternativeMap& GetOperandAlternativesByName() {
         InstructionOperand::DIRECT_ADDRESSING;
     constexpr InstructionOperand::AddressingMode INDIRECT_ADDRESSING =
         InstructionOperand::INDIRECT_ADDRESSING;
-    return new OperandAlternativeMap({
+    const OperandAlternativeList alternatives = {
         {"mm/m32",
          {{"mm1", DIRECT_ADDRESSING, 32}, {"m32", INDIRECT_ADDRESSING, 32}}},
         {"mm/m64",
@@ -198,34 +200,62 @@ const OperandAlternativeMap& GetOperandAlternativesByName() {
          {{"k2", DIRECT_ADDRESSING, 32}, {"m32", INDIRECT_ADDRESSING, 32}}},
         {"k2/m64",
          {{"k2", DIRECT_ADDRESSING, 64}, {"m64", INDIRECT_ADDRESSING, 64}}},
-    });
+    };
+    return new OperandAlternativeMap(alternatives.begin(), alternatives.end());
   }();
   return *kAlternatives;
 }
 
+// An operand that is split into alternatives by AddAlternatives.
+struct OperandWithAlternatives {
+  // The index of the instruction in the instruction set.
+  int instruction_index;
+
+  // The index of the operand in the vendor syntax of the instruction.
+  int operand_index;
+
+  // The alternatives of the operand.
+  const std::vector<OperandAlternative>* alternatives;
+};
+
+// Updates the fields of 'operand' that are specific to 'alternative'.
+void SetOperandAlternative(const OperandAlternative& alternative,
+                           InstructionOperand* operand) {
+  DCHECK(operand != nullptr);
+  operand->set_name(alternative.operand_name);
+  operand->set_addressing_mode(alternative.addressing_mode);
+  operand->set_value_size_bits(alternative.value_size);
+}
+
 }  // namespace
 
 Status AddAlternatives(InstructionSetProto* instruction_set) {
   CHECK(instruction_set != nullptr);
-  Status status = OkStatus();
   const OperandAlternativeMap& alternatives_by_name =
       GetOperandAlternativesByName();
-  std::vector<InstructionProto> new_instructions;
-  for (InstructionProto& instruction :
-       *instruction_set->mutable_instructions()) {
-    InstructionFormat* const vendor_syntax =
-        instruction.mutable_vendor_syntax();
-    for (int operand_index = 0; operand_index < vendor_syntax->operands_size();
+  google::protobuf::RepeatedPtrField<InstructionProto>* const instructions =
+      instruction_set->mutable_instructions();
+
+  // Find all operands that need to be split and check that they can be split.
+  // This way, the number of the new instructions is known before any of them
+  // is created, and the instruction set is not modified when it contains an
+  // error.
+  std::vector<OperandWithAlternatives> operands_with_alternatives;
+  int num_new_instructions = 0;
+  for (int instruction_index = 0; instruction_index < instructions->size();
+       ++instruction_index) {
+    const InstructionProto& instruction = instructions->Get(instruction_index);
+    const InstructionFormat& vendor_syntax = instruction.vendor_syntax();
+    for (int operand_index = 0; operand_index < vendor_syntax.operands_size();
          ++operand_index) {
-      InstructionOperand* const operand =
-          vendor_syntax->mutable_operands(operand_index);
+      const InstructionOperand& operand = vendor_syntax.operands(operand_index);
       const std::vector<OperandAlternative>* const alternatives =
-          FindOrNull(alternatives_by_name, operand->name());
+          alternatives_by_name.Find(GetOperandNameId(operand.name()));
       if (alternatives == nullptr) continue;
 
       // The only encoding that allows alternatives is modrm.rm. An operand with
       // alternatives anywhere else means that there is an error in the data.
-      if (operand->encoding() != InstructionOperand::MODRM_RM_ENCODING) {
+      if (operand.encoding() != InstructionOperand::MODRM_RM_ENCODING) {
         return InvalidArgumentError(
             StrCat("Instruction does not use modrm.rm encoding:\n",
                    instruction.DebugString()));
@@ -233,37 +263,49 @@ Status AddAlternatives(InstructionSetProto* instruction_set) {
       // The altenatives are always "register" vs "memory", because that is the
       // only kind of alternatives that can be expressed through operand
       // encoding.
-      if (operand->addressing_mode() !=
+      if (operand.addressing_mode() !=
           InstructionOperand::ANY_ADDRESSING_WITH_FLEXIBLE_REGISTERS) {
         return InvalidArgumentError(StrCat(
             "The addressing mode does not allow splitting: ",
-            InstructionOperand::AddressingMode_Name(operand->addressing_mode()),
+            InstructionOperand::AddressingMode_Name(operand.addressing_mode()),
             "\n", instruction.DebugString()));
       }
-      // Note that we start iterating at 1, and that we will be reusing
-      // the existing instruction for the first alternative.
-      for (int i = 1; i < alternatives->size(); ++i) {
-        const OperandAlternative& alternative = (*alternatives)[i];
-        new_instructions.push_back(instruction);
-        InstructionOperand* const new_instruction_operand =
-            new_instructions.back().mutable_vendor_syntax()->mutable_operands(
-                operand_index);
-        new_instruction_operand->set_name(alternative.operand_name);
-        new_instruction_operand->set_addressing_mode(
-            alternative.addressing_mode);
-        new_instruction_operand->set_value_size_bits(alternative.value_size);
-      }
-      // Now overwrite the current instruction's operand.
-      const OperandAlternative& first_alternative = alternatives->front();
-      operand->set_name(first_alternative.operand_name);
-      operand->set_addressing_mode(first_alternative.addressing_mode);
-      operand->set_value_size_bits(first_alternative.value_size);
+      operands_with_alternatives.push_back(
+          {instruction_index, operand_index, alternatives});
+      num_new_instructions += alternatives->size() - 1;
     }
   }
-  for (InstructionProto& new_instruction : new_instructions) {
-    instruction_set->add_instructions()->Swap(&new_instruction);
+
+  // Each new instruction is created directly in its final place in the
+  // instruction set; the pointer array of the repeated field is allocated only
+  // once. The operands are processed in the order of the instructions and of
+  // their operands, and for each operand, the new instructions are copies of
+  // the original instruction with the alternatives of the operand that were
+  // already processed.
+  instructions->Reserve(instructions->size() + num_new_instructions);
+  for (const OperandWithAlternatives& operand_with_alternatives :
+       operands_with_alternatives) {
+    InstructionProto* const instruction =
+        instructions->Mutable(operand_with_alternatives.instruction_index);
+    const int operand_index = operand_with_alternatives.operand_index;
+    const std::vector<OperandAlternative>& alternatives =
+        *operand_with_alternatives.alternatives;
+    // Note that we start iterating at 1, and that we will be reusing the
+    // existing instruction for the first alternative.
+    for (int i = 1; i < alternatives.size(); ++i) {
+      InstructionProto* const new_instruction = instructions->Add();
+      *new_instruction = *instruction;
+      SetOperandAlternative(
+          alternatives[i],
+          new_instruction->mutable_vendor_syntax()->mutable_operands(
+              operand_index));
+    }
+    // Now overwrite the current instruction's operand.
+    SetOperandAlternative(
+        alternatives.front(),
+        instruction->mutable_vendor_syntax()->mutable_operands(operand_index));
   }
-  return status;
+  return OkStatus();
 }
 REGISTER_INSTRUCTION_SET_TRANSFORM(AddAlternatives, 6000);
 
@@ -0,0 +1,121 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Benchmarks for AddAlternatives on a synthetic AVX-512-heavy instruction set.
+// Run with:
+//   bazel run -c opt \
+//     //cpu_instructions/x86:cleanup_instruction_set_alternatives_benchmark
+
+#include "strings/string.h"
+
+#include "benchmark/benchmark.h"
+#include "cpu_instructions/proto/instructions.pb.h"
+#include "cpu_instructions/x86/cleanup_instruction_set_alternatives.h"
+#include "glog/logging.h"
+#include "strings/str_cat.h"
+
+namespace cpu_instructions {
+namespace x86 {
+namespace {
+
+// The operands of the synthetic instructions. Most of them are EVEX
+// instructions with one or two operands that have register and memory
+// alternatives, similar to the AVX-512 part of the Intel SDM.
+struct SyntheticOperand {
+  const char* name;
+  InstructionOperand::Encoding encoding;
+};
+const SyntheticOperand kEvexOperandsWithBroadcast[] = {
+    {"zmm1", InstructionOperand::MODRM_REG_ENCODING},
+    {"zmm2", InstructionOperand::VEX_V_ENCODING},
+    {"zmm3/m512/m32bcst", InstructionOperand::MODRM_RM_ENCODING}};
+const SyntheticOperand kEvexOperandsWithMask[] = {
+    {"k1", InstructionOperand::MODRM_REG_ENCODING},
+    {"k2/m16", InstructionOperand::MODRM_RM_ENCODING}};
+const SyntheticOperand kEvexOperandsWithTwoAlternatives[] = {
+    {"xmm1/m64", InstructionOperand::MODRM_RM_ENCODING},
+    {"xmm2/m128", InstructionOperand::MODRM_RM_ENCODING},
+    {"imm8", InstructionOperand::IMMEDIATE_VALUE_ENCODING}};
+const SyntheticOperand kLegacyOperands[] = {
+    {"r32", InstructionOperand::MODRM_REG_ENCODING},
+    {"r/m32", InstructionOperand::MODRM_RM_ENCODING}};
+
+template <size_t kNumOperands>
+void AddSyntheticInstruction(
+    const string& mnemonic, const char* raw_encoding_specification,
+    const SyntheticOperand (&operands)[kNumOperands],
+    InstructionSetProto* instruction_set) {
+  InstructionProto* const instruction = instruction_set->add_instructions();
+  instruction->set_description(StrCat(
+      "Synthetic instruction ", mnemonic,
+      " with a description of a length comparable to the SDM descriptions."));
+  instruction->set_feature_name("AVX512F");
+  instruction->set_available_in_64_bit(true);
+  instruction->set_encoding_scheme("FV");
+  instruction->set_raw_encoding_specification(raw_encoding_specification);
+  InstructionFormat* const vendor_syntax = instruction->mutable_vendor_syntax();
+  vendor_syntax->set_mnemonic(mnemonic);
+  for (const SyntheticOperand& operand : operands) {
+    InstructionOperand* const new_operand = vendor_syntax->add_operands();
+    new_operand->set_name(operand.name);
+    new_operand->set_encoding(operand.encoding);
+    new_operand->set_addressing_mode(
+        operand.encoding == InstructionOperand::MODRM_RM_ENCODING
+            ? InstructionOperand::ANY_ADDRESSING_WITH_FLEXIBLE_REGISTERS
+            : InstructionOperand::DIRECT_ADDRESSING);
+  }
+}
+
+// Creates an instruction set with roughly as many instructions as the full
+// Intel SDM, most of them AVX-512 instructions.
+InstructionSetProto CreateSyntheticInstructionSet() {
+  constexpr int kNumInstructionGroups = 1000;
+  InstructionSetProto instruction_set;
+  for (int i = 0; i < kNumInstructionGroups; ++i) {
+    AddSyntheticInstruction(StrCat("VADDPS", i), "EVEX.NDS.512.0F.W0 58 /r",
+                            kEvexOperandsWithBroadcast, &instruction_set);
+    AddSyntheticInstruction(StrCat("KMOVW", i), "VEX.L0.0F.W0 90 /r",
+                            kEvexOperandsWithMask, &instruction_set);
+    AddSyntheticInstruction(StrCat("VSHUFPD", i),
+                            "EVEX.NDS.128.66.0F.W1 C6 /r ib",
+                            kEvexOperandsWithTwoAlternatives, &instruction_set);
+    AddSyntheticInstruction(StrCat("ADD", i), "03 /r", kLegacyOperands,
+                            &instruction_set);
+  }
+  return instruction_set;
+}
+
+void BM_AddAlternatives(benchmark::State& state) {
+  const InstructionSetProto instruction_set = CreateSyntheticInstructionSet();
+  InstructionSetProto input;
+  while (state.KeepRunning()) {
+    // The transform modifies its input, so each iteration gets a fresh copy.
+    // The copy and the destruction of the output of the previous iteration are
+    // not timed.
+    state.PauseTiming();
+    input = instruction_set;
+    state.ResumeTiming();
+    CHECK(AddAlternatives(&input).ok());
+    benchmark::DoNotOptimize(input);
+  }
+  state.SetItemsProcessed(state.iterations() *
+                          instruction_set.instructions_size());
+}
+BENCHMARK(BM_AddAlternatives);
+
+}  // namespace
+}  // namespace x86
+}  // namespace cpu_instructions
+
+BENCHMARK_MAIN();
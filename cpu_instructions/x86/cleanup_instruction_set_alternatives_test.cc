@@ -14,13 +14,20 @@
 
 #include "cpu_instructions/x86/cleanup_instruction_set_alternatives.h"
 
+#include "strings/string.h"
+
 #include "cpu_instructions/base/cleanup_instruction_set_test_utils.h"
 #include "gtest/gtest.h"
+#include "src/google/protobuf/text_format.h"
+#include "util/task/status.h"
 
 namespace cpu_instructions {
 namespace x86 {
 namespace {
 
+using ::cpu_instructions::util::Status;
+using ::cpu_instructions::util::error::INVALID_ARGUMENT;
+
 TEST(AddAlternativesTest, InstructionWithRM8) {
   constexpr char kInstructionSetProto[] = R"(
       instructions {
@@ -168,6 +175,82 @@ TEST(AddAlternativesTest, NoRenaming) {
                 kExpectedInstructionSetProto);
 }
 
+TEST(AddAlternativesTest, TwoOperandsWithAlternatives) {
+  constexpr char kInstructionSetProto[] = R"(
+      instructions {
+        vendor_syntax {
+          mnemonic: "VCMPSD"
+          operands { addressing_mode: ANY_ADDRESSING_WITH_FLEXIBLE_REGISTERS
+                     encoding: MODRM_RM_ENCODING name: "r/m8" }
+          operands { addressing_mode: ANY_ADDRESSING_WITH_FLEXIBLE_REGISTERS
+                     encoding: MODRM_RM_ENCODING name: "xmm2/m64" }}
+        raw_encoding_specification: "0F C2 /r" }
+      instructions {
+        vendor_syntax {
+          mnemonic: "NOP" }
+        raw_encoding_specification: "90" })";
+  constexpr char kExpectedInstructionSetProto[] = R"(
+      instructions {
+        vendor_syntax {
+          mnemonic: "VCMPSD"
+          operands { addressing_mode: DIRECT_ADDRESSING
+                     encoding: MODRM_RM_ENCODING value_size_bits: 8
+                     name: "r8" }
+          operands { addressing_mode: DIRECT_ADDRESSING
+                     encoding: MODRM_RM_ENCODING value_size_bits: 64
+                     name: "xmm2" }}
+        raw_encoding_specification: "0F C2 /r" }
+      instructions {
+        vendor_syntax {
+          mnemonic: "NOP" }
+        raw_encoding_specification: "90" }
+      instructions {
+        vendor_syntax {
+          mnemonic: "VCMPSD"
+          operands { addressing_mode: INDIRECT_ADDRESSING
+                     encoding: MODRM_RM_ENCODING value_size_bits: 8
+                     name: "m8" }
+          operands { addressing_mode: ANY_ADDRESSING_WITH_FLEXIBLE_REGISTERS
+                     encoding: MODRM_RM_ENCODING name: "xmm2/m64" }}
+        raw_encoding_specification: "0F C2 /r" }
+      instructions {
+        vendor_syntax {
+          mnemonic: "VCMPSD"
+          operands { addressing_mode: DIRECT_ADDRESSING
+                     encoding: MODRM_RM_ENCODING value_size_bits: 8
+                     name: "r8" }
+          operands { addressing_mode: INDIRECT_ADDRESSING
+                     encoding: MODRM_RM_ENCODING value_size_bits: 64
+                     name: "m64" }}
+        raw_encoding_specification: "0F C2 /r" })";
+  TestTransform(AddAlternatives, kInstructionSetProto,
+                kExpectedInstructionSetProto);
+}
+
+TEST(AddAlternativesTest, InvalidEncoding) {
+  constexpr char kInstructionSetProto[] = R"(
+      instructions {
+        vendor_syntax {
+          mnemonic: "ADC"
+          operands { addressing_mode: ANY_ADDRESSING_WITH_FLEXIBLE_REGISTERS
+                     encoding: MODRM_RM_ENCODING name: "r/m8" }}
+        raw_encoding_specification: "12 /r" }
+      instructions {
+        vendor_syntax {
+          mnemonic: "ADC"
+          operands { addressing_mode: ANY_ADDRESSING_WITH_FLEXIBLE_REGISTERS
+                     encoding: MODRM_REG_ENCODING name: "r/m16" }}
+        raw_encoding_specification: "13 /r" })";
+  InstructionSetProto instruction_set;
+  ASSERT_TRUE(::google::protobuf::TextFormat::ParseFromString(
+      kInstructionSetProto, &instruction_set));
+  const string original_instruction_set = instruction_set.DebugString();
+  const Status transform_status = AddAlternatives(&instruction_set);
+  EXPECT_EQ(transform_status.error_code(), INVALID_ARGUMENT);
+  // The instruction set is not modified when the transform fails.
+  EXPECT_EQ(instruction_set.DebugString(), original_instruction_set);
+}
+
 }  // namespace
 }  // namespace x86
 }  // namespace cpu_instructions
@@ -14,7 +14,6 @@
 
 #include "cpu_instructions/x86/cleanup_instruction_set_asm_syntax.h"
 
-#include <unordered_set>
 #include "strings/string.h"
 
 #include "cpu_instructions/base/cleanup_instruction_set.h"
@@ -22,7 +21,7 @@
 #include "glog/logging.h"
 #include "strings/str_cat.h"
 #include "strings/string_view.h"
-#include "util/gtl/map_util.h"
+#include "util/gtl/perfect_hash_map.h"
 #include "util/task/canonical_errors.h"
 #include "util/task/status.h"
 
@@ -46,57 +45,56 @@ char GetSuffixFromPointerType(StringPiece operand) {
   return '\0';
 }
 
+// The mnemonics of the string instructions.
+constexpr const char* kStringMnemonics[] = {"CMPS", "INS",  "LODS", "MOVS",
+                                            "OUTS", "SCAS", "STOS"};
+constexpr auto kStringMnemonicSet = gtl::MakePerfectHashTable(kStringMnemonics);
+
 }  // anonymous namespace
 
-Status AddIntelAsmSyntax(InstructionSetProto* instruction_set) {
-  const std::unordered_set<string> kStringMnemonics = {
-      "CMPS", "INS", "LODS", "MOVS", "OUTS", "SCAS", "STOS"};
-  Status status = OkStatus();
-  for (InstructionProto& instruction :
-       *instruction_set->mutable_instructions()) {
-    InstructionFormat* const syntax = instruction.mutable_syntax();
-    *syntax = instruction.vendor_syntax();
-    if (ContainsKey(kStringMnemonics, syntax->mnemonic())) {
-      // Adds a suffix to all the string mnemonics, because the LLVM assembler
-      // does not recognize the mnemonics without the suffix.
-      if (syntax->operands().empty()) {
-        status = InvalidArgumentError(StrCat(
-            "Unexpected number of arguments:\n", instruction.DebugString()));
-        LOG(ERROR) << status;
-        continue;
-      }
-      char suffix = GetSuffixFromPointerType(syntax->operands(0).name());
-      if (suffix == '\0' && syntax->operands().size() > 1) {
-        suffix = GetSuffixFromPointerType(syntax->operands(1).name());
-      }
-      syntax->set_mnemonic(syntax->mnemonic() + suffix);
-    } else if (syntax->mnemonic() == "INVLPG") {
-      // The assembler only understand m8, and not general memory references.
-      syntax->mutable_operands(0)->set_name("m8");
-    } else if (syntax->mnemonic() == "MOV" &&
-               syntax->operands(1).name() == "imm64") {
-      // MOV r/m64, imm64" uses the mnemonic MOVABS in LLVM.
-      syntax->set_mnemonic("MOVABS");
-    } else if (syntax->mnemonic() == "LSL" &&
-               syntax->operands(0).name() == "r64") {
-      // Replace r32/m16 with r64. This is a simplification.
-      syntax->mutable_operands(1)->set_name("r64");
-    } else if (syntax->mnemonic() == "NOP" && syntax->operands().size() == 1) {
-      // Consider only NOP m32. This is a simplification.
-      syntax->mutable_operands(0)->set_name("m32");
-    } else if (syntax->mnemonic() == "MOVSD" && syntax->operands().empty()) {
-      // Disambiguate MOVSD with argument.
-      auto* operand = syntax->add_operands();
-      operand->set_name("DWORD PTR [RDI]");
-      operand->set_usage(InstructionOperand::USAGE_WRITE);
-      operand = syntax->add_operands();
-      operand->set_name("DWORD PTR [RSI]");
-      operand->set_usage(InstructionOperand::USAGE_READ);
+Status AddIntelAsmSyntax(InstructionProto* instruction) {
+  InstructionFormat* const syntax = instruction->mutable_syntax();
+  *syntax = instruction->vendor_syntax();
+  if (kStringMnemonicSet.Contains(syntax->mnemonic())) {
+    // Adds a suffix to all the string mnemonics, because the LLVM assembler
+    // does not recognize the mnemonics without the suffix.
+    if (syntax->operands().empty()) {
+      const Status status = InvalidArgumentError(StrCat(
+          "Unexpected number of arguments:\n", instruction->DebugString()));
+      LOG(ERROR) << status;
+      return status;
+    }
+    char suffix = GetSuffixFromPointerType(syntax->operands(0).name());
+    if (suffix == '\0' && syntax->operands().size() > 1) {
+      suffix = GetSuffixFromPointerType(syntax->operands(1).name());
     }
+    syntax->set_mnemonic(syntax->mnemonic() + suffix);
+  } else if (syntax->mnemonic() == "INVLPG") {
+    // The assembler only understand m8, and not general memory references.
+    syntax->mutable_operands(0)->set_name("m8");
+  } else if (syntax->mnemonic() == "MOV" &&
+             syntax->operands(1).name() == "imm64") {
+    // MOV r/m64, imm64" uses the mnemonic MOVABS in LLVM.
+    syntax->set_mnemonic("MOVABS");
+  } else if (syntax->mnemonic() == "LSL" &&
+             syntax->operands(0).name() == "r64") {
+    // Replace r32/m16 with r64. This is a simplification.
+    syntax->mutable_operands(1)->set_name("r64");
+  } else if (syntax->mnemonic() == "NOP" && syntax->operands().size() == 1) {
+    // Consider only NOP m32. This is a simplification.
+    syntax->mutable_operands(0)->set_name("m32");
+  } else if (syntax->mnemonic() == "MOVSD" && syntax->operands().empty()) {
+    // Disambiguate MOVSD with argument.
+    auto* operand = syntax->add_operands();
+    operand->set_name("DWORD PTR [RDI]");
+    operand->set_usage(InstructionOperand::USAGE_WRITE);
+    operand = syntax->add_operands();
+    operand->set_name("DWORD PTR [RSI]");
+    operand->set_usage(InstructionOperand::USAGE_READ);
   }
-  return status;
+  return OkStatus();
 }
-REGISTER_INSTRUCTION_SET_TRANSFORM(AddIntelAsmSyntax, kNotInDefaultPipeline);
+REGISTER_INSTRUCTION_TRANSFORM(AddIntelAsmSyntax, kNotInDefaultPipeline);
 
 }  // namespace x86
 }  // namespace cpu_instructions
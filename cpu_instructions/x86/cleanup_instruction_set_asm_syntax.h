@@ -26,8 +26,9 @@ namespace x86 {
 
 using ::cpu_instructions::util::Status;
 
-// Adds the Intel assembler syntax that is parsed by LLVM.
-Status AddIntelAsmSyntax(InstructionSetProto* instruction_set);
+// Adds the Intel assembler syntax that is parsed by LLVM to the instruction.
+// This is a per-instruction transform.
+Status AddIntelAsmSyntax(InstructionProto* instruction);
 
 }  // namespace x86
 }  // namespace cpu_instructions
@@ -21,9 +21,11 @@
 
 #include "cpu_instructions/base/cleanup_instruction_set.h"
 #include "cpu_instructions/proto/x86/encoding_specification.pb.h"
-#include "cpu_instructions/util/status_util.h"
 #include "cpu_instructions/x86/cleanup_instruction_set_utils.h"
 #include "cpu_instructions/x86/encoding_specification.h"
+#include "cpu_instructions/x86/encoding_specification_cache.h"
+#include "cpu_instructions/x86/encoding_specification_literal.h"
+#include "cpu_instructions/x86/packed_encoding.h"
 #include "glog/logging.h"
 #include "re2/re2.h"
 #include "src/google/protobuf/repeated_field.h"
@@ -40,39 +42,45 @@ namespace x86 {
 using ::cpu_instructions::util::InvalidArgumentError;
 using ::cpu_instructions::util::OkStatus;
 using ::cpu_instructions::util::Status;
+using ::cpu_instructions::util::StatusOr;
 
-Status AddMissingMemoryOffsetEncoding(InstructionSetProto* instruction_set) {
+Status AddMissingMemoryOffsetEncoding(InstructionSetIndex* index,
+                                      InstructionSetProto* instruction_set) {
+  CHECK(index != nullptr);
   CHECK(instruction_set != nullptr);
   constexpr char kAddressSizeOverridePrefix[] = "67 ";
   constexpr char k32BitImmediateValueSuffix[] = " id";
   constexpr char k64BitImmediateValueSuffix[] = " io";
-  const std::unordered_set<string> kEncodingSpecifications = {
+  const std::vector<string> kEncodingSpecifications = {
       "A0", "REX.W + A0", "A1", "REX.W + A1",
       "A2", "REX.W + A2", "A3", "REX.W + A3"};
   std::vector<InstructionProto> new_instructions;
-  for (InstructionProto& instruction :
-       *instruction_set->mutable_instructions()) {
+  for (const int position :
+       index->FindByRawEncodingSpecifications(kEncodingSpecifications)) {
+    InstructionProto& instruction =
+        *instruction_set->mutable_instructions(position);
     const string& specification = instruction.raw_encoding_specification();
-    if (ContainsKey(kEncodingSpecifications, specification)) {
-      new_instructions.push_back(instruction);
-      InstructionProto& new_instruction = new_instructions.back();
-      new_instruction.set_raw_encoding_specification(
-          StrCat(kAddressSizeOverridePrefix, specification,
-                 k32BitImmediateValueSuffix));
-      // NOTE(ondrasej): Changing the binary encoding of the original proto will
-      // either invalidate or change the value of the variable specification.
-      // We must thus be careful to not use this variable after it is changed by
-      // instruction.set_raw_encoding_specification.
-      instruction.set_raw_encoding_specification(
-          StrCat(specification, k64BitImmediateValueSuffix));
-    }
+    new_instructions.push_back(instruction);
+    InstructionProto& new_instruction = new_instructions.back();
+    new_instruction.set_raw_encoding_specification(
+        StrCat(kAddressSizeOverridePrefix, specification,
+               k32BitImmediateValueSuffix));
+    // NOTE(ondrasej): Changing the binary encoding of the original proto will
+    // either invalidate or change the value of the variable specification.
+    // We must thus be careful to not use this variable after it is changed by
+    // instruction.set_raw_encoding_specification.
+    instruction.set_raw_encoding_specification(
+        StrCat(specification, k64BitImmediateValueSuffix));
+    index->UpdateInstruction(position);
   }
   for (InstructionProto& new_instruction : new_instructions) {
     instruction_set->add_instructions()->Swap(&new_instruction);
   }
+  index->UpdateAddedInstructions();
   return OkStatus();
 }
-REGISTER_INSTRUCTION_SET_TRANSFORM(AddMissingMemoryOffsetEncoding, 1000);
+REGISTER_INDEXED_INSTRUCTION_SET_TRANSFORM(AddMissingMemoryOffsetEncoding,
+                                           1000);
 
 namespace {
 
@@ -95,36 +103,33 @@ void AddRexWPrefixToInstructionProto(InstructionProto* instruction) {
 }  // namespace
 
 Status FixEncodingSpecificationOfPopFsAndGs(
-    InstructionSetProto* instruction_set) {
+    InstructionSetIndex* index, InstructionSetProto* instruction_set) {
+  CHECK(index != nullptr);
   CHECK(instruction_set != nullptr);
   constexpr char kPopInstruction[] = "POP";
   constexpr char k16Bits[] = "16 bits";
   constexpr char k64Bits[] = "64 bits";
   const std::unordered_set<string> kFsAndGsOperands = {"FS", "GS"};
 
-  // First find all occurences of the POP FS and GS instructions.
-  std::vector<InstructionProto*> pop_instructions;
-  for (InstructionProto& instruction :
-       *instruction_set->mutable_instructions()) {
-    const InstructionFormat& vendor_syntax = instruction.vendor_syntax();
-    if (vendor_syntax.operands_size() == 1 &&
-        vendor_syntax.mnemonic() == kPopInstruction &&
-        ContainsKey(kFsAndGsOperands, vendor_syntax.operands(0).name())) {
-      pop_instructions.push_back(&instruction);
-    }
-  }
-
-  // Make modifications to the 16-bit versions, and make a new copy of the
-  // 64-bit versions. We can't add the new copies to instruction_set directly
-  // from the loop, because that could invalidate the pointers that we collected
-  // in pop_instructions.
+  // Make modifications to the 16-bit versions of POP FS and POP GS, and make a
+  // new copy of the 64-bit versions. We can't add the new copies to
+  // instruction_set directly from the loop, because that could invalidate the
+  // positions returned by the index.
   std::vector<InstructionProto> new_pop_instructions;
-  for (InstructionProto* const instruction : pop_instructions) {
+  for (const int position : index->FindByMnemonic(kPopInstruction)) {
+    InstructionProto* const instruction =
+        instruction_set->mutable_instructions(position);
+    const InstructionFormat& vendor_syntax = instruction->vendor_syntax();
+    if (vendor_syntax.operands_size() != 1 ||
+        !ContainsKey(kFsAndGsOperands, vendor_syntax.operands(0).name())) {
+      continue;
+    }
     // The only way to find out which version it is is from the description of
     // the instruction.
     const string& description = instruction->description();
     if (description.find(k16Bits) != string::npos) {
       AddOperandSizeOverrideToInstructionProto(instruction);
+      index->UpdateInstruction(position);
     } else if (description.find(k64Bits) != string::npos) {
       new_pop_instructions.push_back(*instruction);
       AddRexWPrefixToInstructionProto(&new_pop_instructions.back());
@@ -133,26 +138,30 @@ Status FixEncodingSpecificationOfPopFsAndGs(
   for (InstructionProto& new_pop_instruction : new_pop_instructions) {
     new_pop_instruction.Swap(instruction_set->add_instructions());
   }
+  index->UpdateAddedInstructions();
 
   return OkStatus();
 }
-REGISTER_INSTRUCTION_SET_TRANSFORM(FixEncodingSpecificationOfPopFsAndGs, 1000);
+REGISTER_INDEXED_INSTRUCTION_SET_TRANSFORM(FixEncodingSpecificationOfPopFsAndGs,
+                                           1000);
 
 Status FixEncodingSpecificationOfPushFsAndGs(
-    InstructionSetProto* instruction_set) {
+    InstructionSetIndex* index, InstructionSetProto* instruction_set) {
+  CHECK(index != nullptr);
   CHECK(instruction_set != nullptr);
   constexpr char kPushInstruction[] = "PUSH";
   const std::unordered_set<string> kFsAndGsOperands = {"FS", "GS"};
 
   // Find the existing PUSH instructions for FS and GS, and create the remaining
   // versions of the instructions. Note that we can't add the new versions
-  // directly to instruction_set, because that might invalidate the iterators
-  // used in the for loop.
+  // directly to instruction_set, because that might invalidate the positions
+  // returned by the index.
   std::vector<InstructionProto> new_push_instructions;
-  for (const InstructionProto& instruction : instruction_set->instructions()) {
+  for (const int position : index->FindByMnemonic(kPushInstruction)) {
+    const InstructionProto& instruction =
+        instruction_set->instructions(position);
     const InstructionFormat& vendor_syntax = instruction.vendor_syntax();
     if (vendor_syntax.operands_size() == 1 &&
-        vendor_syntax.mnemonic() == kPushInstruction &&
         ContainsKey(kFsAndGsOperands, vendor_syntax.operands(0).name())) {
       // There is only one version of each of the instruction. Keep this as the
       // base version (64-bit), and add a 16-bit version and a 64-bit version
@@ -168,115 +177,130 @@ Status FixEncodingSpecificationOfPushFsAndGs(
   for (InstructionProto& new_push_instruction : new_push_instructions) {
     new_push_instruction.Swap(instruction_set->add_instructions());
   }
+  index->UpdateAddedInstructions();
   return OkStatus();
 }
-REGISTER_INSTRUCTION_SET_TRANSFORM(FixEncodingSpecificationOfPushFsAndGs, 1000);
+REGISTER_INDEXED_INSTRUCTION_SET_TRANSFORM(
+    FixEncodingSpecificationOfPushFsAndGs, 1000);
 
 Status FixAndCleanUpEncodingSpecificationsOfSetInstructions(
-    InstructionSetProto* instruction_set) {
-  constexpr const char* const kEncodingSpecifications[] = {
-      "0F 90", "0F 91", "0F 92", "0F 93", "0F 93", "0F 94",
-      "0F 95", "0F 96", "0F 97", "0F 98", "0F 99", "0F 9A",
-      "0F 9B", "0F 9C", "0F 9D", "0F 9E", "0F 9F",
+    InstructionSetIndex* index, InstructionSetProto* instruction_set) {
+  CHECK(index != nullptr);
+  CHECK(instruction_set != nullptr);
+  constexpr PackedEncoding kEncodingSpecifications[] = {
+      "0F 90"_enc, "0F 91"_enc, "0F 92"_enc, "0F 93"_enc,
+      "0F 94"_enc, "0F 95"_enc, "0F 96"_enc, "0F 97"_enc,
+      "0F 98"_enc, "0F 99"_enc, "0F 9A"_enc, "0F 9B"_enc,
+      "0F 9C"_enc, "0F 9D"_enc, "0F 9E"_enc, "0F 9F"_enc,
   };
-  std::unordered_set<string> replaced_specifications;
-  std::unordered_set<string> removed_specifications;
-  for (const char* const specification : kEncodingSpecifications) {
-    replaced_specifications.insert(specification);
-    removed_specifications.insert(StrCat("REX + ", specification));
-  }
-  google::protobuf::RepeatedPtrField<InstructionProto>* const instructions =
-      instruction_set->mutable_instructions();
 
-  // Remove the REX versions of the instruction, because the REX prefix doesn't
-  // change anything (it is there only for the register index extension bits).
-  instructions->erase(
-      std::remove_if(
-          instructions->begin(), instructions->end(),
-          [&removed_specifications](const InstructionProto& instruction) {
-            return ContainsKey(removed_specifications,
-                               instruction.raw_encoding_specification());
-          }),
-      instructions->end());
+  std::vector<int> removed_positions;
+  for (const PackedEncoding encoding : kEncodingSpecifications) {
+    // Remove the REX versions of the instruction, because the REX prefix
+    // doesn't change anything (it is there only for the register index
+    // extension bits). The parser uses the same flag for the REX and the REX.W
+    // prefixes; there are no REX.W versions of the SETcc instructions.
+    const std::vector<int> rex_positions = FindByPackedRawEncodingSpecification(
+        index, encoding.With(PackedEncoding::kHasMandatoryRexWPrefix, 1));
+    removed_positions.insert(removed_positions.end(), rex_positions.begin(),
+                             rex_positions.end());
+    // Fix the binary encoding of the non-REX versions.
+    for (const int position :
+         FindByPackedRawEncodingSpecification(index, encoding)) {
+      InstructionProto* const instruction =
+          instruction_set->mutable_instructions(position);
+      instruction->set_raw_encoding_specification(
+          StrCat(instruction->raw_encoding_specification(), " /0"));
+      index->UpdateInstruction(position);
+    }
+  }
 
-  // Fix the binary encoding of the non-REX versions.
-  for (InstructionProto& instruction : *instructions) {
-    const string& specification = instruction.raw_encoding_specification();
-    if (ContainsKey(replaced_specifications, specification)) {
-      instruction.set_raw_encoding_specification(StrCat(specification, " /0"));
+  if (!removed_positions.empty()) {
+    // Removing the instructions from the last one keeps the remaining
+    // positions valid.
+    std::sort(removed_positions.begin(), removed_positions.end());
+    google::protobuf::RepeatedPtrField<InstructionProto>* const instructions =
+        instruction_set->mutable_instructions();
+    for (auto it = removed_positions.rbegin(); it != removed_positions.rend();
+         ++it) {
+      instructions->DeleteSubrange(*it, 1);
     }
+    index->Rebuild();
   }
 
   return OkStatus();
 }
-REGISTER_INSTRUCTION_SET_TRANSFORM(
+REGISTER_INDEXED_INSTRUCTION_SET_TRANSFORM(
     FixAndCleanUpEncodingSpecificationsOfSetInstructions, 1000);
 
-Status FixEncodingSpecificationOfXBegin(InstructionSetProto* instruction_set) {
+Status FixEncodingSpecificationOfXBegin(InstructionSetIndex* index,
+                                        InstructionSetProto* instruction_set) {
+  CHECK(index != nullptr);
   CHECK(instruction_set != nullptr);
-  constexpr char kXBeginEncodingSpecification[] = "C7 F8";
+  constexpr PackedEncoding kXBeginEncodingSpecification = "C7 F8"_enc;
   const std::unordered_map<string, string> kOperandToEncodingSpecification = {
       {"rel16", "66 C7 F8 cw"}, {"rel32", "C7 F8 cd"}};
   Status status = OkStatus();
-  for (InstructionProto& instruction :
-       *instruction_set->mutable_instructions()) {
-    if (instruction.raw_encoding_specification() ==
-        kXBeginEncodingSpecification) {
-      const InstructionFormat& vendor_syntax = instruction.vendor_syntax();
-      if (vendor_syntax.operands_size() != 1) {
-        status = util::InvalidArgumentError(
-            "Unexpected number of arguments of a XBEGIN instruction: ");
-        LOG(ERROR) << status;
-        continue;
-      }
-      if (!FindCopy(kOperandToEncodingSpecification,
-                    vendor_syntax.operands(0).name(),
-                    instruction.mutable_raw_encoding_specification())) {
-        status = InvalidArgumentError(
-            StrCat("Unexpected argument of a XBEGIN instruction: ",
-                   vendor_syntax.operands(0).name()));
-        LOG(ERROR) << status;
-        continue;
-      }
+  for (const int position : FindByPackedRawEncodingSpecification(
+           index, kXBeginEncodingSpecification)) {
+    InstructionProto& instruction =
+        *instruction_set->mutable_instructions(position);
+    const InstructionFormat& vendor_syntax = instruction.vendor_syntax();
+    if (vendor_syntax.operands_size() != 1) {
+      status = util::InvalidArgumentError(
+          "Unexpected number of arguments of a XBEGIN instruction: ");
+      LOG(ERROR) << status;
+      continue;
+    }
+    if (!FindCopy(kOperandToEncodingSpecification,
+                  vendor_syntax.operands(0).name(),
+                  instruction.mutable_raw_encoding_specification())) {
+      status = InvalidArgumentError(
+          StrCat("Unexpected argument of a XBEGIN instruction: ",
+                 vendor_syntax.operands(0).name()));
+      LOG(ERROR) << status;
+      continue;
     }
+    index->UpdateInstruction(position);
   }
   return status;
 }
-REGISTER_INSTRUCTION_SET_TRANSFORM(FixEncodingSpecificationOfXBegin, 1000);
+REGISTER_INDEXED_INSTRUCTION_SET_TRANSFORM(FixEncodingSpecificationOfXBegin,
+                                           1000);
 
-Status FixEncodingSpecifications(InstructionSetProto* instruction_set) {
-  const RE2 fix_w0_regexp("^(VEX[^ ]*\\.)0 ");
-  for (InstructionProto& instruction :
-       *instruction_set->mutable_instructions()) {
-    string specification = instruction.raw_encoding_specification();
+Status FixEncodingSpecifications(InstructionProto* instruction) {
+  CHECK(instruction != nullptr);
+  static const RE2* const fix_w0_regexp = new RE2("^(VEX[^ ]*\\.)0 ");
+  string* const specification =
+      instruction->mutable_raw_encoding_specification();
 
-    GlobalReplaceSubstring("0f", "0F", &specification);
-    GlobalReplaceSubstring("imm8", "ib", &specification);
-    RE2::Replace(&specification, fix_w0_regexp, "\\1W0 ");
+  GlobalReplaceSubstring("0f", "0F", specification);
+  GlobalReplaceSubstring("imm8", "ib", specification);
+  RE2::Replace(specification, *fix_w0_regexp, "\\1W0 ");
 
-    instruction.set_raw_encoding_specification(specification);
-  }
   return OkStatus();
 }
-REGISTER_INSTRUCTION_SET_TRANSFORM(FixEncodingSpecifications, 1000);
+REGISTER_INSTRUCTION_TRANSFORM(FixEncodingSpecifications, 1000);
 
-Status AddMissingModRmAndImmediateSpecification(
-    InstructionSetProto* instruction_set) {
-  CHECK(instruction_set != nullptr);
+Status AddMissingModRmAndImmediateSpecification(InstructionProto* instruction) {
+  CHECK(instruction != nullptr);
   constexpr char kFullModRmSuffix[] = "/r";
-  const std::unordered_set<string> kMissingModRMInstructionMnemonics = {
-      "CVTDQ2PD", "VMOVD"};
+  static const std::unordered_set<string>* const
+      kMissingModRMInstructionMnemonics =
+          new std::unordered_set<string>({"CVTDQ2PD", "VMOVD"});
   constexpr char kImmediateByteSuffix[] = "ib";
-  const std::unordered_set<string> kMissingImmediateInstructionMnemonics = {
-      "KSHIFTLB", "KSHIFTLW", "KSHIFTLD",  "KSHIFTLQ",    "KSHIFTRB",
-      "KSHIFTRW", "KSHIFTRD", "KSHIFTRQ",  "VFIXUPIMMPS", "VFPCLASSSS",
-      "VRANGESD", "VRANGESS", "VREDUCESD",
-  };
+  static const std::unordered_set<string>* const
+      kMissingImmediateInstructionMnemonics = new std::unordered_set<string>({
+          "KSHIFTLB", "KSHIFTLW", "KSHIFTLD",  "KSHIFTLQ",    "KSHIFTRB",
+          "KSHIFTRW", "KSHIFTRD", "KSHIFTRQ",  "VFIXUPIMMPS", "VFPCLASSSS",
+          "VRANGESD", "VRANGESS", "VREDUCESD",
+      });
   constexpr char kVSibSuffix[] = "/vsib";
-  const std::unordered_set<string> kMissingVSibInstructionMnemonics = {
-      "VGATHERDPD", "VGATHERQPD", "VGATHERDPS", "VGATHERQPS",
-      "VPGATHERDD", "VPGATHERDQ", "VPGATHERQD", "VPGATHERQQ",
-  };
+  static const std::unordered_set<string>* const
+      kMissingVSibInstructionMnemonics = new std::unordered_set<string>({
+          "VGATHERDPD", "VGATHERQPD", "VGATHERDPS", "VGATHERQPS",
+          "VPGATHERDD", "VPGATHERDQ", "VPGATHERQD", "VPGATHERQQ",
+      });
 
   // Fixes instruction encodings for instructions matching the given mnemonics
   // by adding the given suffix if need be.
@@ -302,41 +326,33 @@ Status AddMissingModRmAndImmediateSpecification(
     return status;
   };
 
-  for (InstructionProto& instruction :
-       *instruction_set->mutable_instructions()) {
-    RETURN_IF_ERROR(maybe_fix(kMissingModRMInstructionMnemonics,
-                              kFullModRmSuffix, &instruction));
-    RETURN_IF_ERROR(maybe_fix(kMissingImmediateInstructionMnemonics,
-                              kImmediateByteSuffix, &instruction));
-    RETURN_IF_ERROR(
-        maybe_fix(kMissingVSibInstructionMnemonics, kVSibSuffix, &instruction));
-  }
+  RETURN_IF_ERROR(maybe_fix(*kMissingModRMInstructionMnemonics,
+                            kFullModRmSuffix, instruction));
+  RETURN_IF_ERROR(maybe_fix(*kMissingImmediateInstructionMnemonics,
+                            kImmediateByteSuffix, instruction));
+  RETURN_IF_ERROR(
+      maybe_fix(*kMissingVSibInstructionMnemonics, kVSibSuffix, instruction));
   return OkStatus();
 }
-REGISTER_INSTRUCTION_SET_TRANSFORM(AddMissingModRmAndImmediateSpecification,
-                                   1000);
+REGISTER_INSTRUCTION_TRANSFORM(AddMissingModRmAndImmediateSpecification, 1000);
 
-Status ParseEncodingSpecifications(InstructionSetProto* instruction_set) {
-  CHECK(instruction_set != nullptr);
-  Status status = OkStatus();
-  for (InstructionProto& instruction :
-       *instruction_set->mutable_instructions()) {
-    const StatusOr<EncodingSpecification> encoding_specification_or_status =
-        ParseEncodingSpecification(instruction.raw_encoding_specification());
-    if (encoding_specification_or_status.ok()) {
-      *instruction.mutable_x86_encoding_specification() =
-          encoding_specification_or_status.ValueOrDie();
-    } else {
-      UpdateStatus(&status, encoding_specification_or_status.status());
-      LOG(WARNING) << "Could not parse encoding specification: "
-                   << instruction.raw_encoding_specification();
-    }
+Status ParseEncodingSpecifications(InstructionProto* instruction) {
+  CHECK(instruction != nullptr);
+  const StatusOr<EncodingSpecification>& encoding_specification_or_status =
+      GetGlobalEncodingSpecificationCache()->Parse(
+          instruction->raw_encoding_specification());
+  if (!encoding_specification_or_status.ok()) {
+    LOG(WARNING) << "Could not parse encoding specification: "
+                 << instruction->raw_encoding_specification();
+    return encoding_specification_or_status.status();
   }
-  return status;
+  *instruction->mutable_x86_encoding_specification() =
+      encoding_specification_or_status.ValueOrDie();
+  return OkStatus();
 }
 // We must parse the encoding specifications after running all other encoding
 // specification cleanups, but before running any other transform.
-REGISTER_INSTRUCTION_SET_TRANSFORM(ParseEncodingSpecifications, 1010);
+REGISTER_INSTRUCTION_TRANSFORM(ParseEncodingSpecifications, 1010);
 
 }  // namespace x86
 }  // namespace cpu_instructions
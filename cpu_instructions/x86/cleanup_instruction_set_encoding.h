@@ -18,6 +18,7 @@
 #ifndef CPU_INSTRUCTIONS_X86_CLEANUP_INSTRUCTION_SET_ENCODING_H_
 #define CPU_INSTRUCTIONS_X86_CLEANUP_INSTRUCTION_SET_ENCODING_H_
 
+#include "cpu_instructions/base/instruction_set_index.h"
 #include "cpu_instructions/proto/instructions.pb.h"
 #include "util/task/status.h"
 
@@ -35,14 +36,14 @@ using ::cpu_instructions::util::Status;
 // size override prefix. This transform fixes these instructions by replacing
 // the original one with two new instructions (one with the prefix and one
 // without) with the correct binary encoding specification.
-Status AddMissingMemoryOffsetEncoding(InstructionSetProto* instruction_set);
+Status AddMissingMemoryOffsetEncoding(InstructionSetIndex* index,
+                                      InstructionSetProto* instruction_set);
 
 // Adds the missing ModR/M and immediates specifiers to the binary encoding
 // specification of instructions where they are missing. Most of these cases are
 // actual errors in the Intel manual rather than conversion errors that could be
-// fixed elsewhere.
-Status AddMissingModRmAndImmediateSpecification(
-    InstructionSetProto* instruction_set);
+// fixed elsewhere. This is a per-instruction transform.
+Status AddMissingModRmAndImmediateSpecification(InstructionProto* instruction);
 
 // Fixes and cleans up binary encodings of SET* instructions. These are
 // instructions that look at a combination of status flag and update an 8-bit
@@ -55,7 +56,7 @@ Status AddMissingModRmAndImmediateSpecification(
 // This transform adds the /0 specification (because the modrm.reg bits are not
 // used for anything), and it removes the REX versions of the instructions.
 Status FixAndCleanUpEncodingSpecificationsOfSetInstructions(
-    InstructionSetProto* instruction_set);
+    InstructionSetIndex* index, InstructionSetProto* instruction_set);
 
 // Fixes the binary encodings of POP FS and POP GS instructions. These
 // instructions exist in three versions: 16-bit, 32-bit and 64-bit. In protected
@@ -75,7 +76,7 @@ Status FixAndCleanUpEncodingSpecificationsOfSetInstructions(
 // the default, since we're focusing on the 64-bit protected mode), and adds a
 // new version of the 64-bit version that uses the REX.W prefix.
 Status FixEncodingSpecificationOfPopFsAndGs(
-    InstructionSetProto* instruction_set);
+    InstructionSetIndex* index, InstructionSetProto* instruction_set);
 
 // Fixes the binary encodings of PUSH FS and PUSH GS instructions. These
 // instructions exist in three versions symmetrical to the POP FS and POP GS
@@ -85,27 +86,31 @@ Status FixEncodingSpecificationOfPopFsAndGs(
 // missing versions and extends them with the necessary operand size override
 // and REX.W prefixes.
 Status FixEncodingSpecificationOfPushFsAndGs(
-    InstructionSetProto* instruction_set);
+    InstructionSetIndex* index, InstructionSetProto* instruction_set);
 
 // Fixes the binary encoding specification of the instruction XBEGIN. The
 // specifications in the Intel manual have only the opcode, but there is also a
 // code offset passed as an immediate value, and the 16-bit version of the
 // instruction requires an operand-size override prefix.
-Status FixEncodingSpecificationOfXBegin(InstructionSetProto* instruction_set);
+Status FixEncodingSpecificationOfXBegin(InstructionSetIndex* index,
+                                        InstructionSetProto* instruction_set);
 
 // Fixes common errors in the binary encoding specification that were carried
 // from the Intel reference manuals. Errors fixed by this transform are:
 // 1. Replaces 0f with 0F,
 // 2. Replaces imm8 with ib,
 // 3. Replaces .0 at the end of a VEX prefix with .W0.
-Status FixEncodingSpecifications(InstructionSetProto* instruction_set);
+// This is a per-instruction transform.
+Status FixEncodingSpecifications(InstructionProto* instruction);
 
-// Parses the raw encoding specification of each instruction in the
-// instruction set, and stores the parsed proto in the specialized x86 encoding
-// specification field. Assumes that instruction.raw_encoding_specification
-// contains the encoding specification in the format used in the Intel SDM.
-// Returns an error if parsing of any of the encoding specifications fails.
-Status ParseEncodingSpecifications(InstructionSetProto* instruction_set);
+// Parses the raw encoding specification of the instruction, and stores the
+// parsed proto in the specialized x86 encoding specification field. Assumes
+// that instruction.raw_encoding_specification contains the encoding
+// specification in the format used in the Intel SDM. Returns an error if
+// parsing of the encoding specification fails. This is a per-instruction
+// transform; the parsed specifications are shared through the global encoding
+// specification cache.
+Status ParseEncodingSpecifications(InstructionProto* instruction);
 
 }  // namespace x86
 }  // namespace cpu_instructions
@@ -14,6 +14,7 @@
 
 #include "cpu_instructions/x86/cleanup_instruction_set_encoding.h"
 
+#include "cpu_instructions/base/cleanup_instruction_set.h"
 #include "cpu_instructions/base/cleanup_instruction_set_test_utils.h"
 #include "gtest/gtest.h"
 #include "src/google/protobuf/text_format.h"
@@ -165,7 +166,15 @@ TEST(FixAndCleanUpEncodingSpecificationsOfSetInstructionsTest,
              mnemonic: 'STOS'
              operands { name: 'BYTE PTR [RDI]' } operands { name: 'AL' }}
            encoding_scheme: 'NA'
-           raw_encoding_specification: 'AA' })";
+           raw_encoding_specification: 'AA' }
+         instructions {
+           vendor_syntax { mnemonic: 'SETB' operands { name: 'r/m8' }}
+           encoding_scheme: 'M'
+           raw_encoding_specification: 'REX + 0F 92' }
+         instructions {
+           vendor_syntax { mnemonic: 'SETB' operands { name: 'r/m8' }}
+           encoding_scheme: 'M'
+           raw_encoding_specification: '0F 92' })";
   constexpr char kExpectedInstructionSetProto[] =
       R"(instructions {
            vendor_syntax { mnemonic: 'SETA' operands { name: 'r/m8' }}
@@ -176,7 +185,11 @@ TEST(FixAndCleanUpEncodingSpecificationsOfSetInstructionsTest,
              mnemonic: 'STOS'
              operands { name: 'BYTE PTR [RDI]' } operands { name: 'AL' }}
            encoding_scheme: 'NA'
-           raw_encoding_specification: 'AA' })";
+           raw_encoding_specification: 'AA' }
+         instructions {
+           vendor_syntax { mnemonic: 'SETB' operands { name: 'r/m8' }}
+           encoding_scheme: 'M'
+           raw_encoding_specification: '0F 92 /0' })";
   TestTransform(FixAndCleanUpEncodingSpecificationsOfSetInstructions,
                 kInstructionSetProto, kExpectedInstructionSetProto);
 }
@@ -481,7 +494,8 @@ TEST(ParseEncodingSpecificationsTest, ParseErrors) {
   InstructionSetProto instruction_set;
   ASSERT_TRUE(
       TextFormat::ParseFromString(kInstructionSetProto, &instruction_set));
-  const Status status = ParseEncodingSpecifications(&instruction_set);
+  const Status status =
+      RunInstructionTransform(ParseEncodingSpecifications, 0, &instruction_set);
   EXPECT_EQ(status.error_code(), INVALID_ARGUMENT);
 }
 
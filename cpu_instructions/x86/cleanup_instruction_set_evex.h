@@ -26,13 +26,13 @@ namespace x86 {
 
 using ::cpu_instructions::util::Status;
 
-// Adds the EVEX.b bit interpretation field to all instructions in the
-// instruction set.
-Status AddEvexBInterpretation(InstructionSetProto* instruction_set);
+// Adds the EVEX.b bit interpretation field to the instruction. This is a
+// per-instruction transform.
+Status AddEvexBInterpretation(InstructionProto* instruction);
 
-// Adds the opmask-related fields to the encoding specifications of all
-// instructions in the instruction set.
-Status AddEvexOpmaskUsage(InstructionSetProto* instruction_set);
+// Adds the opmask-related fields to the encoding specification of the
+// instruction. This is a per-instruction transform.
+Status AddEvexOpmaskUsage(InstructionProto* instruction);
 
 }  // namespace x86
 }  // namespace cpu_instructions
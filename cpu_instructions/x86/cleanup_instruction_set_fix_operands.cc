@@ -23,6 +23,7 @@
 #include "cpu_instructions/base/cleanup_instruction_set.h"
 #include "cpu_instructions/proto/instructions.pb.h"
 #include "cpu_instructions/x86/cleanup_instruction_set_utils.h"
+#include "cpu_instructions/x86/operand_names.h"
 #include "glog/logging.h"
 #include "src/google/protobuf/repeated_field.h"
 #include "strings/str_cat.h"
@@ -54,9 +55,10 @@ const char* kRDIIndexes[] = {"BYTE PTR [RDI]", "WORD PTR [RDI]",
 
 }  // namespace
 
-Status FixOperandsOfCmpsAndMovs(InstructionSetProto* instruction_set) {
+Status FixOperandsOfCmpsAndMovs(InstructionSetIndex* index,
+                                InstructionSetProto* instruction_set) {
+  CHECK(index != nullptr);
   CHECK(instruction_set != nullptr);
-  const std::unordered_set<string> kMnemonics = {"CMPS", "MOVS"};
   const std::unordered_set<string> kSourceOperands(std::begin(kRSIIndexes),
                                                    std::begin(kRSIIndexes));
   const std::unordered_set<string> kDestinationOperands(
@@ -64,14 +66,10 @@ Status FixOperandsOfCmpsAndMovs(InstructionSetProto* instruction_set) {
   const std::unordered_map<string, string> operand_to_pointer_size(
       std::begin(kOperandToPointerSize), std::end(kOperandToPointerSize));
   Status status = OkStatus();
-  for (InstructionProto& instruction :
-       *instruction_set->mutable_instructions()) {
+  for (const int position : index->FindByMnemonics({"CMPS", "MOVS"})) {
     InstructionFormat* const vendor_syntax =
-        instruction.mutable_vendor_syntax();
-    if (!ContainsKey(kMnemonics, vendor_syntax->mnemonic())) {
-      continue;
-    }
-
+        instruction_set->mutable_instructions(position)
+            ->mutable_vendor_syntax();
     if (vendor_syntax->operands_size() != 2) {
       status = InvalidArgumentError(
           "Unexpected number of operands of a CMPS/MOVS instruction.");
@@ -109,23 +107,24 @@ Status FixOperandsOfCmpsAndMovs(InstructionSetProto* instruction_set) {
   }
   return status;
 }
-REGISTER_INSTRUCTION_SET_TRANSFORM(FixOperandsOfCmpsAndMovs, 2000);
+REGISTER_INDEXED_INSTRUCTION_SET_TRANSFORM(FixOperandsOfCmpsAndMovs, 2000);
 
-Status FixOperandsOfInsAndOuts(InstructionSetProto* instruction_set) {
+Status FixOperandsOfInsAndOuts(InstructionSetIndex* index,
+                               InstructionSetProto* instruction_set) {
+  CHECK(index != nullptr);
+  CHECK(instruction_set != nullptr);
   constexpr char kIns[] = "INS";
   constexpr char kOuts[] = "OUTS";
   const std::unordered_map<string, string> operand_to_pointer_size(
       std::begin(kOperandToPointerSize), std::end(kOperandToPointerSize));
   Status status = OkStatus();
-  for (InstructionProto& instruction :
-       *instruction_set->mutable_instructions()) {
+  for (const int position : index->FindByMnemonics({kIns, kOuts})) {
     InstructionFormat* const vendor_syntax =
-        instruction.mutable_vendor_syntax();
+        instruction_set->mutable_instructions(position)
+            ->mutable_vendor_syntax();
     const bool is_ins = vendor_syntax->mnemonic() == kIns;
     const bool is_outs = vendor_syntax->mnemonic() == kOuts;
-    if (!is_ins && !is_outs) {
-      continue;
-    }
+    CHECK(is_ins || is_outs);
 
     if (vendor_syntax->operands_size() != 2) {
       status = InvalidArgumentError(
@@ -167,9 +166,12 @@ Status FixOperandsOfInsAndOuts(InstructionSetProto* instruction_set) {
   }
   return status;
 }
-REGISTER_INSTRUCTION_SET_TRANSFORM(FixOperandsOfInsAndOuts, 2000);
+REGISTER_INDEXED_INSTRUCTION_SET_TRANSFORM(FixOperandsOfInsAndOuts, 2000);
 
-Status FixOperandsOfLodsScasAndStos(InstructionSetProto* instruction_set) {
+Status FixOperandsOfLodsScasAndStos(InstructionSetIndex* index,
+                                    InstructionSetProto* instruction_set) {
+  CHECK(index != nullptr);
+  CHECK(instruction_set != nullptr);
   // Note that we're matching only the versions with operands. These versions
   // use the mnemonics without the size suffix. By matching exactly these names,
   // we can easily avoid the operand-less versions.
@@ -181,16 +183,14 @@ Status FixOperandsOfLodsScasAndStos(InstructionSetProto* instruction_set) {
   const std::unordered_map<string, string> kOperandToRegister = {
       {"m8", "AL"}, {"m16", "AX"}, {"m32", "EAX"}, {"m64", "RAX"}};
   Status status = OkStatus();
-  for (InstructionProto& instruction :
-       *instruction_set->mutable_instructions()) {
+  for (const int position : index->FindByMnemonics({kLods, kScas, kStos})) {
     InstructionFormat* const vendor_syntax =
-        instruction.mutable_vendor_syntax();
+        instruction_set->mutable_instructions(position)
+            ->mutable_vendor_syntax();
     const bool is_lods = vendor_syntax->mnemonic() == kLods;
     const bool is_stos = vendor_syntax->mnemonic() == kStos;
     const bool is_scas = vendor_syntax->mnemonic() == kScas;
-    if (!is_lods && !is_stos && !is_scas) {
-      continue;
-    }
+    CHECK(is_lods || is_stos || is_scas);
 
     if (vendor_syntax->operands_size() != 1) {
       status = InvalidArgumentError(
@@ -236,17 +236,18 @@ Status FixOperandsOfLodsScasAndStos(InstructionSetProto* instruction_set) {
   }
   return status;
 }
-REGISTER_INSTRUCTION_SET_TRANSFORM(FixOperandsOfLodsScasAndStos, 2000);
+REGISTER_INDEXED_INSTRUCTION_SET_TRANSFORM(FixOperandsOfLodsScasAndStos, 2000);
 
-Status FixOperandsOfVMovq(InstructionSetProto* instruction_set) {
+Status FixOperandsOfVMovq(InstructionSetIndex* index,
+                          InstructionSetProto* instruction_set) {
+  CHECK(index != nullptr);
   CHECK(instruction_set != nullptr);
   constexpr char kVMovQEncoding[] = "VEX.128.F3.0F.WIG 7E /r";
   constexpr char kRegisterOrMemoryOperand[] = "xmm2/m64";
-  ::google::protobuf::RepeatedPtrField<InstructionProto>* const instructions =
-      instruction_set->mutable_instructions();
-  for (InstructionProto& instruction : *instructions) {
-    if (instruction.raw_encoding_specification() != kVMovQEncoding) continue;
-
+  for (const int position :
+       index->FindByRawEncodingSpecification(kVMovQEncoding)) {
+    InstructionProto& instruction =
+        *instruction_set->mutable_instructions(position);
     InstructionFormat* const vendor_syntax =
         instruction.mutable_vendor_syntax();
     if (vendor_syntax->operands_size() != 2) {
@@ -258,7 +259,7 @@ Status FixOperandsOfVMovq(InstructionSetProto* instruction_set) {
   }
   return OkStatus();
 }
-REGISTER_INSTRUCTION_SET_TRANSFORM(FixOperandsOfVMovq, 2000);
+REGISTER_INDEXED_INSTRUCTION_SET_TRANSFORM(FixOperandsOfVMovq, 2000);
 
 Status FixRegOperands(InstructionSetProto* instruction_set) {
   CHECK(instruction_set != nullptr);
@@ -323,9 +324,9 @@ Status FixRegOperands(InstructionSetProto* instruction_set) {
 }
 REGISTER_INSTRUCTION_SET_TRANSFORM(FixRegOperands, 2000);
 
-Status RenameOperands(InstructionSetProto* instruction_set) {
-  CHECK(instruction_set != nullptr);
-  const std::unordered_map<string, string> kOperandRenaming = {
+Status RenameOperands(InstructionProto* instruction) {
+  CHECK(instruction != nullptr);
+  static const std::pair<const char*, const char*> kOperandRenaming[] = {
       // Synonyms (different names used for the same type in different parts of
       // the manual).
       {"m80dec", "m80bcd"},
@@ -338,65 +339,60 @@ Status RenameOperands(InstructionSetProto* instruction_set) {
       // always use the larger of the two values.
       {"m14/28byte", "m28byte"},
       {"m94/108byte", "m108byte"}};
-  for (InstructionProto& instruction :
-       *instruction_set->mutable_instructions()) {
-    InstructionFormat* const vendor_syntax =
-        instruction.mutable_vendor_syntax();
-    for (auto& operand : *vendor_syntax->mutable_operands()) {
-      const string* renaming = FindOrNull(kOperandRenaming, operand.name());
-      if (renaming != nullptr) {
-        operand.set_name(*renaming);
-      }
+  static const OperandNameMap<string>* const operand_renaming =
+      new OperandNameMap<string>(std::begin(kOperandRenaming),
+                                 std::end(kOperandRenaming));
+  InstructionFormat* const vendor_syntax = instruction->mutable_vendor_syntax();
+  for (auto& operand : *vendor_syntax->mutable_operands()) {
+    const string* const renaming =
+        operand_renaming->Find(GetOperandNameId(operand.name()));
+    if (renaming != nullptr) {
+      operand.set_name(*renaming);
     }
   }
   return OkStatus();
 }
-REGISTER_INSTRUCTION_SET_TRANSFORM(RenameOperands, 2000);
+REGISTER_INSTRUCTION_TRANSFORM(RenameOperands, 2000);
 
-Status RemoveImplicitST0Operand(InstructionSetProto* instruction_set) {
-  CHECK(instruction_set != nullptr);
+Status RemoveImplicitST0Operand(InstructionProto* instruction) {
+  CHECK(instruction != nullptr);
   static constexpr char kImplicitST0Operand[] = "ST(0)";
-  const std::unordered_set<string> kUpdatedInstructionEncodings = {
-      "D8 C0+i", "D8 C8+i", "D8 E0+i", "D8 E8+i", "D8 F0+i", "D8 F8+i",
-      "DB E8+i", "DB F0+i", "DE C0+i", "DE C8+i", "DE E0+i", "DE E8+i",
-      "DE F0+i", "DE F8+i", "DF E8+i", "DF F0+i",
-  };
-  for (InstructionProto& instruction :
-       *instruction_set->mutable_instructions()) {
-    if (!ContainsKey(kUpdatedInstructionEncodings,
-                     instruction.raw_encoding_specification())) {
-      continue;
-    }
-    RepeatedPtrField<InstructionOperand>* const operands =
-        instruction.mutable_vendor_syntax()->mutable_operands();
-    operands->erase(std::remove_if(operands->begin(), operands->end(),
-                                   [](const InstructionOperand& operand) {
-                                     return operand.name() ==
-                                            kImplicitST0Operand;
-                                   }),
-                    operands->end());
+  static const std::unordered_set<string>* const kUpdatedInstructionEncodings =
+      new std::unordered_set<string>({
+          "D8 C0+i", "D8 C8+i", "D8 E0+i", "D8 E8+i", "D8 F0+i", "D8 F8+i",
+          "DB E8+i", "DB F0+i", "DE C0+i", "DE C8+i", "DE E0+i", "DE E8+i",
+          "DE F0+i", "DE F8+i", "DF E8+i", "DF F0+i",
+      });
+  if (!ContainsKey(*kUpdatedInstructionEncodings,
+                   instruction->raw_encoding_specification())) {
+    return OkStatus();
   }
+  RepeatedPtrField<InstructionOperand>* const operands =
+      instruction->mutable_vendor_syntax()->mutable_operands();
+  operands->erase(std::remove_if(operands->begin(), operands->end(),
+                                 [](const InstructionOperand& operand) {
+                                   return operand.name() ==
+                                          kImplicitST0Operand;
+                                 }),
+                  operands->end());
   return OkStatus();
 }
-REGISTER_INSTRUCTION_SET_TRANSFORM(RemoveImplicitST0Operand, 2000);
+REGISTER_INSTRUCTION_TRANSFORM(RemoveImplicitST0Operand, 2000);
 
-Status RemoveImplicitXmm0Operand(InstructionSetProto* instruction_set) {
-  CHECK(instruction_set != nullptr);
+Status RemoveImplicitXmm0Operand(InstructionProto* instruction) {
+  CHECK(instruction != nullptr);
   static constexpr char kImplicitXmm0Operand[] = "<XMM0>";
-  for (InstructionProto& instruction :
-       *instruction_set->mutable_instructions()) {
-    RepeatedPtrField<InstructionOperand>* const operands =
-        instruction.mutable_vendor_syntax()->mutable_operands();
-    operands->erase(std::remove_if(operands->begin(), operands->end(),
-                                   [](const InstructionOperand& operand) {
-                                     return operand.name() ==
-                                            kImplicitXmm0Operand;
-                                   }),
-                    operands->end());
-  }
+  RepeatedPtrField<InstructionOperand>* const operands =
+      instruction->mutable_vendor_syntax()->mutable_operands();
+  operands->erase(std::remove_if(operands->begin(), operands->end(),
+                                 [](const InstructionOperand& operand) {
+                                   return operand.name() ==
+                                          kImplicitXmm0Operand;
+                                 }),
+                  operands->end());
   return OkStatus();
 }
-REGISTER_INSTRUCTION_SET_TRANSFORM(RemoveImplicitXmm0Operand, 2000);
+REGISTER_INSTRUCTION_TRANSFORM(RemoveImplicitXmm0Operand, 2000);
 
 }  // namespace x86
 }  // namespace cpu_instructions
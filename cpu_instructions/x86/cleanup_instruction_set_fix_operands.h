@@ -18,6 +18,7 @@
 #ifndef CPU_INSTRUCTIONS_X86_CLEANUP_INSTRUCTION_SET_FIX_OPERANDS_H_
 #define CPU_INSTRUCTIONS_X86_CLEANUP_INSTRUCTION_SET_FIX_OPERANDS_H_
 
+#include "cpu_instructions/base/instruction_set_index.h"
 #include "cpu_instructions/proto/instructions.pb.h"
 #include "util/task/status.h"
 
@@ -36,7 +37,8 @@ using ::cpu_instructions::util::Status;
 // for memory operands specified through the ModR/M byte and allowing any
 // addressing mode. This transform fixes this problem by changng the memory
 // operands to more explicit ones.
-Status FixOperandsOfCmpsAndMovs(InstructionSetProto* instruction_set);
+Status FixOperandsOfCmpsAndMovs(InstructionSetIndex* index,
+                                InstructionSetProto* instruction_set);
 
 // Updates the operands of INS and OUTS instructions. These instructions are
 // documented in the Intel manual in two forms: a form that doesn't use any
@@ -48,7 +50,8 @@ Status FixOperandsOfCmpsAndMovs(InstructionSetProto* instruction_set);
 // for memory operands specified through the ModR/M byte and allowing any
 // addressing mode. This transform fixes this problem by changng the memory
 // operands to more explicit ones.
-Status FixOperandsOfInsAndOuts(InstructionSetProto* instruction_set);
+Status FixOperandsOfInsAndOuts(InstructionSetIndex* index,
+                               InstructionSetProto* instruction_set);
 
 // Updates the operands of LODS, SCAS and STOS instructions. These instructions
 // are documented in the Intel manual in two forms: a form that doesn't use any
@@ -64,7 +67,8 @@ Status FixOperandsOfInsAndOuts(InstructionSetProto* instruction_set);
 //    allowing any addressing mode.
 // This transform fixes this problem by adding the register operand and by
 // changng the memory operand to something more explicit.
-Status FixOperandsOfLodsScasAndStos(InstructionSetProto* instruction_set);
+Status FixOperandsOfLodsScasAndStos(InstructionSetIndex* index,
+                                    InstructionSetProto* instruction_set);
 
 // Fixes the operands of VMOVQ. The Intel manual lists two variants of VMOVQ for
 // XMM registers: one that reads the value from another XMM registers, and one
@@ -75,7 +79,8 @@ Status FixOperandsOfLodsScasAndStos(InstructionSetProto* instruction_set);
 // RemoveDuplicateInstructions.
 // Note that the the transform must run before AddOperandInfo and
 // RemoveDuplicateInstructions.
-Status FixOperandsOfVMovq(InstructionSetProto* instruction_set);
+Status FixOperandsOfVMovq(InstructionSetIndex* index,
+                          InstructionSetProto* instruction_set);
 
 // Fixes the ambiguous operand "reg". There are two cases in the 2015 version
 // of the manual:
@@ -108,21 +113,23 @@ Status FixRegOperands(InstructionSetProto* instruction_set);
 // selected by their binary encoding specification, because the mnemonic is not
 // enough (two different instructions with the same mnemonic might work with the
 // ST(0) register in different ways).
-// Note that this transform depends on the results of RenameOperands.
-Status RemoveImplicitST0Operand(InstructionSetProto* instruction_set);
+// Note that this transform depends on the results of RenameOperands. This is a
+// per-instruction transform.
+Status RemoveImplicitST0Operand(InstructionProto* instruction);
 
 // Removes the implicit xmm0 operand. The operand is added automatically by the
 // LLVM assembler, but it is encoded neither in the ModR/M byte nor in the
 // opcode of the instruction (using the "+i" encoding), and it does not appear
 // in the LLVM disassembly. The Intel manual uses a special name <XMM0> for the
 // implicit use of the operand, and this transform matches it only by its name.
-Status RemoveImplicitXmm0Operand(InstructionSetProto* instruction_set);
+// This is a per-instruction transform.
+Status RemoveImplicitXmm0Operand(InstructionProto* instruction);
 
 // Inspects the operands of the instructions and renames them so that the names
 // are consistent across types of operands. All of these renamings are either
 // synonyms used by the Intel manual in different contexts, or the types are
-// equivalent for 32- and 64-bit code.
-Status RenameOperands(InstructionSetProto* instruction_set);
+// equivalent for 32- and 64-bit code. This is a per-instruction transform.
+Status RenameOperands(InstructionProto* instruction);
 
 }  // namespace x86
 }  // namespace cpu_instructions
@@ -18,7 +18,6 @@
 #include <functional>
 #include <iterator>
 #include <memory>
-#include <unordered_map>
 #include <utility>
 #include <vector>
 #include "strings/string.h"
@@ -28,6 +27,7 @@
 #include "cpu_instructions/proto/x86/encoding_specification.pb.h"
 #include "cpu_instructions/util/status_util.h"
 #include "cpu_instructions/x86/encoding_specification.h"
+#include "cpu_instructions/x86/operand_names.h"
 #include "glog/logging.h"
 #include "strings/str_cat.h"
 #include "util/gtl/map_util.h"
@@ -46,10 +46,9 @@ using ::cpu_instructions::util::OkStatus;
 using ::cpu_instructions::util::Status;
 using ::cpu_instructions::util::StatusOr;
 
-using EncodingMap = std::unordered_map<string, InstructionOperand::Encoding>;
-using AddressingModeMap =
-    std::unordered_map<string, InstructionOperand::AddressingMode>;
-using ValueSizeMap = std::unordered_map<string, uint32_t>;
+using EncodingMap = OperandNameMap<InstructionOperand::Encoding>;
+using AddressingModeMap = OperandNameMap<InstructionOperand::AddressingMode>;
+using ValueSizeMap = OperandNameMap<uint32_t>;
 
 // Contains mapping from operand names to their encoding types. Note that this
 // mapping is incomplete, because it contains the mapping only for the cases in
@@ -772,22 +771,25 @@ Status AssignOperandPropertiesWhereUniquelyDetermined(
        ++operand_index) {
     InstructionOperand* const operand =
         vendor_syntax->mutable_operands(operand_index);
+    const OperandNameId operand_name_id = GetOperandNameId(operand->name());
 
     if (!operand->has_addressing_mode()) {
-      InstructionOperand::AddressingMode addressing_mode;
-      if (!FindCopy(addressing_mode_map, operand->name(), &addressing_mode)) {
+      const InstructionOperand::AddressingMode* const addressing_mode =
+          addressing_mode_map.Find(operand_name_id);
+      if (addressing_mode == nullptr) {
         status = InvalidArgumentError(StrCat(
             "Could not determine addressing mode of operand: ", operand->name(),
             ", instruction ", vendor_syntax->mnemonic()));
         LOG(ERROR) << status;
         continue;
       }
-      operand->set_addressing_mode(addressing_mode);
+      operand->set_addressing_mode(*addressing_mode);
     }
 
-    uint32_t value_size_bits = 0;
-    if (FindCopy(value_size_map, operand->name(), &value_size_bits)) {
-      operand->set_value_size_bits(value_size_bits);
+    const uint32_t* const value_size_bits =
+        value_size_map.Find(operand_name_id);
+    if (value_size_bits != nullptr) {
+      operand->set_value_size_bits(*value_size_bits);
     }
 
     if (operand->has_encoding()) {
@@ -798,9 +800,10 @@ Status AssignOperandPropertiesWhereUniquelyDetermined(
       // encoding to the operand and remove it from the list of available
       // encodings. Then we'll need to assign encodings to the remaining
       // operands only from those "remaining" encodings.
-      InstructionOperand::Encoding operand_encoding;
-      if (FindCopy(encoding_map, operand->name(), &operand_encoding)) {
-        operand->set_encoding(operand_encoding);
+      const InstructionOperand::Encoding* const operand_encoding =
+          encoding_map.Find(operand_name_id);
+      if (operand_encoding != nullptr) {
+        operand->set_encoding(*operand_encoding);
         UpdateStatus(&status, EraseOperandEncoding(*instruction, *operand,
                                                    available_encodings));
       } else {
@@ -914,125 +917,117 @@ Status AssignEncodingRandomlyFromAvailableEncodings(
 
 }  // namespace
 
-Status AddOperandInfo(InstructionSetProto* instruction_set) {
-  CHECK(instruction_set != nullptr);
-  const AddressingModeMap addressing_mode_map(std::begin(kAddressingModeMap),
-                                              std::end(kAddressingModeMap));
-  const EncodingMap encoding_map(std::begin(kEncodingMap),
-                                 std::end(kEncodingMap));
-  const ValueSizeMap value_size_map(std::begin(kOperandValueSizeBitsMap),
-                                    std::end(kOperandValueSizeBitsMap));
-  Status status = OkStatus();
-  for (InstructionProto& instruction :
-       *instruction_set->mutable_instructions()) {
-    InstructionFormat* const vendor_syntax =
-        instruction.mutable_vendor_syntax();
-    if (!instruction.has_x86_encoding_specification()) {
-      return FailedPreconditionError(
-          StrCat("Instruction does not have a parsed encoding specification: ",
-                 instruction.DebugString()));
-    }
-    InstructionOperandEncodingMultiset available_encodings =
-        GetAvailableEncodings(instruction.x86_encoding_specification());
+Status AddOperandInfo(InstructionProto* instruction) {
+  CHECK(instruction != nullptr);
+  static const AddressingModeMap* const addressing_mode_map =
+      new AddressingModeMap(std::begin(kAddressingModeMap),
+                            std::end(kAddressingModeMap));
+  static const EncodingMap* const encoding_map =
+      new EncodingMap(std::begin(kEncodingMap), std::end(kEncodingMap));
+  static const ValueSizeMap* const value_size_map =
+      new ValueSizeMap(std::begin(kOperandValueSizeBitsMap),
+                       std::end(kOperandValueSizeBitsMap));
+  InstructionFormat* const vendor_syntax = instruction->mutable_vendor_syntax();
+  if (!instruction->has_x86_encoding_specification()) {
+    return FailedPreconditionError(
+        StrCat("Instruction does not have a parsed encoding specification: ",
+               instruction->DebugString()));
+  }
+  InstructionOperandEncodingMultiset available_encodings =
+      GetAvailableEncodings(instruction->x86_encoding_specification());
 
-    // First assign the addressing modes and the encodings that can be
-    // determined from the operand itself.
-    std::vector<int> operands_with_no_encoding;
-    RETURN_IF_ERROR(AssignOperandPropertiesWhereUniquelyDetermined(
-        addressing_mode_map, encoding_map, value_size_map, &instruction,
-        &available_encodings, &operands_with_no_encoding));
+  // First assign the addressing modes and the encodings that can be
+  // determined from the operand itself.
+  std::vector<int> operands_with_no_encoding;
+  RETURN_IF_ERROR(AssignOperandPropertiesWhereUniquelyDetermined(
+      *addressing_mode_map, *encoding_map, *value_size_map, instruction,
+      &available_encodings, &operands_with_no_encoding));
 
-    if (!operands_with_no_encoding.empty()) {
-      // There are some operands that were not assigned the encoding just from
-      // the name of the operand. We need to use a more sophisticated process.
-      if (operands_with_no_encoding.size() == 1 &&
-          available_encodings.size() == 1) {
-        // There is just one operand where we need to assign the encoding, and
-        // only one available encoding, so we simply match them. In theory, the
-        // following branch should catch this case, but it doesn't work
-        // correctly because some instructions of this type do not use the usual
-        // encoding_scheme conventions, but we can correctly handle them using
-        // this heuristic.
-        InstructionOperand* const operand =
-            vendor_syntax->mutable_operands(operands_with_no_encoding.front());
-        operand->set_encoding(*available_encodings.begin());
-      } else if (operands_with_no_encoding.size() <=
-                 available_encodings.size()) {
-        // We have enough available encodings to assign to the remaining
-        // operands. First try to use the encoding scheme as a guide, and if
-        // that fails, we just assign the remaining available encodings to the
-        // remaining operands randomly.
-        RETURN_IF_ERROR(AssignEncodingByEncodingScheme(
-            &instruction, operands_with_no_encoding, &available_encodings));
-        RETURN_IF_ERROR(AssignEncodingRandomlyFromAvailableEncodings(
-            &instruction, &available_encodings));
-      } else {
-        VLOG(1) << "operands_with_no_encoding:";
-        for (const int index : operands_with_no_encoding) {
-          VLOG(1) << "  " << index;
-        }
-        VLOG(1) << "available_encodings:";
-        for (const InstructionOperand::Encoding available_encoding :
-             available_encodings) {
-          VLOG(1) << "  "
-                  << InstructionOperand::Encoding_Name(available_encoding);
-        }
-        // We don't have enough available encodings to encode all the operands.
-        status = InvalidArgumentError(StrCat(
-            "There are more operands remaining than available encodings: ",
-            instruction.DebugString()));
-        LOG(ERROR) << status;
-        continue;
-      }
+  if (operands_with_no_encoding.empty()) return OkStatus();
+
+  // There are some operands that were not assigned the encoding just from the
+  // name of the operand. We need to use a more sophisticated process.
+  if (operands_with_no_encoding.size() == 1 &&
+      available_encodings.size() == 1) {
+    // There is just one operand where we need to assign the encoding, and only
+    // one available encoding, so we simply match them. In theory, the
+    // following branch should catch this case, but it doesn't work correctly
+    // because some instructions of this type do not use the usual
+    // encoding_scheme conventions, but we can correctly handle them using this
+    // heuristic.
+    InstructionOperand* const operand =
+        vendor_syntax->mutable_operands(operands_with_no_encoding.front());
+    operand->set_encoding(*available_encodings.begin());
+  } else if (operands_with_no_encoding.size() <= available_encodings.size()) {
+    // We have enough available encodings to assign to the remaining operands.
+    // First try to use the encoding scheme as a guide, and if that fails, we
+    // just assign the remaining available encodings to the remaining operands
+    // randomly.
+    RETURN_IF_ERROR(AssignEncodingByEncodingScheme(
+        instruction, operands_with_no_encoding, &available_encodings));
+    RETURN_IF_ERROR(AssignEncodingRandomlyFromAvailableEncodings(
+        instruction, &available_encodings));
+  } else {
+    VLOG(1) << "operands_with_no_encoding:";
+    for (const int index : operands_with_no_encoding) {
+      VLOG(1) << "  " << index;
     }
+    VLOG(1) << "available_encodings:";
+    for (const InstructionOperand::Encoding available_encoding :
+         available_encodings) {
+      VLOG(1) << "  " << InstructionOperand::Encoding_Name(available_encoding);
+    }
+    // We don't have enough available encodings to encode all the operands.
+    const Status status = InvalidArgumentError(
+        StrCat("There are more operands remaining than available encodings: ",
+               instruction->DebugString()));
+    LOG(ERROR) << status;
+    return status;
   }
-  return status;
+  return OkStatus();
 }
-REGISTER_INSTRUCTION_SET_TRANSFORM(AddOperandInfo, 4000);
+REGISTER_INSTRUCTION_TRANSFORM(AddOperandInfo, 4000);
 
-Status AddMissingOperandUsage(InstructionSetProto* instruction_set) {
-  CHECK(instruction_set != nullptr);
-  for (InstructionProto& instruction :
-       *instruction_set->mutable_instructions()) {
-    for (int operand_pos = 0;
-         operand_pos < instruction.vendor_syntax().operands_size();
-         ++operand_pos) {
-      InstructionOperand* const operand =
-          instruction.mutable_vendor_syntax()->mutable_operands(operand_pos);
-      if (operand->usage() != InstructionOperand::USAGE_UNKNOWN) {
-        // Nothing to do.
-        continue;
+Status AddMissingOperandUsage(InstructionProto* instruction) {
+  CHECK(instruction != nullptr);
+  for (int operand_pos = 0;
+       operand_pos < instruction->vendor_syntax().operands_size();
+       ++operand_pos) {
+    InstructionOperand* const operand =
+        instruction->mutable_vendor_syntax()->mutable_operands(operand_pos);
+    if (operand->usage() != InstructionOperand::USAGE_UNKNOWN) {
+      // Nothing to do.
+      continue;
+    }
+    if (operand->encoding() == InstructionOperand::IMMEDIATE_VALUE_ENCODING) {
+      // An immediate can only be read from.
+      operand->set_usage(InstructionOperand::USAGE_READ);
+    } else if (operand->encoding() == InstructionOperand::VEX_V_ENCODING) {
+      // A VEX encoded operand is always a source unless explicitly marked as a
+      // destination. See table table 2-9 of the SDM volume 2 for details.
+      if (operand_pos == 0) {
+        return InvalidArgumentError(
+            StrCat("Unexpected VEX.vvvv operand without usage specification "
+                   "at position 0:\n",
+                   instruction->DebugString()));
       }
-      if (operand->encoding() == InstructionOperand::IMMEDIATE_VALUE_ENCODING) {
-        // An immediate can only be read from.
-        operand->set_usage(InstructionOperand::USAGE_READ);
-      } else if (operand->encoding() == InstructionOperand::VEX_V_ENCODING) {
-        // A VEX encoded operand is always a source unless explicitly marked as
-        // a destination. See table table 2-9 of the SDM volume 2 for details.
-        if (operand_pos == 0) {
-          return InvalidArgumentError(
-              StrCat("Unexpected VEX.vvvv operand without usage specification "
-                     "at position 0:\n",
-                     instruction.DebugString()));
-        }
+      operand->set_usage(InstructionOperand::USAGE_READ);
+    } else if (operand->encoding() == InstructionOperand::IMPLICIT_ENCODING &&
+               operand->addressing_mode() ==
+                   InstructionOperand::DIRECT_ADDRESSING) {
+      // A few instructions have implicit source or destination registers,
+      // typically AND AX, imm8.
+      if (operand_pos == 0) {
+        operand->set_usage(InstructionOperand::USAGE_WRITE);
+      } else {
         operand->set_usage(InstructionOperand::USAGE_READ);
-      } else if (operand->encoding() == InstructionOperand::IMPLICIT_ENCODING &&
-                 operand->addressing_mode() ==
-                     InstructionOperand::DIRECT_ADDRESSING) {
-        // A few instructions have implicit source or destination registers,
-        // typically AND AX, imm8.
-        if (operand_pos == 0) {
-          operand->set_usage(InstructionOperand::USAGE_WRITE);
-        } else {
-          operand->set_usage(InstructionOperand::USAGE_READ);
-        }
       }
-      // TODO(courbet): Add usage information for X87.
     }
+    // TODO(courbet): Add usage information for X87.
   }
   return OkStatus();
 }
-REGISTER_INSTRUCTION_SET_TRANSFORM(AddMissingOperandUsage, 8000);
+REGISTER_INSTRUCTION_TRANSFORM(AddMissingOperandUsage, 8000);
 
 }  // namespace x86
 }  // namespace cpu_instructions
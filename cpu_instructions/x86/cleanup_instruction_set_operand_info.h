@@ -32,14 +32,16 @@ using ::cpu_instructions::util::Status;
 // function replaces any existing operand information in the vendor syntax so
 // that the i-th operand structure corresponds to the i-th operand of the
 // instruction in the vendor syntax specification.
-// Note that this instruction depends on the output of RenameOperands.
-Status AddOperandInfo(InstructionSetProto* instruction_set);
+// Note that this instruction depends on the output of RenameOperands. This is a
+// per-instruction transform.
+Status AddOperandInfo(InstructionProto* instruction);
 
 // Applies heuristics to determine the usage patterns of operands with unknown
 // usage patterns. For example, VEX.vvvv are implicitly read from except when
 // specified. This tranforms explictly sets usage to USAGE_READ. Also, implicit
 // registers (e.g. in ADD AL, imm8) are usually missing usage in the SDM.
-Status AddMissingOperandUsage(InstructionSetProto* instruction_set);
+// This is a per-instruction transform.
+Status AddMissingOperandUsage(InstructionProto* instruction);
 
 }  // namespace x86
 }  // namespace cpu_instructions
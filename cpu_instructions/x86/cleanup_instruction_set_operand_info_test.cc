@@ -14,6 +14,7 @@
 
 #include "cpu_instructions/x86/cleanup_instruction_set_operand_info.h"
 
+#include "cpu_instructions/base/cleanup_instruction_set.h"
 #include "cpu_instructions/base/cleanup_instruction_set_test_utils.h"
 #include "gtest/gtest.h"
 #include "src/google/protobuf/text_format.h"
@@ -141,7 +142,8 @@ TEST(AddOperandInfoTest, DetectsInconsistentEncodings) {
     InstructionSetProto instruction_set;
     ASSERT_TRUE(::google::protobuf::TextFormat::ParseFromString(
         instruction_set_proto, &instruction_set));
-    const Status transform_status = AddOperandInfo(&instruction_set);
+    const Status transform_status =
+        RunInstructionTransform(AddOperandInfo, 0, &instruction_set);
     EXPECT_EQ(transform_status.error_code(), INVALID_ARGUMENT);
   }
 }
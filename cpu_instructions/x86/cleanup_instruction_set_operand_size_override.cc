@@ -20,7 +20,6 @@
 #include <limits>
 #include <memory>
 #include <unordered_map>
-#include <unordered_set>
 #include <vector>
 #include "strings/string.h"
 
@@ -28,13 +27,16 @@
 #include "cpu_instructions/util/instruction_syntax.h"
 #include "cpu_instructions/x86/cleanup_instruction_set_utils.h"
 #include "cpu_instructions/x86/encoding_specification.h"
+#include "cpu_instructions/x86/encoding_specification_literal.h"
+#include "cpu_instructions/x86/packed_encoding.h"
 #include "glog/logging.h"
 #include "strings/str_cat.h"
 #include "strings/str_join.h"
-#include "util/gtl/map_util.h"
+#include "util/gtl/perfect_hash_map.h"
 #include "util/task/canonical_errors.h"
 #include "util/task/status.h"
 #include "util/task/status_macros.h"
+#include "util/task/statusor.h"
 
 namespace cpu_instructions {
 namespace x86 {
@@ -44,60 +46,78 @@ using ::cpu_instructions::util::FailedPreconditionError;
 using ::cpu_instructions::util::InvalidArgumentError;
 using ::cpu_instructions::util::OkStatus;
 using ::cpu_instructions::util::Status;
+using ::cpu_instructions::util::StatusOr;
 
 // Mnemonics of 16-bit string instructions that take no operands.
 const char* const k16BitInstructionsWithImplicitOperands[] = {
     "CMPSW", "CBW",   "CWD",  "INSW",  "IRET",  "LODSW",
     "MOVSW", "OUTSW", "POPF", "PUSHF", "SCASW", "STOSW"};
 
+// The names of the operands that give away the 16-bit-ness of an instruction.
+constexpr const char* k16BitOperands[] = {"r16", "r/m16"};
+constexpr auto k16BitOperandSet = gtl::MakePerfectHashTable(k16BitOperands);
+
+// One of the operands of the instructions gives away its 16-bit-ness;
+// unfortunately, the position of these operands may differ from instruction to
+// instruction. In this table, we keep the list of affected binary encodings,
+// and the index of the operand that can be used to find the 16-bit version.
+// The encodings are parsed at compile time, so that they can be compared with
+// the encodings of the instructions using only integer operations.
+struct EncodingAndOperandIndex {
+  PackedEncoding encoding;
+  int operand_index;
+};
+constexpr EncodingAndOperandIndex kOperandIndex[] = {
+    {"0F 01 /4"_enc, 0},        // SMSW r/m16; SMSW r32/m16
+    {"0F B2 /r"_enc, 0},        // LSS r16,m16:16; LSS r32,m16:32
+    {"0F B4 /r"_enc, 0},        // LFS r16,m16:16; LFS r32,m16:32
+    {"0F B5 /r"_enc, 0},        // LGS r16,m16:16; LGS r32,m16:32
+    {"50+rw"_enc, 0},           // PUSH r16; PUSH r64
+    {"58+ rw"_enc, 0},          // POP r16; POP r64
+    {"62 /r"_enc, 0},           // BOUND r16,m16&16; BOUND r32,m32&32
+    {"8F /0"_enc, 0},           // POP r/m16; POP r/m64
+    {"C4 /r"_enc, 0},           // LES r16,m16:16; LES r32,m16:32
+    {"C5 /r"_enc, 0},           // LDS r16,m16:16; LDS r32,m16:32
+    {"F2 0F 38 F1 /r"_enc, 1},  // CRC32 r32,r/m16; CRC32 r32,r/m32
+    {"FF /6"_enc, 0},           // PUSH r/m16; PUSH r/m64
+};
+
 }  // namespace
 
 Status AddOperandSizeOverrideToInstructionsWithImplicitOperands(
-    InstructionSetProto* instruction_set) {
+    InstructionSetIndex* index, InstructionSetProto* instruction_set) {
+  CHECK(index != nullptr);
   CHECK(instruction_set != nullptr);
-  const std::unordered_set<string> string_instructions(
+  const std::vector<string> string_instructions(
       std::begin(k16BitInstructionsWithImplicitOperands),
       std::end(k16BitInstructionsWithImplicitOperands));
-  for (InstructionProto& instruction :
-       *instruction_set->mutable_instructions()) {
-    const InstructionFormat& vendor_syntax = instruction.vendor_syntax();
-    if (ContainsKey(string_instructions, vendor_syntax.mnemonic())) {
-      AddOperandSizeOverrideToInstructionProto(&instruction);
-    }
+  for (const int position : index->FindByMnemonics(string_instructions)) {
+    AddOperandSizeOverrideToInstructionProto(
+        instruction_set->mutable_instructions(position));
+    index->UpdateInstruction(position);
   }
   return OkStatus();
 }
-REGISTER_INSTRUCTION_SET_TRANSFORM(
+REGISTER_INDEXED_INSTRUCTION_SET_TRANSFORM(
     AddOperandSizeOverrideToInstructionsWithImplicitOperands, 3000);
 
 Status AddOperandSizeOverrideToSpecialCaseInstructions(
-    InstructionSetProto* instruction_set) {
+    InstructionSetIndex* index, InstructionSetProto* instruction_set) {
+  CHECK(index != nullptr);
   CHECK(instruction_set != nullptr);
-  const std::unordered_set<string> k16BitOperands = {"r16", "r/m16"};
-  // One of the operands of the instructions gives away its 16-bit-ness;
-  // unfortunately, the position of these operands may differ from instruction
-  // to instruction. In this map, we keep the list of affected binary encodings,
-  // and the index of the operand that can be used to find the 16-bit version.
-  const std::unordered_map<string, int> kOperandIndex = {
-      {"0F 01 /4", 0},        // SMSW r/m16; SMSW r32/m16
-      {"0F B2 /r", 0},        // LSS r16,m16:16; LSS r32,m16:32
-      {"0F B2 /r", 0},        // LSS r16,m16:16; LSS r32,m16:32
-      {"0F B4 /r", 0},        // LFS r16,m16:16; LFS r32,m16:32
-      {"0F B5 /r", 0},        // LGS r16,m16:16; LGS r32,m16:32
-      {"50+rw", 0},           // PUSH r16; PUSH r64
-      {"58+ rw", 0},          // POP r16; POP r64
-      {"62 /r", 0},           // BOUND r16,m16&16; BOUND r32,m32&32
-      {"8F /0", 0},           // POP r/m16; POP r/m64
-      {"C4 /r", 0},           // LES r16,m16:16; LES r32,m16:32
-      {"C5 /r", 0},           // LDS r16,m16:16; LDS r32,m16:32
-      {"F2 0F 38 F1 /r", 1},  // CRC32 r32,r/m16; CRC32 r32,r/m32
-      {"FF /6", 0},           // PUSH r/m16; PUSH r/m64
-  };
-  for (InstructionProto& instruction :
-       *instruction_set->mutable_instructions()) {
-    int32_t operand_index = std::numeric_limits<int32_t>::max();
-    if (FindCopy(kOperandIndex, instruction.raw_encoding_specification(),
-                 &operand_index)) {
+  for (const EncodingAndOperandIndex& encoding_and_operand_index :
+       kOperandIndex) {
+    for (const int position :
+         index->FindByOpcode(encoding_and_operand_index.encoding.opcode())) {
+      InstructionProto& instruction =
+          *instruction_set->mutable_instructions(position);
+      const StatusOr<PackedEncoding> encoding =
+          GetPackedRawEncodingSpecification(instruction);
+      if (!encoding.ok() ||
+          encoding.ValueOrDie() != encoding_and_operand_index.encoding) {
+        continue;
+      }
+      const int operand_index = encoding_and_operand_index.operand_index;
       const InstructionFormat& vendor_syntax = instruction.vendor_syntax();
       if (operand_index >= vendor_syntax.operands_size()) {
         return InvalidArgumentError(
@@ -109,15 +129,16 @@ Status AddOperandSizeOverrideToSpecialCaseInstructions(
       // use a 16-bit value, and just leave the other bits undefined (or
       // zeroed). Instead, we need to look at the string representation of the
       // type of the operand.
-      if (ContainsKey(k16BitOperands,
-                      vendor_syntax.operands(operand_index).name())) {
+      if (k16BitOperandSet.Contains(
+              vendor_syntax.operands(operand_index).name())) {
         AddOperandSizeOverrideToInstructionProto(&instruction);
+        index->UpdateInstruction(position);
       }
     }
   }
   return OkStatus();
 }
-REGISTER_INSTRUCTION_SET_TRANSFORM(
+REGISTER_INDEXED_INSTRUCTION_SET_TRANSFORM(
     AddOperandSizeOverrideToSpecialCaseInstructions, 3000);
 
 namespace {
@@ -148,8 +169,9 @@ string FormatAllInstructions(
 
 Status AddOperandSizeOverridePrefix(InstructionSetProto* instruction_set) {
   CHECK(instruction_set != nullptr);
-  std::unordered_map<string, std::vector<InstructionProto*>>
-      instructions_by_raw_encoding_specification;
+  std::unordered_map<PackedEncoding, std::vector<InstructionProto*>,
+                     PackedEncodingHash>
+      instructions_by_encoding_specification;
 
   // First we cluster instructions by their binary encoding. We ignore the
   // size(s) of immediate values, because their sizes often differ, even though
@@ -183,16 +205,20 @@ Status AddOperandSizeOverridePrefix(InstructionSetProto* instruction_set) {
     if (specification.has_vex_prefix()) continue;
 
     // Remove information about immediate values from the encoding, and then
-    // index the instructions by the serialized version of the proto.
+    // index the instructions by the packed version of the proto.
     specification.clear_immediate_value_bytes();
-    const string serialized_specification = specification.SerializeAsString();
-    instructions_by_raw_encoding_specification[serialized_specification]
-        .push_back(&instruction);
+    const StatusOr<PackedEncoding> packed_specification_or_status =
+        PackedEncoding::FromProto(specification);
+    RETURN_IF_ERROR(packed_specification_or_status.status());
+    const PackedEncoding& packed_specification =
+        packed_specification_or_status.ValueOrDie();
+    instructions_by_encoding_specification[packed_specification].push_back(
+        &instruction);
   }
 
   // Inspect all instruction groups and add the operand size override prefix if
   // needed.
-  for (const auto& bucket : instructions_by_raw_encoding_specification) {
+  for (const auto& bucket : instructions_by_encoding_specification) {
     const std::vector<InstructionProto*>& instructions = bucket.second;
 
     // If there is only one instruction in the group, it probably means that it
@@ -18,6 +18,7 @@
 #ifndef CPU_INSTRUCTIONS_X86_CLEANUP_INSTRUCTION_SET_OPERAND_SIZE_OVERRIDE_H_
 #define CPU_INSTRUCTIONS_X86_CLEANUP_INSTRUCTION_SET_OPERAND_SIZE_OVERRIDE_H_
 
+#include "cpu_instructions/base/instruction_set_index.h"
 #include "cpu_instructions/proto/instructions.pb.h"
 #include "util/task/status.h"
 
@@ -38,7 +39,7 @@ Status AddOperandSizeOverridePrefix(InstructionSetProto* instruction_set);
 // implicit operands. Because these instructions have no operand, we have no way
 // of detecting the 16-bit version other than through their mnemonics.
 Status AddOperandSizeOverrideToInstructionsWithImplicitOperands(
-    InstructionSetProto* instruction_set);
+    InstructionSetIndex* index, InstructionSetProto* instruction_set);
 
 // Adds the operand size override prefix to 16-bit versions of instructions
 // where the generic 16-bit detection fails. This function handles instructions
@@ -46,7 +47,7 @@ Status AddOperandSizeOverrideToInstructionsWithImplicitOperands(
 // strictly 16-bit and 32-bit. They are typically either 16/64-bit instructions
 // or 32/48-bit instructions (16-bit selector + 16/32-bit offset).
 Status AddOperandSizeOverrideToSpecialCaseInstructions(
-    InstructionSetProto* instruction_set);
+    InstructionSetIndex* index, InstructionSetProto* instruction_set);
 
 }  // namespace x86
 }  // namespace cpu_instructions
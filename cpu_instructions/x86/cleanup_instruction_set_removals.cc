@@ -20,6 +20,7 @@
 
 #include "cpu_instructions/base/cleanup_instruction_set.h"
 #include "cpu_instructions/proto/instructions.pb.h"
+#include "cpu_instructions/util/proto_fingerprint.h"
 #include "glog/logging.h"
 #include "src/google/protobuf/repeated_field.h"
 #include "strings/string_view.h"
@@ -36,14 +37,18 @@ using ::cpu_instructions::util::Status;
 
 Status RemoveDuplicateInstructions(InstructionSetProto* instruction_set) {
   CHECK(instruction_set != nullptr);
-  std::unordered_set<string> visited_instructions;
+  // The instructions are identified by their fingerprints; keeping the whole
+  // serialized instructions in the set would double the memory needed for the
+  // instruction set.
+  std::unordered_set<Fingerprint128, Fingerprint128Hash> visited_instructions;
+  visited_instructions.reserve(instruction_set->instructions_size());
 
   // A function that keeps track of instruction it has already encountered.
   // Returns true if an instruction was already seen, false otherwise.
   auto remove_instruction_if_visited =
       [&visited_instructions](const InstructionProto& instruction) {
-        const string serialized_instruction = instruction.SerializeAsString();
-        return !visited_instructions.insert(serialized_instruction).second;
+        return !visited_instructions.insert(GetProtoFingerprint(instruction))
+                    .second;
       };
 
   ::google::protobuf::RepeatedPtrField<InstructionProto>* const instructions =
@@ -55,61 +60,62 @@ Status RemoveDuplicateInstructions(InstructionSetProto* instruction_set) {
 }
 REGISTER_INSTRUCTION_SET_TRANSFORM(RemoveDuplicateInstructions, 4000);
 
-Status RemoveInstructionsWaitingForFpuSync(
-    InstructionSetProto* instruction_set) {
+namespace {
+
+// Removes all instructions for which 'predicate' returns true from the
+// instruction set.
+Status RemoveInstructions(InstructionRemovalPredicate* predicate,
+                          InstructionSetProto* instruction_set) {
   CHECK(instruction_set != nullptr);
+  RemoveInstructionsIf({predicate}, instruction_set, nullptr, nullptr);
+  return OkStatus();
+}
+
+}  // namespace
+
+bool IsInstructionWaitingForFpuSync(const InstructionProto& instruction) {
   // NOTE(ondrasej): The space after the opcode is important, because with it,
   // the prefix does not match the stand-alone FWAIT instructions that is
   // encoded as "9B".
   static constexpr char kFWaitPrefix[] = "9B ";
-  ::google::protobuf::RepeatedPtrField<InstructionProto>* const instructions =
-      instruction_set->mutable_instructions();
-  const auto uses_fwait_for_sync = [](const InstructionProto& instruction) {
-    return StringPiece(instruction.raw_encoding_specification())
-        .starts_with(kFWaitPrefix);
-  };
-  instructions->erase(std::remove_if(instructions->begin(), instructions->end(),
-                                     uses_fwait_for_sync),
-                      instructions->end());
-  return OkStatus();
+  return StringPiece(instruction.raw_encoding_specification())
+      .starts_with(kFWaitPrefix);
+}
+
+Status RemoveInstructionsWaitingForFpuSync(
+    InstructionSetProto* instruction_set) {
+  return RemoveInstructions(IsInstructionWaitingForFpuSync, instruction_set);
+}
+REGISTER_INSTRUCTION_REMOVAL(RemoveInstructionsWaitingForFpuSync,
+                             IsInstructionWaitingForFpuSync, 0);
+
+bool IsNonEncodableInstruction(const InstructionProto& instruction) {
+  return !instruction.available_in_64_bit();
 }
-REGISTER_INSTRUCTION_SET_TRANSFORM(RemoveInstructionsWaitingForFpuSync, 0);
 
 Status RemoveNonEncodableInstructions(InstructionSetProto* instruction_set) {
-  CHECK(instruction_set != nullptr);
-  ::google::protobuf::RepeatedPtrField<InstructionProto>* const instructions =
-      instruction_set->mutable_instructions();
-  instructions->erase(
-      std::remove_if(instructions->begin(), instructions->end(),
-                     [](const InstructionProto& instruction) {
-                       return !instruction.available_in_64_bit();
-                     }),
-      instructions->end());
-  return OkStatus();
+  return RemoveInstructions(IsNonEncodableInstruction, instruction_set);
 }
-REGISTER_INSTRUCTION_SET_TRANSFORM(RemoveNonEncodableInstructions, 0);
+REGISTER_INSTRUCTION_REMOVAL(RemoveNonEncodableInstructions,
+                             IsNonEncodableInstruction, 0);
 
-Status RemoveRepAndRepneInstructions(InstructionSetProto* instruction_set) {
-  CHECK(instruction_set != nullptr);
+bool IsRepOrRepneInstruction(const InstructionProto& instruction) {
   // NOTE(ondrasej): We're comparing the REP prefix without the space after it.
   // This will match also the REPE and REPNE prefixes. On the other hand, there
   // are no instructions that would use REP in their mnemonic, so optimizing
   // the matching this way is safe.
   static constexpr char kRepPrefix[] = "REP";
-  ::google::protobuf::RepeatedPtrField<InstructionProto>* const instructions =
-      instruction_set->mutable_instructions();
-  const auto uses_rep_or_repne = [](const InstructionProto& instruction) {
-    StringPiece mnemonic(instruction.vendor_syntax().mnemonic());
-    return mnemonic.starts_with(kRepPrefix);
-  };
-  instructions->erase(std::remove_if(instructions->begin(), instructions->end(),
-                                     uses_rep_or_repne),
-                      instructions->end());
-  return OkStatus();
+  return StringPiece(instruction.vendor_syntax().mnemonic())
+      .starts_with(kRepPrefix);
+}
+
+Status RemoveRepAndRepneInstructions(InstructionSetProto* instruction_set) {
+  return RemoveInstructions(IsRepOrRepneInstruction, instruction_set);
 }
 // TODO(ondrasej): In addition to removing them, we should also add an attribute
 // saying whether the REP/REPE/REPNE prefix is allowed.
-REGISTER_INSTRUCTION_SET_TRANSFORM(RemoveRepAndRepneInstructions, 0);
+REGISTER_INSTRUCTION_REMOVAL(RemoveRepAndRepneInstructions,
+                             IsRepOrRepneInstruction, 0);
 
 const std::unordered_set<string>* const kRemovedEncodingSpecifications =
     new std::unordered_set<string>(
@@ -145,39 +151,30 @@ const std::unordered_set<string>* const kRemovedEncodingSpecifications =
 const std::unordered_set<string>* const kRemovedMnemonics =
     new std::unordered_set<string>({"XLAT"});
 
+bool IsSpecialCaseInstruction(const InstructionProto& instruction) {
+  return ContainsKey(*kRemovedEncodingSpecifications,
+                     instruction.raw_encoding_specification()) ||
+         ContainsKey(*kRemovedMnemonics,
+                     instruction.vendor_syntax().mnemonic());
+}
+
 Status RemoveSpecialCaseInstructions(InstructionSetProto* instruction_set) {
-  CHECK(instruction_set != nullptr);
-  ::google::protobuf::RepeatedPtrField<InstructionProto>* const instructions =
-      instruction_set->mutable_instructions();
-  const auto is_special_case_instruction =
-      [](const InstructionProto& instruction) {
-        return ContainsKey(*kRemovedEncodingSpecifications,
-                           instruction.raw_encoding_specification()) ||
-               ContainsKey(*kRemovedMnemonics,
-                           instruction.vendor_syntax().mnemonic());
-      };
-  instructions->erase(std::remove_if(instructions->begin(), instructions->end(),
-                                     is_special_case_instruction),
-                      instructions->end());
-  return OkStatus();
+  return RemoveInstructions(IsSpecialCaseInstruction, instruction_set);
+}
+REGISTER_INSTRUCTION_REMOVAL(RemoveSpecialCaseInstructions,
+                             IsSpecialCaseInstruction, 0);
+
+bool IsUndefinedInstruction(const InstructionProto& instruction) {
+  constexpr const char* const kRemovedInstructions[] = {"UD0", "UD1"};
+  return c_linear_search(kRemovedInstructions,
+                         instruction.vendor_syntax().mnemonic());
 }
-REGISTER_INSTRUCTION_SET_TRANSFORM(RemoveSpecialCaseInstructions, 0);
 
 Status RemoveUndefinedInstructions(InstructionSetProto* instruction_set) {
-  ::google::protobuf::RepeatedPtrField<InstructionProto>* const instructions =
-      instruction_set->mutable_instructions();
-  const auto is_undefined_instruction =
-      [](const InstructionProto& instruction) {
-        constexpr const char* const kRemovedInstructions[] = {"UD0", "UD1"};
-        return c_linear_search(kRemovedInstructions,
-                               instruction.vendor_syntax().mnemonic());
-      };
-  instructions->erase(std::remove_if(instructions->begin(), instructions->end(),
-                                     is_undefined_instruction),
-                      instructions->end());
-  return OkStatus();
+  return RemoveInstructions(IsUndefinedInstruction, instruction_set);
 }
-REGISTER_INSTRUCTION_SET_TRANSFORM(RemoveUndefinedInstructions, 0);
+REGISTER_INSTRUCTION_REMOVAL(RemoveUndefinedInstructions,
+                             IsUndefinedInstruction, 0);
 
 }  // namespace x86
 }  // namespace cpu_instructions
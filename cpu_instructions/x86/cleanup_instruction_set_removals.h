@@ -33,16 +33,23 @@ using ::cpu_instructions::util::Status;
 // cases are so unlikely in our data set that we can safely ignore them.
 Status RemoveDuplicateInstructions(InstructionSetProto* instruction_set);
 
+// The transforms below, except for RemoveDuplicateInstructions, are removal
+// transforms: each of them removes the instructions for which the corresponding
+// predicate returns true. In the default pipeline, all of them run together in
+// a single pass over the instruction set.
+
 // Removes all instructions that use the pseudo-prefix "9B" (wait for pending
 // FPU exceptions). The byte "9B" actually is a stand-alone instruction, and
 // the disassembler treats it as such.
 // TODO(ondrasej): We need to verify how the instruction is treated by the CPU,
 // e.g. if it is fused into a single micro-operation, or if the CPU does some
 // kind of synchronization to prevent other exceptions from happening.
+bool IsInstructionWaitingForFpuSync(const InstructionProto& instruction);
 Status RemoveInstructionsWaitingForFpuSync(
     InstructionSetProto* instruction_set);
 
 // Removes instructions that are not encodable in the 64-bit x86-64 mode.
+bool IsNonEncodableInstruction(const InstructionProto& instruction);
 Status RemoveNonEncodableInstructions(InstructionSetProto* instruction_set);
 
 // Removes all instructions that use the prefixes "F2" and "F3" in the binary
@@ -52,6 +59,7 @@ Status RemoveNonEncodableInstructions(InstructionSetProto* instruction_set);
 // TODO(ondrasej): We should keep the information that these instructions can
 // have the REP/REPNE prefix, ideally in a separate field of the instruction
 // proto.
+bool IsRepOrRepneInstruction(const InstructionProto& instruction);
 Status RemoveRepAndRepneInstructions(InstructionSetProto* instruction_set);
 
 // Removes instructions that are a special case of another instructions. All of
@@ -60,11 +68,13 @@ Status RemoveRepAndRepneInstructions(InstructionSetProto* instruction_set);
 // that perform a certain operation on ST(0) and ST(1), but we also have another
 // instruction that uses the same mnemonic, performs the same operation on ST(0)
 // and ST(i), and encodes to the same sequence of bytes when used with ST(1).
+bool IsSpecialCaseInstruction(const InstructionProto& instruction);
 Status RemoveSpecialCaseInstructions(InstructionSetProto* instruction_set);
 
 // Removes the UD0 and UD1 instructions introduced in the December 2016 version
 // of the SDM. These instructions are not "real" instructions - they raise the
 // "undefined opcode" exception, by using an undefined opcode.
+bool IsUndefinedInstruction(const InstructionProto& instruction);
 Status RemoveUndefinedInstructions(InstructionSetProto* instruction_set);
 
 }  // namespace x86
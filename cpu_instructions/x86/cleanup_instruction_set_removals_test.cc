@@ -14,7 +14,11 @@
 
 #include "cpu_instructions/x86/cleanup_instruction_set_removals.h"
 
+#include <vector>
+
+#include "cpu_instructions/base/cleanup_instruction_set.h"
 #include "cpu_instructions/base/cleanup_instruction_set_test_utils.h"
+#include "gmock/gmock.h"
 #include "gtest/gtest.h"
 
 namespace cpu_instructions {
@@ -323,6 +327,24 @@ TEST(RemoveUndefinedInstructionsTest, RemoveSomeInstructions) {
                 kExpectedInstructionSetProto);
 }
 
+TEST(RemovalsTest, AreFusedInDefaultPipeline) {
+  // All the removals have the same rank, and they run as a single element of
+  // the default pipeline.
+  const std::vector<InstructionSetTransform> pipeline =
+      GetDefaultTransformPipeline();
+  ASSERT_FALSE(pipeline.empty());
+  const string fused_name = GetTransformName(pipeline[0]);
+  EXPECT_THAT(fused_name,
+              ::testing::HasSubstr("RemoveInstructionsWaitingForFpuSync"));
+  EXPECT_THAT(fused_name,
+              ::testing::HasSubstr("RemoveNonEncodableInstructions"));
+  EXPECT_THAT(fused_name,
+              ::testing::HasSubstr("RemoveRepAndRepneInstructions"));
+  EXPECT_THAT(fused_name,
+              ::testing::HasSubstr("RemoveSpecialCaseInstructions"));
+  EXPECT_THAT(fused_name, ::testing::HasSubstr("RemoveUndefinedInstructions"));
+}
+
 }  // namespace
 }  // namespace x86
 }  // namespace cpu_instructions
@@ -17,17 +17,38 @@
 #include "strings/string.h"
 
 #include "cpu_instructions/proto/x86/encoding_specification.pb.h"
+#include "cpu_instructions/x86/encoding_specification_cache.h"
 #include "glog/logging.h"
 #include "strings/str_cat.h"
+#include "util/task/status.h"
 
 namespace cpu_instructions {
 namespace x86 {
 namespace {
 
+using ::cpu_instructions::util::StatusOr;
+
 // The operand size override prefix used by the 16-bit versions of some
 // instructions.
 const char kOperandSizeOverridePrefix[] = "66 ";
 
+// Returns the key of 'encoding' in the index of packed encodings.
+string GetPackedEncodingKey(PackedEncoding encoding) {
+  return StrCat(encoding.encoding_bits(), ":", encoding.prefix_bits());
+}
+
+// The custom key function of InstructionSetIndex used by
+// FindByPackedRawEncodingSpecification.
+bool GetPackedRawEncodingSpecificationKey(const InstructionProto& instruction,
+                                          string* key) {
+  CHECK(key != nullptr);
+  const StatusOr<PackedEncoding> encoding =
+      GetPackedRawEncodingSpecification(instruction);
+  if (!encoding.ok()) return false;
+  *key = GetPackedEncodingKey(encoding.ValueOrDie());
+  return true;
+}
+
 }  // namespace
 
 // Adds the operand size override prefix to the binary encoding specification of
@@ -56,5 +77,21 @@ void AddOperandSizeOverrideToInstructionProto(InstructionProto* instruction) {
   }
 }
 
+StatusOr<PackedEncoding> GetPackedRawEncodingSpecification(
+    const InstructionProto& instruction) {
+  const StatusOr<EncodingSpecification>& specification =
+      GetGlobalEncodingSpecificationCache()->Parse(
+          instruction.raw_encoding_specification());
+  if (!specification.ok()) return specification.status();
+  return PackedEncoding::FromProto(specification.ValueOrDie());
+}
+
+std::vector<int> FindByPackedRawEncodingSpecification(
+    InstructionSetIndex* index, PackedEncoding encoding) {
+  CHECK(index != nullptr);
+  return index->FindByCustomKey(GetPackedRawEncodingSpecificationKey,
+                                GetPackedEncodingKey(encoding));
+}
+
 }  // namespace x86
 }  // namespace cpu_instructions
@@ -17,7 +17,12 @@
 #ifndef CPU_INSTRUCTIONS_X86_CLEANUP_INSTRUCTION_SET_UTILS_H_
 #define CPU_INSTRUCTIONS_X86_CLEANUP_INSTRUCTION_SET_UTILS_H_
 
+#include <vector>
+
+#include "cpu_instructions/base/instruction_set_index.h"
 #include "cpu_instructions/proto/instructions.pb.h"
+#include "cpu_instructions/x86/packed_encoding.h"
+#include "util/task/statusor.h"
 
 namespace cpu_instructions {
 namespace x86 {
@@ -27,6 +32,22 @@ namespace x86 {
 // not added and a warning is printed to the log.
 void AddOperandSizeOverrideToInstructionProto(InstructionProto* instruction);
 
+// Parses the raw encoding specification of the given instruction proto using
+// the global encoding specification cache, and returns it as a packed encoding.
+// Returns an error if the raw encoding specification can't be parsed or if it
+// does not fit into a packed encoding.
+util::StatusOr<PackedEncoding> GetPackedRawEncodingSpecification(
+    const InstructionProto& instruction);
+
+// Returns the positions of the instructions whose raw encoding specification,
+// parsed using the global encoding specification cache, is 'encoding'. The
+// lookup does not depend on the spelling of the raw encoding specification,
+// and it works before the parsed encoding specifications are added to the
+// instructions. Instructions whose raw encoding specification can't be parsed
+// are not indexed.
+std::vector<int> FindByPackedRawEncodingSpecification(
+    InstructionSetIndex* index, PackedEncoding encoding);
+
 }  // namespace x86
 }  // namespace cpu_instructions
 
@@ -16,6 +16,7 @@
 
 #include "cpu_instructions/proto/instructions.pb.h"
 #include "cpu_instructions/testing/test_util.h"
+#include "cpu_instructions/x86/encoding_specification_literal.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "src/google/protobuf/text_format.h"
@@ -25,6 +26,9 @@ namespace x86 {
 namespace {
 
 using ::cpu_instructions::testing::EqualsProto;
+using ::testing::ElementsAre;
+using ::testing::IsEmpty;
+using ::cpu_instructions::util::StatusOr;
 
 TEST(AddOperandSizeOverrideToInstructionProtoTest, AddsPrefix) {
   constexpr char kInstructionProto[] = R"(
@@ -122,6 +126,50 @@ TEST(AddOperandSizeOverrideToInstructionProtoTest,
   EXPECT_THAT(instruction, EqualsProto(kExpectedInstructionProto));
 }
 
+TEST(GetPackedRawEncodingSpecificationTest, ParsesRawSpecification) {
+  InstructionProto instruction;
+  instruction.set_raw_encoding_specification("REX.W + 81 /2 id");
+  const StatusOr<PackedEncoding> encoding =
+      GetPackedRawEncodingSpecification(instruction);
+  ASSERT_TRUE(encoding.ok()) << encoding.status();
+  EXPECT_EQ(encoding.ValueOrDie(), "REX.W + 81 /2 id"_enc);
+}
+
+TEST(GetPackedRawEncodingSpecificationTest, InvalidSpecification) {
+  InstructionProto instruction;
+  instruction.set_raw_encoding_specification("81 /2 ix");
+  EXPECT_FALSE(GetPackedRawEncodingSpecification(instruction).ok());
+}
+
+TEST(FindByPackedRawEncodingSpecificationTest, FindsInstructions) {
+  constexpr char kInstructionSetProto[] = R"(
+      instructions { raw_encoding_specification: '0F 90' }
+      instructions { raw_encoding_specification: 'REX + 0F 90' }
+      instructions { raw_encoding_specification: '0F  90' }
+      instructions { raw_encoding_specification: '0F 9X' }
+      instructions { raw_encoding_specification: '0F 91' })";
+  InstructionSetProto instruction_set;
+  ASSERT_TRUE(::google::protobuf::TextFormat::ParseFromString(
+      kInstructionSetProto, &instruction_set));
+  InstructionSetIndex index(&instruction_set);
+  EXPECT_THAT(FindByPackedRawEncodingSpecification(&index, "0F 90"_enc),
+              ElementsAre(0, 2));
+  EXPECT_THAT(
+      FindByPackedRawEncodingSpecification(
+          &index,
+          "0F 90"_enc.With(PackedEncoding::kHasMandatoryRexWPrefix, 1)),
+      ElementsAre(1));
+  EXPECT_THAT(FindByPackedRawEncodingSpecification(&index, "0F 92"_enc),
+              IsEmpty());
+
+  instruction_set.mutable_instructions(4)->set_raw_encoding_specification(
+      "0F 90");
+  index.UpdateInstruction(4);
+  EXPECT_TRUE(index.IsUpToDate());
+  EXPECT_THAT(FindByPackedRawEncodingSpecification(&index, "0F 90"_enc),
+              ElementsAre(0, 2, 4));
+}
+
 }  // namespace
 }  // namespace x86
 }  // namespace cpu_instructions
@@ -19,18 +19,15 @@
 
 #include <cstdint>
 #include <functional>
-#include <iterator>
-#include <unordered_map>
 #include <utility>
 #include "strings/string.h"
 
 #include "cpu_instructions/proto/x86/encoding_specification.pb.h"
 #include "cpu_instructions/proto/x86/instruction_encoding.pb.h"
 #include "glog/logging.h"
-#include "re2/re2.h"
 #include "strings/str_cat.h"
 #include "strings/string_view.h"
-#include "util/gtl/map_util.h"
+#include "util/gtl/perfect_hash_map.h"
 #include "util/task/canonical_errors.h"
 #include "util/task/status_macros.h"
 
@@ -43,11 +40,8 @@ using ::cpu_instructions::util::OkStatus;
 using ::cpu_instructions::util::Status;
 using ::cpu_instructions::util::StatusOr;
 
-// RE2 and protobuf have two slightly different implementations of StringPiece.
-// In this file, we use RE2::Consume heavily, so we explicitly switch to the RE2
-// implementation.
-using ::re2::StringPiece;
-
+// Removes 'prefix' from the beginning of 'sp'. Returns true if 'sp' started
+// with 'prefix'; otherwise, returns false and leaves 'sp' unchanged.
 bool ConsumePrefix(StringPiece* sp, StringPiece prefix) {
   DCHECK(sp != nullptr);
   if (!sp->starts_with(prefix)) return false;
@@ -55,6 +49,48 @@ bool ConsumePrefix(StringPiece* sp, StringPiece prefix) {
   return true;
 }
 
+// Removes all space characters from the beginning of 'sp'.
+inline void ConsumeSpaces(StringPiece* sp) {
+  DCHECK(sp != nullptr);
+  while (!sp->empty() && (*sp)[0] == ' ') sp->remove_prefix(1);
+}
+
+// Consumes a separator character surrounded by an optional whitespace, i.e.
+// the regexp " *<separator> *". Returns false and leaves 'sp' unchanged if
+// 'sp' does not start with the separator.
+bool ConsumeSeparator(StringPiece* sp, char separator) {
+  DCHECK(sp != nullptr);
+  StringPiece rest = *sp;
+  ConsumeSpaces(&rest);
+  if (rest.empty() || rest[0] != separator) return false;
+  rest.remove_prefix(1);
+  ConsumeSpaces(&rest);
+  *sp = rest;
+  return true;
+}
+
+// Returns the value of an uppercase hexadecimal digit, or -1 if 'c' is not an
+// uppercase hexadecimal digit.
+inline int UppercaseHexDigitValue(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+// Consumes the first token from 'tokens' that is a prefix of 'sp'. Returns the
+// index of the token in 'tokens' or -1 if no token matched; in the latter case,
+// 'sp' is left unchanged. The tokens are tried in the order in which they
+// appear in 'tokens'.
+template <size_t kNumTokens>
+int ConsumeFirstToken(StringPiece* sp,
+                      const char* const (&tokens)[kNumTokens]) {
+  DCHECK(sp != nullptr);
+  for (size_t i = 0; i < kNumTokens; ++i) {
+    if (ConsumePrefix(sp, tokens[i])) return static_cast<int>(i);
+  }
+  return -1;
+}
+
 // The parser for the instruction encoding specification language used in the
 // Intel manuals.
 class EncodingSpecificationParser {
@@ -91,27 +127,17 @@ class EncodingSpecificationParser {
 
   // The current state of the parser.
   EncodingSpecification specification_;
-
-  // Hash maps mapping tokens of the instruction encoding specification language
-  // to enum values of the encoding protos.
-  const std::unordered_map<string, VexOperandUsage> vex_operand_usage_tokens_;
-  const std::unordered_map<string, VexVectorSize> vector_size_tokens_;
-  const std::unordered_map<string, VexEncoding::MandatoryPrefix>
-      mandatory_prefix_tokens_;
-  const std::unordered_map<string, VexPrefixEncodingSpecification::VexWUsage>
-      vex_w_usage_tokens_;
-  const std::unordered_map<uint32_t, VexEncoding::MapSelect> map_select_tokens_;
 };
 
 // Definitions of maps from tokens to the enum values used in the instruction
-// encoding specification proto. These values are used to initialize the hash
-// maps used in the parser object.
-const std::pair<const char*, VexOperandUsage> kVexOperandUsageTokens[] = {
+// encoding specification proto. The string tokens are looked up through perfect
+// hash tables built at compile time.
+constexpr gtl::PerfectHashMapEntry<VexOperandUsage> kVexOperandUsageTokens[] = {
     {"", NO_VEX_OPERAND_USAGE},
     {"NDS", VEX_OPERAND_IS_FIRST_SOURCE_REGISTER},
     {"NDD", VEX_OPERAND_IS_DESTINATION_REGISTER},
     {"DDS", VEX_OPERAND_IS_SECOND_SOURCE_REGISTER}};
-const std::pair<const char*, VexVectorSize> kVectorSizeTokens[] = {
+constexpr gtl::PerfectHashMapEntry<VexVectorSize> kVectorSizeTokens[] = {
     {"LZ", VEX_VECTOR_SIZE_BIT_IS_ZERO},
     // The two following are undocumented. We assume that L0 is equivalent
     // to LZ, and extend the semantics to L1 naturally to mean "L must be
@@ -123,23 +149,170 @@ const std::pair<const char*, VexVectorSize> kVectorSizeTokens[] = {
     {"512", VEX_VECTOR_SIZE_512_BIT},
     {"LIG", VEX_VECTOR_SIZE_IS_IGNORED},
     {"LIG.128", VEX_VECTOR_SIZE_128_BIT}};
-const std::pair<const char*, VexEncoding::MandatoryPrefix>
+constexpr gtl::PerfectHashMapEntry<VexEncoding::MandatoryPrefix>
     kMandatoryPrefixTokens[] = {
         {"", VexEncoding::NO_MANDATORY_PREFIX},
         {"66", VexEncoding::MANDATORY_PREFIX_OPERAND_SIZE_OVERRIDE},
         {"F2", VexEncoding::MANDATORY_PREFIX_REPNE},
         {"F3", VexEncoding::MANDATORY_PREFIX_REPE}};
-const std::pair<const char*, VexPrefixEncodingSpecification::VexWUsage>
-    kVexWUsageTokens[] = {
-        {"", VexPrefixEncodingSpecification::VEX_W_IS_IGNORED},
-        {"W0", VexPrefixEncodingSpecification::VEX_W_IS_ZERO},
-        {"W1", VexPrefixEncodingSpecification::VEX_W_IS_ONE},
-        {"WIG", VexPrefixEncodingSpecification::VEX_W_IS_IGNORED}};
+using VexWUsage = VexPrefixEncodingSpecification::VexWUsage;
+constexpr gtl::PerfectHashMapEntry<VexWUsage> kVexWUsageTokens[] = {
+    {"", VexPrefixEncodingSpecification::VEX_W_IS_IGNORED},
+    {"W0", VexPrefixEncodingSpecification::VEX_W_IS_ZERO},
+    {"W1", VexPrefixEncodingSpecification::VEX_W_IS_ONE},
+    {"WIG", VexPrefixEncodingSpecification::VEX_W_IS_IGNORED}};
 const std::pair<uint32_t, VexEncoding::MapSelect> kMapSelectTokens[] = {
     {0x0f, VexEncoding::MAP_SELECT_0F},
     {0x0f3a, VexEncoding::MAP_SELECT_0F3A},
     {0x0f38, VexEncoding::MAP_SELECT_0F38}};
 
+constexpr auto kVexOperandUsageTokenTable =
+    gtl::MakePerfectHashTable(kVexOperandUsageTokens);
+constexpr auto kVectorSizeTokenTable =
+    gtl::MakePerfectHashTable(kVectorSizeTokens);
+constexpr auto kMandatoryPrefixTokenTable =
+    gtl::MakePerfectHashTable(kMandatoryPrefixTokens);
+constexpr auto kVexWUsageTokenTable =
+    gtl::MakePerfectHashTable(kVexWUsageTokens);
+
+// Returns the value of 'token' in 'tokens'. Dies if 'token' is not in the
+// table.
+template <typename ValueType, size_t kNumTokens>
+ValueType FindTokenOrDie(
+    const gtl::PerfectHashMap<ValueType, kNumTokens>& tokens,
+    StringPiece token) {
+  const gtl::PerfectHashMapEntry<ValueType>* const entry = tokens.Find(token);
+  CHECK(entry != nullptr) << "Unknown token: '" << token << "'";
+  return entry->value;
+}
+
+// Returns the map select value of the opcode map 'opcode_map'. Dies if
+// 'opcode_map' is not in kMapSelectTokens.
+VexEncoding::MapSelect GetMapSelectOrDie(uint32_t opcode_map) {
+  for (const auto& token : kMapSelectTokens) {
+    if (token.first == opcode_map) return token.second;
+  }
+  LOG(FATAL) << "Unknown opcode map: " << opcode_map;
+  return VexEncoding::MapSelect();
+}
+
+// The tokens of the legacy prefixes. The manual uses the REX prefix in several
+// forms: REX.W and REX.R to signal that a specific bit of the REX prefix is
+// required, or just REX which probably implies REX.W. The longer forms must be
+// listed before the plain REX, because the tokens are tried in order.
+enum LegacyPrefixToken {
+  kOperandSizeOverrideToken,
+  kAddressSizeOverrideToken,
+  kRepneToken,
+  kRepeToken,
+  kRexRToken,
+  kRexWToken,
+  kRexToken,
+};
+constexpr const char* kLegacyPrefixTokens[] = {"66",    "67",    "F2", "F3",
+                                               "REX.R", "REX.W", "REX"};
+
+// The tokens of the fields of the VEX prefix specification. The tokens of each
+// field are tried in the order in which they are listed; when the rest of the
+// specification can't be parsed, the parser backtracks and tries the next
+// token, e.g. to tell LIG from LIG.128.
+constexpr const char* kVexPrefixTypeTokens[] = {"EVEX", "VEX"};
+constexpr const char* kVexOperandUsageFieldTokens[] = {"NDS", "NDD", "DDS"};
+constexpr const char* kVectorSizeFieldTokens[] = {
+    "LIG", "LZ", "L0", "L1", "LIG.128", "128", "256", "512"};
+constexpr const char* kMandatoryPrefixFieldTokens[] = {"66", "F2", "F3"};
+constexpr const char* kOpcodeMapFieldTokens[] = {"0F", "0F3A", "0F38"};
+constexpr const char* kVexWUsageFieldTokens[] = {"W0", "W1", "WIG"};
+
+// Describes one dot-separated field of the VEX prefix specification.
+struct VexPrefixField {
+  template <size_t kNumTokens>
+  constexpr VexPrefixField(const char* const (&field_tokens)[kNumTokens],
+                           bool field_is_optional)
+      : tokens(field_tokens),
+        num_tokens(kNumTokens),
+        is_optional(field_is_optional) {}
+
+  const char* const* tokens;
+  int num_tokens;
+  bool is_optional;
+};
+
+// The fields of the VEX prefix specification in the order in which they appear
+// in the specification. For more details on the format see Intel 64 and IA-32
+// Architectures Software Developer's Manual, Volume 2: Instruction Set
+// Reference, A-Z, Section 3.1.1.2 (page 3.3).
+enum VexPrefixFieldIndex {
+  kVexOperandUsageField,
+  kVectorSizeField,
+  kMandatoryPrefixField,
+  kOpcodeMapField,
+  kVexWUsageField,
+  kNumVexPrefixFields
+};
+constexpr VexPrefixField kVexPrefixFields[kNumVexPrefixFields] = {
+    {kVexOperandUsageFieldTokens, true},
+    {kVectorSizeFieldTokens, true},
+    {kMandatoryPrefixFieldTokens, true},
+    {kOpcodeMapFieldTokens, false},
+    {kVexWUsageFieldTokens, true}};
+
+// Matches the VEX prefix fields starting with the field 'field_index' against
+// 'specification'. Each field is separated from the previous part of the
+// specification by a dot (optionally surrounded by spaces), and the last field
+// must be followed by a space. On success, stores the token of each field to
+// 'field_values' (an empty string if an optional field was not present),
+// stores the remaining part of the specification to 'rest' and returns true.
+// Returns false if the specification does not match.
+bool MatchVexPrefixFields(int field_index, StringPiece specification,
+                          StringPiece* field_values, StringPiece* rest) {
+  DCHECK(field_values != nullptr);
+  DCHECK(rest != nullptr);
+  if (field_index == kNumVexPrefixFields) {
+    if (!ConsumePrefix(&specification, " ")) return false;
+    *rest = specification;
+    return true;
+  }
+  const VexPrefixField& field = kVexPrefixFields[field_index];
+  StringPiece field_start = specification;
+  if (ConsumeSeparator(&field_start, '.')) {
+    for (int i = 0; i < field.num_tokens; ++i) {
+      StringPiece field_end = field_start;
+      if (ConsumePrefix(&field_end, field.tokens[i]) &&
+          MatchVexPrefixFields(field_index + 1, field_end, field_values,
+                               rest)) {
+        field_values[field_index] = field.tokens[i];
+        return true;
+      }
+    }
+  }
+  if (!field.is_optional) return false;
+  field_values[field_index] = StringPiece();
+  return MatchVexPrefixFields(field_index + 1, specification, field_values,
+                              rest);
+}
+
+// Returns the value of an opcode map token from kOpcodeMapFieldTokens, i.e. the
+// token parsed as a hexadecimal number.
+uint32_t ParseOpcodeMap(StringPiece opcode_map_token) {
+  uint32_t opcode_map = 0;
+  for (const char c : opcode_map_token) {
+    const int digit = UppercaseHexDigitValue(c);
+    CHECK_GE(digit, 0) << "Invalid opcode map: " << opcode_map_token;
+    opcode_map = (opcode_map << 4) | digit;
+  }
+  return opcode_map;
+}
+
+// The tokens of the registers encoded in the opcode byte, e.g. "+ rb".
+constexpr const char* kOpcodeEncodedRegisterTokens[] = {"i", "rb", "rw", "rd",
+                                                        "ro"};
+// Memory operand suffixes. There might be a m64/m128 suffix that is not
+// explained in the Intel manuals, but that most likely means that the operand
+// in the ModR/M byte must be a memory operand. In practice, I've never seen
+// them without another ModR/M suffix, so we just ignore them.
+constexpr const char* kMemoryOperandSuffixTokens[] = {"m64", "m128", "m256"};
+
 inline void ConsumeWhitespace(StringPiece* specification) {
   DCHECK(specification != nullptr);
   while (ConsumePrefix(specification, " ") ||
@@ -147,17 +320,7 @@ inline void ConsumeWhitespace(StringPiece* specification) {
   }
 }
 
-EncodingSpecificationParser::EncodingSpecificationParser()
-    : vex_operand_usage_tokens_(std::begin(kVexOperandUsageTokens),
-                                std::end(kVexOperandUsageTokens)),
-      vector_size_tokens_(std::begin(kVectorSizeTokens),
-                          std::end(kVectorSizeTokens)),
-      mandatory_prefix_tokens_(std::begin(kMandatoryPrefixTokens),
-                               std::end(kMandatoryPrefixTokens)),
-      vex_w_usage_tokens_(std::begin(kVexWUsageTokens),
-                          std::end(kVexWUsageTokens)),
-      map_select_tokens_(std::begin(kMapSelectTokens),
-                         std::end(kMapSelectTokens)) {}
+EncodingSpecificationParser::EncodingSpecificationParser() {}
 
 StatusOr<EncodingSpecification> EncodingSpecificationParser::ParseFromString(
     StringPiece specification) {
@@ -174,47 +337,44 @@ StatusOr<EncodingSpecification> EncodingSpecificationParser::ParseFromString(
 Status EncodingSpecificationParser::ParseLegacyPrefixes(
     StringPiece* specification) {
   CHECK(specification != nullptr);
-  // A regexp for parsing the legacy prefixes. For more details on the format,
-  // see Intel 64 and IA-32 Architectures Software Developer's Manual, Volume 2:
-  // Instruction Set Reference, A-Z, Section 3.1.1.1 (page 3.2).
+  // For more details on the format of the legacy prefixes, see Intel 64 and
+  // IA-32 Architectures Software Developer's Manual, Volume 2: Instruction Set
+  // Reference, A-Z, Section 3.1.1.1 (page 3.2).
   // The parser matches all the possible prefixes and removes them from the
-  // specification. When the string does not match anymore, it assues that this
-  // is the beginning of the opcode and switches to parsing the opcode.
-  // NOTE(ondrasej): kLegacyPrefixRegex must be static - removing it causes an
-  // internal compiler error on gcc 4.8.
-  static constexpr char kLegacyPrefixRegex[] =
-      " *(?:"                  // Optional whitespace before the prefix.
-      "(66)|"                  // The operand size override prefix.
-      "(67)|"                  // THe address size override prefix.
-      "(F2)|"                  // The REPNE prefix.
-      "(F3)|"                  // The REPE prefix.
-      "(REX(?:\\.(?:R|W))?))"  // The REX prefix. The manual uses this prefix in
-                               // several forms: REX.W and REX.R to signal that
-                               // a specific bit of the REX prefix is required,
-                               // or just REX which probably implies REX.W.
-      "(?: *\\+ *)?";          // Consume also any whitespace at the end.
-  static const LazyRE2 legacy_prefix_parser = {kLegacyPrefixRegex};
-  string operand_size_override_prefix;
-  string address_size_override_prefix;
-  string repne_prefix;
-  string repe_prefix;
-  string rex_prefix;
+  // specification. When the string does not match anymore, it assumes that
+  // this is the beginning of the opcode and switches to parsing the opcode.
   bool has_mandatory_address_size_override_prefix = false;
   bool has_mandatory_operand_size_override_prefix = false;
   bool has_mandatory_repe_prefix = false;
   bool has_mandatory_repne_prefix = false;
   bool has_mandatory_rex_prefix = false;
-  while (RE2::Consume(specification, *legacy_prefix_parser,
-                      &operand_size_override_prefix,
-                      &address_size_override_prefix, &repne_prefix,
-                      &repe_prefix, &rex_prefix)) {
-    has_mandatory_operand_size_override_prefix |=
-        !operand_size_override_prefix.empty();
-    has_mandatory_address_size_override_prefix |=
-        !address_size_override_prefix.empty();
-    has_mandatory_repe_prefix |= !repe_prefix.empty();
-    has_mandatory_repne_prefix |= !repne_prefix.empty();
-    has_mandatory_rex_prefix |= !rex_prefix.empty();
+  while (true) {
+    StringPiece rest = *specification;
+    ConsumeSpaces(&rest);
+    const int token = ConsumeFirstToken(&rest, kLegacyPrefixTokens);
+    if (token < 0) break;
+    switch (token) {
+      case kOperandSizeOverrideToken:
+        has_mandatory_operand_size_override_prefix = true;
+        break;
+      case kAddressSizeOverrideToken:
+        has_mandatory_address_size_override_prefix = true;
+        break;
+      case kRepneToken:
+        has_mandatory_repne_prefix = true;
+        break;
+      case kRepeToken:
+        has_mandatory_repe_prefix = true;
+        break;
+      case kRexRToken:
+      case kRexWToken:
+      case kRexToken:
+        has_mandatory_rex_prefix = true;
+        break;
+    }
+    // Consume also any whitespace and the plus sign at the end.
+    ConsumeSeparator(&rest, '+');
+    *specification = rest;
   }
   // Note that just calling mutable_legacy_prefixes will create an empty
   // legacy_prefixes field of the specification. This is desirable, because it
@@ -235,60 +395,44 @@ Status EncodingSpecificationParser::ParseLegacyPrefixes(
 Status EncodingSpecificationParser::ParseVexOrEvexPrefix(
     StringPiece* specification) {
   CHECK(specification != nullptr);
-  // A regexp for parsing the VEX prefix specification. For more details on the
-  // format see Intel 64 and IA-32 Architectures Software Developer's Manual,
-  // Volume 2: Instruction Set Reference, A-Z, Section 3.1.1.2 (page 3.3).
   // NOTE(ondrasej): Note that some of the fields do not affect the size of the
   // instruction encoding, so we just check that they have a valid value, but we
-  // do not extract this value out of the regexp.
-  // NOTE(ondrasej): kVexPrefixRegexp must be static - removing it causes an
-  // internal compiler error on gcc 4.8.
-  static constexpr char kVexPrefixRegexp[] =
-      "(E?VEX)"                    // The VEX prefix.
-      "(?: *\\. *(NDS|NDD|DDS))?"  // The directionality of the operand(s).
-      "(?: *\\. *(LIG|LZ|L0|L1|LIG\\.128|128|256|512))?"  // Interpretation of
-                                                          // the VEX and EVEX
-                                                          // L/L' bits.
-      "(?: *\\. *(66|F2|F3))?"     // The mandatory prefixes.
-      " *\\. *(0F|0F3A|0F38)"      // The opcode prefix based on VEX.mmmmm.
-      "(?: *\\. *(W0|W1|WIG))? ";  // Interpretation of the VEX.W bit.
+  // do not use this value.
   VexPrefixEncodingSpecification* const vex_prefix =
       specification_.mutable_vex_prefix();
 
-  static const LazyRE2 vex_prefix_parser = {kVexPrefixRegexp};
-  string prefix_type_str;
-  string vex_operand_directionality;
-  string vex_l_usage_str;
-  string mandatory_prefix_str;
-  uint32_t opcode_map;
-  string vex_w_str;
-  if (!RE2::Consume(specification, *vex_prefix_parser, &prefix_type_str,
-                    &vex_operand_directionality, &vex_l_usage_str,
-                    &mandatory_prefix_str, RE2::Hex(&opcode_map), &vex_w_str)) {
+  StringPiece rest = *specification;
+  const int prefix_type_token = ConsumeFirstToken(&rest, kVexPrefixTypeTokens);
+  StringPiece field_values[kNumVexPrefixFields];
+  if (prefix_type_token < 0 ||
+      !MatchVexPrefixFields(0, rest, field_values, &rest)) {
     return InvalidArgumentError(StrCat("Could not parse the VEX prefix: '",
                                        specification->ToString(), "'"));
   }
+  *specification = rest;
 
   // Parse the fields of the VEX prefix specification.
-  // Note that we use the regexp to filter out invalid values of these fields,
-  // so FindOrDie never dies unless the regexp and the token definitions at the
+  // Note that the parser accepts only valid values of these fields, so the
+  // lookups never die unless the field tokens and the token definitions at the
   // top of this file are out of sync.
   const VexPrefixType prefix_type =
-      prefix_type_str == "EVEX" ? EVEX_PREFIX : VEX_PREFIX;
+      prefix_type_token == 0 ? EVEX_PREFIX : VEX_PREFIX;
   const VexVectorSize vector_size =
-      FindOrDie(vector_size_tokens_, vex_l_usage_str);
+      FindTokenOrDie(kVectorSizeTokenTable, field_values[kVectorSizeField]);
   vex_prefix->set_prefix_type(prefix_type);
-  vex_prefix->set_vex_operand_usage(
-      FindOrDie(vex_operand_usage_tokens_, vex_operand_directionality));
+  vex_prefix->set_vex_operand_usage(FindTokenOrDie(
+      kVexOperandUsageTokenTable, field_values[kVexOperandUsageField]));
   vex_prefix->set_vector_size(vector_size);
   if (vector_size == VEX_VECTOR_SIZE_512_BIT && prefix_type != EVEX_PREFIX) {
     return InvalidArgumentError(
         "The 512 bit vector size can be used only in an EVEX prefix");
   }
-  vex_prefix->set_mandatory_prefix(
-      FindOrDie(mandatory_prefix_tokens_, mandatory_prefix_str));
-  vex_prefix->set_vex_w_usage(FindOrDie(vex_w_usage_tokens_, vex_w_str));
-  vex_prefix->set_map_select(FindOrDie(map_select_tokens_, opcode_map));
+  vex_prefix->set_mandatory_prefix(FindTokenOrDie(
+      kMandatoryPrefixTokenTable, field_values[kMandatoryPrefixField]));
+  vex_prefix->set_vex_w_usage(
+      FindTokenOrDie(kVexWUsageTokenTable, field_values[kVexWUsageField]));
+  const uint32_t opcode_map = ParseOpcodeMap(field_values[kOpcodeMapField]);
+  vex_prefix->set_map_select(GetMapSelectOrDie(opcode_map));
 
   // NOTE(ondrasej): The string specification of the opcode map is an equivalent
   // of opcode prefixes in the legacy encoding, and not the actual value used in
@@ -309,25 +453,35 @@ Status EncodingSpecificationParser::ParseOpcodeAndSuffixes(
   // The ModR/M info and immediate values have a fixed position, but
   // both of these are easy to tell from each other, so we can just parse them
   // in a for loop.
-  static const LazyRE2 opcode_byte_parser = {
-      " *([0-9A-F]{2})(?: *\\+ *(i|rb|rw|rd|ro))?"};
-  int opcode_byte = 0;
   int num_opcode_bytes = 0;
-  string opcode_encoded_register;
   uint32_t opcode = specification_.opcode();
-  while (RE2::Consume(&specification, *opcode_byte_parser,
-                      RE2::Hex(&opcode_byte), &opcode_encoded_register)) {
+  while (true) {
+    StringPiece rest = specification;
+    ConsumeSpaces(&rest);
+    if (rest.size() < 2) break;
+    const int high_nibble = UppercaseHexDigitValue(rest[0]);
+    const int low_nibble = UppercaseHexDigitValue(rest[1]);
+    if (high_nibble < 0 || low_nibble < 0) break;
+    rest.remove_prefix(2);
     ++num_opcode_bytes;
-    opcode = (opcode << 8) | opcode_byte;
-    if (!opcode_encoded_register.empty()) {
-      if (opcode_encoded_register[0] == 'i') {
-        specification_.set_operand_in_opcode(
-            EncodingSpecification::FP_STACK_REGISTER_IN_OPCODE);
-      } else {
+    opcode = (opcode << 8) | (high_nibble << 4) | low_nibble;
+
+    // The opcode byte may be followed by "+ <register>" that specifies that
+    // the register operand is encoded in the three least significant bits of
+    // the opcode.
+    StringPiece encoded_register = rest;
+    if (ConsumeSeparator(&encoded_register, '+')) {
+      const int token =
+          ConsumeFirstToken(&encoded_register, kOpcodeEncodedRegisterTokens);
+      if (token >= 0) {
         specification_.set_operand_in_opcode(
-            EncodingSpecification::GENERAL_PURPOSE_REGISTER_IN_OPCODE);
+            token == 0
+                ? EncodingSpecification::FP_STACK_REGISTER_IN_OPCODE
+                : EncodingSpecification::GENERAL_PURPOSE_REGISTER_IN_OPCODE);
+        rest = encoded_register;
       }
     }
+    specification = rest;
   }
   specification_.set_opcode(opcode);
   if (num_opcode_bytes == 0) {
@@ -344,50 +498,21 @@ Status EncodingSpecificationParser::ParseOpcodeAndSuffixes(
   }
 
   VLOG(1) << "Parsing suffixes: " << specification;
-  // The variable that receives the value must be string. If we used chars
-  // directly, the matching would fail because RE2 doesn't know how to convert
-  // an empty matching group to a char.
-  string is4_suffix_str;
-  string modrm_suffix_str;
-  string vsib_suffix_str;
-  string immediate_value_size_str;
-  string code_offset_size_str;
-  // Notes on the suffix regexp:
-  // * There might be a m64/m128 suffix that is not explained in the Intel
-  //   manuals, but that most likely means that the operand in the ModR/M byte
-  //   must be a memory operand. In practice, I've never seen them without
-  //   another ModR/M suffix, so we just ignore them here.
-  static const LazyRE2 modrm_and_imm_parser = {
-      " *(?:"
-      "(\\/is4)|"   // is4
-      "i([bwdo])|"  // immediate
-      "/([r0-9])|"  // modrm
-      "(/vsib)|"    // vsib
-      "(?:m(?:64|128|256))|"
-      "c([bwdpot]))"};  // code offset size
-  while (RE2::Consume(&specification, *modrm_and_imm_parser, &is4_suffix_str,
-                      &immediate_value_size_str, &modrm_suffix_str,
-                      &vsib_suffix_str, &code_offset_size_str)) {
-    VLOG(1) << "modrm_suffix = " << modrm_suffix_str;
-    VLOG(1) << "immediate_value_size_str = " << immediate_value_size_str;
-    VLOG(1) << "code_offset_size = " << code_offset_size_str;
-    // Only one of the following if statements will actually be evaluated,
-    // because RE2 clears both strings at the beginning of the call to Consume.
-    if (!modrm_suffix_str.empty()) {
-      // If there was a ModR/M specifier, parse the usage of the MODRM.reg
-      // value.
-      const char modrm_suffix = modrm_suffix_str[0];
-      if (modrm_suffix == 'r') {
-        specification_.set_modrm_usage(EncodingSpecification::FULL_MODRM);
-      } else {
-        specification_.set_modrm_usage(
-            EncodingSpecification::OPCODE_EXTENSION_IN_MODRM);
-        specification_.set_modrm_opcode_extension(modrm_suffix - '0');
+  while (true) {
+    StringPiece rest = specification;
+    ConsumeSpaces(&rest);
+    if (ConsumePrefix(&rest, "/is4")) {
+      if (!specification_.has_vex_prefix()) {
+        return InvalidArgumentError(
+            "The VEX operand suffix /is4 is specified for an instruction that "
+            "does not use the VEX prefix.");
       }
-    } else if (!immediate_value_size_str.empty()) {
-      // If there was an immediate value specifier, parse the size of the
-      // immediate value.
-      switch (immediate_value_size_str[0]) {
+      specification_.mutable_vex_prefix()->set_has_vex_operand_suffix(true);
+    } else if (rest.size() >= 2 && rest[0] == 'i' &&
+               StringPiece("bwdo").find(rest[1]) != StringPiece::npos) {
+      // An immediate value specifier; parse the size of the immediate value.
+      VLOG(1) << "immediate_value_size = " << rest[1];
+      switch (rest[1]) {
         case 'b':
           specification_.add_immediate_value_bytes(1);
           break;
@@ -400,12 +525,36 @@ Status EncodingSpecificationParser::ParseOpcodeAndSuffixes(
         case 'o':
           specification_.add_immediate_value_bytes(8);
           break;
-        default:
-          return InvalidArgumentError(StrCat("Invalid immediate value size: ",
-                                             immediate_value_size_str));
       }
-    } else if (!code_offset_size_str.empty()) {
-      switch (code_offset_size_str[0]) {
+      rest.remove_prefix(2);
+    } else if (rest.size() >= 2 && rest[0] == '/' &&
+               (rest[1] == 'r' || (rest[1] >= '0' && rest[1] <= '9'))) {
+      // A ModR/M specifier; parse the usage of the MODRM.reg value.
+      const char modrm_suffix = rest[1];
+      VLOG(1) << "modrm_suffix = " << modrm_suffix;
+      if (modrm_suffix == 'r') {
+        specification_.set_modrm_usage(EncodingSpecification::FULL_MODRM);
+      } else {
+        specification_.set_modrm_usage(
+            EncodingSpecification::OPCODE_EXTENSION_IN_MODRM);
+        specification_.set_modrm_opcode_extension(modrm_suffix - '0');
+      }
+      rest.remove_prefix(2);
+    } else if (ConsumePrefix(&rest, "/vsib")) {
+      if (!specification_.has_vex_prefix()) {
+        return InvalidArgumentError(
+            "The VEX operand suffix /vsib is specified for an instruction that "
+            "does not use the VEX prefix.");
+      }
+      specification_.mutable_vex_prefix()->set_vsib_usage(
+          VexPrefixEncodingSpecification::VSIB_USED);
+    } else if (ConsumeFirstToken(&rest, kMemoryOperandSuffixTokens) >= 0) {
+      // The memory operand suffixes are ignored.
+    } else if (rest.size() >= 2 && rest[0] == 'c' &&
+               StringPiece("bwdpot").find(rest[1]) != StringPiece::npos) {
+      // A code offset specifier; parse the size of the code offset.
+      VLOG(1) << "code_offset_size = " << rest[1];
+      switch (rest[1]) {
         case 'b':
           specification_.set_code_offset_bytes(1);
           break;
@@ -424,28 +573,12 @@ Status EncodingSpecificationParser::ParseOpcodeAndSuffixes(
         case 't':
           specification_.set_code_offset_bytes(10);
           break;
-        default:
-          return InvalidArgumentError(
-              StrCat("Invalid code offset size: ", immediate_value_size_str));
-      }
-    } else if (!is4_suffix_str.empty()) {
-      CHECK_EQ("/is4", is4_suffix_str);
-      if (!specification_.has_vex_prefix()) {
-        return InvalidArgumentError(
-            "The VEX operand suffix /is4 is specified for an instruction that "
-            "does not use the VEX prefix.");
       }
-      specification_.mutable_vex_prefix()->set_has_vex_operand_suffix(true);
-    } else if (!vsib_suffix_str.empty()) {
-      CHECK_EQ("/vsib", vsib_suffix_str);
-      if (!specification_.has_vex_prefix()) {
-        return InvalidArgumentError(
-            "The VEX operand suffix /vsib is specified for an instruction that "
-            "does not use the VEX prefix.");
-      }
-      specification_.mutable_vex_prefix()->set_vsib_usage(
-          VexPrefixEncodingSpecification::VSIB_USED);
+      rest.remove_prefix(2);
+    } else {
+      break;
     }
+    specification = rest;
   }
 
   // VSIB implies that ModRM is used: ModRM.rm has to be 0b100, and ModRM.reg
@@ -0,0 +1,73 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Benchmarks for the encoding specification parser. Run with:
+//   bazel run -c opt //cpu_instructions/x86:encoding_specification_benchmark
+
+#include <fstream>
+#include <vector>
+#include "strings/string.h"
+
+#include "benchmark/benchmark.h"
+#include "cpu_instructions/x86/encoding_specification.h"
+#include "glog/logging.h"
+
+namespace cpu_instructions {
+namespace x86 {
+namespace {
+
+// The benchmark is run from the root of the runfiles tree.
+const char kCorpusPath[] =
+    "cpu_instructions/x86/testdata/encoding_specification_corpus.txt";
+
+// Reads the corpus of encoding specifications; one specification per line.
+// The corpus contains both valid and invalid specifications.
+std::vector<string> ReadCorpus() {
+  std::ifstream corpus_file(kCorpusPath);
+  CHECK(corpus_file.good()) << "Could not open " << kCorpusPath;
+  std::vector<string> corpus;
+  string line;
+  while (std::getline(corpus_file, line)) corpus.push_back(line);
+  return corpus;
+}
+
+void BM_ParseEncodingSpecificationCorpus(benchmark::State& state) {
+  const std::vector<string> corpus = ReadCorpus();
+  while (state.KeepRunning()) {
+    for (const string& specification : corpus) {
+      benchmark::DoNotOptimize(ParseEncodingSpecification(specification));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * corpus.size());
+}
+BENCHMARK(BM_ParseEncodingSpecificationCorpus);
+
+// The argument of the benchmark is the index of the specification in the list
+// below.
+void BM_ParseEncodingSpecification(benchmark::State& state) {
+  const std::vector<string> kSpecifications = {
+      "0F 1F /0", "REX.W + 8B /r", "66 0F 3A 0F /r ib",
+      "EVEX.NDS.512.66.0F.W1 58 /r", "VEX.256.66.0F38.W0 92 /vsib"};
+  const string& specification = kSpecifications[state.range(0)];
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(ParseEncodingSpecification(specification));
+  }
+}
+BENCHMARK(BM_ParseEncodingSpecification)->DenseRange(0, 4);
+
+}  // namespace
+}  // namespace x86
+}  // namespace cpu_instructions
+
+BENCHMARK_MAIN();
@@ -0,0 +1,64 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cpu_instructions/x86/encoding_specification_cache.h"
+
+#include <utility>
+
+#include "cpu_instructions/x86/encoding_specification.h"
+
+namespace cpu_instructions {
+namespace x86 {
+
+EncodingSpecificationCache::EncodingSpecificationCache()
+    : num_hits_(0), num_misses_(0) {}
+
+const StatusOr<EncodingSpecification>& EncodingSpecificationCache::Parse(
+    const string& specification) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto it = entries_.find(specification);
+    if (it != entries_.end()) {
+      ++num_hits_;
+      return it->second;
+    }
+  }
+  // Parse the specification without holding the lock, so that other threads
+  // can use the cache in the meantime.
+  StatusOr<EncodingSpecification> parsed_specification =
+      ParseEncodingSpecification(specification);
+  std::lock_guard<std::mutex> lock(mutex_);
+  const auto inserted =
+      entries_.emplace(specification, std::move(parsed_specification));
+  if (inserted.second) {
+    ++num_misses_;
+  } else {
+    ++num_hits_;
+  }
+  return inserted.first->second;
+}
+
+int EncodingSpecificationCache::size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return entries_.size();
+}
+
+EncodingSpecificationCache* GetGlobalEncodingSpecificationCache() {
+  static EncodingSpecificationCache* const cache =
+      new EncodingSpecificationCache();
+  return cache;
+}
+
+}  // namespace x86
+}  // namespace cpu_instructions
@@ -0,0 +1,88 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Contains a thread-safe cache of parsed instruction encoding specifications.
+// The same encoding specification strings are shared by many instructions in
+// the database, e.g. by the instructions created by AddAlternatives, and the
+// cache makes sure that each of them is parsed only once.
+
+#ifndef CPU_INSTRUCTIONS_X86_ENCODING_SPECIFICATION_CACHE_H_
+#define CPU_INSTRUCTIONS_X86_ENCODING_SPECIFICATION_CACHE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>  // NOLINT
+#include <unordered_map>
+#include "strings/string.h"
+
+#include "cpu_instructions/proto/x86/encoding_specification.pb.h"
+#include "util/task/statusor.h"
+
+namespace cpu_instructions {
+namespace x86 {
+
+using ::cpu_instructions::util::StatusOr;
+
+// A memoizing wrapper around ParseEncodingSpecification. All methods of the
+// class are thread-safe.
+//
+// Typical usage:
+// EncodingSpecificationCache* const cache =
+//     GetGlobalEncodingSpecificationCache();
+// const StatusOr<EncodingSpecification>& specification_or_status =
+//     cache->Parse("F3 0F AE /3");
+class EncodingSpecificationCache {
+ public:
+  EncodingSpecificationCache();
+
+  // Disallow copy and assign.
+  EncodingSpecificationCache(const EncodingSpecificationCache&) = delete;
+  EncodingSpecificationCache& operator=(const EncodingSpecificationCache&) =
+      delete;
+
+  // Returns the result of ParseEncodingSpecification(specification). The
+  // specification is parsed on the first request, and the result, including
+  // parsing errors, is returned for all following requests. The returned
+  // reference remains valid for the lifetime of the cache.
+  const StatusOr<EncodingSpecification>& Parse(const string& specification);
+
+  // The number of requests answered from the cache and the number of requests
+  // that added a new entry to the cache. When two threads parse the same
+  // specification at the same time, only the one that inserts the result to
+  // the cache is counted as a miss.
+  int64_t num_hits() const { return num_hits_.load(); }
+  int64_t num_misses() const { return num_misses_.load(); }
+
+  // Returns the number of distinct specifications in the cache.
+  int size() const;
+
+ private:
+  mutable std::mutex mutex_;
+  // The parsed specifications, indexed by their string representation.
+  // Elements of std::unordered_map are never moved, so references to them
+  // remain valid even when the map is rehashed.
+  std::unordered_map<string, StatusOr<EncodingSpecification>> entries_;
+
+  std::atomic<int64_t> num_hits_;
+  std::atomic<int64_t> num_misses_;
+};
+
+// Returns the process-wide cache used by the instruction set transforms and the
+// tools working with the instruction database. The cache is never destroyed.
+EncodingSpecificationCache* GetGlobalEncodingSpecificationCache();
+
+}  // namespace x86
+}  // namespace cpu_instructions
+
+#endif  // CPU_INSTRUCTIONS_X86_ENCODING_SPECIFICATION_CACHE_H_
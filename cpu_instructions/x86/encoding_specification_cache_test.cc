@@ -0,0 +1,101 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cpu_instructions/x86/encoding_specification_cache.h"
+
+#include <thread>  // NOLINT
+#include <vector>
+#include "strings/string.h"
+
+#include "cpu_instructions/testing/test_util.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "util/task/status.h"
+
+namespace cpu_instructions {
+namespace x86 {
+namespace {
+
+using ::cpu_instructions::testing::EqualsProto;
+
+TEST(EncodingSpecificationCacheTest, ParsesSpecification) {
+  EncodingSpecificationCache cache;
+  const StatusOr<EncodingSpecification>& specification_or_status =
+      cache.Parse("F3 0F AE /3");
+  ASSERT_OK(specification_or_status.status());
+  EXPECT_THAT(specification_or_status.ValueOrDie(),
+              EqualsProto(R"(legacy_prefixes {
+                               has_mandatory_repe_prefix: true }
+                             opcode: 0x0fae
+                             modrm_usage: OPCODE_EXTENSION_IN_MODRM
+                             modrm_opcode_extension: 3)"));
+  EXPECT_EQ(cache.num_hits(), 0);
+  EXPECT_EQ(cache.num_misses(), 1);
+  EXPECT_EQ(cache.size(), 1);
+}
+
+TEST(EncodingSpecificationCacheTest, ReturnsCachedSpecification) {
+  EncodingSpecificationCache cache;
+  const StatusOr<EncodingSpecification>* const first = &cache.Parse("0F 06");
+  cache.Parse("REX.W + 8B /r");
+  const StatusOr<EncodingSpecification>* const second = &cache.Parse("0F 06");
+  EXPECT_EQ(first, second);
+  EXPECT_EQ(cache.num_hits(), 1);
+  EXPECT_EQ(cache.num_misses(), 2);
+  EXPECT_EQ(cache.size(), 2);
+}
+
+TEST(EncodingSpecificationCacheTest, CachesErrors) {
+  EncodingSpecificationCache cache;
+  EXPECT_FALSE(cache.Parse("foo? bar!").ok());
+  EXPECT_FALSE(cache.Parse("foo? bar!").ok());
+  EXPECT_EQ(cache.num_hits(), 1);
+  EXPECT_EQ(cache.num_misses(), 1);
+}
+
+TEST(EncodingSpecificationCacheTest, MultipleThreads) {
+  constexpr int kNumThreads = 8;
+  constexpr int kNumRequestsPerThread = 1000;
+  const std::vector<string> kSpecifications = {
+      "0F 1F /0", "REX.W + 8B /r", "66 0F 3A 0F /r ib",
+      "EVEX.NDS.512.66.0F.W1 58 /r", "VEX.256.66.0F38.W0 92 /vsib", "invalid"};
+  EncodingSpecificationCache cache;
+  std::vector<std::thread> threads;
+  for (int thread = 0; thread < kNumThreads; ++thread) {
+    threads.emplace_back([&cache, &kSpecifications, thread]() {
+      for (int i = 0; i < kNumRequestsPerThread; ++i) {
+        const string& specification =
+            kSpecifications[(thread + i) % kSpecifications.size()];
+        EXPECT_EQ(cache.Parse(specification).ok(),
+                  specification != "invalid");
+      }
+    });
+  }
+  for (std::thread& thread : threads) thread.join();
+  EXPECT_EQ(cache.size(), kSpecifications.size());
+  EXPECT_EQ(cache.num_misses(), kSpecifications.size());
+  EXPECT_EQ(cache.num_hits() + cache.num_misses(),
+            kNumThreads * kNumRequestsPerThread);
+}
+
+TEST(EncodingSpecificationCacheTest, GlobalCache) {
+  EncodingSpecificationCache* const cache =
+      GetGlobalEncodingSpecificationCache();
+  ASSERT_NE(cache, nullptr);
+  EXPECT_EQ(cache, GetGlobalEncodingSpecificationCache());
+}
+
+}  // namespace
+}  // namespace x86
+}  // namespace cpu_instructions
@@ -0,0 +1,380 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// A differential test of the encoding specification parser. Compares the
+// results of ParseEncodingSpecification with a reference parser based on
+// regular expressions on a corpus of encoding specifications and on random
+// mutations of the specifications from the corpus.
+
+#include <cstdint>
+#include <random>
+#include <vector>
+#include "strings/string.h"
+
+#include "cpu_instructions/proto/x86/encoding_specification.pb.h"
+#include "cpu_instructions/x86/encoding_specification.h"
+#include "cpu_instructions/x86/encoding_specification_test_utils.h"
+#include "gtest/gtest.h"
+#include "re2/re2.h"
+#include "strings/str_cat.h"
+#include "util/task/canonical_errors.h"
+#include "util/task/status.h"
+#include "util/task/status_macros.h"
+#include "util/task/statusor.h"
+
+namespace cpu_instructions {
+namespace x86 {
+namespace {
+
+using ::cpu_instructions::util::FailedPreconditionError;
+using ::cpu_instructions::util::InvalidArgumentError;
+using ::cpu_instructions::util::OkStatus;
+using ::cpu_instructions::util::Status;
+using ::cpu_instructions::util::StatusOr;
+
+// The number of random mutations generated for each specification in the
+// corpus.
+constexpr int kNumMutationsPerSpecification = 200;
+
+// The error message used by the reference parser for inputs on which the
+// production parser dies. These inputs are excluded from the comparison.
+const char kParserDiesError[] = "The production parser dies on this input";
+
+// The reference implementation of the parser of the encoding specification
+// language, based on regular expressions. This is the implementation that was
+// used before the hand-written parser, and it defines the expected behavior.
+class ReferenceParser {
+ public:
+  // Parses 'specification_str'. Returns FailedPreconditionError with
+  // kParserDiesError when the production parser is expected to die.
+  StatusOr<EncodingSpecification> Parse(const string& specification_str);
+
+ private:
+  Status ParseLegacyPrefixes(re2::StringPiece* specification);
+  Status ParseVexOrEvexPrefix(re2::StringPiece* specification);
+  Status ParseOpcodeAndSuffixes(re2::StringPiece specification);
+
+  EncodingSpecification specification_;
+};
+
+StatusOr<EncodingSpecification> ReferenceParser::Parse(
+    const string& specification_str) {
+  re2::StringPiece specification(specification_str);
+  specification_.Clear();
+  if (specification.starts_with("VEX.") || specification.starts_with("EVEX")) {
+    RETURN_IF_ERROR(ParseVexOrEvexPrefix(&specification));
+  } else {
+    RETURN_IF_ERROR(ParseLegacyPrefixes(&specification));
+  }
+  RETURN_IF_ERROR(ParseOpcodeAndSuffixes(specification));
+  return specification_;
+}
+
+Status ReferenceParser::ParseLegacyPrefixes(re2::StringPiece* specification) {
+  static const LazyRE2 legacy_prefix_parser = {
+      " *(?:(66)|(67)|(F2)|(F3)|(REX(?:\\.(?:R|W))?))(?: *\\+ *)?"};
+  string operand_size_override_prefix;
+  string address_size_override_prefix;
+  string repne_prefix;
+  string repe_prefix;
+  string rex_prefix;
+  LegacyPrefixEncodingSpecification* const legacy_prefixes =
+      specification_.mutable_legacy_prefixes();
+  legacy_prefixes->set_has_mandatory_operand_size_override_prefix(false);
+  legacy_prefixes->set_has_mandatory_address_size_override_prefix(false);
+  legacy_prefixes->set_has_mandatory_repe_prefix(false);
+  legacy_prefixes->set_has_mandatory_repne_prefix(false);
+  legacy_prefixes->set_has_mandatory_rex_w_prefix(false);
+  while (RE2::Consume(specification, *legacy_prefix_parser,
+                      &operand_size_override_prefix,
+                      &address_size_override_prefix, &repne_prefix,
+                      &repe_prefix, &rex_prefix)) {
+    if (!operand_size_override_prefix.empty()) {
+      legacy_prefixes->set_has_mandatory_operand_size_override_prefix(true);
+    }
+    if (!address_size_override_prefix.empty()) {
+      legacy_prefixes->set_has_mandatory_address_size_override_prefix(true);
+    }
+    if (!repe_prefix.empty()) {
+      legacy_prefixes->set_has_mandatory_repe_prefix(true);
+    }
+    if (!repne_prefix.empty()) {
+      legacy_prefixes->set_has_mandatory_repne_prefix(true);
+    }
+    if (!rex_prefix.empty()) {
+      legacy_prefixes->set_has_mandatory_rex_w_prefix(true);
+    }
+  }
+  return OkStatus();
+}
+
+Status ReferenceParser::ParseVexOrEvexPrefix(re2::StringPiece* specification) {
+  static const LazyRE2 vex_prefix_parser = {
+      "(E?VEX)"
+      "(?: *\\. *(NDS|NDD|DDS))?"
+      "(?: *\\. *(LIG|LZ|L0|L1|LIG\\.128|128|256|512))?"
+      "(?: *\\. *(66|F2|F3))?"
+      " *\\. *(0F|0F3A|0F38)"
+      "(?: *\\. *(W0|W1|WIG))? "};
+  string prefix_type_str;
+  string vex_operand_directionality;
+  string vex_l_usage_str;
+  string mandatory_prefix_str;
+  uint32_t opcode_map;
+  string vex_w_str;
+  if (!RE2::Consume(specification, *vex_prefix_parser, &prefix_type_str,
+                    &vex_operand_directionality, &vex_l_usage_str,
+                    &mandatory_prefix_str, RE2::Hex(&opcode_map), &vex_w_str)) {
+    return InvalidArgumentError(StrCat("Could not parse the VEX prefix: '",
+                                       specification->ToString(), "'"));
+  }
+  VexPrefixEncodingSpecification* const vex_prefix =
+      specification_.mutable_vex_prefix();
+  const VexPrefixType prefix_type =
+      prefix_type_str == "EVEX" ? EVEX_PREFIX : VEX_PREFIX;
+  vex_prefix->set_prefix_type(prefix_type);
+
+  if (vex_operand_directionality.empty()) {
+    vex_prefix->set_vex_operand_usage(NO_VEX_OPERAND_USAGE);
+  } else if (vex_operand_directionality == "NDS") {
+    vex_prefix->set_vex_operand_usage(VEX_OPERAND_IS_FIRST_SOURCE_REGISTER);
+  } else if (vex_operand_directionality == "NDD") {
+    vex_prefix->set_vex_operand_usage(VEX_OPERAND_IS_DESTINATION_REGISTER);
+  } else {
+    vex_prefix->set_vex_operand_usage(VEX_OPERAND_IS_SECOND_SOURCE_REGISTER);
+  }
+
+  // The production parser does not have a value for the missing vector size,
+  // and it dies when looking it up.
+  if (vex_l_usage_str.empty()) return FailedPreconditionError(kParserDiesError);
+  VexVectorSize vector_size = VEX_VECTOR_SIZE_IS_IGNORED;
+  if (vex_l_usage_str == "LZ" || vex_l_usage_str == "L0") {
+    vector_size = VEX_VECTOR_SIZE_BIT_IS_ZERO;
+  } else if (vex_l_usage_str == "L1") {
+    vector_size = VEX_VECTOR_SIZE_BIT_IS_ONE;
+  } else if (vex_l_usage_str == "128" || vex_l_usage_str == "LIG.128") {
+    vector_size = VEX_VECTOR_SIZE_128_BIT;
+  } else if (vex_l_usage_str == "256") {
+    vector_size = VEX_VECTOR_SIZE_256_BIT;
+  } else if (vex_l_usage_str == "512") {
+    vector_size = VEX_VECTOR_SIZE_512_BIT;
+  }
+  vex_prefix->set_vector_size(vector_size);
+  if (vector_size == VEX_VECTOR_SIZE_512_BIT && prefix_type != EVEX_PREFIX) {
+    return InvalidArgumentError(
+        "The 512 bit vector size can be used only in an EVEX prefix");
+  }
+
+  if (mandatory_prefix_str.empty()) {
+    vex_prefix->set_mandatory_prefix(VexEncoding::NO_MANDATORY_PREFIX);
+  } else if (mandatory_prefix_str == "66") {
+    vex_prefix->set_mandatory_prefix(
+        VexEncoding::MANDATORY_PREFIX_OPERAND_SIZE_OVERRIDE);
+  } else if (mandatory_prefix_str == "F2") {
+    vex_prefix->set_mandatory_prefix(VexEncoding::MANDATORY_PREFIX_REPNE);
+  } else {
+    vex_prefix->set_mandatory_prefix(VexEncoding::MANDATORY_PREFIX_REPE);
+  }
+
+  if (vex_w_str == "W0") {
+    vex_prefix->set_vex_w_usage(VexPrefixEncodingSpecification::VEX_W_IS_ZERO);
+  } else if (vex_w_str == "W1") {
+    vex_prefix->set_vex_w_usage(VexPrefixEncodingSpecification::VEX_W_IS_ONE);
+  } else {
+    vex_prefix->set_vex_w_usage(
+        VexPrefixEncodingSpecification::VEX_W_IS_IGNORED);
+  }
+
+  switch (opcode_map) {
+    case 0x0f:
+      vex_prefix->set_map_select(VexEncoding::MAP_SELECT_0F);
+      break;
+    case 0x0f3a:
+      vex_prefix->set_map_select(VexEncoding::MAP_SELECT_0F3A);
+      break;
+    default:
+      vex_prefix->set_map_select(VexEncoding::MAP_SELECT_0F38);
+      break;
+  }
+  specification_.set_opcode(opcode_map);
+  return OkStatus();
+}
+
+Status ReferenceParser::ParseOpcodeAndSuffixes(
+    re2::StringPiece specification) {
+  static const LazyRE2 opcode_byte_parser = {
+      " *([0-9A-F]{2})(?: *\\+ *(i|rb|rw|rd|ro))?"};
+  int opcode_byte = 0;
+  int num_opcode_bytes = 0;
+  string opcode_encoded_register;
+  uint32_t opcode = specification_.opcode();
+  while (RE2::Consume(&specification, *opcode_byte_parser,
+                      RE2::Hex(&opcode_byte), &opcode_encoded_register)) {
+    ++num_opcode_bytes;
+    opcode = (opcode << 8) | opcode_byte;
+    if (!opcode_encoded_register.empty()) {
+      specification_.set_operand_in_opcode(
+          opcode_encoded_register[0] == 'i'
+              ? EncodingSpecification::FP_STACK_REGISTER_IN_OPCODE
+              : EncodingSpecification::GENERAL_PURPOSE_REGISTER_IN_OPCODE);
+    }
+  }
+  specification_.set_opcode(opcode);
+  if (num_opcode_bytes == 0) {
+    return InvalidArgumentError("The instruction did not have an opcode byte.");
+  }
+  if (specification_.has_vex_prefix() && num_opcode_bytes != 1) {
+    return InvalidArgumentError(
+        "Unexpected number of opcode bytes in a VEX-encoded instruction.");
+  }
+  if (specification.empty()) return OkStatus();
+
+  static const LazyRE2 modrm_and_imm_parser = {
+      " *(?:(\\/is4)|i([bwdo])|/([r0-9])|(/vsib)|(?:m(?:64|128|256))|"
+      "c([bwdpot]))"};
+  string is4_suffix_str;
+  string modrm_suffix_str;
+  string vsib_suffix_str;
+  string immediate_value_size_str;
+  string code_offset_size_str;
+  while (RE2::Consume(&specification, *modrm_and_imm_parser, &is4_suffix_str,
+                      &immediate_value_size_str, &modrm_suffix_str,
+                      &vsib_suffix_str, &code_offset_size_str)) {
+    if (!modrm_suffix_str.empty()) {
+      if (modrm_suffix_str[0] == 'r') {
+        specification_.set_modrm_usage(EncodingSpecification::FULL_MODRM);
+      } else {
+        specification_.set_modrm_usage(
+            EncodingSpecification::OPCODE_EXTENSION_IN_MODRM);
+        specification_.set_modrm_opcode_extension(modrm_suffix_str[0] - '0');
+      }
+    } else if (!immediate_value_size_str.empty()) {
+      switch (immediate_value_size_str[0]) {
+        case 'b':
+          specification_.add_immediate_value_bytes(1);
+          break;
+        case 'w':
+          specification_.add_immediate_value_bytes(2);
+          break;
+        case 'd':
+          specification_.add_immediate_value_bytes(4);
+          break;
+        case 'o':
+          specification_.add_immediate_value_bytes(8);
+          break;
+      }
+    } else if (!code_offset_size_str.empty()) {
+      switch (code_offset_size_str[0]) {
+        case 'b':
+          specification_.set_code_offset_bytes(1);
+          break;
+        case 'w':
+          specification_.set_code_offset_bytes(2);
+          break;
+        case 'd':
+          specification_.set_code_offset_bytes(4);
+          break;
+        case 'p':
+          specification_.set_code_offset_bytes(6);
+          break;
+        case 'o':
+          specification_.set_code_offset_bytes(8);
+          break;
+        case 't':
+          specification_.set_code_offset_bytes(10);
+          break;
+      }
+    } else if (!is4_suffix_str.empty()) {
+      if (!specification_.has_vex_prefix()) {
+        return InvalidArgumentError(
+            "The VEX operand suffix /is4 is specified for an instruction that "
+            "does not use the VEX prefix.");
+      }
+      specification_.mutable_vex_prefix()->set_has_vex_operand_suffix(true);
+    } else if (!vsib_suffix_str.empty()) {
+      if (!specification_.has_vex_prefix()) {
+        return InvalidArgumentError(
+            "The VEX operand suffix /vsib is specified for an instruction that "
+            "does not use the VEX prefix.");
+      }
+      specification_.mutable_vex_prefix()->set_vsib_usage(
+          VexPrefixEncodingSpecification::VSIB_USED);
+    }
+  }
+  if (specification_.vex_prefix().vsib_usage() ==
+          VexPrefixEncodingSpecification::VSIB_USED &&
+      specification_.modrm_usage() == EncodingSpecification::NO_MODRM_USAGE) {
+    specification_.set_modrm_usage(EncodingSpecification::FULL_MODRM);
+  }
+  while (specification.starts_with(" ") || specification.starts_with("+")) {
+    specification.remove_prefix(1);
+  }
+  return specification.empty() ? OkStatus()
+                               : InvalidArgumentError(StrCat(
+                                     "The specification was not fully parsed: ",
+                                     specification.ToString()));
+}
+
+// Parses 'specification' with both parsers, and checks that the results are
+// the same. Returns true if the specification was compared, and false if it
+// was skipped because the production parser dies on it.
+bool ExpectSameResults(const string& specification) {
+  ReferenceParser reference_parser;
+  const StatusOr<EncodingSpecification> expected =
+      reference_parser.Parse(specification);
+  if (!expected.ok() && expected.status().error_message() == kParserDiesError) {
+    return false;
+  }
+  const StatusOr<EncodingSpecification> actual =
+      ParseEncodingSpecification(specification);
+  EXPECT_EQ(expected.ok(), actual.ok()) << "'" << specification << "'";
+  if (expected.ok() && actual.ok()) {
+    EXPECT_EQ(expected.ValueOrDie().DebugString(),
+              actual.ValueOrDie().DebugString())
+        << "'" << specification << "'";
+  } else if (!expected.ok() && !actual.ok()) {
+    EXPECT_EQ(expected.status(), actual.status())
+        << "'" << specification << "'";
+  }
+  return true;
+}
+
+TEST(EncodingSpecificationFuzzTest, Corpus) {
+  const std::vector<string> corpus = ReadEncodingSpecificationCorpus();
+  int num_compared = 0;
+  for (const string& specification : corpus) {
+    if (ExpectSameResults(specification)) ++num_compared;
+  }
+  EXPECT_GT(num_compared, 0);
+}
+
+TEST(EncodingSpecificationFuzzTest, Mutations) {
+  const std::vector<string> corpus = ReadEncodingSpecificationCorpus();
+  // Use a fixed seed, so that the test is deterministic.
+  std::mt19937 rng(20170101);
+  int num_compared = 0;
+  for (const string& specification : corpus) {
+    for (int i = 0; i < kNumMutationsPerSpecification; ++i) {
+      if (ExpectSameResults(
+              MutateEncodingSpecification(corpus, specification, &rng))) {
+        ++num_compared;
+      }
+    }
+  }
+  EXPECT_GT(num_compared, 0);
+}
+
+}  // namespace
+}  // namespace x86
+}  // namespace cpu_instructions
@@ -0,0 +1,584 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Contains a compile-time parser of the instruction encoding specification
+// language, and the user-defined literal "..."_enc that turns an encoding
+// specification into a PackedEncoding.
+//
+// The parser accepts exactly the same language as ParseEncodingSpecification,
+// and it produces the packed version of the proto returned by that function.
+// When the literal is used to initialize a constexpr variable, an invalid
+// encoding specification is a compilation error:
+//
+// constexpr PackedEncoding kLss = "0F B2 /r"_enc;     // OK.
+// constexpr PackedEncoding kTypo = "0F B2 /rr"_enc;   // Does not compile.
+//
+// When an invalid literal is evaluated at runtime, the program is aborted.
+// Note that the specifications for which ParseEncodingSpecification dies (VEX
+// prefixes without the L field) are rejected by the literal.
+//
+// The parser is written in the C++11 subset of constexpr functions, i.e. each
+// function consists of a single return statement and loops are expressed as
+// recursion.
+
+#ifndef CPU_INSTRUCTIONS_X86_ENCODING_SPECIFICATION_LITERAL_H_
+#define CPU_INSTRUCTIONS_X86_ENCODING_SPECIFICATION_LITERAL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <cstdlib>
+
+#include "cpu_instructions/proto/x86/encoding_specification.pb.h"
+#include "cpu_instructions/proto/x86/instruction_encoding.pb.h"
+#include "cpu_instructions/x86/packed_encoding.h"
+
+namespace cpu_instructions {
+namespace x86 {
+namespace encoding_literal_internal {
+
+// The state of the parser: the parsed text, the position of the first
+// character that was not consumed yet, and the encoding parsed so far.
+struct ParserState {
+  const char* text;
+  size_t size;
+  size_t position;
+  bool ok;
+  PackedEncoding encoding;
+};
+
+constexpr size_t kNoMatch = static_cast<size_t>(-1);
+
+constexpr ParserState MoveTo(const ParserState& state, size_t position) {
+  return ParserState{state.text, state.size, position, state.ok,
+                     state.encoding};
+}
+
+constexpr ParserState SetField(const ParserState& state,
+                               PackedEncoding::Field field, uint64_t value) {
+  return ParserState{state.text, state.size, state.position, state.ok,
+                     state.encoding.With(field, value)};
+}
+
+constexpr ParserState Fail(const ParserState& state) {
+  return ParserState{state.text, state.size, state.position, false,
+                     state.encoding};
+}
+
+// Returns the character at 'position' or '\0' if 'position' is out of range.
+constexpr char CharAt(const ParserState& state, size_t position) {
+  return position < state.size ? state.text[position] : '\0';
+}
+
+constexpr size_t TokenLength(const char* token) {
+  return *token == '\0' ? 0 : 1 + TokenLength(token + 1);
+}
+
+constexpr bool StartsWith(const ParserState& state, size_t position,
+                          const char* token) {
+  return *token == '\0' ||
+         (CharAt(state, position) == *token &&
+          StartsWith(state, position + 1, token + 1));
+}
+
+constexpr size_t SkipSpaces(const ParserState& state, size_t position) {
+  return CharAt(state, position) == ' ' ? SkipSpaces(state, position + 1)
+                                        : position;
+}
+
+// Returns the position after the regexp " *<separator> *" that starts at
+// 'position', or kNoMatch if the text at 'position' does not match it.
+constexpr size_t SkipSeparatorAt(const ParserState& state, size_t position,
+                                 char separator) {
+  return CharAt(state, position) == separator
+             ? SkipSpaces(state, position + 1)
+             : kNoMatch;
+}
+constexpr size_t SkipSeparator(const ParserState& state, size_t position,
+                               char separator) {
+  return SkipSeparatorAt(state, SkipSpaces(state, position), separator);
+}
+
+// Returns the index of the first token from 'tokens' that starts at
+// 'position', or -1 if there is no such token.
+constexpr int FindFirstToken(const ParserState& state, size_t position,
+                             const char* const* tokens, int num_tokens,
+                             int index = 0) {
+  return index >= num_tokens ? -1
+         : StartsWith(state, position, tokens[index])
+             ? index
+             : FindFirstToken(state, position, tokens, num_tokens, index + 1);
+}
+
+constexpr int UppercaseHexDigitValue(char c) {
+  return c >= '0' && c <= '9' ? c - '0' : c >= 'A' && c <= 'F' ? c - 'A' + 10
+                                                               : -1;
+}
+
+// Legacy prefixes. The tokens are tried in this order, so the longer forms of
+// the REX prefix must be listed before the plain REX.
+constexpr const char* kLegacyPrefixTokens[] = {"66",    "67",    "F2", "F3",
+                                               "REX.R", "REX.W", "REX"};
+constexpr PackedEncoding::Field kLegacyPrefixFields[] = {
+    PackedEncoding::kHasMandatoryOperandSizeOverridePrefix,
+    PackedEncoding::kHasMandatoryAddressSizeOverridePrefix,
+    PackedEncoding::kHasMandatoryRepnePrefix,
+    PackedEncoding::kHasMandatoryRepePrefix,
+    PackedEncoding::kHasMandatoryRexWPrefix,
+    PackedEncoding::kHasMandatoryRexWPrefix,
+    PackedEncoding::kHasMandatoryRexWPrefix};
+constexpr int kNumLegacyPrefixTokens = 7;
+
+constexpr ParserState ParseLegacyPrefixes(const ParserState& state);
+
+// Consumes the optional " *\+ *" after a legacy prefix.
+constexpr ParserState SkipLegacyPrefixSeparator(const ParserState& state,
+                                                size_t separator_end) {
+  return separator_end == kNoMatch ? state : MoveTo(state, separator_end);
+}
+
+constexpr ParserState ParseLegacyPrefix(const ParserState& state,
+                                        size_t token_position, int token) {
+  return token < 0
+             ? state
+             : ParseLegacyPrefixes(SkipLegacyPrefixSeparator(
+                   MoveTo(SetField(state, kLegacyPrefixFields[token], 1),
+                          token_position +
+                              TokenLength(kLegacyPrefixTokens[token])),
+                   SkipSeparator(state,
+                                 token_position +
+                                     TokenLength(kLegacyPrefixTokens[token]),
+                                 '+')));
+}
+
+constexpr ParserState ParseLegacyPrefixesAt(const ParserState& state,
+                                            size_t token_position) {
+  return ParseLegacyPrefix(
+      state, token_position,
+      FindFirstToken(state, token_position, kLegacyPrefixTokens,
+                     kNumLegacyPrefixTokens));
+}
+
+constexpr ParserState ParseLegacyPrefixes(const ParserState& state) {
+  return ParseLegacyPrefixesAt(state, SkipSpaces(state, state.position));
+}
+
+// The fields of the VEX prefix, and their tokens in the order in which they
+// are tried. The values of the fields are in the same order as the tokens;
+// the value at index 0 is used when an optional field is not present.
+enum VexPrefixFieldIndex {
+  kVexOperandUsageField,
+  kVectorSizeField,
+  kMandatoryPrefixField,
+  kOpcodeMapField,
+  kVexWUsageField,
+  kNumVexPrefixFields
+};
+constexpr const char* kVexOperandUsageFieldTokens[] = {"NDS", "NDD", "DDS"};
+constexpr const char* kVectorSizeFieldTokens[] = {
+    "LIG", "LZ", "L0", "L1", "LIG.128", "128", "256", "512"};
+constexpr const char* kMandatoryPrefixFieldTokens[] = {"66", "F2", "F3"};
+constexpr const char* kOpcodeMapFieldTokens[] = {"0F", "0F3A", "0F38"};
+constexpr const char* kVexWUsageFieldTokens[] = {"W0", "W1", "WIG"};
+
+constexpr VexOperandUsage kVexOperandUsageValues[] = {
+    NO_VEX_OPERAND_USAGE, VEX_OPERAND_IS_FIRST_SOURCE_REGISTER,
+    VEX_OPERAND_IS_DESTINATION_REGISTER, VEX_OPERAND_IS_SECOND_SOURCE_REGISTER};
+constexpr VexVectorSize kVectorSizeValues[] = {
+    VEX_VECTOR_SIZE_IS_IGNORED,  VEX_VECTOR_SIZE_IS_IGNORED,
+    VEX_VECTOR_SIZE_BIT_IS_ZERO, VEX_VECTOR_SIZE_BIT_IS_ZERO,
+    VEX_VECTOR_SIZE_BIT_IS_ONE,  VEX_VECTOR_SIZE_128_BIT,
+    VEX_VECTOR_SIZE_128_BIT,     VEX_VECTOR_SIZE_256_BIT,
+    VEX_VECTOR_SIZE_512_BIT};
+constexpr VexEncoding::MandatoryPrefix kMandatoryPrefixValues[] = {
+    VexEncoding::NO_MANDATORY_PREFIX,
+    VexEncoding::MANDATORY_PREFIX_OPERAND_SIZE_OVERRIDE,
+    VexEncoding::MANDATORY_PREFIX_REPNE, VexEncoding::MANDATORY_PREFIX_REPE};
+constexpr VexEncoding::MapSelect kMapSelectValues[] = {
+    VexEncoding::UNDEFINED_OPERAND_MAP, VexEncoding::MAP_SELECT_0F,
+    VexEncoding::MAP_SELECT_0F3A, VexEncoding::MAP_SELECT_0F38};
+constexpr uint32_t kOpcodeMapValues[] = {0, 0x0f, 0x0f3a, 0x0f38};
+constexpr VexPrefixEncodingSpecification::VexWUsage kVexWUsageValues[] = {
+    VexPrefixEncodingSpecification::VEX_W_IS_IGNORED,
+    VexPrefixEncodingSpecification::VEX_W_IS_ZERO,
+    VexPrefixEncodingSpecification::VEX_W_IS_ONE,
+    VexPrefixEncodingSpecification::VEX_W_IS_IGNORED};
+
+constexpr const char* const* VexFieldTokens(int field) {
+  return field == kVexOperandUsageField   ? kVexOperandUsageFieldTokens
+         : field == kVectorSizeField      ? kVectorSizeFieldTokens
+         : field == kMandatoryPrefixField ? kMandatoryPrefixFieldTokens
+         : field == kOpcodeMapField       ? kOpcodeMapFieldTokens
+                                          : kVexWUsageFieldTokens;
+}
+constexpr int VexFieldNumTokens(int field) {
+  return field == kVectorSizeField ? 8 : 3;
+}
+
+// The result of matching the VEX prefix fields. 'choices' contains four bits
+// for each field: 0 when the field is not present, or the index of the token
+// plus one.
+struct VexMatch {
+  bool ok;
+  size_t end;
+  uint32_t choices;
+};
+
+constexpr VexMatch AddVexFieldChoice(const VexMatch& match, int field,
+                                     int token) {
+  return VexMatch{match.ok, match.end,
+                  match.choices | (static_cast<uint32_t>(token + 1)
+                                   << (4 * field))};
+}
+
+constexpr int VexFieldChoice(const VexMatch& match, int field) {
+  return (match.choices >> (4 * field)) & 0xf;
+}
+
+constexpr VexMatch MatchVexFields(const ParserState& state, int field,
+                                  size_t position);
+
+// Matches the field 'field' when none of the tokens starting with 'token'
+// matched; this is possible only for optional fields.
+constexpr VexMatch SkipVexField(const ParserState& state, int field,
+                                size_t position) {
+  return field == kOpcodeMapField ? VexMatch{false, 0, 0}
+                                  : MatchVexFields(state, field + 1, position);
+}
+
+constexpr VexMatch MatchVexFieldToken(const ParserState& state, int field,
+                                      size_t position, size_t token_position,
+                                      int token);
+
+constexpr VexMatch AcceptVexFieldTokenOrBacktrack(
+    const VexMatch& rest_match, const ParserState& state, int field,
+    size_t position, size_t token_position, int token) {
+  return rest_match.ok ? AddVexFieldChoice(rest_match, field, token)
+                       : MatchVexFieldToken(state, field, position,
+                                            token_position, token + 1);
+}
+
+constexpr VexMatch MatchVexFieldToken(const ParserState& state, int field,
+                                      size_t position, size_t token_position,
+                                      int token) {
+  return token_position == kNoMatch || token >= VexFieldNumTokens(field)
+             ? SkipVexField(state, field, position)
+         : !StartsWith(state, token_position, VexFieldTokens(field)[token])
+             ? MatchVexFieldToken(state, field, position, token_position,
+                                  token + 1)
+             : AcceptVexFieldTokenOrBacktrack(
+                   MatchVexFields(
+                       state, field + 1,
+                       token_position +
+                           TokenLength(VexFieldTokens(field)[token])),
+                   state, field, position, token_position, token);
+}
+
+// Matches the fields of the VEX prefix starting with 'field'. Each field is
+// preceded by a dot, and the last field must be followed by a space.
+constexpr VexMatch MatchVexFields(const ParserState& state, int field,
+                                  size_t position) {
+  return field == kNumVexPrefixFields
+             ? (CharAt(state, position) == ' '
+                    ? VexMatch{true, position + 1, 0}
+                    : VexMatch{false, 0, 0})
+             : MatchVexFieldToken(state, field, position,
+                                  SkipSeparator(state, position, '.'), 0);
+}
+
+constexpr ParserState ApplyVexFields(const ParserState& state,
+                                     VexPrefixType prefix_type,
+                                     const VexMatch& match) {
+  return !match.ok || VexFieldChoice(match, kVectorSizeField) == 0 ||
+                 (prefix_type != EVEX_PREFIX &&
+                  kVectorSizeValues[VexFieldChoice(match, kVectorSizeField)] ==
+                      VEX_VECTOR_SIZE_512_BIT)
+             ? Fail(state)
+             : ParserState{
+                   state.text, state.size, match.end, state.ok,
+                   state.encoding
+                       .With(PackedEncoding::kPrefixKind,
+                             PackedEncoding::kVexPrefix)
+                       .With(PackedEncoding::kVexPrefixType, prefix_type)
+                       .With(PackedEncoding::kVexOperandUsage,
+                             kVexOperandUsageValues[VexFieldChoice(
+                                 match, kVexOperandUsageField)])
+                       .With(PackedEncoding::kVexVectorSize,
+                             kVectorSizeValues[VexFieldChoice(
+                                 match, kVectorSizeField)])
+                       .With(PackedEncoding::kVexMandatoryPrefix,
+                             kMandatoryPrefixValues[VexFieldChoice(
+                                 match, kMandatoryPrefixField)])
+                       .With(PackedEncoding::kVexMapSelect,
+                             kMapSelectValues[VexFieldChoice(
+                                 match, kOpcodeMapField)])
+                       .With(PackedEncoding::kVexWUsage,
+                             kVexWUsageValues[VexFieldChoice(
+                                 match, kVexWUsageField)])
+                       .With(PackedEncoding::kOpcode,
+                             kOpcodeMapValues[VexFieldChoice(
+                                 match, kOpcodeMapField)])};
+}
+
+constexpr ParserState ParseVexPrefix(const ParserState& state) {
+  return StartsWith(state, 0, "EVEX")
+             ? ApplyVexFields(state, EVEX_PREFIX,
+                              MatchVexFields(state, 0, TokenLength("EVEX")))
+         : StartsWith(state, 0, "VEX")
+             ? ApplyVexFields(state, VEX_PREFIX,
+                              MatchVexFields(state, 0, TokenLength("VEX")))
+             : Fail(state);
+}
+
+constexpr bool IsVexEncoding(const ParserState& state) {
+  return state.encoding.prefix_kind() == PackedEncoding::kVexPrefix;
+}
+
+// The opcode bytes and the registers encoded in them.
+constexpr const char* kOpcodeEncodedRegisterTokens[] = {"i", "rb", "rw", "rd",
+                                                        "ro"};
+constexpr int kNumOpcodeEncodedRegisterTokens = 5;
+constexpr EncodingSpecification::OperandInOpcode kOperandInOpcodeValues[] = {
+    EncodingSpecification::FP_STACK_REGISTER_IN_OPCODE,
+    EncodingSpecification::GENERAL_PURPOSE_REGISTER_IN_OPCODE,
+    EncodingSpecification::GENERAL_PURPOSE_REGISTER_IN_OPCODE,
+    EncodingSpecification::GENERAL_PURPOSE_REGISTER_IN_OPCODE,
+    EncodingSpecification::GENERAL_PURPOSE_REGISTER_IN_OPCODE};
+
+constexpr bool IsOpcodeByteAt(const ParserState& state, size_t position) {
+  return UppercaseHexDigitValue(CharAt(state, position)) >= 0 &&
+         UppercaseHexDigitValue(CharAt(state, position + 1)) >= 0;
+}
+
+constexpr ParserState AddOpcodeByte(const ParserState& state,
+                                    size_t position) {
+  return MoveTo(
+      SetField(state, PackedEncoding::kOpcode,
+               (static_cast<uint64_t>(state.encoding.opcode()) << 8) |
+                   (UppercaseHexDigitValue(CharAt(state, position)) << 4) |
+                   UppercaseHexDigitValue(CharAt(state, position + 1))),
+      position + 2);
+}
+
+constexpr ParserState SetOpcodeEncodedRegister(const ParserState& state,
+                                               size_t token_position,
+                                               int token) {
+  return token < 0
+             ? state
+             : MoveTo(SetField(state, PackedEncoding::kOperandInOpcode,
+                               kOperandInOpcodeValues[token]),
+                      token_position +
+                          TokenLength(kOpcodeEncodedRegisterTokens[token]));
+}
+
+constexpr ParserState ParseOpcodeEncodedRegisterAt(const ParserState& state,
+                                                   size_t token_position) {
+  return token_position == kNoMatch
+             ? state
+             : SetOpcodeEncodedRegister(
+                   state, token_position,
+                   FindFirstToken(state, token_position,
+                                  kOpcodeEncodedRegisterTokens,
+                                  kNumOpcodeEncodedRegisterTokens));
+}
+
+constexpr ParserState ParseOpcodeEncodedRegister(const ParserState& state) {
+  return ParseOpcodeEncodedRegisterAt(
+      state, SkipSeparator(state, state.position, '+'));
+}
+
+// The suffixes of the specification.
+constexpr const char* kMemoryOperandSuffixTokens[] = {"m64", "m128", "m256"};
+constexpr int kNumMemoryOperandSuffixTokens = 3;
+
+constexpr int ImmediateValueBytes(char c) {
+  return c == 'b' ? 1 : c == 'w' ? 2 : c == 'd' ? 4 : c == 'o' ? 8 : 0;
+}
+
+constexpr int CodeOffsetBytes(char c) {
+  return c == 'b'   ? 1
+         : c == 'w' ? 2
+         : c == 'd' ? 4
+         : c == 'p' ? 6
+         : c == 'o' ? 8
+         : c == 't' ? 10
+                    : 0;
+}
+
+constexpr PackedEncoding::Field ImmediateValueBytesField(int index) {
+  return index == 0   ? PackedEncoding::kImmediateValueBytes0
+         : index == 1 ? PackedEncoding::kImmediateValueBytes1
+                      : PackedEncoding::kImmediateValueBytes2;
+}
+
+// Adds an immediate value. The packed encoding can hold at most
+// PackedEncoding::kMaxNumImmediateValues immediate values; specifications with
+// more immediate values are rejected.
+constexpr ParserState AddImmediateValue(const ParserState& state,
+                                        int num_bytes) {
+  return state.encoding.Get(PackedEncoding::kNumImmediateValues) >=
+                 PackedEncoding::kMaxNumImmediateValues
+             ? Fail(state)
+             : SetField(
+                   SetField(state,
+                            ImmediateValueBytesField(state.encoding.Get(
+                                PackedEncoding::kNumImmediateValues)),
+                            num_bytes),
+                   PackedEncoding::kNumImmediateValues,
+                   state.encoding.Get(PackedEncoding::kNumImmediateValues) + 1);
+}
+
+constexpr ParserState SetModRmUsage(const ParserState& state, char suffix) {
+  return suffix == 'r'
+             ? SetField(state, PackedEncoding::kModRmUsage,
+                        EncodingSpecification::FULL_MODRM)
+             : SetField(SetField(state, PackedEncoding::kModRmUsage,
+                                 EncodingSpecification::
+                                     OPCODE_EXTENSION_IN_MODRM),
+                        PackedEncoding::kModRmOpcodeExtension, suffix - '0');
+}
+
+constexpr size_t SkipWhitespace(const ParserState& state, size_t position) {
+  return CharAt(state, position) == ' ' || CharAt(state, position) == '+'
+             ? SkipWhitespace(state, position + 1)
+             : position;
+}
+
+// VSIB implies that ModRM is used. The specification must be fully consumed,
+// except for the trailing whitespace.
+constexpr ParserState FinishSuffixes(const ParserState& state) {
+  return SkipWhitespace(state, state.position) != state.size
+             ? Fail(state)
+         : state.encoding.Get(PackedEncoding::kVsibUsage) ==
+                       VexPrefixEncodingSpecification::VSIB_USED &&
+                   state.encoding.Get(PackedEncoding::kModRmUsage) ==
+                       EncodingSpecification::NO_MODRM_USAGE
+             ? SetField(state, PackedEncoding::kModRmUsage,
+                        EncodingSpecification::FULL_MODRM)
+             : state;
+}
+
+constexpr ParserState ParseSuffixes(const ParserState& state);
+
+constexpr ParserState ParseSuffixAt(const ParserState& state,
+                                    size_t position) {
+  return !state.ok ? state
+         : StartsWith(state, position, "/is4")
+             ? (IsVexEncoding(state)
+                    ? ParseSuffixes(MoveTo(
+                          SetField(state, PackedEncoding::kHasVexOperandSuffix,
+                                   1),
+                          position + 4))
+                    : Fail(state))
+         : CharAt(state, position) == 'i' &&
+                 ImmediateValueBytes(CharAt(state, position + 1)) > 0
+             ? ParseSuffixes(MoveTo(
+                   AddImmediateValue(
+                       state, ImmediateValueBytes(CharAt(state, position + 1))),
+                   position + 2))
+         : CharAt(state, position) == '/' &&
+                 (CharAt(state, position + 1) == 'r' ||
+                  (CharAt(state, position + 1) >= '0' &&
+                   CharAt(state, position + 1) <= '9'))
+             ? ParseSuffixes(MoveTo(
+                   SetModRmUsage(state, CharAt(state, position + 1)),
+                   position + 2))
+         : StartsWith(state, position, "/vsib")
+             ? (IsVexEncoding(state)
+                    ? ParseSuffixes(MoveTo(
+                          SetField(state, PackedEncoding::kVsibUsage,
+                                   VexPrefixEncodingSpecification::VSIB_USED),
+                          position + 5))
+                    : Fail(state))
+         : FindFirstToken(state, position, kMemoryOperandSuffixTokens,
+                          kNumMemoryOperandSuffixTokens) >= 0
+             ? ParseSuffixes(MoveTo(
+                   state,
+                   position +
+                       TokenLength(kMemoryOperandSuffixTokens[FindFirstToken(
+                           state, position, kMemoryOperandSuffixTokens,
+                           kNumMemoryOperandSuffixTokens)])))
+         : CharAt(state, position) == 'c' &&
+                 CodeOffsetBytes(CharAt(state, position + 1)) > 0
+             ? ParseSuffixes(MoveTo(
+                   SetField(state, PackedEncoding::kCodeOffsetBytes,
+                            CodeOffsetBytes(CharAt(state, position + 1))),
+                   position + 2))
+             : FinishSuffixes(state);
+}
+
+constexpr ParserState ParseSuffixes(const ParserState& state) {
+  return ParseSuffixAt(state, SkipSpaces(state, state.position));
+}
+
+constexpr ParserState FinishOpcode(const ParserState& state,
+                                   int num_opcode_bytes) {
+  return num_opcode_bytes == 0 ||
+                 (IsVexEncoding(state) && num_opcode_bytes != 1)
+             ? Fail(state)
+         : state.position == state.size ? state
+                                        : ParseSuffixes(state);
+}
+
+constexpr ParserState ParseOpcodeBytes(const ParserState& state,
+                                       int num_opcode_bytes) {
+  return IsOpcodeByteAt(state, SkipSpaces(state, state.position))
+             ? ParseOpcodeBytes(
+                   ParseOpcodeEncodedRegister(AddOpcodeByte(
+                       state, SkipSpaces(state, state.position))),
+                   num_opcode_bytes + 1)
+             : FinishOpcode(state, num_opcode_bytes);
+}
+
+constexpr ParserState ParseOpcodeAndSuffixes(const ParserState& state) {
+  return state.ok ? ParseOpcodeBytes(state, 0) : state;
+}
+
+// Parses 'text' and returns the final state of the parser. The parsing
+// succeeded if and only if the 'ok' field of the returned state is true.
+constexpr ParserState ParseEncodingSpecificationLiteral(const char* text,
+                                                        size_t size) {
+  return ParseOpcodeAndSuffixes(
+      StartsWith(ParserState{text, size, 0, true, PackedEncoding()}, 0,
+                 "VEX.") ||
+              StartsWith(ParserState{text, size, 0, true, PackedEncoding()},
+                         0, "EVEX")
+          ? ParseVexPrefix(ParserState{text, size, 0, true, PackedEncoding()})
+          : ParseLegacyPrefixes(ParserState{
+                text, size, 0, true,
+                PackedEncoding().With(PackedEncoding::kPrefixKind,
+                                      PackedEncoding::kLegacyPrefixes)}));
+}
+
+// Called when the literal is not a valid encoding specification. This function
+// is not constexpr, so calling it during the initialization of a constexpr
+// variable is a compilation error.
+inline PackedEncoding InvalidEncodingSpecificationLiteral() { abort(); }
+
+constexpr PackedEncoding GetEncodingOrDie(const ParserState& state) {
+  return state.ok ? state.encoding : InvalidEncodingSpecificationLiteral();
+}
+
+}  // namespace encoding_literal_internal
+
+// Parses the encoding specification at compile time and returns its packed
+// encoding. See the comment at the top of this file for more details.
+constexpr PackedEncoding operator"" _enc(const char* text, size_t size) {
+  return encoding_literal_internal::GetEncodingOrDie(
+      encoding_literal_internal::ParseEncodingSpecificationLiteral(text, size));
+}
+
+}  // namespace x86
+}  // namespace cpu_instructions
+
+#endif  // CPU_INSTRUCTIONS_X86_ENCODING_SPECIFICATION_LITERAL_H_
@@ -0,0 +1,147 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cpu_instructions/x86/encoding_specification_literal.h"
+
+#include <random>
+#include <vector>
+#include "strings/string.h"
+
+#include "cpu_instructions/proto/x86/encoding_specification.pb.h"
+#include "cpu_instructions/x86/encoding_specification.h"
+#include "cpu_instructions/x86/encoding_specification_test_utils.h"
+#include "cpu_instructions/x86/packed_encoding.h"
+#include "gtest/gtest.h"
+#include "strings/str_cat.h"
+#include "util/task/statusor.h"
+
+namespace cpu_instructions {
+namespace x86 {
+namespace {
+
+using ::cpu_instructions::util::StatusOr;
+using encoding_literal_internal::ParseEncodingSpecificationLiteral;
+using encoding_literal_internal::ParserState;
+
+// The number of random mutations generated for each specification in the
+// corpus.
+constexpr int kNumMutationsPerSpecification = 20;
+
+// The literals are parsed at compile time; the checks below are evaluated by
+// the compiler.
+constexpr PackedEncoding kLss = "0F B2 /r"_enc;
+static_assert(kLss.opcode() == 0x0fb2, "Unexpected opcode");
+static_assert(kLss.prefix_kind() == PackedEncoding::kLegacyPrefixes,
+              "Unexpected prefix kind");
+static_assert(kLss.Get(PackedEncoding::kModRmUsage) ==
+                  EncodingSpecification::FULL_MODRM,
+              "Unexpected ModR/M usage");
+
+constexpr PackedEncoding kMovRexW = "REX.W + B8+ rd io"_enc;
+static_assert(kMovRexW.opcode() == 0xb8, "Unexpected opcode");
+static_assert(kMovRexW.Get(PackedEncoding::kHasMandatoryRexWPrefix) == 1,
+              "Unexpected REX.W prefix");
+static_assert(kMovRexW.Get(PackedEncoding::kOperandInOpcode) ==
+                  EncodingSpecification::GENERAL_PURPOSE_REGISTER_IN_OPCODE,
+              "Unexpected operand in opcode");
+static_assert(kMovRexW.Get(PackedEncoding::kNumImmediateValues) == 1 &&
+                  kMovRexW.Get(PackedEncoding::kImmediateValueBytes0) == 8,
+              "Unexpected immediate value");
+
+constexpr PackedEncoding kVGatherDps = "VEX.DDS.128.66.0F38.W0 92 /r"_enc;
+static_assert(kVGatherDps.opcode() == 0x0f3892, "Unexpected opcode");
+static_assert(kVGatherDps.prefix_kind() == PackedEncoding::kVexPrefix,
+              "Unexpected prefix kind");
+static_assert(kVGatherDps.Get(PackedEncoding::kVexOperandUsage) ==
+                  VEX_OPERAND_IS_SECOND_SOURCE_REGISTER,
+              "Unexpected VEX operand usage");
+
+static_assert(
+    !ParseEncodingSpecificationLiteral("0F B2 /rr", 9).ok,
+    "An invalid specification was accepted");
+static_assert(
+    !ParseEncodingSpecificationLiteral("VEX.NDS.66.0F 58 /r", 19).ok,
+    "A VEX specification without the L field was accepted");
+
+bool IsVexSpecification(const string& specification) {
+  return specification.compare(0, 3, "VEX") == 0 ||
+         specification.compare(0, 4, "EVEX") == 0;
+}
+
+// Checks that the literal parser returns the same encoding as
+// ParseEncodingSpecification followed by PackedEncoding::FromProto. The
+// runtime parser is not used on VEX specifications rejected by the literal
+// parser, because it dies on some of them.
+void ExpectSameEncoding(const string& specification) {
+  SCOPED_TRACE(StrCat("specification = \"", specification, "\""));
+  const ParserState state = ParseEncodingSpecificationLiteral(
+      specification.data(), specification.size());
+  if (!state.ok && IsVexSpecification(specification)) return;
+  const StatusOr<EncodingSpecification> proto =
+      ParseEncodingSpecification(specification);
+  if (!proto.ok()) {
+    EXPECT_FALSE(state.ok);
+    return;
+  }
+  const StatusOr<PackedEncoding> expected =
+      PackedEncoding::FromProto(proto.ValueOrDie());
+  ASSERT_EQ(expected.ok(), state.ok);
+  if (state.ok) {
+    EXPECT_EQ(expected.ValueOrDie().encoding_bits(),
+              state.encoding.encoding_bits());
+    EXPECT_EQ(expected.ValueOrDie().prefix_bits(),
+              state.encoding.prefix_bits());
+  }
+}
+
+TEST(EncodingSpecificationLiteralTest, Corpus) {
+  for (const string& specification : ReadEncodingSpecificationCorpus()) {
+    ExpectSameEncoding(specification);
+  }
+}
+
+TEST(EncodingSpecificationLiteralTest, Mutations) {
+  const std::vector<string> corpus = ReadEncodingSpecificationCorpus();
+  // Use a fixed seed, so that the test is deterministic.
+  std::mt19937 rng(20170102);
+  for (const string& specification : corpus) {
+    for (int i = 0; i < kNumMutationsPerSpecification; ++i) {
+      ExpectSameEncoding(
+          MutateEncodingSpecification(corpus, specification, &rng));
+    }
+  }
+}
+
+TEST(EncodingSpecificationLiteralTest, LiteralEvaluatedAtRuntime) {
+  const string specification = "66 0F 3A 0F /r ib";
+  EXPECT_EQ(
+      PackedEncoding::FromProto(
+          ParseEncodingSpecification(specification).ValueOrDie())
+          .ValueOrDie(),
+      "66 0F 3A 0F /r ib"_enc);
+}
+
+TEST(EncodingSpecificationLiteralDeathTest, InvalidLiteralAtRuntime) {
+  // The literal is not used to initialize a constexpr variable, so the error
+  // is detected at runtime.
+  const char* const kInvalidSpecification = "0F /q";
+  EXPECT_DEATH(
+      encoding_literal_internal::GetEncodingOrDie(
+          ParseEncodingSpecificationLiteral(kInvalidSpecification, 5)),
+      "");
+}
+
+}  // namespace
+}  // namespace x86
+}  // namespace cpu_instructions
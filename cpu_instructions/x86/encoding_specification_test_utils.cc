@@ -0,0 +1,86 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cpu_instructions/x86/encoding_specification_test_utils.h"
+
+#include <stddef.h>
+#include <cstdlib>
+#include <fstream>
+
+#include "glog/logging.h"
+#include "strings/str_cat.h"
+
+namespace cpu_instructions {
+namespace x86 {
+namespace {
+
+const char kTestDataPath[] = "/__main__/cpu_instructions/x86/testdata/";
+const char kCorpusFileName[] = "encoding_specification_corpus.txt";
+
+}  // namespace
+
+std::vector<string> ReadEncodingSpecificationCorpus() {
+  const char* const test_srcdir = getenv("TEST_SRCDIR");
+  CHECK(test_srcdir != nullptr) << "TEST_SRCDIR is not set";
+  const string path = StrCat(test_srcdir, kTestDataPath, kCorpusFileName);
+  std::ifstream corpus_file(path);
+  CHECK(corpus_file.good()) << "Could not open " << path;
+  std::vector<string> corpus;
+  string line;
+  while (std::getline(corpus_file, line)) corpus.push_back(line);
+  CHECK(!corpus.empty());
+  return corpus;
+}
+
+string MutateEncodingSpecification(const std::vector<string>& corpus,
+                                   const string& specification,
+                                   std::mt19937* rng) {
+  CHECK(rng != nullptr);
+  CHECK(!corpus.empty());
+  static constexpr char kAlphabet[] = " .+/0123456789ABCDEFLNRSVWXZcdimoprtwb";
+  std::uniform_int_distribution<int> alphabet_distribution(
+      0, sizeof(kAlphabet) - 2);
+  string mutated = specification;
+  const int num_edits = std::uniform_int_distribution<int>(1, 3)(*rng);
+  for (int edit = 0; edit < num_edits; ++edit) {
+    const size_t position =
+        std::uniform_int_distribution<size_t>(0, mutated.size())(*rng);
+    switch (std::uniform_int_distribution<int>(0, 3)(*rng)) {
+      case 0:  // Delete a character.
+        if (position < mutated.size()) mutated.erase(position, 1);
+        break;
+      case 1:  // Insert a character.
+        mutated.insert(position, 1, kAlphabet[alphabet_distribution(*rng)]);
+        break;
+      case 2:  // Replace a character.
+        if (position < mutated.size()) {
+          mutated[position] = kAlphabet[alphabet_distribution(*rng)];
+        }
+        break;
+      case 3: {  // Splice with a suffix of another specification.
+        const string& other = corpus[std::uniform_int_distribution<size_t>(
+            0, corpus.size() - 1)(*rng)];
+        const size_t other_position =
+            std::uniform_int_distribution<size_t>(0, other.size())(*rng);
+        mutated = StrCat(mutated.substr(0, position),
+                         other.substr(other_position));
+        break;
+      }
+    }
+  }
+  return mutated;
+}
+
+}  // namespace x86
+}  // namespace cpu_instructions
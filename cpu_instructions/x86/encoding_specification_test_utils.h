@@ -0,0 +1,49 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Contains helper functions for the tests of the parsers of the encoding
+// specification language: reading the corpus of encoding specifications and
+// creating random mutations of the specifications.
+
+#ifndef CPU_INSTRUCTIONS_X86_ENCODING_SPECIFICATION_TEST_UTILS_H_
+#define CPU_INSTRUCTIONS_X86_ENCODING_SPECIFICATION_TEST_UTILS_H_
+
+#include <random>
+#include <vector>
+#include "strings/string.h"
+
+namespace cpu_instructions {
+namespace x86 {
+
+// Reads the corpus of encoding specifications from the test data; one
+// specification per line. The corpus contains both valid and invalid
+// specifications. The test must have
+// "testdata/encoding_specification_corpus.txt" in its data. Dies if the corpus
+// can't be read or if it is empty.
+std::vector<string> ReadEncodingSpecificationCorpus();
+
+// Returns a random mutation of 'specification'. The mutation consists of one
+// to three edits, where an edit deletes, inserts or replaces a character, or
+// splices the specification with a suffix of another specification from
+// 'corpus'. The mutations use characters that are significant for the encoding
+// specification language, so that the mutated specifications exercise the
+// parsers beyond the first character.
+string MutateEncodingSpecification(const std::vector<string>& corpus,
+                                   const string& specification,
+                                   std::mt19937* rng);
+
+}  // namespace x86
+}  // namespace cpu_instructions
+
+#endif  // CPU_INSTRUCTIONS_X86_ENCODING_SPECIFICATION_TEST_UTILS_H_
@@ -0,0 +1,477 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// The decoding tables have one row for each opcode in each opcode map; rows
+// with the same contents are shared. A row contains one byte for each
+// combination of the reg field of the ModR/M byte and of the prefix state, at
+// the index (reg << 5) | prefix_state. Each byte contains:
+//  * kIsValid: the opcode is valid with this prefix state and reg field,
+//  * kHasModRm: the instruction has a ModR/M byte; this bit is the same for all
+//    values of the reg field, so that it can be read before the ModR/M byte,
+//  * the number of bytes of the immediate values and code offsets.
+// The prefix state is a combination of PrefixBits.
+
+#include "cpu_instructions/x86/instruction_length_decoder.h"
+
+#include <algorithm>
+#include <map>
+#include "strings/string.h"
+
+#include "cpu_instructions/proto/x86/encoding_specification.pb.h"
+#include "cpu_instructions/x86/encoding_specification_cache.h"
+#include "glog/logging.h"
+#include "strings/str_cat.h"
+#include "util/task/canonical_errors.h"
+#include "util/task/status.h"
+
+namespace cpu_instructions {
+namespace x86 {
+namespace {
+
+using ::cpu_instructions::util::InvalidArgumentError;
+using ::cpu_instructions::util::OkStatus;
+using ::cpu_instructions::util::Status;
+
+using DecoderRow = std::array<uint8_t, 256>;
+
+// The opcode maps. The legacy, VEX and EVEX versions of the maps have separate
+// tables.
+enum OpcodeMap {
+  kLegacyOneByteMap,
+  kLegacy0FMap,
+  kLegacy0F38Map,
+  kLegacy0F3AMap,
+  kVex0FMap,
+  kVex0F38Map,
+  kVex0F3AMap,
+  kEvex0FMap,
+  kEvex0F38Map,
+  kEvex0F3AMap,
+  kNumOpcodeMaps
+};
+
+// The distance between the legacy and the VEX (resp. EVEX) versions of an
+// opcode map.
+constexpr int kVexMapOffset = kVex0FMap - kLegacy0FMap;
+constexpr int kEvexMapOffset = kEvex0FMap - kLegacy0FMap;
+
+// The bits of the prefix state. For VEX and EVEX instructions, the mandatory
+// prefix and the W bit of the prefix are mapped to the bits of the
+// corresponding legacy prefixes.
+enum PrefixBits {
+  kOperandSizeOverride = 1,
+  kRexW = 2,
+  kRepe = 4,
+  kRepne = 8,
+  kAddressSizeOverride = 16,
+};
+constexpr int kNumPrefixStates = 32;
+
+// The bits of the entries of the decoding tables.
+enum EntryBits {
+  kTrailingBytesMask = 0x3f,
+  kHasModRm = 0x40,
+  kIsValid = 0x80,
+};
+
+// The kinds of the bytes that may precede the opcode.
+enum PrefixKind {
+  kNotAPrefix,
+  kLegacyPrefix,
+  kRexPrefix,
+};
+
+// The prefix state bits for the values of the pp field of the VEX and EVEX
+// prefixes.
+constexpr int kVexPpPrefixBits[] = {0, kOperandSizeOverride, kRepe, kRepne};
+
+// The VEX maps for the values of the map select field of the VEX and EVEX
+// prefixes; -1 marks the values that are not used.
+constexpr int kVexMapSelectMaps[] = {-1, kLegacy0FMap, kLegacy0F38Map,
+                                     kLegacy0F3AMap};
+
+inline PrefixKind GetPrefixKind(uint8_t byte) {
+  switch (byte) {
+    case 0x26:
+    case 0x2e:
+    case 0x36:
+    case 0x3e:
+    case 0x64:
+    case 0x65:
+    case 0x66:
+    case 0x67:
+    case 0xf0:
+    case 0xf2:
+    case 0xf3:
+      return kLegacyPrefix;
+    default:
+      return (byte & 0xf0) == 0x40 ? kRexPrefix : kNotAPrefix;
+  }
+}
+
+// Returns the prefix state after the legacy prefix 'byte'. The segment
+// override and lock prefixes do not change the state; of the REPE and REPNE
+// prefixes, the last one wins.
+inline int UpdatePrefixState(int prefix_state, uint8_t byte) {
+  switch (byte) {
+    case 0x66:
+      return prefix_state | kOperandSizeOverride;
+    case 0x67:
+      return prefix_state | kAddressSizeOverride;
+    case 0xf2:
+      return (prefix_state & ~kRepe) | kRepne;
+    case 0xf3:
+      return (prefix_state & ~kRepne) | kRepe;
+    default:
+      return prefix_state;
+  }
+}
+
+// The information needed to decode one instruction from the database.
+struct OpcodeVariant {
+  // The prefix state bits that must be present.
+  int required_prefixes = 0;
+  // The value of the reg field of the ModR/M byte required by the instruction,
+  // or -1 if the instruction accepts any value.
+  int modrm_reg = -1;
+  bool has_modrm = false;
+  // The number of bytes of the immediate values and code offsets.
+  int trailing_bytes = 0;
+};
+
+// Returns the specificity of the variant; when more variants match the
+// prefixes of an instruction, the one with the highest specificity is used.
+// REX.W has precedence over the operand size override prefix.
+int GetSpecificity(const OpcodeVariant& variant) {
+  int specificity = 0;
+  for (int bit = 1; bit < kNumPrefixStates; bit <<= 1) {
+    if (variant.required_prefixes & bit) ++specificity;
+  }
+  if (variant.required_prefixes & kRexW) ++specificity;
+  return specificity;
+}
+
+// Returns the prefix state bits required by 'specification'.
+int GetRequiredPrefixes(const EncodingSpecification& specification) {
+  int required_prefixes = 0;
+  if (specification.has_vex_prefix()) {
+    const VexPrefixEncodingSpecification& vex_prefix =
+        specification.vex_prefix();
+    required_prefixes |= kVexPpPrefixBits[vex_prefix.mandatory_prefix() & 3];
+    if (vex_prefix.vex_w_usage() ==
+        VexPrefixEncodingSpecification::VEX_W_IS_ONE) {
+      required_prefixes |= kRexW;
+    }
+    return required_prefixes;
+  }
+  const LegacyPrefixEncodingSpecification& legacy_prefixes =
+      specification.legacy_prefixes();
+  if (legacy_prefixes.has_mandatory_operand_size_override_prefix()) {
+    required_prefixes |= kOperandSizeOverride;
+  }
+  if (legacy_prefixes.has_mandatory_rex_w_prefix()) required_prefixes |= kRexW;
+  if (legacy_prefixes.has_mandatory_repe_prefix()) required_prefixes |= kRepe;
+  if (legacy_prefixes.has_mandatory_repne_prefix()) required_prefixes |= kRepne;
+  if (legacy_prefixes.has_mandatory_address_size_override_prefix()) {
+    required_prefixes |= kAddressSizeOverride;
+  }
+  return required_prefixes;
+}
+
+// Adds the variants of the instruction described by 'specification' to
+// 'variants', indexed by the opcode map and the opcode byte.
+Status AddOpcodeVariants(const EncodingSpecification& specification,
+                         std::vector<std::vector<OpcodeVariant>>* variants) {
+  CHECK(variants != nullptr);
+  std::vector<uint8_t> opcode_bytes;
+  uint32_t opcode = specification.opcode();
+  do {
+    opcode_bytes.insert(opcode_bytes.begin(), opcode & 0xff);
+    opcode >>= 8;
+  } while (opcode != 0);
+  // The FWAIT instruction in front of some x87 instructions is decoded as a
+  // separate instruction.
+  if (opcode_bytes.size() > 1 && opcode_bytes[0] == 0x9b) {
+    opcode_bytes.erase(opcode_bytes.begin());
+  }
+
+  int map = kLegacyOneByteMap;
+  int map_bytes = 0;
+  if (opcode_bytes.size() > 1 && opcode_bytes[0] == 0x0f) {
+    if (opcode_bytes.size() > 2 && opcode_bytes[1] == 0x38) {
+      map = kLegacy0F38Map;
+      map_bytes = 2;
+    } else if (opcode_bytes.size() > 2 && opcode_bytes[1] == 0x3a) {
+      map = kLegacy0F3AMap;
+      map_bytes = 2;
+    } else {
+      map = kLegacy0FMap;
+      map_bytes = 1;
+    }
+  }
+  if (specification.has_vex_prefix()) {
+    if (map == kLegacyOneByteMap) {
+      return InvalidArgumentError(
+          StrCat("The opcode of a VEX instruction does not specify a map: ",
+                 specification.opcode()));
+    }
+    map += specification.vex_prefix().prefix_type() == EVEX_PREFIX
+               ? kEvexMapOffset
+               : kVexMapOffset;
+  }
+
+  OpcodeVariant variant;
+  variant.required_prefixes = GetRequiredPrefixes(specification);
+  variant.has_modrm = specification.modrm_usage() !=
+                      EncodingSpecification::NO_MODRM_USAGE;
+  if (specification.modrm_usage() ==
+      EncodingSpecification::OPCODE_EXTENSION_IN_MODRM) {
+    variant.modrm_reg = specification.modrm_opcode_extension() & 7;
+  }
+  for (const uint32_t immediate_value_bytes :
+       specification.immediate_value_bytes()) {
+    variant.trailing_bytes += immediate_value_bytes;
+  }
+  variant.trailing_bytes += specification.code_offset_bytes();
+  if (specification.vex_prefix().has_vex_operand_suffix()) {
+    // The register operand is encoded in the upper bits of an 8-bit immediate
+    // value.
+    ++variant.trailing_bytes;
+  }
+
+  // The bytes that follow the primary opcode byte are decoded as a ModR/M byte
+  // with a fixed value, and possibly more immediate bytes.
+  const int primary_opcode = opcode_bytes[map_bytes];
+  const int num_fixed_bytes = opcode_bytes.size() - map_bytes - 1;
+  if (num_fixed_bytes > 0) {
+    variant.has_modrm = true;
+    variant.modrm_reg = (opcode_bytes[map_bytes + 1] >> 3) & 7;
+    variant.trailing_bytes += num_fixed_bytes - 1;
+  }
+  if (variant.trailing_bytes > kTrailingBytesMask) {
+    return InvalidArgumentError(
+        StrCat("Too many immediate bytes: ", variant.trailing_bytes));
+  }
+
+  // When the opcode encodes a register, the instruction uses eight opcodes.
+  const bool has_operand_in_opcode =
+      specification.operand_in_opcode() !=
+          EncodingSpecification::NO_OPERAND_IN_OPCODE &&
+      num_fixed_bytes == 0;
+  const int num_opcodes = has_operand_in_opcode ? 8 : 1;
+  if (primary_opcode + num_opcodes > 256) {
+    return InvalidArgumentError(
+        StrCat("Invalid register in opcode: ", specification.opcode()));
+  }
+  for (int i = 0; i < num_opcodes; ++i) {
+    (*variants)[map * 256 + primary_opcode + i].push_back(variant);
+  }
+  return OkStatus();
+}
+
+// Builds the row of the decoding tables for an opcode with the given variants.
+DecoderRow BuildRow(const std::vector<OpcodeVariant>& variants) {
+  DecoderRow row;
+  row.fill(0);
+  for (int prefix_state = 0; prefix_state < kNumPrefixStates;
+       ++prefix_state) {
+    bool has_modrm = false;
+    for (int reg = 0; reg < 8; ++reg) {
+      const OpcodeVariant* best_variant = nullptr;
+      int best_specificity = -1;
+      for (const OpcodeVariant& variant : variants) {
+        if ((prefix_state & variant.required_prefixes) !=
+                variant.required_prefixes ||
+            (variant.modrm_reg >= 0 && variant.modrm_reg != reg)) {
+          continue;
+        }
+        const int specificity = GetSpecificity(variant);
+        if (specificity > best_specificity) {
+          best_variant = &variant;
+          best_specificity = specificity;
+        }
+      }
+      if (best_variant == nullptr) continue;
+      has_modrm |= best_variant->has_modrm;
+      row[(reg << 5) | prefix_state] =
+          kIsValid | best_variant->trailing_bytes;
+    }
+    if (has_modrm) {
+      for (int reg = 0; reg < 8; ++reg) {
+        row[(reg << 5) | prefix_state] |= kHasModRm;
+      }
+    }
+  }
+  return row;
+}
+
+}  // namespace
+
+constexpr int InstructionLengthDecoder::kMaxInstructionLength;
+
+InstructionLengthDecoder::InstructionLengthDecoder()
+    : row_indices_(kNumOpcodeMaps * 256, 0), rows_(1) {
+  rows_[0].fill(0);
+}
+
+StatusOr<InstructionLengthDecoder> InstructionLengthDecoder::Create(
+    const InstructionSetProto& instruction_set) {
+  std::vector<std::vector<OpcodeVariant>> variants(kNumOpcodeMaps * 256);
+  for (const InstructionProto& instruction : instruction_set.instructions()) {
+    if (!instruction.available_in_64_bit()) continue;
+    EncodingSpecification specification;
+    if (instruction.has_x86_encoding_specification()) {
+      specification = instruction.x86_encoding_specification();
+    } else {
+      const StatusOr<EncodingSpecification>& parsed_specification =
+          GetGlobalEncodingSpecificationCache()->Parse(
+              instruction.raw_encoding_specification());
+      if (!parsed_specification.ok()) return parsed_specification.status();
+      specification = parsed_specification.ValueOrDie();
+    }
+    const Status status = AddOpcodeVariants(specification, &variants);
+    if (!status.ok()) {
+      return InvalidArgumentError(
+          StrCat(status.error_message(), "\nInstruction: ",
+                 instruction.raw_encoding_specification()));
+    }
+  }
+
+  InstructionLengthDecoder decoder;
+  std::map<DecoderRow, uint16_t> row_index_by_contents;
+  row_index_by_contents[decoder.rows_[0]] = 0;
+  for (size_t i = 0; i < variants.size(); ++i) {
+    if (variants[i].empty()) continue;
+    const DecoderRow row = BuildRow(variants[i]);
+    const auto inserted =
+        row_index_by_contents.insert(std::make_pair(row, decoder.rows_.size()));
+    if (inserted.second) decoder.rows_.push_back(row);
+    decoder.row_indices_[i] = inserted.first->second;
+  }
+  VLOG(1) << "Number of rows of the decoding tables: " << decoder.rows_.size();
+  return decoder;
+}
+
+int InstructionLengthDecoder::GetInstructionLength(const uint8_t* code,
+                                                   size_t size) const {
+  const size_t max_length =
+      std::min(size, static_cast<size_t>(kMaxInstructionLength));
+  size_t position = 0;
+  int prefix_state = 0;
+  bool has_rex_w = false;
+
+  // The legacy prefixes and the REX prefix. The REX prefix is ignored unless it
+  // immediately precedes the opcode.
+  for (;; ++position) {
+    if (position >= max_length) return 0;
+    const uint8_t byte = code[position];
+    const PrefixKind prefix_kind = GetPrefixKind(byte);
+    if (prefix_kind == kNotAPrefix) break;
+    if (prefix_kind == kRexPrefix) {
+      has_rex_w = (byte & 0x08) != 0;
+    } else {
+      has_rex_w = false;
+      prefix_state = UpdatePrefixState(prefix_state, byte);
+    }
+  }
+  if (has_rex_w) prefix_state |= kRexW;
+
+  // The opcode map. In 64-bit mode, C4, C5 and 62 always start a VEX or an
+  // EVEX prefix. The mandatory prefixes and REX.W are taken from the VEX or
+  // EVEX prefix; the address size override prefix is kept.
+  int map = kLegacyOneByteMap;
+  switch (code[position]) {
+    case 0xc5:
+      if (position + 2 >= max_length) return 0;
+      map = kVex0FMap;
+      prefix_state = (prefix_state & kAddressSizeOverride) |
+                     kVexPpPrefixBits[code[position + 1] & 3];
+      position += 2;
+      break;
+    case 0xc4:
+    case 0x62: {
+      const bool is_evex = code[position] == 0x62;
+      const int prefix_size = is_evex ? 4 : 3;
+      if (position + prefix_size >= max_length) return 0;
+      const int map_select =
+          code[position + 1] & (is_evex ? 0x03 : 0x1f);
+      if (map_select > 3 || kVexMapSelectMaps[map_select] < 0) return 0;
+      map = kVexMapSelectMaps[map_select] +
+            (is_evex ? kEvexMapOffset : kVexMapOffset);
+      const uint8_t w_vvvv_pp = code[position + 2];
+      prefix_state = (prefix_state & kAddressSizeOverride) |
+                     kVexPpPrefixBits[w_vvvv_pp & 3] |
+                     ((w_vvvv_pp & 0x80) ? kRexW : 0);
+      position += prefix_size;
+      break;
+    }
+    case 0x0f:
+      if (position + 1 >= max_length) return 0;
+      switch (code[position + 1]) {
+        case 0x38:
+          map = kLegacy0F38Map;
+          position += 2;
+          break;
+        case 0x3a:
+          map = kLegacy0F3AMap;
+          position += 2;
+          break;
+        default:
+          map = kLegacy0FMap;
+          position += 1;
+          break;
+      }
+      break;
+    default:
+      break;
+  }
+
+  // The opcode, ModR/M, SIB and displacement bytes.
+  if (position >= max_length) return 0;
+  const Row& row = rows_[row_indices_[map * 256 + code[position]]];
+  ++position;
+  uint8_t entry = row[prefix_state];
+  if (entry & kHasModRm) {
+    if (position >= max_length) return 0;
+    const uint8_t modrm = code[position];
+    ++position;
+    entry = row[(((modrm >> 3) & 7) << 5) | prefix_state];
+    const int mod = modrm >> 6;
+    const int rm = modrm & 7;
+    if (mod != 3) {
+      if (rm == 4) {
+        if (position >= max_length) return 0;
+        const uint8_t sib = code[position];
+        ++position;
+        if (mod == 0 && (sib & 7) == 5) position += 4;
+      } else if (mod == 0 && rm == 5) {
+        // RIP-relative addressing.
+        position += 4;
+      }
+      if (mod == 1) {
+        position += 1;
+      } else if (mod == 2) {
+        position += 4;
+      }
+    }
+  }
+  if (!(entry & kIsValid)) return 0;
+
+  // The immediate values and code offsets.
+  position += entry & kTrailingBytesMask;
+  return position <= max_length ? static_cast<int>(position) : 0;
+}
+
+}  // namespace x86
+}  // namespace cpu_instructions
@@ -0,0 +1,99 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Contains a table-driven decoder of the lengths of x86-64 instructions. The
+// decoding tables are generated from the encoding specifications of an
+// instruction database; the decoder then walks the raw code bytes using only
+// table lookups and the fixed rules for the ModR/M, SIB and displacement bytes.
+
+#ifndef CPU_INSTRUCTIONS_X86_INSTRUCTION_LENGTH_DECODER_H_
+#define CPU_INSTRUCTIONS_X86_INSTRUCTION_LENGTH_DECODER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <array>
+#include <vector>
+
+#include "cpu_instructions/proto/instructions.pb.h"
+#include "util/task/statusor.h"
+
+namespace cpu_instructions {
+namespace x86 {
+
+using ::cpu_instructions::util::StatusOr;
+
+// Decodes the lengths of x86-64 instructions, using decoding tables generated
+// from an instruction database. The decoder works in 64-bit mode; it handles
+// the legacy prefixes, the REX prefix, the VEX and EVEX prefixes, the opcode
+// maps 0F, 0F 38 and 0F 3A, the ModR/M, SIB and displacement bytes, and the
+// immediate values and code offsets described by the encoding specifications.
+//
+// The decoder does not validate the instructions. When the prefixes of an
+// instruction do not match any instruction from the database exactly, the
+// length is computed from the most specific instruction with the same opcode
+// whose mandatory prefixes are all present.
+//
+// Typical usage:
+// const InstructionLengthDecoder decoder =
+//     InstructionLengthDecoder::Create(instruction_set).ValueOrDie();
+// for (size_t offset = 0; offset < code_size;) {
+//   const int length =
+//       decoder.GetInstructionLength(code + offset, code_size - offset);
+//   if (length == 0) break;
+//   offset += length;
+// }
+class InstructionLengthDecoder {
+ public:
+  // The maximal length of an x86-64 instruction in bytes.
+  static constexpr int kMaxInstructionLength = 15;
+
+  // Creates a decoder for the instructions in 'instruction_set'. Instructions
+  // that are not available in 64-bit mode are ignored. Uses the parsed encoding
+  // specification of the instructions when available, and parses the raw
+  // encoding specification otherwise. Returns an error if the encoding
+  // specification of an instruction can't be parsed, or if its opcode can't be
+  // used in 64-bit mode.
+  static StatusOr<InstructionLengthDecoder> Create(
+      const InstructionSetProto& instruction_set);
+
+  // Creates a decoder that does not recognize any instruction.
+  InstructionLengthDecoder();
+
+  // Returns the length in bytes of the instruction that starts at code[0].
+  // Returns 0 when the bytes do not start with an instruction from the
+  // database, and when the instruction is longer than 'size' bytes or than
+  // kMaxInstructionLength bytes.
+  int GetInstructionLength(const uint8_t* code, size_t size) const;
+
+  // Returns the number of distinct rows of the decoding tables. Opcodes that
+  // are decoded the same way share their row.
+  int num_rows() const { return rows_.size(); }
+
+ private:
+  // One row of the decoding tables contains the entries for a single opcode in
+  // an opcode map. The layout of the rows and of the entries is described in
+  // instruction_length_decoder.cc.
+  using Row = std::array<uint8_t, 256>;
+
+  // The index of the row of each opcode in each opcode map. The row with the
+  // index 0 contains only invalid entries.
+  std::vector<uint16_t> row_indices_;
+  // The distinct rows of the decoding tables.
+  std::vector<Row> rows_;
+};
+
+}  // namespace x86
+}  // namespace cpu_instructions
+
+#endif  // CPU_INSTRUCTIONS_X86_INSTRUCTION_LENGTH_DECODER_H_
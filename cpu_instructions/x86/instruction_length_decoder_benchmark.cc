@@ -0,0 +1,143 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Benchmarks for the instruction length decoder. The decoder is generated from
+// an instruction database produced by parse_sdm, and it decodes the .text
+// section of an x86-64 ELF binary. Run with:
+//   bazel run -c opt \
+//     //cpu_instructions/x86:instruction_length_decoder_benchmark -- \
+//     --cpu_instructions_instruction_set=/path/to/instructions.pbtxt \
+//     --cpu_instructions_binary=/path/to/large/binary
+
+#include <elf.h>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <vector>
+#include "strings/string.h"
+
+#include "benchmark/benchmark.h"
+#include "cpu_instructions/proto/instructions.pb.h"
+#include "cpu_instructions/util/proto_util.h"
+#include "cpu_instructions/x86/instruction_length_decoder.h"
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+#include "strings/str_cat.h"
+
+DEFINE_string(cpu_instructions_instruction_set, "",
+              "The instruction database used to generate the decoding tables, "
+              "as a text format InstructionSetProto.");
+DEFINE_string(cpu_instructions_binary, "/proc/self/exe",
+              "The x86-64 ELF binary whose .text section is decoded.");
+
+namespace cpu_instructions {
+namespace x86 {
+namespace {
+
+// Reads the contents of the section 'section_name' from the 64-bit ELF file
+// 'filename'. Dies if the file can't be read or if it does not have the
+// section.
+std::vector<uint8_t> ReadElfSectionOrDie(const string& filename,
+                                         const string& section_name) {
+  std::ifstream file(filename, std::ios::binary);
+  CHECK(file.good()) << "Could not open " << filename;
+  const std::vector<uint8_t> contents((std::istreambuf_iterator<char>(file)),
+                                      std::istreambuf_iterator<char>());
+  Elf64_Ehdr header;
+  CHECK_GE(contents.size(), sizeof(header));
+  memcpy(&header, contents.data(), sizeof(header));
+  CHECK_EQ(memcmp(header.e_ident, ELFMAG, SELFMAG), 0) << "Not an ELF file";
+  CHECK_EQ(header.e_ident[EI_CLASS], ELFCLASS64) << "Not a 64-bit ELF file";
+  CHECK_EQ(header.e_machine, EM_X86_64) << "Not an x86-64 ELF file";
+  CHECK_LE(header.e_shoff + header.e_shnum * sizeof(Elf64_Shdr),
+           contents.size());
+
+  std::vector<Elf64_Shdr> sections(header.e_shnum);
+  memcpy(sections.data(), contents.data() + header.e_shoff,
+         sections.size() * sizeof(Elf64_Shdr));
+  CHECK_LT(header.e_shstrndx, sections.size());
+  const Elf64_Shdr& names_section = sections[header.e_shstrndx];
+  for (const Elf64_Shdr& section : sections) {
+    CHECK_LT(section.sh_name, names_section.sh_size);
+    const char* const name = reinterpret_cast<const char*>(
+        contents.data() + names_section.sh_offset + section.sh_name);
+    if (section_name != name) continue;
+    CHECK_LE(section.sh_offset + section.sh_size, contents.size());
+    return std::vector<uint8_t>(
+        contents.begin() + section.sh_offset,
+        contents.begin() + section.sh_offset + section.sh_size);
+  }
+  LOG(FATAL) << "Section " << section_name << " was not found in " << filename;
+  return {};
+}
+
+InstructionSetProto ReadInstructionSetOrDie() {
+  CHECK(!FLAGS_cpu_instructions_instruction_set.empty())
+      << "missing --cpu_instructions_instruction_set";
+  return ReadTextProtoOrDie<InstructionSetProto>(
+      FLAGS_cpu_instructions_instruction_set);
+}
+
+void BM_CreateInstructionLengthDecoder(benchmark::State& state) {
+  const InstructionSetProto instruction_set = ReadInstructionSetOrDie();
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(InstructionLengthDecoder::Create(instruction_set));
+  }
+  state.SetItemsProcessed(state.iterations() *
+                          instruction_set.instructions_size());
+}
+BENCHMARK(BM_CreateInstructionLengthDecoder);
+
+// Decodes the lengths of all instructions in the .text section. When the
+// decoder does not recognize an instruction, it skips a single byte; the
+// number of skipped bytes is reported in the label of the benchmark.
+void BM_DecodeInstructionLengths(benchmark::State& state) {
+  const InstructionLengthDecoder decoder =
+      InstructionLengthDecoder::Create(ReadInstructionSetOrDie()).ValueOrDie();
+  const std::vector<uint8_t> code =
+      ReadElfSectionOrDie(FLAGS_cpu_instructions_binary, ".text");
+  int num_instructions = 0;
+  int num_skipped_bytes = 0;
+  while (state.KeepRunning()) {
+    num_instructions = 0;
+    num_skipped_bytes = 0;
+    for (size_t offset = 0; offset < code.size(); ++num_instructions) {
+      const int length = decoder.GetInstructionLength(
+          code.data() + offset, code.size() - offset);
+      if (length == 0) {
+        ++num_skipped_bytes;
+        offset += 1;
+      } else {
+        offset += length;
+      }
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * code.size());
+  state.SetItemsProcessed(state.iterations() * num_instructions);
+  state.SetLabel(StrCat(code.size(), " bytes, ", num_skipped_bytes,
+                        " bytes skipped"));
+}
+BENCHMARK(BM_DecodeInstructionLengths);
+
+}  // namespace
+}  // namespace x86
+}  // namespace cpu_instructions
+
+int main(int argc, char** argv) {
+  benchmark::Initialize(&argc, argv);
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
@@ -0,0 +1,217 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cpu_instructions/x86/instruction_length_decoder.h"
+
+#include <cstdint>
+#include <vector>
+#include "strings/string.h"
+
+#include "cpu_instructions/proto/instructions.pb.h"
+#include "cpu_instructions/util/proto_util.h"
+#include "gtest/gtest.h"
+#include "strings/str_cat.h"
+#include "util/task/statusor.h"
+
+namespace cpu_instructions {
+namespace x86 {
+namespace {
+
+// A small instruction database. The encoding specifications are in the form
+// produced by the cleanup transforms; the 16-bit and 64-bit versions of the
+// instructions have the operand size override and the REX.W prefixes.
+constexpr char kInstructionSetProto[] = R"(
+    instructions { raw_encoding_specification: '90' }
+    instructions { raw_encoding_specification: '9B' }
+    instructions { raw_encoding_specification: 'C3' }
+    instructions { raw_encoding_specification: '50+rd' }
+    instructions { raw_encoding_specification: '89 /r' }
+    instructions { raw_encoding_specification: '66 89 /r' }
+    instructions { raw_encoding_specification: 'REX.W + 89 /r' }
+    instructions { raw_encoding_specification: '8B /r' }
+    instructions { raw_encoding_specification: 'REX.W + 8B /r' }
+    instructions { raw_encoding_specification: '83 /5 ib' }
+    instructions { raw_encoding_specification: 'REX.W + 83 /5 ib' }
+    instructions { raw_encoding_specification: 'B8+ rd id' }
+    instructions { raw_encoding_specification: '66 B8+ rw iw' }
+    instructions { raw_encoding_specification: 'REX.W + B8+ rd io' }
+    instructions { raw_encoding_specification: 'A1 io' }
+    instructions { raw_encoding_specification: '67 A1 id' }
+    instructions { raw_encoding_specification: 'C8 iw ib' }
+    instructions { raw_encoding_specification: 'E8 cd' }
+    instructions { raw_encoding_specification: '74 cb' }
+    instructions { raw_encoding_specification: '0F 84 cd' }
+    instructions { raw_encoding_specification: 'F6 /0 ib' }
+    instructions { raw_encoding_specification: 'F6 /2' }
+    instructions { raw_encoding_specification: 'F3 0F B8 /r' }
+    instructions { raw_encoding_specification: 'REX.W + 0F B1 /r' }
+    instructions { raw_encoding_specification: '0F 01 /7' }
+    instructions { raw_encoding_specification: '0F 01 F8' }
+    instructions { raw_encoding_specification: 'D9 /0' }
+    instructions { raw_encoding_specification: 'D9 E8' }
+    instructions { raw_encoding_specification: '9B D9 /7' }
+    instructions { raw_encoding_specification: '66 0F 3A 0F /r ib' }
+    instructions { raw_encoding_specification: 'VEX.128.0F.WIG 77' }
+    instructions {
+      raw_encoding_specification: 'VEX.NDS.128.66.0F3A.WIG 0F /r ib' }
+    instructions {
+      raw_encoding_specification: 'VEX.NDS.128.66.0F3A.W0 4B /r /is4' }
+    instructions { raw_encoding_specification: 'EVEX.NDS.512.0F.W0 58 /r' }
+    instructions {
+      raw_encoding_specification: '37'
+      available_in_64_bit: false })";
+
+class InstructionLengthDecoderTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    const StatusOr<InstructionLengthDecoder> decoder =
+        InstructionLengthDecoder::Create(
+            ParseProtoFromStringOrDie<InstructionSetProto>(
+                kInstructionSetProto));
+    ASSERT_TRUE(decoder.ok()) << decoder.status();
+    decoder_ = decoder.ValueOrDie();
+  }
+
+  void ExpectLength(const std::vector<uint8_t>& code, int expected_length) {
+    SCOPED_TRACE(StrCat("code size = ", code.size()));
+    EXPECT_EQ(decoder_.GetInstructionLength(code.data(), code.size()),
+              expected_length);
+  }
+
+  InstructionLengthDecoder decoder_;
+};
+
+TEST_F(InstructionLengthDecoderTest, OneByteOpcodes) {
+  ExpectLength({0x90}, 1);                                // NOP
+  ExpectLength({0x55}, 1);                                // PUSH RBP
+  ExpectLength({0xc3}, 1);                                // RET
+  ExpectLength({0xb8, 0x78, 0x56, 0x34, 0x12}, 5);        // MOV EAX, imm32
+  ExpectLength({0xe8, 0xfb, 0x00, 0x00, 0x00}, 5);        // CALL rel32
+  ExpectLength({0x74, 0x10}, 2);                          // JE rel8
+  ExpectLength({0xc8, 0x10, 0x00, 0x01}, 4);              // ENTER 16, 1
+  ExpectLength({0xa1, 1, 2, 3, 4, 5, 6, 7, 8}, 9);        // MOV EAX, moffs64
+}
+
+TEST_F(InstructionLengthDecoderTest, OperandSizePrefixes) {
+  ExpectLength({0x66, 0xb8, 0x34, 0x12}, 4);  // MOV AX, imm16
+  ExpectLength({0x48, 0xb8, 1, 2, 3, 4, 5, 6, 7, 8}, 10);  // MOV RAX, imm64
+  // REX.W has precedence over the operand size override prefix.
+  ExpectLength({0x66, 0x48, 0xb8, 1, 2, 3, 4, 5, 6, 7, 8}, 11);
+  // The REX prefix is ignored when it does not precede the opcode.
+  ExpectLength({0x48, 0x66, 0xb8, 0x34, 0x12}, 5);
+  ExpectLength({0x67, 0xa1, 0x44, 0x33, 0x22, 0x11}, 6);  // MOV EAX, moffs32
+}
+
+TEST_F(InstructionLengthDecoderTest, ModRmSibAndDisplacement) {
+  ExpectLength({0x48, 0x89, 0xe5}, 3);                    // MOV RBP, RSP
+  ExpectLength({0x48, 0x83, 0xec, 0x10}, 4);              // SUB RSP, 16
+  ExpectLength({0x8b, 0x44, 0x24, 0x08}, 4);              // SIB + disp8
+  ExpectLength({0x8b, 0x05, 0x78, 0x56, 0x34, 0x12}, 6);  // RIP + disp32
+  ExpectLength({0x8b, 0x04, 0x25, 0x78, 0x56, 0x34, 0x12}, 7);  // SIB, no base
+  ExpectLength({0x48, 0x8b, 0x88, 0x78, 0x56, 0x34, 0x12}, 7);  // disp32
+}
+
+TEST_F(InstructionLengthDecoderTest, OpcodeExtensionInModRm) {
+  ExpectLength({0xf6, 0xc0, 0x01}, 3);  // TEST AL, imm8
+  ExpectLength({0xf6, 0xd0}, 2);        // NOT AL
+  // F6 /1 is not in the database.
+  ExpectLength({0xf6, 0xc8, 0x01}, 0);
+}
+
+TEST_F(InstructionLengthDecoderTest, TwoAndThreeByteOpcodes) {
+  ExpectLength({0x0f, 0x84, 0xfa, 0x0f, 0x00, 0x00}, 6);  // JE rel32
+  ExpectLength({0xf3, 0x0f, 0xb8, 0xc1}, 4);              // POPCNT
+  ExpectLength({0xf0, 0x48, 0x0f, 0xb1, 0x0a}, 5);        // LOCK CMPXCHG
+  ExpectLength({0x66, 0x0f, 0x3a, 0x0f, 0xc1, 0x08}, 6);  // PALIGNR
+}
+
+TEST_F(InstructionLengthDecoderTest, FixedModRmBytes) {
+  ExpectLength({0x0f, 0x01, 0xf8}, 3);  // SWAPGS
+  ExpectLength({0x0f, 0x01, 0x38}, 3);  // INVLPG [RAX]
+  ExpectLength({0xd9, 0xe8}, 2);        // FLD1
+  // FSTCW is decoded as FWAIT followed by FNSTCW.
+  ExpectLength({0x9b, 0xd9, 0x38}, 1);
+  ExpectLength({0xd9, 0x38}, 2);
+}
+
+TEST_F(InstructionLengthDecoderTest, VexAndEvexPrefixes) {
+  ExpectLength({0xc5, 0xf8, 0x77}, 3);                    // VZEROUPPER
+  ExpectLength({0xc4, 0xe3, 0x71, 0x0f, 0xc2, 0x08}, 6);  // VPALIGNR
+  ExpectLength({0xc4, 0xe3, 0x71, 0x4b, 0xc2, 0x30}, 6);  // VBLENDVPD
+  ExpectLength({0x62, 0xf1, 0x7c, 0x48, 0x58, 0xc1}, 6);  // VADDPS
+  ExpectLength({0x62, 0xf1, 0x7c, 0x48, 0x58, 0x40, 0x01}, 7);  // disp8*N
+  // The VEX opcode maps are separate from the legacy opcode maps.
+  ExpectLength({0xc5, 0xf8, 0x90}, 0);
+}
+
+TEST_F(InstructionLengthDecoderTest, InvalidAndTruncatedInstructions) {
+  ExpectLength({}, 0);
+  ExpectLength({0x66}, 0);
+  ExpectLength({0xb8, 0x78, 0x56, 0x34}, 0);
+  ExpectLength({0x8b, 0x04, 0x25, 0x78, 0x56, 0x34}, 0);
+  ExpectLength({0xc4, 0xe3, 0x71}, 0);
+  // AAA is not available in 64-bit mode.
+  ExpectLength({0x37}, 0);
+  // UD2 is not in the database.
+  ExpectLength({0x0f, 0x0b}, 0);
+  // The instruction is longer than 15 bytes.
+  ExpectLength({0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66,
+                0x66, 0x66, 0x66, 0x66, 0x66, 0x90},
+               0);
+}
+
+TEST_F(InstructionLengthDecoderTest, WalksCode) {
+  const std::vector<uint8_t> kCode = {
+      0x55,                                // PUSH RBP
+      0x48, 0x89, 0xe5,                    // MOV RBP, RSP
+      0x48, 0x83, 0xec, 0x10,              // SUB RSP, 16
+      0x8b, 0x44, 0x24, 0x08,              // MOV EAX, [RSP + 8]
+      0xc5, 0xf8, 0x77,                    // VZEROUPPER
+      0xe8, 0xfb, 0x00, 0x00, 0x00,        // CALL rel32
+      0xc3,                                // RET
+  };
+  std::vector<int> lengths;
+  for (size_t offset = 0; offset < kCode.size();) {
+    const int length = decoder_.GetInstructionLength(kCode.data() + offset,
+                                                     kCode.size() - offset);
+    ASSERT_GT(length, 0) << "offset = " << offset;
+    lengths.push_back(length);
+    offset += length;
+  }
+  EXPECT_EQ(lengths, std::vector<int>({1, 3, 4, 4, 3, 5, 1}));
+}
+
+TEST_F(InstructionLengthDecoderTest, SharesRows) {
+  // The database uses 37 opcodes, but many of them are decoded the same way,
+  // e.g. all opcodes of PUSH r64, or 90, C3 and VZEROUPPER.
+  EXPECT_EQ(decoder_.num_rows(), 15);
+}
+
+TEST(InstructionLengthDecoderCreateTest, EmptyDecoder) {
+  const InstructionLengthDecoder decoder;
+  constexpr uint8_t kNop[] = {0x90};
+  EXPECT_EQ(decoder.GetInstructionLength(kNop, sizeof(kNop)), 0);
+  EXPECT_EQ(decoder.num_rows(), 1);
+}
+
+TEST(InstructionLengthDecoderCreateTest, InvalidEncodingSpecification) {
+  const InstructionSetProto instruction_set =
+      ParseProtoFromStringOrDie<InstructionSetProto>(
+          "instructions { raw_encoding_specification: '0F /x' }");
+  EXPECT_FALSE(InstructionLengthDecoder::Create(instruction_set).ok());
+}
+
+}  // namespace
+}  // namespace x86
+}  // namespace cpu_instructions
@@ -0,0 +1,137 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cpu_instructions/x86/operand_names.h"
+
+#include <iterator>
+
+#include "util/gtl/perfect_hash_map.h"
+
+namespace cpu_instructions {
+namespace x86 {
+namespace {
+
+// The list of all operand names in the registry. The id of an operand name is
+// its index in this list. The list contains the operand names accepted by the
+// parser of the vendor syntax, and the operand names introduced or recognized
+// by the cleanup transforms.
+constexpr const char* kOperandNames[] = {
+    // Implicit values, used for shifts and interrupts.
+    "0", "1", "3",
+    // General-purpose registers.
+    "r8", "r16", "r32", "r32a", "r32b", "r64", "r64a", "r64b", "reg",
+    // General-purpose registers/memory addressed through ModR/M.
+    "r/m8", "r/m16", "r/m32", "r/m64", "r8/m8", "r16/m16", "r32/m8", "r32/m16",
+    "r32/m32", "r64/m8", "r64/m16", "r64/m64", "reg/m8", "reg/m16", "reg/m32",
+    // Specific general-purpose registers.
+    "AL", "AX", "CL", "DX", "EAX", "RAX",
+    // Control and debug registers.
+    "CR0-CR7", "CR8", "DR0-DR7",
+    // Segment registers.
+    "Sreg", "CS", "DS", "ES", "FS", "GS", "SS",
+    // Immediate values.
+    "imm8", "imm16", "imm32", "imm64",
+    // Memory addresses.
+    "m", "mem", "mib", "m8", "m16", "m16int", "m32", "m32fp", "m32int", "m64",
+    "m64fp", "m64int", "m80bcd", "m80dec", "m80fp", "m128", "m256", "m512",
+    // Addresses pointing to state storage.
+    "m2byte", "m14byte", "m14/28byte", "m28byte", "m94byte", "m94/108byte",
+    "m108byte", "m512byte",
+    // Indirect far pointers.
+    "m16:16", "m16:32", "m16:64",
+    // Addresses pointing to pairs of integers.
+    "m16&16", "m16&32", "m16&64", "m32&32",
+    // Immediate far pointers.
+    "ptr16:16", "ptr16:32",
+    // Memory offsets.
+    "moffs8", "moffs16", "moffs32", "moffs64",
+    // Relative branch values.
+    "rel8", "rel16", "rel32",
+    // Implicit memory operands of string instructions.
+    "BYTE PTR [RSI]", "WORD PTR [RSI]", "DWORD PTR [RSI]", "QWORD PTR [RSI]",
+    "BYTE PTR [RDI]", "WORD PTR [RDI]", "DWORD PTR [RDI]", "QWORD PTR [RDI]",
+    // Floating-point stack registers.
+    "ST", "ST(0)", "ST(i)",
+    // MMX registers and MMX registers/memory.
+    "mm", "mm1", "mm2", "mm/m32", "mm/m64", "mm2/m64",
+    // XMM registers, <XMM0> is implicit.
+    "<XMM0>", "xmm", "xmm0", "xmm1", "xmm2", "xmm3", "xmm4",
+    // XMM registers/memory addressed through ModR/M.
+    "xmm/m8", "xmm/m16", "xmm/m32", "xmm/m64", "xmm/m128", "xmm1/m8",
+    "xmm1/m16", "xmm1/m32", "xmm1/m64", "xmm1/m128", "xmm2/m8", "xmm2/m16",
+    "xmm2/m32", "xmm2/m64", "xmm2/m128", "xmm2/m256", "xmm3/m8", "xmm3/m16",
+    "xmm3/m32", "xmm3/m64", "xmm3/m128", "xmm3/m256",
+    // XMM registers/memory/vector addressed through ModR/M or EVEX.
+    "xmm2/m64/m32bcst", "xmm2/m64/m64bcst", "xmm2/m128/m32bcst",
+    "xmm2/m128/m64bcst", "xmm3/m128/m32bcst", "xmm3/m128/m64bcst",
+    // YMM registers.
+    "ymm0", "ymm1", "ymm2", "ymm3", "ymm4",
+    // YMM registers/memory addressed through ModR/M.
+    "ymm/m8", "ymm/m16", "ymm/m32", "ymm/m64", "ymm/m128", "ymm/m256",
+    "ymm1/m8", "ymm1/m16", "ymm1/m32", "ymm1/m64", "ymm1/m128", "ymm1/m256",
+    "ymm2/m8", "ymm2/m16", "ymm2/m32", "ymm2/m64", "ymm2/m128", "ymm2/m256",
+    "ymm3/m8", "ymm3/m16", "ymm3/m32", "ymm3/m64", "ymm3/m128", "ymm3/m256",
+    // YMM registers/memory/vector addressed through ModR/M or EVEX.
+    "ymm2/m256/m32bcst", "ymm2/m256/m64bcst", "ymm3/m256/m32bcst",
+    "ymm3/m256/m64bcst",
+    // ZMM registers.
+    "zmm0", "zmm1", "zmm2", "zmm3", "zmm4",
+    // ZMM registers/memory addressed through ModR/M.
+    "zmm0/m512", "zmm1/m8", "zmm1/m16", "zmm1/m32", "zmm1/m64", "zmm1/m128",
+    "zmm1/m256", "zmm1/m512", "zmm2/m8", "zmm2/m16", "zmm2/m32", "zmm2/m64",
+    "zmm2/m128", "zmm2/m256", "zmm2/m512", "zmm3/m8", "zmm3/m16", "zmm3/m32",
+    "zmm3/m64", "zmm3/m128", "zmm3/m256", "zmm3/m512",
+    // ZMM registers/memory/vector addressed through ModR/M or EVEX.
+    "zmm1/m512/m32bcst", "zmm1/m512/m64bcst", "zmm2/m512/m32bcst",
+    "zmm2/m512/m64bcst", "zmm3/m512/m32bcst", "zmm3/m512/m64bcst",
+    // AVX vector addresses.
+    "vm32x", "vm32y", "vm32z", "vm64x", "vm64y", "vm64z",
+    // MPX registers and MPX registers/memory.
+    "bnd", "bnd0", "bnd1", "bnd2", "bnd3", "bnd0/m64", "bnd0/m128", "bnd1/m64",
+    "bnd1/m128", "bnd2/m64", "bnd2/m128", "bnd3/m64", "bnd3/m128",
+    // Opmask registers.
+    "k0", "k1", "k2", "k3", "k4", "k5", "k6", "k7",
+    // Opmask registers/memory.
+    "k2/m8", "k2/m16", "k2/m32", "k2/m64",
+};
+
+// Returns the operand names in the registry, indexed by their ids.
+const std::vector<string>& GetOperandNames() {
+  static const std::vector<string>* const kNames =
+      new std::vector<string>(std::begin(kOperandNames),
+                              std::end(kOperandNames));
+  return *kNames;
+}
+
+// The mapping from the operand names in the registry to their ids. The table
+// is built by the compiler, which also checks that the names are unique.
+constexpr auto kOperandNameIds = gtl::MakePerfectHashTable(kOperandNames);
+
+}  // namespace
+
+int GetNumOperandNames() { return kOperandNameIds.size(); }
+
+OperandNameId GetOperandNameId(const string& operand_name) {
+  return kOperandNameIds.IndexOf(operand_name);
+}
+
+const string& GetOperandName(OperandNameId id) {
+  const std::vector<string>& names = GetOperandNames();
+  CHECK_GE(id, 0);
+  CHECK_LT(id, names.size());
+  return names[id];
+}
+
+}  // namespace x86
+}  // namespace cpu_instructions
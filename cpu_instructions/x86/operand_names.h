@@ -0,0 +1,118 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Contains a registry of the operand names used in the Intel manual and in the
+// instruction database. The registry assigns each of the names a small dense
+// integer id, so that the properties of the operands can be stored in arrays
+// indexed by the id instead of in hash maps keyed by the name of the operand.
+//
+// Operand names are still stored as strings in InstructionOperand.name; code
+// that needs several properties of an operand looks up the id of its name once,
+// and then uses the id with all the OperandNameMaps and OperandNameSets it
+// needs.
+
+#ifndef CPU_INSTRUCTIONS_X86_OPERAND_NAMES_H_
+#define CPU_INSTRUCTIONS_X86_OPERAND_NAMES_H_
+
+#include <vector>
+#include "strings/string.h"
+
+#include "glog/logging.h"
+
+namespace cpu_instructions {
+namespace x86 {
+
+// The id of an operand name. The ids of the names in the registry are dense,
+// i.e. they are the numbers from 0 to GetNumOperandNames() - 1.
+using OperandNameId = int;
+
+// The id returned for operand names that are not in the registry.
+constexpr OperandNameId kInvalidOperandNameId = -1;
+
+// Returns the number of operand names in the registry.
+int GetNumOperandNames();
+
+// Returns the id of 'operand_name', or kInvalidOperandNameId if the name is not
+// in the registry.
+OperandNameId GetOperandNameId(const string& operand_name);
+
+// Returns the operand name with the given id. 'id' must be a valid id of an
+// operand name from the registry.
+const string& GetOperandName(OperandNameId id);
+
+// A map from operand names to values of type ValueType, stored as an array
+// indexed by the ids of the operand names. ValueType must be default
+// constructible and copyable.
+template <typename ValueType>
+class OperandNameMap {
+ public:
+  // Creates the map from a list of (name, value) pairs in [begin, end). When a
+  // name appears in the list more than once, the first value is used. All the
+  // names must be in the registry.
+  template <typename InputIterator>
+  OperandNameMap(InputIterator begin, InputIterator end)
+      : values_(GetNumOperandNames()),
+        has_value_(GetNumOperandNames(), false) {
+    for (; begin != end; ++begin) {
+      const OperandNameId id = GetOperandNameId(begin->first);
+      CHECK_NE(id, kInvalidOperandNameId)
+          << "Unknown operand name: " << begin->first;
+      if (has_value_[id]) continue;
+      values_[id] = begin->second;
+      has_value_[id] = true;
+    }
+  }
+
+  // Returns the value for the operand name with the given id, or nullptr if
+  // there is no value for it. 'id' may be kInvalidOperandNameId.
+  const ValueType* Find(OperandNameId id) const {
+    if (id == kInvalidOperandNameId || !has_value_[id]) return nullptr;
+    return &values_[id];
+  }
+
+ private:
+  std::vector<ValueType> values_;
+  std::vector<bool> has_value_;
+};
+
+// A set of operand names, stored as a bitmap indexed by the ids of the operand
+// names.
+class OperandNameSet {
+ public:
+  // Creates the set from the list of names in [begin, end). All the names must
+  // be in the registry.
+  template <typename InputIterator>
+  OperandNameSet(InputIterator begin, InputIterator end)
+      : contains_(GetNumOperandNames(), false) {
+    for (; begin != end; ++begin) {
+      const OperandNameId id = GetOperandNameId(*begin);
+      CHECK_NE(id, kInvalidOperandNameId) << "Unknown operand name: " << *begin;
+      contains_[id] = true;
+    }
+  }
+
+  // Returns true if the operand name with the given id is in the set. 'id' may
+  // be kInvalidOperandNameId.
+  bool Contains(OperandNameId id) const {
+    return id != kInvalidOperandNameId && contains_[id];
+  }
+
+ private:
+  std::vector<bool> contains_;
+};
+
+}  // namespace x86
+}  // namespace cpu_instructions
+
+#endif  // CPU_INSTRUCTIONS_X86_OPERAND_NAMES_H_
@@ -0,0 +1,81 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cpu_instructions/x86/operand_names.h"
+
+#include <iterator>
+#include <utility>
+#include "strings/string.h"
+
+#include "gtest/gtest.h"
+
+namespace cpu_instructions {
+namespace x86 {
+namespace {
+
+TEST(OperandNamesTest, IdsAreDense) {
+  const int num_operand_names = GetNumOperandNames();
+  EXPECT_GT(num_operand_names, 0);
+  for (OperandNameId id = 0; id < num_operand_names; ++id) {
+    EXPECT_EQ(GetOperandNameId(GetOperandName(id)), id);
+  }
+}
+
+TEST(OperandNamesTest, KnownAndUnknownNames) {
+  const OperandNameId rm32_id = GetOperandNameId("r/m32");
+  EXPECT_NE(rm32_id, kInvalidOperandNameId);
+  EXPECT_EQ(GetOperandName(rm32_id), "r/m32");
+  EXPECT_NE(GetOperandNameId("xmm2/m128/m32bcst"), kInvalidOperandNameId);
+  EXPECT_NE(GetOperandNameId("imm8"), rm32_id);
+
+  EXPECT_EQ(GetOperandNameId(""), kInvalidOperandNameId);
+  EXPECT_EQ(GetOperandNameId("R/M32"), kInvalidOperandNameId);
+  EXPECT_EQ(GetOperandNameId("r/m32 "), kInvalidOperandNameId);
+}
+
+TEST(OperandNameMapTest, Find) {
+  const std::pair<const char*, int> kValues[] = {
+      {"r/m8", 8}, {"r/m16", 16}, {"r/m8", 1000}};
+  const OperandNameMap<int> values(std::begin(kValues), std::end(kValues));
+
+  const int* const rm8_value = values.Find(GetOperandNameId("r/m8"));
+  ASSERT_NE(rm8_value, nullptr);
+  // The first value of a name that appears more than once is used.
+  EXPECT_EQ(*rm8_value, 8);
+  const int* const rm16_value = values.Find(GetOperandNameId("r/m16"));
+  ASSERT_NE(rm16_value, nullptr);
+  EXPECT_EQ(*rm16_value, 16);
+
+  EXPECT_EQ(values.Find(GetOperandNameId("r/m32")), nullptr);
+  EXPECT_EQ(values.Find(kInvalidOperandNameId), nullptr);
+}
+
+TEST(OperandNameSetTest, Contains) {
+  const char* const kNames[] = {"imm8", "rel8"};
+  const OperandNameSet names(std::begin(kNames), std::end(kNames));
+  EXPECT_TRUE(names.Contains(GetOperandNameId("imm8")));
+  EXPECT_TRUE(names.Contains(GetOperandNameId("rel8")));
+  EXPECT_FALSE(names.Contains(GetOperandNameId("imm16")));
+  EXPECT_FALSE(names.Contains(kInvalidOperandNameId));
+}
+
+TEST(OperandNameMapDeathTest, UnknownName) {
+  const std::pair<const char*, int> kValues[] = {{"r/m65", 65}};
+  EXPECT_DEATH(OperandNameMap<int>(std::begin(kValues), std::end(kValues)),
+               "Unknown operand name: r/m65");
+}
+
+}  // namespace
+}  // namespace x86
+}  // namespace cpu_instructions
@@ -0,0 +1,234 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cpu_instructions/x86/packed_encoding.h"
+
+#include "glog/logging.h"
+#include "strings/str_cat.h"
+#include "util/task/canonical_errors.h"
+#include "util/task/status.h"
+
+namespace cpu_instructions {
+namespace x86 {
+
+using ::cpu_instructions::util::InvalidArgumentError;
+using ::cpu_instructions::util::OkStatus;
+using ::cpu_instructions::util::Status;
+
+constexpr int PackedEncoding::kMaxNumImmediateValues;
+constexpr int PackedEncoding::kMaxNumEvexBInterpretations;
+
+namespace {
+
+constexpr PackedEncoding::Field kImmediateValueBytesFields[] = {
+    PackedEncoding::kImmediateValueBytes0,
+    PackedEncoding::kImmediateValueBytes1,
+    PackedEncoding::kImmediateValueBytes2};
+constexpr PackedEncoding::Field kEvexBInterpretationFields[] = {
+    PackedEncoding::kEvexBInterpretation0,
+    PackedEncoding::kEvexBInterpretation1,
+    PackedEncoding::kEvexBInterpretation2};
+
+// Builds a packed encoding field by field, and remembers the first field whose
+// value did not fit into the packed encoding.
+class PackedEncodingBuilder {
+ public:
+  // Sets 'field' to 'value'. 'field_name' is used in the error message when
+  // the value does not fit into the field. Note that enum values are passed as
+  // int64_t, so that negative values are not truncated before the check.
+  void Set(PackedEncoding::Field field, int64_t value,
+           const char* field_name) {
+    if (value < 0 || !PackedEncoding::FitsInField(field, value)) {
+      if (status_.ok()) {
+        status_ = InvalidArgumentError(
+            StrCat("The value of ", field_name, " does not fit into a packed ",
+                   "encoding: ", value));
+      }
+      return;
+    }
+    encoding_ = encoding_.With(field, value);
+  }
+
+  const PackedEncoding& encoding() const { return encoding_; }
+  const Status& status() const { return status_; }
+
+ private:
+  PackedEncoding encoding_;
+  Status status_ = OkStatus();
+};
+
+}  // namespace
+
+StatusOr<PackedEncoding> PackedEncoding::FromProto(
+    const EncodingSpecification& specification) {
+  PackedEncodingBuilder builder;
+  builder.Set(kOpcode, specification.opcode(), "opcode");
+  builder.Set(kOperandInOpcode, specification.operand_in_opcode(),
+              "operand_in_opcode");
+  builder.Set(kModRmUsage, specification.modrm_usage(), "modrm_usage");
+  builder.Set(kModRmOpcodeExtension, specification.modrm_opcode_extension(),
+              "modrm_opcode_extension");
+  builder.Set(kCodeOffsetBytes, specification.code_offset_bytes(),
+              "code_offset_bytes");
+  const int num_immediate_values = specification.immediate_value_bytes_size();
+  if (num_immediate_values > kMaxNumImmediateValues) {
+    return InvalidArgumentError(
+        StrCat("Too many immediate values for a packed encoding: ",
+               num_immediate_values));
+  }
+  builder.Set(kNumImmediateValues, num_immediate_values,
+              "the number of immediate values");
+  for (int i = 0; i < num_immediate_values; ++i) {
+    builder.Set(kImmediateValueBytesFields[i],
+                specification.immediate_value_bytes(i),
+                "immediate_value_bytes");
+  }
+
+  switch (specification.prefix_case()) {
+    case EncodingSpecification::kLegacyPrefixes: {
+      const LegacyPrefixEncodingSpecification& legacy_prefixes =
+          specification.legacy_prefixes();
+      builder.Set(kPrefixKind, kLegacyPrefixes, "prefix");
+      builder.Set(kHasMandatoryRexWPrefix,
+                  legacy_prefixes.has_mandatory_rex_w_prefix(),
+                  "has_mandatory_rex_w_prefix");
+      builder.Set(kHasMandatoryRepePrefix,
+                  legacy_prefixes.has_mandatory_repe_prefix(),
+                  "has_mandatory_repe_prefix");
+      builder.Set(kHasMandatoryRepnePrefix,
+                  legacy_prefixes.has_mandatory_repne_prefix(),
+                  "has_mandatory_repne_prefix");
+      builder.Set(kHasMandatoryOperandSizeOverridePrefix,
+                  legacy_prefixes.has_mandatory_operand_size_override_prefix(),
+                  "has_mandatory_operand_size_override_prefix");
+      builder.Set(kHasMandatoryAddressSizeOverridePrefix,
+                  legacy_prefixes.has_mandatory_address_size_override_prefix(),
+                  "has_mandatory_address_size_override_prefix");
+      break;
+    }
+    case EncodingSpecification::kVexPrefix: {
+      const VexPrefixEncodingSpecification& vex_prefix =
+          specification.vex_prefix();
+      builder.Set(kPrefixKind, kVexPrefix, "prefix");
+      builder.Set(kVexPrefixType, vex_prefix.prefix_type(), "prefix_type");
+      builder.Set(kVexOperandUsage, vex_prefix.vex_operand_usage(),
+                  "vex_operand_usage");
+      builder.Set(kVexVectorSize, vex_prefix.vector_size(), "vector_size");
+      builder.Set(kVexMandatoryPrefix, vex_prefix.mandatory_prefix(),
+                  "mandatory_prefix");
+      builder.Set(kVexMapSelect, vex_prefix.map_select(), "map_select");
+      builder.Set(kVexWUsage, vex_prefix.vex_w_usage(), "vex_w_usage");
+      builder.Set(kHasVexOperandSuffix, vex_prefix.has_vex_operand_suffix(),
+                  "has_vex_operand_suffix");
+      builder.Set(kVsibUsage, vex_prefix.vsib_usage(), "vsib_usage");
+      builder.Set(kEvexOpmaskUsage, vex_prefix.opmask_usage(),
+                  "opmask_usage");
+      builder.Set(kEvexMaskingOperation, vex_prefix.masking_operation(),
+                  "masking_operation");
+      const int num_interpretations = vex_prefix.evex_b_interpretations_size();
+      if (num_interpretations > kMaxNumEvexBInterpretations) {
+        return InvalidArgumentError(
+            StrCat("Too many EVEX.b interpretations for a packed encoding: ",
+                   num_interpretations));
+      }
+      builder.Set(kNumEvexBInterpretations, num_interpretations,
+                  "the number of EVEX.b interpretations");
+      for (int i = 0; i < num_interpretations; ++i) {
+        builder.Set(kEvexBInterpretationFields[i],
+                    vex_prefix.evex_b_interpretations(i),
+                    "evex_b_interpretations");
+      }
+      break;
+    }
+    case EncodingSpecification::PREFIX_NOT_SET:
+      builder.Set(kPrefixKind, kNoPrefix, "prefix");
+      break;
+  }
+  if (!builder.status().ok()) return builder.status();
+  return builder.encoding();
+}
+
+EncodingSpecification PackedEncoding::ToProto() const {
+  EncodingSpecification specification;
+  specification.set_opcode(Get(kOpcode));
+  specification.set_operand_in_opcode(
+      static_cast<EncodingSpecification::OperandInOpcode>(
+          Get(kOperandInOpcode)));
+  specification.set_modrm_usage(
+      static_cast<EncodingSpecification::ModRmUsage>(Get(kModRmUsage)));
+  specification.set_modrm_opcode_extension(Get(kModRmOpcodeExtension));
+  specification.set_code_offset_bytes(Get(kCodeOffsetBytes));
+  const int num_immediate_values = Get(kNumImmediateValues);
+  for (int i = 0; i < num_immediate_values; ++i) {
+    specification.add_immediate_value_bytes(
+        Get(kImmediateValueBytesFields[i]));
+  }
+
+  switch (prefix_kind()) {
+    case kLegacyPrefixes: {
+      LegacyPrefixEncodingSpecification* const legacy_prefixes =
+          specification.mutable_legacy_prefixes();
+      legacy_prefixes->set_has_mandatory_rex_w_prefix(
+          Get(kHasMandatoryRexWPrefix));
+      legacy_prefixes->set_has_mandatory_repe_prefix(
+          Get(kHasMandatoryRepePrefix));
+      legacy_prefixes->set_has_mandatory_repne_prefix(
+          Get(kHasMandatoryRepnePrefix));
+      legacy_prefixes->set_has_mandatory_operand_size_override_prefix(
+          Get(kHasMandatoryOperandSizeOverridePrefix));
+      legacy_prefixes->set_has_mandatory_address_size_override_prefix(
+          Get(kHasMandatoryAddressSizeOverridePrefix));
+      break;
+    }
+    case kVexPrefix: {
+      VexPrefixEncodingSpecification* const vex_prefix =
+          specification.mutable_vex_prefix();
+      vex_prefix->set_prefix_type(
+          static_cast<VexPrefixType>(Get(kVexPrefixType)));
+      vex_prefix->set_vex_operand_usage(
+          static_cast<VexOperandUsage>(Get(kVexOperandUsage)));
+      vex_prefix->set_vector_size(
+          static_cast<VexVectorSize>(Get(kVexVectorSize)));
+      vex_prefix->set_mandatory_prefix(
+          static_cast<VexEncoding::MandatoryPrefix>(Get(kVexMandatoryPrefix)));
+      vex_prefix->set_map_select(
+          static_cast<VexEncoding::MapSelect>(Get(kVexMapSelect)));
+      vex_prefix->set_vex_w_usage(
+          static_cast<VexPrefixEncodingSpecification::VexWUsage>(
+              Get(kVexWUsage)));
+      vex_prefix->set_has_vex_operand_suffix(Get(kHasVexOperandSuffix));
+      vex_prefix->set_vsib_usage(
+          static_cast<VexPrefixEncodingSpecification::VSibUsage>(
+              Get(kVsibUsage)));
+      vex_prefix->set_opmask_usage(
+          static_cast<EvexOpmaskUsage>(Get(kEvexOpmaskUsage)));
+      vex_prefix->set_masking_operation(
+          static_cast<EvexMaskingOperation>(Get(kEvexMaskingOperation)));
+      const int num_interpretations = Get(kNumEvexBInterpretations);
+      for (int i = 0; i < num_interpretations; ++i) {
+        vex_prefix->add_evex_b_interpretations(static_cast<EvexBInterpretation>(
+            Get(kEvexBInterpretationFields[i])));
+      }
+      break;
+    }
+    case kNoPrefix:
+      break;
+    default:
+      LOG(FATAL) << "Invalid prefix kind: " << prefix_kind();
+  }
+  return specification;
+}
+
+}  // namespace x86
+}  // namespace cpu_instructions
@@ -0,0 +1,203 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Contains PackedEncoding, a compact value type that holds the same information
+// as the EncodingSpecification proto in two 64-bit integers. Unlike the proto,
+// packed encodings can be compared, hashed and sorted using only integer
+// operations, and they can be created at compile time.
+
+#ifndef CPU_INSTRUCTIONS_X86_PACKED_ENCODING_H_
+#define CPU_INSTRUCTIONS_X86_PACKED_ENCODING_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cpu_instructions/proto/x86/encoding_specification.pb.h"
+#include "util/task/statusor.h"
+
+namespace cpu_instructions {
+namespace x86 {
+
+using ::cpu_instructions::util::StatusOr;
+
+// A bit-packed representation of EncodingSpecification. The conversion between
+// the proto and the packed encoding is lossless for all encoding specifications
+// where the fields fit into the bits reserved for them; this includes all
+// specifications produced by ParseEncodingSpecification.
+//
+// The opcode is stored in the most significant bits of the encoding word, so
+// sorting packed encodings sorts them by their opcode first.
+//
+// Typical usage:
+// const PackedEncoding packed_encoding =
+//     PackedEncoding::FromProto(specification).ValueOrDie();
+// std::unordered_set<PackedEncoding, PackedEncodingHash> encodings;
+// encodings.insert(packed_encoding);
+class PackedEncoding {
+ public:
+  // The kinds of the prefix oneof of EncodingSpecification.
+  enum PrefixKind {
+    kNoPrefix = 0,
+    kLegacyPrefixes = 1,
+    kVexPrefix = 2,
+  };
+
+  // The fields of the packed encoding. The value of each enum item describes
+  // the location of the field: bits 16-23 are the index of the word, bits 8-15
+  // are the index of the least significant bit of the field in the word, and
+  // bits 0-7 are the width of the field in bits. Repeated fields of the proto
+  // are stored as a count and a fixed number of value fields.
+  enum Field : uint32_t {
+    // Fields of EncodingSpecification.
+    kOpcode = 0x002020,
+    kOperandInOpcode = 0x000002,
+    kModRmUsage = 0x000202,
+    kModRmOpcodeExtension = 0x000404,
+    kCodeOffsetBytes = 0x000804,
+    kNumImmediateValues = 0x000c02,
+    kImmediateValueBytes0 = 0x000e04,
+    kImmediateValueBytes1 = 0x001204,
+    kImmediateValueBytes2 = 0x001604,
+    kPrefixKind = 0x001a02,
+
+    // Fields of LegacyPrefixEncodingSpecification.
+    kHasMandatoryRexWPrefix = 0x010001,
+    kHasMandatoryRepePrefix = 0x010101,
+    kHasMandatoryRepnePrefix = 0x010201,
+    kHasMandatoryOperandSizeOverridePrefix = 0x010301,
+    kHasMandatoryAddressSizeOverridePrefix = 0x010401,
+
+    // Fields of VexPrefixEncodingSpecification.
+    kVexPrefixType = 0x010802,
+    kVexOperandUsage = 0x010a02,
+    kVexVectorSize = 0x010c03,
+    kVexMandatoryPrefix = 0x010f02,
+    kVexMapSelect = 0x011102,
+    kVexWUsage = 0x011302,
+    kHasVexOperandSuffix = 0x011501,
+    kVsibUsage = 0x011601,
+    kEvexOpmaskUsage = 0x011702,
+    kEvexMaskingOperation = 0x011902,
+    kNumEvexBInterpretations = 0x011b02,
+    kEvexBInterpretation0 = 0x011d03,
+    kEvexBInterpretation1 = 0x012003,
+    kEvexBInterpretation2 = 0x012303,
+  };
+
+  // The maximal number of values of the repeated fields.
+  static constexpr int kMaxNumImmediateValues = 3;
+  static constexpr int kMaxNumEvexBInterpretations = 3;
+
+  // Creates an empty packed encoding; it is equivalent to an empty
+  // EncodingSpecification proto.
+  constexpr PackedEncoding() : encoding_bits_(0), prefix_bits_(0) {}
+
+  // Creates a packed encoding from its raw bits, as returned by encoding_bits()
+  // and prefix_bits().
+  constexpr PackedEncoding(uint64_t encoding_bits, uint64_t prefix_bits)
+      : encoding_bits_(encoding_bits), prefix_bits_(prefix_bits) {}
+
+  // Converts 'specification' to a packed encoding. Returns an error if one of
+  // the fields of the proto does not fit into the packed encoding.
+  static StatusOr<PackedEncoding> FromProto(
+      const EncodingSpecification& specification);
+
+  // Converts the packed encoding back to the proto.
+  EncodingSpecification ToProto() const;
+
+  // Returns the value of 'field'.
+  constexpr uint32_t Get(Field field) const {
+    return static_cast<uint32_t>((Word(field) >> FieldShift(field)) &
+                                 FieldMask(field));
+  }
+
+  // Returns a copy of the packed encoding where 'field' is set to 'value'. The
+  // bits of 'value' that do not fit into the field are dropped; use
+  // FitsInField to check the value first.
+  constexpr PackedEncoding With(Field field, uint64_t value) const {
+    return FieldWord(field) == 0
+               ? PackedEncoding(ReplaceBits(encoding_bits_, field, value),
+                                prefix_bits_)
+               : PackedEncoding(encoding_bits_,
+                                ReplaceBits(prefix_bits_, field, value));
+  }
+
+  // Returns true if 'value' can be stored in 'field' without loss.
+  static constexpr bool FitsInField(Field field, uint64_t value) {
+    return (value & ~FieldMask(field)) == 0;
+  }
+
+  // Accessors for the most commonly used fields.
+  constexpr uint32_t opcode() const { return Get(kOpcode); }
+  constexpr PrefixKind prefix_kind() const {
+    return static_cast<PrefixKind>(Get(kPrefixKind));
+  }
+
+  // The raw bits of the packed encoding.
+  constexpr uint64_t encoding_bits() const { return encoding_bits_; }
+  constexpr uint64_t prefix_bits() const { return prefix_bits_; }
+
+ private:
+  static constexpr int FieldWord(Field field) { return (field >> 16) & 0xff; }
+  static constexpr int FieldShift(Field field) { return (field >> 8) & 0xff; }
+  static constexpr uint64_t FieldMask(Field field) {
+    return (uint64_t{1} << (field & 0xff)) - 1;
+  }
+  static constexpr uint64_t ReplaceBits(uint64_t word, Field field,
+                                        uint64_t value) {
+    return (word & ~(FieldMask(field) << FieldShift(field))) |
+           ((value & FieldMask(field)) << FieldShift(field));
+  }
+  constexpr uint64_t Word(Field field) const {
+    return FieldWord(field) == 0 ? encoding_bits_ : prefix_bits_;
+  }
+
+  // Contains the fields of EncodingSpecification, except for the prefixes.
+  uint64_t encoding_bits_;
+  // Contains the fields of the legacy or the VEX prefix specification.
+  uint64_t prefix_bits_;
+};
+
+inline constexpr bool operator==(const PackedEncoding& a,
+                                 const PackedEncoding& b) {
+  return a.encoding_bits() == b.encoding_bits() &&
+         a.prefix_bits() == b.prefix_bits();
+}
+
+inline constexpr bool operator!=(const PackedEncoding& a,
+                                 const PackedEncoding& b) {
+  return !(a == b);
+}
+
+inline constexpr bool operator<(const PackedEncoding& a,
+                                const PackedEncoding& b) {
+  return a.encoding_bits() < b.encoding_bits() ||
+         (a.encoding_bits() == b.encoding_bits() &&
+          a.prefix_bits() < b.prefix_bits());
+}
+
+// A hash function for using PackedEncoding as a key of std::unordered_set and
+// std::unordered_map.
+struct PackedEncodingHash {
+  size_t operator()(const PackedEncoding& encoding) const {
+    return static_cast<size_t>(
+        (encoding.encoding_bits() * 0x9e3779b97f4a7c15ULL) ^
+        encoding.prefix_bits());
+  }
+};
+
+}  // namespace x86
+}  // namespace cpu_instructions
+
+#endif  // CPU_INSTRUCTIONS_X86_PACKED_ENCODING_H_
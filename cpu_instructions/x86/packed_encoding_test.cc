@@ -0,0 +1,166 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cpu_instructions/x86/packed_encoding.h"
+
+#include <algorithm>
+#include <unordered_set>
+#include <vector>
+#include "strings/string.h"
+
+#include "cpu_instructions/testing/test_util.h"
+#include "cpu_instructions/util/proto_util.h"
+#include "cpu_instructions/x86/encoding_specification.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "util/task/status.h"
+
+namespace cpu_instructions {
+namespace x86 {
+namespace {
+
+using ::cpu_instructions::testing::EqualsProto;
+
+// The packed encoding can be built and inspected at compile time.
+constexpr PackedEncoding kCompileTimeEncoding =
+    PackedEncoding()
+        .With(PackedEncoding::kOpcode, 0x0fae)
+        .With(PackedEncoding::kPrefixKind, PackedEncoding::kLegacyPrefixes);
+static_assert(kCompileTimeEncoding.opcode() == 0x0fae,
+              "Unexpected opcode of a compile-time packed encoding");
+static_assert(kCompileTimeEncoding.prefix_kind() ==
+                  PackedEncoding::kLegacyPrefixes,
+              "Unexpected prefix kind of a compile-time packed encoding");
+
+// Parses 'specification_str', converts it to a packed encoding, and checks that
+// converting the packed encoding back to a proto gives the original proto.
+PackedEncoding CheckRoundTrip(const string& specification_str) {
+  SCOPED_TRACE(specification_str);
+  const StatusOr<EncodingSpecification> specification_or_status =
+      ParseEncodingSpecification(specification_str);
+  CHECK_OK(specification_or_status.status());
+  const EncodingSpecification& specification =
+      specification_or_status.ValueOrDie();
+  const StatusOr<PackedEncoding> packed_encoding_or_status =
+      PackedEncoding::FromProto(specification);
+  EXPECT_OK(packed_encoding_or_status.status());
+  if (!packed_encoding_or_status.ok()) return PackedEncoding();
+  const PackedEncoding packed_encoding = packed_encoding_or_status.ValueOrDie();
+  EXPECT_THAT(packed_encoding.ToProto(),
+              EqualsProto(specification.DebugString()));
+  EXPECT_EQ(packed_encoding.opcode(), specification.opcode());
+  return packed_encoding;
+}
+
+TEST(PackedEncodingTest, EmptyProto) {
+  const PackedEncoding packed_encoding =
+      PackedEncoding::FromProto(EncodingSpecification()).ValueOrDie();
+  EXPECT_EQ(packed_encoding, PackedEncoding());
+  EXPECT_EQ(packed_encoding.prefix_kind(), PackedEncoding::kNoPrefix);
+  EXPECT_THAT(packed_encoding.ToProto(), EqualsProto(""));
+}
+
+TEST(PackedEncodingTest, RoundTripOfParsedSpecifications) {
+  for (const char* const specification :
+       {"37", "0F 06", "REX + 80 /2 ib", "REX.W + 8B /r", "66 0F 3A 0F /r ib",
+        "F3 0F AE /3", "F2 REX.W 0F 38 F1 /r", "67 E3 cb", "C8 iw ib",
+        "D8 C0+i", "B8+ rd io", "FF /9", "E8 cp", "EA ct",
+        "VEX.NDS.LIG.F3.0F.WIG 58 /r", "VEX.256.66.0F38.W0 92 /vsib",
+        "VEX.NDS.128.66.0F3A.W0 4A /r /is4", "EVEX.NDS.512.66.0F.W1 58 /r",
+        "VEX.L1.0F.W1 41 /r", "VEX.NDD.LIG.F2.0F38.W0 F7 /r"}) {
+    CheckRoundTrip(specification);
+  }
+}
+
+TEST(PackedEncodingTest, RoundTripOfEvexFields) {
+  const EncodingSpecification specification =
+      ParseProtoFromStringOrDie<EncodingSpecification>(R"(
+        opcode: 0x0f58
+        modrm_usage: FULL_MODRM
+        vex_prefix {
+          prefix_type: EVEX_PREFIX
+          vex_operand_usage: VEX_OPERAND_IS_FIRST_SOURCE_REGISTER
+          vector_size: VEX_VECTOR_SIZE_512_BIT
+          mandatory_prefix: MANDATORY_PREFIX_OPERAND_SIZE_OVERRIDE
+          map_select: MAP_SELECT_0F
+          vex_w_usage: VEX_W_IS_ONE
+          evex_b_interpretations: EVEX_B_ENABLES_64_BIT_BROADCAST
+          evex_b_interpretations: EVEX_B_ENABLES_STATIC_ROUNDING_CONTROL
+          opmask_usage: EVEX_OPMASK_IS_OPTIONAL
+          masking_operation: EVEX_MASKING_MERGING_AND_ZEROING
+        })");
+  const PackedEncoding packed_encoding =
+      PackedEncoding::FromProto(specification).ValueOrDie();
+  EXPECT_EQ(packed_encoding.prefix_kind(), PackedEncoding::kVexPrefix);
+  EXPECT_EQ(packed_encoding.Get(PackedEncoding::kNumEvexBInterpretations), 2);
+  EXPECT_THAT(packed_encoding.ToProto(),
+              EqualsProto(specification.DebugString()));
+}
+
+TEST(PackedEncodingTest, EmptyLegacyPrefixesArePreserved) {
+  const PackedEncoding packed_encoding = CheckRoundTrip("0F 06");
+  EXPECT_EQ(packed_encoding.prefix_kind(), PackedEncoding::kLegacyPrefixes);
+  EXPECT_NE(packed_encoding, PackedEncoding().With(PackedEncoding::kOpcode,
+                                                   packed_encoding.opcode()));
+}
+
+TEST(PackedEncodingTest, ValuesThatDoNotFit) {
+  EncodingSpecification specification;
+  specification.set_modrm_opcode_extension(16);
+  EXPECT_FALSE(PackedEncoding::FromProto(specification).ok());
+
+  specification.Clear();
+  for (int i = 0; i <= PackedEncoding::kMaxNumImmediateValues; ++i) {
+    specification.add_immediate_value_bytes(1);
+  }
+  EXPECT_FALSE(PackedEncoding::FromProto(specification).ok());
+
+  specification.Clear();
+  specification.add_immediate_value_bytes(16);
+  EXPECT_FALSE(PackedEncoding::FromProto(specification).ok());
+
+  specification.Clear();
+  specification.mutable_vex_prefix()->set_vector_size(
+      static_cast<VexVectorSize>(8));
+  EXPECT_FALSE(PackedEncoding::FromProto(specification).ok());
+}
+
+TEST(PackedEncodingTest, EqualityAndHash) {
+  const std::vector<string> kSpecifications = {
+      "0F 06", "66 0F 06", "0F 06 ib", "0F 06 iw", "0F 06 ib iw", "0F 06 iw ib",
+      "VEX.128.0F.W0 06 /r", "VEX.256.0F.W0 06 /r", "EVEX.512.0F.W0 06 /r"};
+  std::unordered_set<PackedEncoding, PackedEncodingHash> encodings;
+  for (const string& specification : kSpecifications) {
+    const PackedEncoding packed_encoding = CheckRoundTrip(specification);
+    EXPECT_TRUE(encodings.insert(packed_encoding).second) << specification;
+    EXPECT_EQ(packed_encoding, CheckRoundTrip(specification));
+  }
+  EXPECT_EQ(encodings.size(), kSpecifications.size());
+}
+
+TEST(PackedEncodingTest, SortsByOpcodeFirst) {
+  std::vector<PackedEncoding> encodings = {
+      CheckRoundTrip("F3 0F AE /3"), CheckRoundTrip("REX.W + 8B /r"),
+      CheckRoundTrip("37"), CheckRoundTrip("VEX.256.66.0F38.W0 92 /vsib")};
+  std::sort(encodings.begin(), encodings.end());
+  std::vector<uint32_t> opcodes;
+  for (const PackedEncoding& encoding : encodings) {
+    opcodes.push_back(encoding.opcode());
+  }
+  EXPECT_THAT(opcodes, ::testing::ElementsAre(0x37, 0x8b, 0x0fae, 0x0f3892));
+}
+
+}  // namespace
+}  // namespace x86
+}  // namespace cpu_instructions
@@ -15,6 +15,7 @@
 #include "cpu_instructions/x86/pdf/intel_sdm_extractor.h"
 
 #include <algorithm>
+#include <deque>
 #include <map>
 #include <set>
 #include <unordered_map>
@@ -22,10 +23,13 @@
 #include <utility>
 #include <vector>
 
+#include "cpu_instructions/util/parallel.h"
 #include "cpu_instructions/x86/pdf/pdf_document_utils.h"
 #include "cpu_instructions/x86/pdf/vendor_syntax.h"
+#include "gflags/gflags.h"
 #include "glog/logging.h"
 #include "re2/re2.h"
+#include "re2/set.h"
 #include "strings/case.h"
 #include "strings/str_cat.h"
 #include "strings/str_join.h"
@@ -34,8 +38,13 @@
 #include "strings/strip.h"
 #include "strings/util.h"
 #include "util/gtl/map_util.h"
+#include "util/gtl/perfect_hash_map.h"
 #include "util/gtl/ptr_util.h"
 
+DEFINE_int32(cpu_instructions_sdm_extractor_num_threads, 0,
+             "The number of threads used to extract the instruction sections "
+             "from the SDM. When zero, uses one thread per hardware thread.");
+
 namespace cpu_instructions {
 namespace x86 {
 namespace pdf {
@@ -47,42 +56,82 @@ using re2::StringPiece;
 // The top/bottom page margin, in pixels.
 constexpr const float kPageMargin = 50.0f;
 
+// A list of (value, regexp) pairs, where the value associated to a text is the
+// value of the first regexp in the list that fully matches the text. All the
+// regexps are compiled into a single RE2::Set, so that finding the first
+// matching regexp scans the text only once instead of trying each regexp in
+// turn.
+template <typename ValueType>
+class RegexpMatchers {
+ public:
+  // The value type of 'matchers' must be std::pair<ValueType, RE2*> or other
+  // type that behaves the same way. Note that the following two containers
+  // satisfy the requirements: std::map<ValueType, RE2*> and
+  // std::vector<std::pair<ValueType, RE2*>>. The order of the pairs in the
+  // container is the order in which the regexps are tried.
+  template <typename Container>
+  explicit RegexpMatchers(const Container& matchers)
+      : set_(RE2::DefaultOptions, RE2::ANCHOR_BOTH) {
+    for (const auto& pair : matchers) {
+      string error;
+      CHECK_EQ(set_.Add(pair.second->pattern(), &error), matchers_.size())
+          << "Invalid regexp '" << pair.second->pattern() << "': " << error;
+      matchers_.emplace_back(pair.first, pair.second);
+    }
+    CHECK(set_.Compile()) << "Unable to compile regexp set";
+  }
+
+  // Returns the first pair whose regexp fully matches 'text', or nullptr if
+  // there is no such pair.
+  const std::pair<ValueType, const RE2*>* FindFirstMatch(
+      const string& text) const {
+    std::vector<int> matching_indices;
+    if (!set_.Match(text, &matching_indices)) return nullptr;
+    // RE2::Set does not report the matching regexps in any specific order.
+    const int first_index =
+        *std::min_element(matching_indices.begin(), matching_indices.end());
+    return &matchers_[first_index];
+  }
+
+ private:
+  std::vector<std::pair<ValueType, const RE2*>> matchers_;
+  RE2::Set set_;
+};
+
 // Returns the value associated to the first matching regexp. If there is a
 // match, the function returns the first matching RE2 object from 'matchers';
 // otherwise, it returns nullptr.
-//
-// The value type of the container must be std::pair<value, matcher> or other
-// type that behaves the same way. Note that the following two containers
-// satisfy the requirements: std::map<ValueType, RE2*> and
-// std::vector<std::pair<ValueType, RE2*>>.
-template <typename ValueType, typename Container>
-const RE2* TryParse(const Container& matchers, const string& text,
-                    ValueType* output) {
+template <typename ValueType>
+const RE2* TryParse(const RegexpMatchers<ValueType>& matchers,
+                    const string& text, ValueType* output) {
   CHECK(output != nullptr) << "must not be nullptr";
-  for (const auto& pair : matchers) {
-    if (RE2::FullMatch(text, *pair.second)) {
-      *output = pair.first;
-      return pair.second;
-    }
-  }
-  return nullptr;
+  const auto* const match = matchers.FindFirstMatch(text);
+  if (match == nullptr) return nullptr;
+  *output = match->first;
+  return match->second;
 }
 
 // Returns the value associated to the first matching regexp in the map or the
 // provided default value.
-template <typename ValueType, typename Container>
-ValueType ParseWithDefault(const Container& matchers, const string& text,
-                           const ValueType& default_value) {
-  for (const auto& pair : matchers) {
-    if (RE2::FullMatch(text, *pair.second)) return pair.first;
-  }
-  return default_value;
+template <typename ValueType>
+ValueType ParseWithDefault(const RegexpMatchers<ValueType>& matchers,
+                           const string& text, const ValueType& default_value) {
+  const auto* const match = matchers.FindFirstMatch(text);
+  return match == nullptr ? default_value : match->first;
 }
 
 typedef std::vector<const PdfPage*> Pages;
 typedef std::vector<const PdfTextTableRow*> Rows;
 typedef google::protobuf::RepeatedField<InstructionTable::Column> Columns;
 
+// The rows of a sub section of an instruction. The rows point to the rows of
+// the PdfDocument, and they are copied to a SubSection proto only when the
+// caller asks for them.
+struct SubSectionRows {
+  SubSection::Type type = SubSection::UNKNOWN;
+  Rows rows;
+};
+
 void RemoveSpaceAndLF(string* text) { strrmm(text, "\n "); }
 
 constexpr const size_t kMaxInstructionIdSize = 60;
@@ -93,11 +142,14 @@ constexpr const char kInstructionSetRef[] = "INSTRUCTION SET REFERENCE";
 // - in the footer of a page for a particular instruction
 // It does so by removing some characters and imposing a limit on the text size.
 // Limiting the size is necessary because when text is too long it gets
-// truncated in different ways.
-string Normalize(string text) {
-  strrmm(&text, "\n ∗*");
-  if (text.size() > kMaxInstructionIdSize) text.resize(kMaxInstructionIdSize);
-  return text;
+// truncated in different ways. The id is stored to 'output', whose buffer is
+// reused.
+void Normalize(const string& text, string* output) {
+  output->assign(text);
+  strrmm(output, "\n ∗*");
+  if (output->size() > kMaxInstructionIdSize) {
+    output->resize(kMaxInstructionIdSize);
+  }
 }
 
 // If page number is even, returns the rightmost string in the footer, else the
@@ -107,39 +159,6 @@ const string& GetFooterSectionName(const PdfPage& page) {
                                 : GetCellTextOrEmpty(page, -1, 0);
 }
 
-// If 'page' is the first page of an instruction, returns a unique identifier
-// for this instruction. Otherwise return empty string.
-string GetInstructionGroupId(const PdfPage& page) {
-  if (!strings::StartsWith(GetCellTextOrEmpty(page, 0, 0), kInstructionSetRef))
-    return {};
-  const string maybe_instruction = Normalize(GetCellTextOrEmpty(page, 1, 0));
-  const string& footer_section_name = GetFooterSectionName(page);
-  if (maybe_instruction == Normalize(footer_section_name)) {
-    return footer_section_name;
-  }
-  return {};
-}
-
-// True if page footer's corresponds to the same instruction_id.
-bool IsPageInstruction(const PdfPage& page,
-                       const string& instruction_group_id) {
-  return Normalize(GetFooterSectionName(page)) ==
-         Normalize(instruction_group_id);
-}
-
-// Returns the list of pages an instruction spans.
-std::vector<const PdfPage*> GetInstructionsPages(
-    const PdfDocument& document, const int first_page,
-    const string& instruction_group_id) {
-  std::vector<const PdfPage*> result;
-  for (int i = first_page; i < document.pages_size(); ++i) {
-    const auto& page = document.pages(i);
-    if (!IsPageInstruction(page, instruction_group_id)) break;
-    result.push_back(&page);
-  }
-  return result;
-}
-
 constexpr const float kMinSubSectionTitleFontSize = 9.5f;
 
 string GetSubSectionTitle(const PdfTextTableRow& row) {
@@ -155,132 +174,138 @@ string GetSubSectionTitle(const PdfTextTableRow& row) {
   return text;
 }
 
-const std::map<SubSection::Type, const RE2*>& GetSubSectionMatchers() {
-  static const auto* kSubSection = new std::map<SubSection::Type, const RE2*>{
-      {SubSection::CPP_COMPILER_INTRISIC,
-       new RE2(".*C/C\\+\\+ Compiler Intrinsic Equivalent.*")},
-      {SubSection::DESCRIPTION, new RE2("Description")},
-      {SubSection::EFFECTIVE_OPERAND_SIZE, new RE2("Effective Operand Size")},
-      {SubSection::EXCEPTIONS, new RE2("Exceptions \\(All .*")},
-      {SubSection::EXCEPTIONS_64BITS_MODE,
-       new RE2("64-[Bb]it Mode Exceptions")},
-      {SubSection::EXCEPTIONS_COMPATIBILITY_MODE,
-       new RE2("Compatibility Mode Exceptions")},
-      {SubSection::EXCEPTIONS_FLOATING_POINT,
-       new RE2("Floating-Point Exceptions")},
-      {SubSection::EXCEPTIONS_NUMERIC, new RE2("Numeric Exceptions")},
-      {SubSection::EXCEPTIONS_OTHER, new RE2("Other Exceptions")},
-      {SubSection::EXCEPTIONS_PROTECTED_MODE,
-       new RE2("Protected Mode Exceptions")},
-      {SubSection::EXCEPTIONS_REAL_ADDRESS_MODE,
-       new RE2("Real[- ]Address Mode Exceptions")},
-      {SubSection::EXCEPTIONS_VIRTUAL_8086_MODE,
-       new RE2("Virtual[- ]8086 Mode Exceptions")},
-      {SubSection::FLAGS_AFFECTED, new RE2("A?Flags Affected")},
-      {SubSection::FLAGS_AFFECTED_FPU, new RE2("FPU Flags Affected")},
-      {SubSection::FLAGS_AFFECTED_INTEGER, new RE2("Integer Flags Affected")},
-      {SubSection::IA32_ARCHITECTURE_COMPATIBILITY,
-       new RE2("IA-32 Architecture Compatibility")},
-      {SubSection::IA32_ARCHITECTURE_LEGACY_COMPATIBILITY,
-       new RE2("IA-32 Architecture Legacy Compatibility")},
-      {SubSection::IMPLEMENTATION_NOTES, new RE2("Implementation Notes?")},
-      {SubSection::INSTRUCTION_OPERAND_ENCODING,
-       new RE2("Instruction Operand Encoding1?")},
-      {SubSection::NOTES, new RE2("Notes:")},
-      {SubSection::OPERATION, new RE2("Operation")},
-      {SubSection::OPERATION_IA32_MODE, new RE2("IA-32e Mode Operation")},
-      {SubSection::OPERATION_NON_64BITS_MODE,
-       new RE2("Non-64-Bit Mode Operation")},
-  };
+const RegexpMatchers<SubSection::Type>& GetSubSectionMatchers() {
+  static const auto* kSubSection = new RegexpMatchers<SubSection::Type>(
+      std::map<SubSection::Type, const RE2*>{
+          {SubSection::CPP_COMPILER_INTRISIC,
+           new RE2(".*C/C\\+\\+ Compiler Intrinsic Equivalent.*")},
+          {SubSection::DESCRIPTION, new RE2("Description")},
+          {SubSection::EFFECTIVE_OPERAND_SIZE,
+           new RE2("Effective Operand Size")},
+          {SubSection::EXCEPTIONS, new RE2("Exceptions \\(All .*")},
+          {SubSection::EXCEPTIONS_64BITS_MODE,
+           new RE2("64-[Bb]it Mode Exceptions")},
+          {SubSection::EXCEPTIONS_COMPATIBILITY_MODE,
+           new RE2("Compatibility Mode Exceptions")},
+          {SubSection::EXCEPTIONS_FLOATING_POINT,
+           new RE2("Floating-Point Exceptions")},
+          {SubSection::EXCEPTIONS_NUMERIC, new RE2("Numeric Exceptions")},
+          {SubSection::EXCEPTIONS_OTHER, new RE2("Other Exceptions")},
+          {SubSection::EXCEPTIONS_PROTECTED_MODE,
+           new RE2("Protected Mode Exceptions")},
+          {SubSection::EXCEPTIONS_REAL_ADDRESS_MODE,
+           new RE2("Real[- ]Address Mode Exceptions")},
+          {SubSection::EXCEPTIONS_VIRTUAL_8086_MODE,
+           new RE2("Virtual[- ]8086 Mode Exceptions")},
+          {SubSection::FLAGS_AFFECTED, new RE2("A?Flags Affected")},
+          {SubSection::FLAGS_AFFECTED_FPU, new RE2("FPU Flags Affected")},
+          {SubSection::FLAGS_AFFECTED_INTEGER,
+           new RE2("Integer Flags Affected")},
+          {SubSection::IA32_ARCHITECTURE_COMPATIBILITY,
+           new RE2("IA-32 Architecture Compatibility")},
+          {SubSection::IA32_ARCHITECTURE_LEGACY_COMPATIBILITY,
+           new RE2("IA-32 Architecture Legacy Compatibility")},
+          {SubSection::IMPLEMENTATION_NOTES, new RE2("Implementation Notes?")},
+          {SubSection::INSTRUCTION_OPERAND_ENCODING,
+           new RE2("Instruction Operand Encoding1?")},
+          {SubSection::NOTES, new RE2("Notes:")},
+          {SubSection::OPERATION, new RE2("Operation")},
+          {SubSection::OPERATION_IA32_MODE, new RE2("IA-32e Mode Operation")},
+          {SubSection::OPERATION_NON_64BITS_MODE,
+           new RE2("Non-64-Bit Mode Operation")},
+      });
   return *kSubSection;
 }
 
-const std::map<InstructionTable::Column, const RE2*>&
+const RegexpMatchers<InstructionTable::Column>&
 GetInstructionColumnMatchers() {
   static const auto* kInstructionColumns =
-      new std::map<InstructionTable::Column, const RE2*>{
-          {InstructionTable::IT_OPCODE, new RE2(R"(Opcode\*{0,3})")},
-          {InstructionTable::IT_OPCODE_INSTRUCTION,
-           new RE2(R"(Opcode\*?/?\n?Instruction)")},
-          {InstructionTable::IT_INSTRUCTION, new RE2(R"(Instruction)")},
-          {InstructionTable::IT_MODE_SUPPORT_64_32BIT,
-           new RE2(R"(64/3\n?2\n?[- ]?\n?bit \n?Mode( \n?Support)?)")},
-          {InstructionTable::IT_MODE_SUPPORT_64BIT,
-           new RE2(R"(64-[Bb]it \n?Mode)")},
-          {InstructionTable::IT_MODE_COMPAT_LEG,
-           new RE2(R"(Compat/\n?Leg Mode\*?)")},
-          {InstructionTable::IT_FEATURE_FLAG,
-           new RE2(R"(CPUID(\ ?\n?Fea\-?\n?ture \n?Flag)?)")},
-          {InstructionTable::IT_DESCRIPTION, new RE2(R"(Description)")},
-          {InstructionTable::IT_OP_EN, new RE2(R"(Op\ ?\n?/?\ ?\n?E\n?[nN])")},
-      };
+      new RegexpMatchers<InstructionTable::Column>(
+          std::map<InstructionTable::Column, const RE2*>{
+              {InstructionTable::IT_OPCODE, new RE2(R"(Opcode\*{0,3})")},
+              {InstructionTable::IT_OPCODE_INSTRUCTION,
+               new RE2(R"(Opcode\*?/?\n?Instruction)")},
+              {InstructionTable::IT_INSTRUCTION, new RE2(R"(Instruction)")},
+              {InstructionTable::IT_MODE_SUPPORT_64_32BIT,
+               new RE2(R"(64/3\n?2\n?[- ]?\n?bit \n?Mode( \n?Support)?)")},
+              {InstructionTable::IT_MODE_SUPPORT_64BIT,
+               new RE2(R"(64-[Bb]it \n?Mode)")},
+              {InstructionTable::IT_MODE_COMPAT_LEG,
+               new RE2(R"(Compat/\n?Leg Mode\*?)")},
+              {InstructionTable::IT_FEATURE_FLAG,
+               new RE2(R"(CPUID(\ ?\n?Fea\-?\n?ture \n?Flag)?)")},
+              {InstructionTable::IT_DESCRIPTION, new RE2(R"(Description)")},
+              {InstructionTable::IT_OP_EN,
+               new RE2(R"(Op\ ?\n?/?\ ?\n?E\n?[nN])")},
+      });
   return *kInstructionColumns;
 }
 
-const std::map<InstructionTable::Mode, const RE2*>&
-GetInstructionModeMatchers() {
-  static const auto* kModes = new std::map<InstructionTable::Mode, const RE2*>{
-      {InstructionTable::MODE_V, new RE2(R"([Vv](?:alid)?[1-9*]*)")},
-      {InstructionTable::MODE_I, new RE2(R"(Inv\.|[Ii](?:nvalid)?[1-9*]*)")},
-      {InstructionTable::MODE_NE, new RE2(R"(NA|NE|N\. ?E1?\.[1-9*]*)")},
-      {InstructionTable::MODE_NP, new RE2(R"(NP)")},
-      {InstructionTable::MODE_NI, new RE2(R"(NI)")},
-      {InstructionTable::MODE_NS, new RE2(R"(N\.?S\.?)")},
-  };
+const RegexpMatchers<InstructionTable::Mode>& GetInstructionModeMatchers() {
+  static const auto* kModes = new RegexpMatchers<InstructionTable::Mode>(
+      std::map<InstructionTable::Mode, const RE2*>{
+          {InstructionTable::MODE_V, new RE2(R"([Vv](?:alid)?[1-9*]*)")},
+          {InstructionTable::MODE_I,
+           new RE2(R"(Inv\.|[Ii](?:nvalid)?[1-9*]*)")},
+          {InstructionTable::MODE_NE, new RE2(R"(NA|NE|N\. ?E1?\.[1-9*]*)")},
+          {InstructionTable::MODE_NP, new RE2(R"(NP)")},
+          {InstructionTable::MODE_NI, new RE2(R"(NI)")},
+          {InstructionTable::MODE_NS, new RE2(R"(N\.?S\.?)")},
+      });
   return *kModes;
 }
 
-const std::set<string>& GetValidFeatureSet() {
-  static const auto* kValidFeatures = new std::set<string>{
-      "3DNOW",      "ADX",      "AES",        "AVX",      "AVX2",
-      "AVX512BW",   "AVX512CD", "AVX512DQ",   "AVX512ER", "AVX512F",
-      "AVX512IFMA", "AVX512PF", "AVX512VBMI", "AVX512VL", "BMI1",
-      "BMI2",       "CLMUL",    "CLWB",       "F16C",     "FMA",
-      "FPU",        "FSGSBASE", "HLE",        "INVPCID",  "LZCNT",
-      "MMX",        "MPX",      "OSPKE",      "PRFCHW",   "RDPID",
-      "RDRAND",     "RDSEED",   "RTM",        "SHA",      "SMAP",
-      "SSE",        "SSE2",     "SSE3",       "SSE4_1",   "SSE4_2",
-      "SSSE3",      "XSAVEOPT"};
-  return *kValidFeatures;
-}
+constexpr const char* kValidFeatures[] = {
+    "3DNOW",      "ADX",      "AES",        "AVX",      "AVX2",
+    "AVX512BW",   "AVX512CD", "AVX512DQ",   "AVX512ER", "AVX512F",
+    "AVX512IFMA", "AVX512PF", "AVX512VBMI", "AVX512VL", "BMI1",
+    "BMI2",       "CLMUL",    "CLWB",       "F16C",     "FMA",
+    "FPU",        "FSGSBASE", "HLE",        "INVPCID",  "LZCNT",
+    "MMX",        "MPX",      "OSPKE",      "PRFCHW",   "RDPID",
+    "RDRAND",     "RDSEED",   "RTM",        "SHA",      "SMAP",
+    "SSE",        "SSE2",     "SSE3",       "SSE4_1",   "SSE4_2",
+    "SSSE3",      "XSAVEOPT"};
+constexpr auto kValidFeatureSet = gtl::MakePerfectHashTable(kValidFeatures);
 
 using OperandEncoding =
     InstructionTable::OperandEncodingCrossref::OperandEncoding;
 using OperandEncodingMatchers =
-    std::vector<std::pair<OperandEncoding::OperandEncodingSpec, RE2*>>;
+    RegexpMatchers<OperandEncoding::OperandEncodingSpec>;
 
 const OperandEncodingMatchers& GetOperandEncodingSpecMatchers() {
   // See unit tests for examples.
-  static const auto* kOperandEncodingSpec = new OperandEncodingMatchers{{
-      {OperandEncoding::OE_NA, new RE2("NA")},
-      {OperandEncoding::OE_VEX_SUFFIX, new RE2(R"(imm8\[7:4\])")},
-      {OperandEncoding::OE_IMMEDIATE,
-       new RE2(
-           R"((?:(?:[iI]mm(?:\/?(?:8|16|26|32|64)){1,4})(?:\[[0-9]:[0-9]\])?|Offset|Moffs|iw)(?:\s+\(([wW, rR]+)\))?)")},
-      {OperandEncoding::OE_MOD_REG, new RE2(R"(ModRM:reg\s+\(([rR, wW]+)\))")},
-      {OperandEncoding::OE_MOD_RM,
-       new RE2(
-           R"(ModRM:r/?m\s+\(([rR, wW]+)(?:ModRM:\[[0-9]+:[0-9]+\] must (?:not )?be [01]+b)?\))")},
-      {OperandEncoding::OE_VEX,
-       new RE2(R"(VEX\.(?:[1v]{4})(?:\s+\(([rR, wW]+)\))?)")},
-      {OperandEncoding::OE_EVEX_V,
-       new RE2(R"((?:EVEX\.)?(?:v{4})(?:\s+\(([rR, wW]+)\))?)")},
-      {OperandEncoding::OE_OPCODE,
-       new RE2(R"(opcode\s*\+\s*rd\s+\(([rR, wW]+)\))")},
-      {OperandEncoding::OE_IMPLICIT,
-       new RE2(R"([Ii]mplicit XMM0(?:\s+\(([rR, wW]+)\))?)")},
-      {OperandEncoding::OE_REGISTERS,
-       new RE2(
-           R"(<?[A-Z][A-Z0-9]+>?(?:/<?[A-Z][A-Z0-9]+>?)*(?:\s+\(([rR, wW]+)\))?)")},
-      {OperandEncoding::OE_REGISTERS2,
-       new RE2(R"(RDX/EDX is implied 64/32 bits \nsource)")},
-      {OperandEncoding::OE_CONSTANT, new RE2(R"([0-9])")},
-      {OperandEncoding::OE_SIB,
-       new RE2(
-           R"(SIB\.base\s+\(r\):\s+Address of pointer\nSIB\.index\(r\))")},
-      {OperandEncoding::OE_VSIB,
-       new RE2(R"(BaseReg \(R\): VSIB:base,\nVectorReg\(R\): VSIB:index)")},
-  }};
+  static const auto* kOperandEncodingSpec = new OperandEncodingMatchers(
+      std::vector<std::pair<OperandEncoding::OperandEncodingSpec, RE2*>>{
+          {OperandEncoding::OE_NA, new RE2("NA")},
+          {OperandEncoding::OE_VEX_SUFFIX, new RE2(R"(imm8\[7:4\])")},
+          {OperandEncoding::OE_IMMEDIATE,
+           new RE2(
+               R"((?:(?:[iI]mm(?:\/?(?:8|16|26|32|64)){1,4})(?:\[[0-9]:[0-9]\])?|Offset|Moffs|iw)(?:\s+\(([wW, rR]+)\))?)")},
+          {OperandEncoding::OE_MOD_REG,
+           new RE2(R"(ModRM:reg\s+\(([rR, wW]+)\))")},
+          {OperandEncoding::OE_MOD_RM,
+           new RE2(
+               R"(ModRM:r/?m\s+\(([rR, wW]+)(?:ModRM:\[[0-9]+:[0-9]+\] must (?:not )?be [01]+b)?\))")},
+          {OperandEncoding::OE_VEX,
+           new RE2(R"(VEX\.(?:[1v]{4})(?:\s+\(([rR, wW]+)\))?)")},
+          {OperandEncoding::OE_EVEX_V,
+           new RE2(R"((?:EVEX\.)?(?:v{4})(?:\s+\(([rR, wW]+)\))?)")},
+          {OperandEncoding::OE_OPCODE,
+           new RE2(R"(opcode\s*\+\s*rd\s+\(([rR, wW]+)\))")},
+          {OperandEncoding::OE_IMPLICIT,
+           new RE2(R"([Ii]mplicit XMM0(?:\s+\(([rR, wW]+)\))?)")},
+          {OperandEncoding::OE_REGISTERS,
+           new RE2(
+               R"(<?[A-Z][A-Z0-9]+>?(?:/<?[A-Z][A-Z0-9]+>?)*(?:\s+\(([rR, wW]+)\))?)")},
+          {OperandEncoding::OE_REGISTERS2,
+           new RE2(R"(RDX/EDX is implied 64/32 bits \nsource)")},
+          {OperandEncoding::OE_CONSTANT, new RE2(R"([0-9])")},
+          {OperandEncoding::OE_SIB,
+           new RE2(
+               R"(SIB\.base\s+\(r\):\s+Address of pointer\nSIB\.index\(r\))")},
+          {OperandEncoding::OE_VSIB,
+           new RE2(R"(BaseReg \(R\): VSIB:base,\nVectorReg\(R\): VSIB:index)")},
+      });
   return *kOperandEncodingSpec;
 }
 
@@ -312,7 +337,7 @@ string CleanupDescription(string input) {
   return output;
 }
 
-// We want to normalize features to the set defined by GetValidFeatureSet or
+// We want to normalize features to the set defined by kValidFeatures or
 // logical composition of them (several features separated by '&&' or '||')
 // TODO(gchatelet): Move this to configuration file.
 string FixFeature(string feature) {
@@ -423,7 +448,7 @@ void ParseCell(const InstructionTable::Column column, string text,
         const string piece = raw_piece.ToString();
         if (!feature_name->empty()) feature_name->append(" ");
         const bool is_logic_operator = piece == "&&" || piece == "||";
-        if (is_logic_operator || ContainsKey(GetValidFeatureSet(), piece)) {
+        if (is_logic_operator || kValidFeatureSet.Contains(piece)) {
           StrAppend(feature_name, piece);
         } else {
           feature_name->append(kUnknown);
@@ -439,20 +464,21 @@ void ParseCell(const InstructionTable::Column column, string text,
   }
 }
 
-void ParseInstructionTable(const SubSection& sub_section,
+void ParseInstructionTable(const SubSectionRows& sub_section,
                            InstructionTable* table) {
-  CHECK(sub_section.rows_size()) << "sub_section must have rows";
+  CHECK(!sub_section.rows.empty()) << "sub_section must have rows";
   // First we collect the content of the table and get rid of redundant header
   // lines.
-  std::vector<PdfTextTableRow> rows;
-  for (const auto& row : sub_section.rows()) {
+  Rows rows;
+  for (const PdfTextTableRow* const pdf_row : sub_section.rows) {
+    const PdfTextTableRow& row = *pdf_row;
     if (table->columns().empty()) {
       // Columns are empty, we are parsing the header of the instruction table.
       for (const auto& block : row.blocks()) {
         CHECK(!block.text().empty())
             << "empty text block while parsing instruction table header, "
-               "current subsection : "
-            << sub_section.DebugString();
+               "current row : "
+            << row.DebugString();
         InstructionTable::Column column;
         if (TryParse(GetInstructionColumnMatchers(), block.text(), &column) !=
             nullptr) {
@@ -480,7 +506,7 @@ void ParseInstructionTable(const SubSection& sub_section,
       if (first_cell_type == first_column_type) {
         continue;
       }
-      rows.push_back(row);
+      rows.push_back(&row);
     }
   }
   const auto& columns = table->columns();
@@ -489,30 +515,38 @@ void ParseInstructionTable(const SubSection& sub_section,
     return;
   }
   // Sometimes for IT_OPCODE_INSTRUCTION columns, the instruction is on a
-  // separate line so we want to put it back the previous line.
+  // separate line so we want to put it back the previous line. The rows of the
+  // document are not modified: the rows that need to be updated are copied to
+  // 'merged_rows'.
+  std::deque<PdfTextTableRow> merged_rows;
   if (columns.Get(0) == InstructionTable::IT_OPCODE_INSTRUCTION) {
-    PdfTextTableRow* previous = nullptr;
-    for (auto& row : rows) {
-      if (previous && row.blocks().size() == 1) {
-        auto* previous_text = previous->mutable_blocks(0)->mutable_text();
+    const PdfTextTableRow** previous = nullptr;
+    for (const PdfTextTableRow*& row : rows) {
+      if (previous && row->blocks().size() == 1) {
+        if (merged_rows.empty() || *previous != &merged_rows.back()) {
+          merged_rows.push_back(**previous);
+          *previous = &merged_rows.back();
+        }
+        auto* previous_text =
+            merged_rows.back().mutable_blocks(0)->mutable_text();
         previous_text->push_back('\n');
-        previous_text->append(row.blocks().Get(0).text());
+        previous_text->append(row->blocks().Get(0).text());
       }
       previous = &row;
     }
     // Removing lonely lines.
     rows.erase(std::remove_if(rows.begin(), rows.end(),
-                              [](const PdfTextTableRow& row) {
-                                return row.blocks_size() == 1;
+                              [](const PdfTextTableRow* row) {
+                                return row->blocks_size() == 1;
                               }),
                rows.end());
   }
   // Parse instructions
-  for (const auto& row : rows) {
-    if (row.blocks_size() != columns.size()) break;  // end of the table
+  for (const PdfTextTableRow* const row : rows) {
+    if (row->blocks_size() != columns.size()) break;  // end of the table
     auto* instruction = table->add_instructions();
     int i = 0;
-    for (const auto& block : row.blocks()) {
+    for (const auto& block : row->blocks()) {
       ParseCell(table->columns(i++), block.text(), instruction);
     }
   }
@@ -559,10 +593,11 @@ void ParseOperandEncodingTableRow(const PdfTextTableRow& row,
 // Extracts information from the Operand Encoding Table.
 // For each row in the table we create an operand_encoding containing a
 // crossreference_name and a list of operand_encoding_specs.
-void ParseOperandEncodingTable(const SubSection& sub_section,
+void ParseOperandEncodingTable(const SubSectionRows& sub_section,
                                InstructionTable* table) {
   size_t column_count = 0;
-  for (const auto& row : sub_section.rows()) {
+  for (const PdfTextTableRow* const pdf_row : sub_section.rows) {
+    const PdfTextTableRow& row = *pdf_row;
     if (column_count == 0) {
       // Parsing the operand encoding table header, we just make sure the text
       // is valid but don't store any informations.
@@ -585,10 +620,9 @@ void ParseOperandEncodingTable(const SubSection& sub_section,
 
 // Read pages and gathers lines that belong to a particular SubSection (e.g.
 // "Description", "Operand Encoding Table", "Affected Flags"...)
-std::vector<SubSection> ExtractSubSectionRows(const Pages& pages) {
-  std::vector<SubSection> output;
+std::vector<SubSectionRows> ExtractSubSectionRows(const Pages& pages) {
+  std::vector<SubSectionRows> output(1);
   bool first_row = true;
-  SubSection current;
   for (const auto* page : pages) {
     for (const auto* pdf_row : GetPageBodyRows(*page, kPageMargin)) {
       const string section_title = GetSubSectionTitle(*pdf_row);
@@ -597,25 +631,32 @@ std::vector<SubSection> ExtractSubSectionRows(const Pages& pages) {
                     : ParseWithDefault(GetSubSectionMatchers(), section_title,
                                        SubSection::UNKNOWN);
       if (section_type != SubSection::UNKNOWN) {
-        output.push_back(current);
-        current.Clear();
-        current.set_type(section_type);
+        output.emplace_back();
+        output.back().type = section_type;
       } else {
-        PdfTextTableRow row = *pdf_row;
-        for (auto& block : *row.mutable_blocks()) {
-          block.clear_bounding_box();
-          block.clear_font_size();
-        }
-        row.clear_bounding_box();
-        row.Swap(current.add_rows());
+        output.back().rows.push_back(pdf_row);
       }
       first_row = false;
     }
   }
-  output.push_back(current);
   return output;
 }
 
+// Copies the rows of 'sub_section' to 'output', without the layout
+// information.
+void CopySubSectionRows(const SubSectionRows& sub_section, SubSection* output) {
+  output->mutable_rows()->Reserve(sub_section.rows.size());
+  for (const PdfTextTableRow* const pdf_row : sub_section.rows) {
+    PdfTextTableRow* const row = output->add_rows();
+    *row = *pdf_row;
+    for (auto& block : *row->mutable_blocks()) {
+      block.clear_bounding_box();
+      block.clear_font_size();
+    }
+    row->clear_bounding_box();
+  }
+}
+
 // This function sets the proper encoding for each instruction by looking it up
 // in the Operand Encoding Table. Duplicated identifiers in the Operand Encoding
 // Table are discarded and encoding is set to ANY_ENCODING.
@@ -719,17 +760,20 @@ void PairOperandEncodings(InstructionSection* section) {
   }
 }
 
-// Process the sub sections of the instructions and extract relevant data.
-void ProcessSubSections(std::vector<SubSection> sub_sections,
+// Process the sub sections of the instructions and extract relevant data. When
+// 'keep_sub_section_rows' is true, the rows of each sub section are also copied
+// to 'section'.
+void ProcessSubSections(const std::vector<SubSectionRows>& sub_sections,
+                        bool keep_sub_section_rows,
                         InstructionSection* section) {
-  for (SubSection& sub_section : sub_sections) {
+  for (const SubSectionRows& sub_section : sub_sections) {
     // Discard empty sections.
-    if (sub_section.rows().empty()) {
+    if (sub_section.rows.empty()) {
       continue;
     }
     // Process
     auto* instruction_table = section->mutable_instruction_table();
-    switch (sub_section.type()) {
+    switch (sub_section.type) {
       case SubSection::INSTRUCTION_TABLE:
         ParseInstructionTable(sub_section, instruction_table);
         break;
@@ -739,13 +783,60 @@ void ProcessSubSections(std::vector<SubSection> sub_sections,
       default:
         break;
     }
-    sub_section.Swap(section->add_sub_sections());
+    SubSection* const output_sub_section = section->add_sub_sections();
+    output_sub_section->set_type(sub_section.type);
+    if (keep_sub_section_rows) {
+      CopySubSectionRows(sub_section, output_sub_section);
+    }
   }
   PairOperandEncodings(section);
 }
 
 }  // namespace
 
+void InstructionSectionIndexer::AddPage(const PdfPage& page) {
+  const int page_index = num_pages_++;
+  const string& footer_section_name = GetFooterSectionName(page);
+  Normalize(footer_section_name, &normalized_text_);
+  const int footer_key_id = InternFooterKey(normalized_text_);
+  if (footer_key_id != current_footer_key_id_) {
+    CloseOpenSections(page_index - 1);
+    current_footer_key_id_ = footer_key_id;
+  }
+  // If 'page' is the first page of an instruction, the normalized instruction
+  // name in the header matches the footer, and the footer is used as a unique
+  // identifier for this instruction.
+  if (!footer_section_name.empty() &&
+      strings::StartsWith(GetCellTextOrEmpty(page, 0, 0), kInstructionSetRef)) {
+    Normalize(GetCellTextOrEmpty(page, 1, 0), &normalized_text_);
+    if (FindWithDefault(footer_key_ids_, normalized_text_, -1) ==
+        footer_key_id) {
+      open_sections_.emplace_back(footer_section_name, page_index);
+    }
+  }
+}
+
+void InstructionSectionIndexer::Finish() {
+  CloseOpenSections(num_pages_ - 1);
+  current_footer_key_id_ = -1;
+}
+
+void InstructionSectionIndexer::CloseOpenSections(int last_page_index) {
+  for (auto& id_first_page : open_sections_) {
+    sections_[id_first_page.first] =
+        PageRange(id_first_page.second, last_page_index);
+  }
+  open_sections_.clear();
+}
+
+int InstructionSectionIndexer::InternFooterKey(const string& key) {
+  const auto it = footer_key_ids_.find(key);
+  if (it != footer_key_ids_.end()) return it->second;
+  const int key_id = footer_key_ids_.size();
+  footer_key_ids_.emplace(key, key_id);
+  return key_id;
+}
+
 OperandEncoding ParseOperandEncodingTableCell(const string& content) {
   OperandEncoding::OperandEncodingSpec spec = OperandEncoding::OE_NA;
   const RE2* const regexp =
@@ -799,25 +890,50 @@ OperandEncoding ParseOperandEncodingTableCell(const string& content) {
   return encoding;
 }
 
-SdmDocument ConvertPdfDocumentToSdmDocument(const PdfDocument& pdf) {
+SdmDocument ConvertPdfDocumentToSdmDocument(const PdfDocument& pdf,
+                                            bool keep_sub_section_rows) {
   // Find all instruction pages.
   SdmDocument sdm_document;
+  InstructionSectionIndexer section_indexer;
+  for (const PdfPage& page : pdf.pages()) {
+    section_indexer.AddPage(page);
+  }
+  section_indexer.Finish();
   std::map<string, Pages> instruction_group_id_to_pages;
-  for (int i = 0; i < pdf.pages_size(); ++i) {
-    const string instruction_group_id = GetInstructionGroupId(pdf.pages(i));
-    if (instruction_group_id.empty()) continue;
-    instruction_group_id_to_pages[instruction_group_id] =
-        GetInstructionsPages(pdf, i, instruction_group_id);
+  for (const auto& id_page_range : section_indexer.sections()) {
+    const InstructionSectionIndexer::PageRange& page_range =
+        id_page_range.second;
+    Pages& pages = instruction_group_id_to_pages[id_page_range.first];
+    for (int i = page_range.first; i <= page_range.second; ++i) {
+      pages.push_back(&pdf.pages(i));
+    }
   }
-  // Now processing instruction pages
+  // Now processing instruction pages. The sections only read their own pages,
+  // so they are processed in parallel; they are then added to the document in
+  // the order of instruction_group_id_to_pages to keep the output stable.
+  std::vector<const std::pair<const string, Pages>*> sections_to_process;
+  sections_to_process.reserve(instruction_group_id_to_pages.size());
   for (const auto& id_pages_pair : instruction_group_id_to_pages) {
-    InstructionSection section;
-    const auto& group_id = id_pages_pair.first;
-    const auto& pages = id_pages_pair.second;
-    LOG(INFO) << "Processing section id " << group_id << " pages "
-              << pages.front()->number() << "-" << pages.back()->number();
-    section.set_id(group_id);
-    ProcessSubSections(ExtractSubSectionRows(pages), &section);
+    sections_to_process.push_back(&id_pages_pair);
+  }
+  std::vector<InstructionSection> sections(sections_to_process.size());
+  ParallelFor(sections_to_process.size(),
+              FLAGS_cpu_instructions_sdm_extractor_num_threads,
+              [&sections_to_process, &sections,
+               keep_sub_section_rows](int section_index) {
+                const auto& id_pages_pair = *sections_to_process[section_index];
+                const auto& group_id = id_pages_pair.first;
+                const auto& pages = id_pages_pair.second;
+                InstructionSection& section = sections[section_index];
+                LOG(INFO) << "Processing section id " << group_id << " pages "
+                          << pages.front()->number() << "-"
+                          << pages.back()->number();
+                section.set_id(group_id);
+                ProcessSubSections(ExtractSubSectionRows(pages),
+                                   keep_sub_section_rows, &section);
+              });
+  sdm_document.mutable_instruction_sections()->Reserve(sections.size());
+  for (InstructionSection& section : sections) {
     section.Swap(sdm_document.add_instruction_sections());
   }
   return sdm_document;
@@ -836,6 +952,29 @@ InstructionSetProto ProcessIntelSdmDocument(const SdmDocument& sdm_document) {
   return instruction_set;
 }
 
+InstructionSetProto ProcessIntelSdmDocument(SdmDocument&& sdm_document) {
+  InstructionSetProto instruction_set;
+  int num_instructions = 0;
+  for (const auto& section : sdm_document.instruction_sections()) {
+    num_instructions += section.instruction_table().instructions_size();
+  }
+  auto* const instructions = instruction_set.mutable_instructions();
+  instructions->Reserve(num_instructions);
+  std::vector<InstructionProto*> section_instructions;
+  for (auto& section : *sdm_document.mutable_instruction_sections()) {
+    auto* const table_instructions =
+        section.mutable_instruction_table()->mutable_instructions();
+    section_instructions.resize(table_instructions->size());
+    table_instructions->ExtractSubrange(0, table_instructions->size(),
+                                        section_instructions.data());
+    for (InstructionProto* const instruction : section_instructions) {
+      instruction->set_group_id(section.id());
+      instructions->AddAllocated(instruction);
+    }
+  }
+  return instruction_set;
+}
+
 }  // namespace pdf
 }  // namespace x86
 }  // namespace cpu_instructions
@@ -15,6 +15,10 @@
 #ifndef CPU_INSTRUCTIONS_X86_PDF_INTEL_SDM_EXTRACTOR_H_
 #define CPU_INSTRUCTIONS_X86_PDF_INTEL_SDM_EXTRACTOR_H_
 
+#include <map>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 #include "strings/string.h"
 
 #include "cpu_instructions/proto/instructions.pb.h"
@@ -25,10 +29,76 @@ namespace cpu_instructions {
 namespace x86 {
 namespace pdf {
 
-SdmDocument ConvertPdfDocumentToSdmDocument(const PdfDocument& document);
+// Finds the instruction sections of a document, i.e. the ranges of pages that
+// describe a single instruction, in a single linear pass over the pages. The
+// pages are added one by one, so that the sections can be found while the pages
+// are being parsed.
+//
+// A section starts on a page whose header says "INSTRUCTION SET REFERENCE" and
+// whose title matches the footer of the page, and it spans all the following
+// pages with the same footer. The normalized footer of each page is computed
+// only once, and interned so that following pages are compared by id.
+class InstructionSectionIndexer {
+ public:
+  // An inclusive range of page indices, in the order in which they were added.
+  using PageRange = std::pair<int, int>;
+
+  InstructionSectionIndexer() {}
+
+  InstructionSectionIndexer(const InstructionSectionIndexer&) = delete;
+  InstructionSectionIndexer& operator=(const InstructionSectionIndexer&) =
+      delete;
+
+  // Adds the next page of the document. The page index of 'page' is the number
+  // of pages added before it.
+  void AddPage(const PdfPage& page);
+
+  // Closes the sections that span the last added pages. Must be called after
+  // the last page was added; AddPage() must not be called afterwards.
+  void Finish();
+
+  // Returns the sections found so far, indexed by their instruction group id.
+  // When the document contains several sections with the same id, the last one
+  // wins. The sections are complete only after Finish() was called.
+  const std::map<string, PageRange>& sections() const { return sections_; }
 
+ private:
+  // Adds the sections that span the current run of pages to sections_. The
+  // last page of the run is 'last_page_index'.
+  void CloseOpenSections(int last_page_index);
+
+  // Returns the id of the normalized footer 'key', adding it if needed.
+  int InternFooterKey(const string& key);
+
+  std::map<string, PageRange> sections_;
+  std::unordered_map<string, int> footer_key_ids_;
+  // The sections that start in the current run of pages with the same footer,
+  // as pairs (instruction group id, first page index).
+  std::vector<std::pair<string, int>> open_sections_;
+  // The footer key id of the current run of pages, and the index of the next
+  // page.
+  int current_footer_key_id_ = -1;
+  int num_pages_ = 0;
+  // A buffer for normalizing texts, reused across pages.
+  string normalized_text_;
+};
+
+// Extracts the instruction sections from 'document'. The instruction tables of
+// the sections are always filled in. When 'keep_sub_section_rows' is true, the
+// sub sections of each instruction section also contain the text of their rows;
+// this is only needed for debugging, and it makes up most of the size of the
+// output.
+SdmDocument ConvertPdfDocumentToSdmDocument(const PdfDocument& document,
+                                            bool keep_sub_section_rows = true);
+
+// Collects the instructions of all the instruction sections of 'sdm_document'
+// into an instruction set, and sets their group ids.
 InstructionSetProto ProcessIntelSdmDocument(const SdmDocument& sdm_document);
 
+// Same as above, but moves the instructions out of 'sdm_document' instead of
+// copying them. The instruction tables of 'sdm_document' are left empty.
+InstructionSetProto ProcessIntelSdmDocument(SdmDocument&& sdm_document);
+
 // Parses the contents of an operand encoding cell.
 InstructionTable::OperandEncodingCrossref::OperandEncoding
 ParseOperandEncodingTableCell(const string& content);
@@ -0,0 +1,131 @@
+// Copyright 2016 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Benchmarks for the SDM extractor, on the SDM test data and on synthetic
+// inputs. Run with:
+//   bazel run -c opt //cpu_instructions/x86/pdf:intel_sdm_extractor_benchmark
+
+#include <utility>
+#include <vector>
+#include "strings/string.h"
+
+#include "benchmark/benchmark.h"
+#include "cpu_instructions/util/proto_util.h"
+#include "cpu_instructions/x86/pdf/intel_sdm_extractor.h"
+#include "cpu_instructions/x86/pdf/pdf_document_parser.h"
+#include "strings/str_cat.h"
+
+namespace cpu_instructions {
+namespace x86 {
+namespace pdf {
+namespace {
+
+// The benchmark is run from the root of the runfiles tree.
+const char kPdfDocumentPath[] =
+    "cpu_instructions/x86/pdf/testdata/253666_p170_p171_pdfdoc.pbtxt";
+
+// The argument of the benchmark is the value of 'keep_sub_section_rows'.
+void BM_ConvertPdfDocumentToSdmDocument(benchmark::State& state) {
+  const bool keep_sub_section_rows = state.range(0);
+  PdfDocument pdf_document = ReadTextProtoOrDie<PdfDocument>(kPdfDocumentPath);
+  for (auto& page : *pdf_document.mutable_pages()) {
+    Cluster(&page);
+  }
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(
+        ConvertPdfDocumentToSdmDocument(pdf_document, keep_sub_section_rows));
+  }
+}
+BENCHMARK(BM_ConvertPdfDocumentToSdmDocument)->Arg(false)->Arg(true);
+
+// Creates an SDM document with roughly as many instruction sections and
+// instructions as the full Intel SDM. Only the fields that are relevant for
+// ProcessIntelSdmDocument are filled.
+SdmDocument CreateFullSizeSdmDocument() {
+  constexpr int kNumSections = 1200;
+  constexpr int kInstructionsPerSection = 5;
+  SdmDocument sdm_document;
+  for (int section_index = 0; section_index < kNumSections; ++section_index) {
+    InstructionSection* const section = sdm_document.add_instruction_sections();
+    section->set_id(StrCat("INSTRUCTION", section_index));
+    for (int i = 0; i < kInstructionsPerSection; ++i) {
+      InstructionProto* const instruction =
+          section->mutable_instruction_table()->add_instructions();
+      instruction->set_description(
+          StrCat("Description of the instruction number ", i, "."));
+      instruction->set_feature_name("AVX512F");
+      instruction->set_raw_encoding_specification(
+          "EVEX.NDS.512.66.0F.W1 58 /r");
+      InstructionFormat* const vendor_syntax =
+          instruction->mutable_vendor_syntax();
+      vendor_syntax->set_mnemonic(StrCat("VADDPD", i));
+      for (const char* const operand : {"zmm1", "zmm2", "zmm3/m512"}) {
+        vendor_syntax->add_operands()->set_name(operand);
+      }
+    }
+  }
+  return sdm_document;
+}
+
+void BM_ProcessIntelSdmDocumentByCopy(benchmark::State& state) {
+  const SdmDocument sdm_document = CreateFullSizeSdmDocument();
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(ProcessIntelSdmDocument(sdm_document));
+  }
+}
+BENCHMARK(BM_ProcessIntelSdmDocumentByCopy);
+
+void BM_ProcessIntelSdmDocumentByMove(benchmark::State& state) {
+  const SdmDocument sdm_document = CreateFullSizeSdmDocument();
+  while (state.KeepRunning()) {
+    // The input is consumed by each iteration, only the processing is timed.
+    state.PauseTiming();
+    SdmDocument input = sdm_document;
+    state.ResumeTiming();
+    benchmark::DoNotOptimize(ProcessIntelSdmDocument(std::move(input)));
+  }
+}
+BENCHMARK(BM_ProcessIntelSdmDocumentByMove);
+
+void BM_ParseOperandEncodingTableCell(benchmark::State& state) {
+  // A sample of the cells found in the operand encoding tables, matching
+  // patterns from the beginning to the end of the list of matchers.
+  const std::vector<string> kCells = {
+      "NA",
+      "imm8",
+      "ModRM:reg (r, w)",
+      "ModRM:r/m (w, ModRM:[7:6] must not be 11b)",
+      "VEX.vvvv (r)",
+      "EVEX.vvvv (r)",
+      "opcode + rd (r, w)",
+      "Implicit XMM0 (r)",
+      "AX/EAX/RAX (r, w)",
+      "3",
+      "BaseReg (R): VSIB:base,\nVectorReg(R): VSIB:index",
+  };
+  while (state.KeepRunning()) {
+    for (const string& cell : kCells) {
+      benchmark::DoNotOptimize(ParseOperandEncodingTableCell(cell));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * kCells.size());
+}
+BENCHMARK(BM_ParseOperandEncodingTableCell);
+
+}  // namespace
+}  // namespace pdf
+}  // namespace x86
+}  // namespace cpu_instructions
+
+BENCHMARK_MAIN();
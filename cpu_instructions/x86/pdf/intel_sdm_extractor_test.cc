@@ -14,6 +14,9 @@
 
 #include "cpu_instructions/x86/pdf/intel_sdm_extractor.h"
 
+#include <utility>
+#include <vector>
+
 #include "cpu_instructions/testing/test_util.h"
 #include "cpu_instructions/util/proto_util.h"
 #include "cpu_instructions/x86/pdf/pdf_document_parser.h"
@@ -53,6 +56,78 @@ TEST(IntelSdmExtractorTest, BitSetPage) {
                                    "253666_p170_p171_instructionset")));
 }
 
+TEST(IntelSdmExtractorTest, ProcessIntelSdmDocumentByMove) {
+  SdmDocument sdm_document = GetProto<SdmDocument>("253666_p170_p171_sdmdoc");
+  const InstructionSetProto instruction_set =
+      ProcessIntelSdmDocument(std::move(sdm_document));
+  EXPECT_THAT(instruction_set, EqualsProto(GetProto<InstructionSetProto>(
+                                   "253666_p170_p171_instructionset")));
+  for (const auto& section : sdm_document.instruction_sections()) {
+    EXPECT_EQ(section.instruction_table().instructions_size(), 0);
+  }
+}
+
+TEST(IntelSdmExtractorTest, BitSetPageWithoutSubSectionRows) {
+  PdfDocument pdf_document = GetProto<PdfDocument>("253666_p170_p171_pdfdoc");
+  for (auto& page : *pdf_document.mutable_pages()) {
+    Cluster(&page);
+  }
+
+  SdmDocument expected_sdm_document =
+      GetProto<SdmDocument>("253666_p170_p171_sdmdoc");
+  for (auto& section : *expected_sdm_document.mutable_instruction_sections()) {
+    for (auto& sub_section : *section.mutable_sub_sections()) {
+      sub_section.clear_rows();
+    }
+  }
+  const SdmDocument sdm_document = ConvertPdfDocumentToSdmDocument(
+      pdf_document, /* keep_sub_section_rows = */ false);
+  EXPECT_THAT(sdm_document, EqualsProto(expected_sdm_document));
+}
+
+// Creates a page with the given number. When 'title' is not empty, the page is
+// the first page of an instruction. The footer of the page contains
+// 'footer_section_name', on the side where the SDM puts it.
+PdfPage CreatePage(int number, const string& title,
+                   const string& footer_section_name) {
+  PdfPage page;
+  page.set_number(number);
+  if (!title.empty()) {
+    page.add_rows()->add_blocks()->set_text("INSTRUCTION SET REFERENCE, A-L");
+    page.add_rows()->add_blocks()->set_text(title);
+  }
+  page.add_rows()->add_blocks()->set_text("Some text");
+  PdfTextTableRow* const footer = page.add_rows();
+  const string page_number = StrCat("Vol. 2A ", number);
+  if (number % 2 == 0) footer->add_blocks()->set_text(page_number);
+  footer->add_blocks()->set_text(footer_section_name);
+  if (number % 2 == 1) footer->add_blocks()->set_text(page_number);
+  return page;
+}
+
+TEST(InstructionSectionIndexerTest, FindsSections) {
+  const std::vector<PdfPage> pages = {
+      CreatePage(1, "", "CONTENTS"),
+      CreatePage(2, "ADD—Add", "ADD—Add"),
+      CreatePage(3, "", "ADD—Add"),
+      CreatePage(4, "", "ADD\n—Add"),
+      CreatePage(5, "ADDPD—Add Packed", "ADDPD—Add Packed"),
+      CreatePage(6, "BT—Bit Test", "ADDPD—Add Packed"),
+      CreatePage(7, "BT—Bit Test", "BT—Bit Test"),
+  };
+  InstructionSectionIndexer indexer;
+  for (const PdfPage& page : pages) {
+    indexer.AddPage(page);
+  }
+  indexer.Finish();
+  using PageRange = InstructionSectionIndexer::PageRange;
+  EXPECT_THAT(indexer.sections(),
+              ::testing::ElementsAre(
+                  ::testing::Pair("ADDPD—Add Packed", PageRange(4, 5)),
+                  ::testing::Pair("ADD—Add", PageRange(1, 3)),
+                  ::testing::Pair("BT—Bit Test", PageRange(6, 6))));
+}
+
 TEST(IntelSdmExtractorTest, ParseOperandEncodingTableCell) {
   EXPECT_THAT(ParseOperandEncodingTableCell("NA"), EqualsProto("spec: OE_NA"));
 
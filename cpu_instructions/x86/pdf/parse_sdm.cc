@@ -19,12 +19,15 @@
 #include <fstream>
 #include <functional>
 #include <memory>
+#include <utility>
+#include <vector>
 #include "strings/string.h"
 
 #include "cpu_instructions/util/proto_util.h"
 #include "cpu_instructions/x86/pdf/intel_sdm_extractor.h"
 #include "cpu_instructions/x86/pdf/pdf_document_utils.h"
 #include "cpu_instructions/x86/pdf/xpdf_util.h"
+#include "gflags/gflags.h"
 #include "glog/logging.h"
 #include "re2/re2.h"
 #include "strings/str_cat.h"
@@ -32,6 +35,11 @@
 #include "util/gtl/map_util.h"
 #include "util/gtl/ptr_util.h"
 
+DEFINE_bool(cpu_instructions_save_sdm_document, false,
+            "Save the interpreted SDM document of each input file, including "
+            "the text of all the sub sections, as "
+            "<output_base>_<input_id>.sdm.pb for debugging.");
+
 namespace cpu_instructions {
 namespace x86 {
 namespace pdf {
@@ -65,6 +73,30 @@ struct InputSpec {
   int last_page = 0;
 };
 
+// Moves the instructions and the source infos of 'source' to the end of the
+// corresponding fields of 'destination'. The elements are transferred without
+// copying them, and 'source' is left empty.
+void MoveInstructionSet(InstructionSetProto* source,
+                        InstructionSetProto* destination) {
+  CHECK(source != nullptr);
+  CHECK(destination != nullptr);
+  std::vector<InstructionProto*> instructions(source->instructions_size());
+  source->mutable_instructions()->ExtractSubrange(0, instructions.size(),
+                                                  instructions.data());
+  destination->mutable_instructions()->Reserve(
+      destination->instructions_size() + instructions.size());
+  for (InstructionProto* const instruction : instructions) {
+    destination->mutable_instructions()->AddAllocated(instruction);
+  }
+  std::vector<InstructionSetSourceInfo*> source_infos(
+      source->source_infos_size());
+  source->mutable_source_infos()->ExtractSubrange(0, source_infos.size(),
+                                                  source_infos.data());
+  for (InstructionSetSourceInfo* const source_info : source_infos) {
+    destination->mutable_source_infos()->AddAllocated(source_info);
+  }
+}
+
 // Parses the input specification (see FLAGS_cpu_instructions_input_spec for the
 // format).
 std::vector<InputSpec> ParseInputSpec(const string& input_spec) {
@@ -110,15 +142,19 @@ InstructionSetProto ParseSdmOrDie(const string& input_spec,
     WriteBinaryProtoOrDie(pb_filename, pdf_document);
 
     LOG(INFO) << "Extracting instruction set";
-    const SdmDocument sdm_document =
-        ConvertPdfDocumentToSdmDocument(pdf_document);
-    const string sdm_pb_filename = StrCat(output_base, "_", spec_id, ".sdm.pb");
-    LOG(INFO) << "Saving pdf as proto file : " << sdm_pb_filename;
-    WriteBinaryProtoOrDie(sdm_pb_filename, sdm_document);
-    InstructionSetProto instruction_set = ProcessIntelSdmDocument(sdm_document);
+    SdmDocument sdm_document = ConvertPdfDocumentToSdmDocument(
+        pdf_document, FLAGS_cpu_instructions_save_sdm_document);
+    if (FLAGS_cpu_instructions_save_sdm_document) {
+      const string sdm_pb_filename =
+          StrCat(output_base, "_", spec_id, ".sdm.pb");
+      LOG(INFO) << "Saving pdf as proto file : " << sdm_pb_filename;
+      WriteBinaryProtoOrDie(sdm_pb_filename, sdm_document);
+    }
+    InstructionSetProto instruction_set =
+        ProcessIntelSdmDocument(std::move(sdm_document));
     *instruction_set.add_source_infos() =
         CreateInstructionSetSourceInfo(doc->GetMetadata());
-    full_instruction_set.MergeFrom(instruction_set);
+    MoveInstructionSet(&instruction_set, &full_instruction_set);
   }
 
   // Outputs the instructions.
@@ -25,9 +25,11 @@ namespace pdf {
 
 // Parses the Intel SDM. Input is specified in input_spec. Outputs are:
 //   - The parsed database of instructions, written to <output_base>.pbtxt
-//   - Two raw protos per input file for debug, with the contents
-//     of the PDF (raw parsed input) and SDM (interpreted input) respectively,
-//     as <output_base>_<input_id>.{pdf,sdm}.pb
+//   - A raw proto per input file for debug, with the contents of the PDF (raw
+//     parsed input), as <output_base>_<input_id>.pdf.pb
+//   - With --cpu_instructions_save_sdm_document, another raw proto per input
+//     file for debug, with the contents of the SDM (interpreted input), as
+//     <output_base>_<input_id>.sdm.pb
 // The patches contained in patch_sets_file are applied before interpreting the
 // SDM.
 InstructionSetProto ParseSdmOrDie(const string& input_spec,
@@ -16,7 +16,7 @@
 
 #include <algorithm>
 #include <cfloat>
-#include <map>
+#include <functional>
 #include <unordered_map>
 #include <vector>
 #include "strings/string.h"
@@ -24,7 +24,6 @@
 #include "cpu_instructions/x86/pdf/geometry.h"
 #include "strings/str_cat.h"
 #include "strings/str_join.h"
-#include "strings/string_view.h"
 #include "util/graph/connected_components.h"
 #include "util/gtl/map_util.h"
 
@@ -103,18 +102,42 @@ class Characters {
   QuadTree tree_;
 };
 
-std::vector<Indices> GetClusters(DenseConnectedComponentsFinder* finder) {
-  std::map<int, Indices> all_indices;
-  const std::vector<int> component_ids = finder->GetComponentIds();
-  for (size_t i = 0; i < component_ids.size(); ++i) {
-    all_indices[component_ids[i]].push_back(i);
+// The connected components of a DenseConnectedComponentsFinder, stored in
+// compressed sparse row form to avoid allocating one container per component.
+class Clusters {
+ public:
+  // A view on the node indices of a single cluster. The indices are mutable so
+  // that they can be sorted in place.
+  class Cluster {
+   public:
+    using iterator = std::vector<int>::iterator;
+
+    Cluster(iterator begin, iterator end) : begin_(begin), end_(end) {}
+
+    iterator begin() const { return begin_; }
+    iterator end() const { return end_; }
+    size_t size() const { return end_ - begin_; }
+
+   private:
+    iterator begin_;
+    iterator end_;
+  };
+
+  explicit Clusters(DenseConnectedComponentsFinder* finder) {
+    finder->GetComponents(&offsets_, &nodes_);
   }
-  std::vector<Indices> output;
-  for (auto& id_indices_pair : all_indices) {
-    output.push_back(std::move(id_indices_pair.second));
+
+  size_t size() const { return offsets_.size() - 1; }
+
+  Cluster Get(size_t index) {
+    return Cluster(nodes_.begin() + offsets_[index],
+                   nodes_.begin() + offsets_[index + 1]);
   }
-  return output;
-}
+
+ private:
+  std::vector<int> offsets_;
+  std::vector<int> nodes_;
+};
 
 // Actually clusters the characters by retaining the closest character in the
 // forward direction and linking them together in PdfTextSegments.
@@ -159,7 +182,9 @@ void ClusterCharacters(const Characters& all, PdfTextSegments* segments) {
   }
 
   // Pushes a set of character indices as a new segment.
-  for (auto& indices : GetClusters(&components)) {
+  Clusters clusters(&components);
+  for (size_t cluster = 0; cluster < clusters.size(); ++cluster) {
+    const Clusters::Cluster indices = clusters.Get(cluster);
     // Returns whether characters[a] is before characters[b].
     const auto reading_order_cmp = [&all](size_t index_a, size_t index_b) {
       const auto& a = all.Get(index_a);
@@ -195,24 +220,31 @@ class Segments {
   Segments(const PdfPagePreventSegmentBindings& prevent_bindings,
            const PdfTextSegments* segments)
       : segments_(segments) {
+    first_char_index_to_segment_index_.reserve(segments->size());
     for (size_t i = 0; i < segments->size(); ++i) {
       InsertOrDie(&first_char_index_to_segment_index_, GetFirstCharIndex(i), i);
-      InsertIfNotPresent(&text_to_index_, segments->Get(i).text(), i);
     }
     for (const auto& prevent_binding : prevent_bindings) {
-      const string key =
-          CreateKey(prevent_binding.first(), prevent_binding.second());
-      if (!InsertIfNotPresent(&prevent_bindings_, key)) {
-        LOG(FATAL) << "Duplicated prevent_segment_bindings '" << key
-                   << "' in config file";
+      if (FindPreventBinding(prevent_binding.first(),
+                             prevent_binding.second()) !=
+          prevent_bindings_.end()) {
+        LOG(FATAL) << "Duplicated prevent_segment_bindings '"
+                   << CreateKey(prevent_binding) << "' in config file";
       }
+      prevent_bindings_.emplace(
+          GetKeyHash(prevent_binding.first(), prevent_binding.second()),
+          &prevent_binding);
     }
   }
 
   ~Segments() {
     if (!prevent_bindings_.empty()) {
+      std::vector<string> keys;
+      for (const auto& hash_binding : prevent_bindings_) {
+        keys.push_back(CreateKey(*hash_binding.second));
+      }
       LOG(ERROR) << "The following prevent_segment_bindings were not consumed\n"
-                 << strings::Join(prevent_bindings_, "\n");
+                 << strings::Join(keys, "\n");
     }
   }
 
@@ -229,24 +261,46 @@ class Segments {
                            following_char_index, index);
   }
 
-  size_t GetIndexFor(StringPiece text) const {
-    return FindWithDefault(text_to_index_, text, StringPiece::npos);
-  }
-
+  // Returns true if the binding between a and b must be prevented. Each
+  // binding from the configuration is consumed by the first pair of segments
+  // that matches it. This is called for every candidate pair of segments, so
+  // it does not allocate.
   bool ConsumePreventSegmentBinding(const PdfTextSegment& a,
                                     const PdfTextSegment& b) {
-    const string key = CreateKey(a.text(), b.text());
-    const bool prevent = ContainsKey(prevent_bindings_, key);
-    if (prevent) {
-      LOG(INFO) << "Preventing segment binding between '" << key << "'";
-      prevent_bindings_.erase(key);
-    }
-    return prevent;
+    if (prevent_bindings_.empty()) return false;
+    const auto it = FindPreventBinding(a.text(), b.text());
+    if (it == prevent_bindings_.end()) return false;
+    LOG(INFO) << "Preventing segment binding between '"
+              << CreateKey(*it->second) << "'";
+    prevent_bindings_.erase(it);
+    return true;
   }
 
  private:
-  static string CreateKey(const string& a, const string& b) {
-    return StrCat(a, " <-> ", b);
+  // The prevent_segment_bindings that were not consumed yet, indexed by the
+  // hash of their texts. The bindings are owned by the caller of Cluster().
+  using PreventBindings =
+      std::unordered_multimap<size_t, const PdfPagePreventSegmentBinding*>;
+
+  static string CreateKey(const PdfPagePreventSegmentBinding& binding) {
+    return StrCat(binding.first(), " <-> ", binding.second());
+  }
+
+  static size_t GetKeyHash(const string& a, const string& b) {
+    const std::hash<string> hasher;
+    const size_t hash_a = hasher(a);
+    return hash_a ^ (hasher(b) + 0x9e3779b9 + (hash_a << 6) + (hash_a >> 2));
+  }
+
+  // Returns the binding between the segments with texts a and b, or
+  // prevent_bindings_.end() if there is no such binding.
+  PreventBindings::iterator FindPreventBinding(const string& a,
+                                               const string& b) {
+    const auto range = prevent_bindings_.equal_range(GetKeyHash(a, b));
+    for (auto it = range.first; it != range.second; ++it) {
+      if (it->second->first() == a && it->second->second() == b) return it;
+    }
+    return prevent_bindings_.end();
   }
 
   size_t GetFirstCharIndex(size_t index) const {
@@ -261,9 +315,7 @@ class Segments {
 
   const PdfTextSegments* segments_;
   std::unordered_map<size_t, size_t> first_char_index_to_segment_index_;
-  // ok to store StringPieces we own the data.
-  std::map<StringPiece, size_t> text_to_index_;
-  std::unordered_set<string> prevent_bindings_;
+  PreventBindings prevent_bindings_;
 };
 
 // Clusters the consecutive segments and link them together into PdfTextBlocks.
@@ -311,7 +363,9 @@ void ClusterSegments(Segments* segments, PdfTextBlocks* blocks) {
     }
   }
 
-  for (auto& indices : GetClusters(&components)) {
+  Clusters clusters(&components);
+  for (size_t cluster = 0; cluster < clusters.size(); ++cluster) {
+    const Clusters::Cluster indices = clusters.Get(cluster);
     // Returns whether segments[a] is before segments[b].
     const auto reading_order_cmp = [segments](size_t a_index, size_t b_index) {
       const auto& a = segments->Get(a_index);
@@ -354,8 +408,9 @@ class Blocks {
 
   const PdfTextBlock& Get(size_t index) const { return *blocks_.at(index); }
 
-  Blocks Keep(Indices indices) const {
+  Blocks Keep(const Clusters::Cluster& indices) const {
     std::vector<const PdfTextBlock*> subset;
+    subset.reserve(indices.size());
     for (const size_t index : indices) subset.push_back(blocks_.at(index));
     return Blocks(std::move(subset));
   }
@@ -392,7 +447,9 @@ void ClusterColumns(const Blocks& row_blocks, PdfTextBlocks* output) {
     }
   }
 
-  for (auto& col_indices : GetClusters(&connected_columns)) {
+  Clusters columns(&connected_columns);
+  for (size_t column = 0; column < columns.size(); ++column) {
+    const Clusters::Cluster col_indices = columns.Get(column);
     const auto top_down_cmp = [&row_blocks](size_t a_index, size_t b_index) {
       const auto& a = row_blocks.Get(a_index).bounding_box();
       const auto& b = row_blocks.Get(b_index).bounding_box();
@@ -452,7 +509,9 @@ void ClusterRows(const Blocks& page_blocks, PdfTextTableRows* rows) {
     }
   }
 
-  for (auto& row_indices : GetClusters(&connected_rows)) {
+  Clusters rows_clusters(&connected_rows);
+  for (size_t row_index = 0; row_index < rows_clusters.size(); ++row_index) {
+    const Clusters::Cluster row_indices = rows_clusters.Get(row_index);
     const Blocks row_blocks = page_blocks.Keep(row_indices);
 
     PdfTextTableRow row;
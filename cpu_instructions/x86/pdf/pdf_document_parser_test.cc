@@ -181,6 +181,63 @@ TEST(ExtractLine, do_not_connect) {
   EXPECT_EQ(page.rows(0).blocks(1).text(), "n");
 }
 
+constexpr char kTwoLinesPage[] = R"(
+    number    : 1
+    width     : 612
+    height    : 792
+    characters: {
+      codepoint      : 0x00000049
+      utf8: "I"
+      font_size      : 24.0
+      orientation    : EAST
+      bounding_box: {
+        left  : 202.92
+        top   : 165.84
+        right : 209.328
+        bottom: 189.84
+      }
+      fill_color_hash: 1
+    }
+    characters: {
+      codepoint      : 0x0000006e
+      utf8: "n"
+      font_size      : 24.0
+      orientation    : EAST
+      bounding_box: {
+        left  : 202.92
+        top   : 191.84 # on the line below the previous char
+        right : 216.6960
+        bottom: 215.84
+      }
+      fill_color_hash: 1
+    }
+  )";
+
+TEST(ExtractLine, connect_lines) {
+  PdfPage page = ParseProtoFromStringOrDie<PdfPage>(kTwoLinesPage);
+  Cluster(&page);
+  ASSERT_EQ(page.segments().size(), 2);
+  ASSERT_EQ(page.blocks().size(), 1);
+  EXPECT_EQ(page.blocks(0).text(), "I\nn");
+}
+
+TEST(ExtractLine, prevent_segment_binding) {
+  PdfPage page = ParseProtoFromStringOrDie<PdfPage>(kTwoLinesPage);
+  PdfPagePreventSegmentBindings prevent_segment_bindings;
+  PdfPagePreventSegmentBinding* const binding = prevent_segment_bindings.Add();
+  binding->set_first("I");
+  binding->set_second("n");
+  // This one does not match any pair of segments and is just reported.
+  PdfPagePreventSegmentBinding* const unused = prevent_segment_bindings.Add();
+  unused->set_first("n");
+  unused->set_second("I");
+  Cluster(&page, prevent_segment_bindings);
+  ASSERT_EQ(page.segments().size(), 2);
+  ASSERT_EQ(page.blocks().size(), 2);
+  EXPECT_EQ(page.blocks(0).text(), "I");
+  EXPECT_EQ(page.blocks(1).text(), "n");
+}
+
 }  // namespace
 
 }  // namespace pdf
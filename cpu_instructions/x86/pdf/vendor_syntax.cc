@@ -14,10 +14,11 @@
 
 #include "cpu_instructions/x86/pdf/vendor_syntax.h"
 
+#include <iterator>
 #include <unordered_map>
-#include <unordered_set>
 #include <vector>
 
+#include "cpu_instructions/x86/operand_names.h"
 #include "glog/logging.h"
 #include "re2/re2.h"
 #include "strings/str_split.h"
@@ -162,9 +163,8 @@ const LazyRE2 kOperandRegexp = {
 }  // namespace
 
 bool ParseVendorSyntax(string content, InstructionFormat* instruction_format) {
-  static const auto* const kValidIntelOperandTypes =
-      new std::unordered_set<string>(std::begin(kValidOperandTypes),
-                                     std::end(kValidOperandTypes));
+  static const auto* const kValidIntelOperandTypes = new OperandNameSet(
+      std::begin(kValidOperandTypes), std::end(kValidOperandTypes));
   // Remove any asterisks (typically artifacts from notes).
   content.erase(std::remove(content.begin(), content.end(), '*'),
                 content.end());
@@ -186,7 +186,7 @@ bool ParseVendorSyntax(string content, InstructionFormat* instruction_format) {
     StripWhitespace(&tag1);
     StripWhitespace(&tag2);
     operand_name = FixOperandName(operand_name);
-    if (!ContainsKey(*kValidIntelOperandTypes, operand_name)) {
+    if (!kValidIntelOperandTypes->Contains(GetOperandNameId(operand_name))) {
       LOG(ERROR) << "Unknown operand '" << operand_name << "' while parsing '"
                  << content << "'";
       operand_name = kUnknown;
@@ -15,6 +15,7 @@
 // The following uses disjoint-sets algorithms, see:
 // https://en.wikipedia.org/wiki/Disjoint-set_data_structure#Disjoint-set_forests
 
+#include <algorithm>
 #include <numeric>
 
 #include "util/graph/connected_components.h"
@@ -37,6 +38,12 @@ void DenseConnectedComponentsFinder::SetNumberOfNodes(int num_nodes) {
   num_components_ += num_nodes - old_num_nodes;
 }
 
+void DenseConnectedComponentsFinder::Reserve(int num_nodes) {
+  parent_.reserve(num_nodes);
+  component_size_.reserve(num_nodes);
+  rank_.reserve(num_nodes);
+}
+
 int DenseConnectedComponentsFinder::FindRoot(int node) {
   DCHECK_GE(node, 0);
   DCHECK_LT(node, GetNumberOfNodes());
@@ -122,3 +129,29 @@ std::vector<int> DenseConnectedComponentsFinder::GetComponentIds() {
   }
   return component_ids;
 }
+
+void DenseConnectedComponentsFinder::GetComponents(std::vector<int>* offsets,
+                                                   std::vector<int>* nodes) {
+  CHECK(offsets != nullptr);
+  CHECK(nodes != nullptr);
+  const std::vector<int> component_ids = GetComponentIds();
+
+  // First pass: count the nodes in each component, and turn the counts into
+  // the index of the first node of each component.
+  offsets->assign(num_components_ + 1, 0);
+  for (const int component_id : component_ids) {
+    ++(*offsets)[component_id + 1];
+  }
+  std::partial_sum(offsets->begin(), offsets->end(), offsets->begin());
+
+  // Second pass: place each node at the current insertion point of its
+  // component. Nodes are visited in increasing order, so each component ends
+  // up sorted. Each insertion point ends up at the start of the next
+  // component, so the offsets are shifted back by one position afterwards.
+  nodes->resize(component_ids.size());
+  for (int node = 0; node < static_cast<int>(component_ids.size()); ++node) {
+    (*nodes)[(*offsets)[component_ids[node]]++] = node;
+  }
+  std::copy_backward(offsets->begin(), offsets->end() - 1, offsets->end());
+  offsets->front() = 0;
+}
@@ -40,16 +40,26 @@
 // ... and so on...
 // Of course, in this usage, the connected components finder retains
 // these pointers through its lifetime (though it doesn't dereference them).
+//
+// When the node type is hashable, prefer passing a hash functor:
+//   ConnectedComponentsFinder<MyNodeType, MyNodeTypeHash> cc;
+// Nodes are then indexed by an open-addressing hash table that does not
+// allocate per node. For large graphs, reserve space upfront and add the
+// edges in bulk:
+//   cc.Reserve(num_nodes);
+//   cc.AddEdges(edges);
 
 #ifndef UTIL_GRAPH_CONNECTED_COMPONENTS_H_
 #define UTIL_GRAPH_CONNECTED_COMPONENTS_H_
 
+#include <cstdint>
 #include <functional>
 #include <map>
 #include <memory>
 #include <set>
 #include <unordered_map>
 #include <unordered_set>
+#include <utility>
 #include <vector>
 
 #include "glog/logging.h"
@@ -74,6 +84,10 @@ class DenseConnectedComponentsFinder {
   int GetNumberOfComponents() const { return num_components_; }
   int GetNumberOfNodes() const { return parent_.size(); }
 
+  // Reserves memory for "num_nodes" nodes. This does not change the number of
+  // nodes in the graph.
+  void Reserve(int num_nodes);
+
   // Sets the number of nodes in the graph. The graph can only grow: this
   // dies if "num_nodes" is lower or equal to any of the values ever given
   // to AddEdge(), or lower than a previous value given to SetNumberOfNodes().
@@ -95,6 +109,16 @@ class DenseConnectedComponentsFinder {
   // Non-const because it does path compression internally.
   std::vector<int> GetComponentIds();
 
+  // Groups the nodes by component in compressed sparse row form: the nodes of
+  // component i are (*nodes)[(*offsets)[i]] to (*nodes)[(*offsets)[i + 1] - 1].
+  // Components are numbered as in GetComponentIds() and the nodes of each
+  // component are listed in increasing order. On return, offsets has
+  // GetNumberOfComponents() + 1 elements and nodes has GetNumberOfNodes()
+  // elements. This is a counting sort over the component ids: it runs in two
+  // linear passes and reuses the storage of the output vectors.
+  // Non-const because it does path compression internally.
+  void GetComponents(std::vector<int>* offsets, std::vector<int>* nodes);
+
  private:
   // parent[i] is the id of an ancestor for node i. A node is a root iff
   // parent[i] == i.
@@ -109,6 +133,128 @@ class DenseConnectedComponentsFinder {
 };
 
 namespace internal {
+
+// An open-addressing hash map from nodes to their dense index, used as the
+// index of ConnectedComponentsFinder when nodes are hashable. Since the values
+// are always 0, 1, 2, ... in insertion order, the (node, index) pairs are
+// stored contiguously in insertion order and the hash table only contains
+// positions in that array. Unlike std::unordered_map, this does not allocate
+// per node. Only the subset of the std::unordered_map API needed by
+// ConnectedComponentsFinder and FindWithDefault() is provided, and elements
+// cannot be erased.
+template <typename T, typename HashT, typename EqualT = std::equal_to<T>>
+class FlatHashIndexMap {
+ public:
+  using key_type = T;
+  using mapped_type = int;
+  using value_type = std::pair<T, int>;
+  using const_iterator = typename std::vector<value_type>::const_iterator;
+  using iterator = const_iterator;
+
+  FlatHashIndexMap() {}
+
+  const_iterator begin() const { return elements_.begin(); }
+  const_iterator end() const { return elements_.end(); }
+  size_t size() const { return elements_.size(); }
+  bool empty() const { return elements_.empty(); }
+
+  // Makes sure that "num_elements" elements can be stored without rehashing.
+  void reserve(size_t num_elements) {
+    elements_.reserve(num_elements);
+    if (MaxSizeForNumSlots(slots_.size()) < num_elements) {
+      Rehash(num_elements);
+    }
+  }
+
+  const_iterator find(const T& key) const {
+    if (slots_.empty()) return end();
+    for (size_t slot = GetFirstSlot(key);; slot = (slot + 1) & slot_mask_) {
+      const int position = slots_[slot];
+      if (position == kEmptySlot) return end();
+      if (equal_(elements_[position].first, key)) {
+        return elements_.begin() + position;
+      }
+    }
+  }
+
+  // Inserts (key, index) if key is not present. "index" must be equal to
+  // size(); this is what ConnectedComponentsFinder does.
+  std::pair<const_iterator, bool> emplace(const T& key, int index) {
+    DCHECK_EQ(index, static_cast<int>(elements_.size()));
+    if (MaxSizeForNumSlots(slots_.size()) <= elements_.size()) {
+      Rehash(elements_.size() + 1);
+    }
+    size_t slot = GetFirstSlot(key);
+    for (; slots_[slot] != kEmptySlot; slot = (slot + 1) & slot_mask_) {
+      const int position = slots_[slot];
+      if (equal_(elements_[position].first, key)) {
+        return std::make_pair(elements_.begin() + position, false);
+      }
+    }
+    slots_[slot] = elements_.size();
+    elements_.emplace_back(key, index);
+    return std::make_pair(elements_.end() - 1, true);
+  }
+
+ private:
+  static constexpr int kEmptySlot = -1;
+  static constexpr size_t kMinNumSlots = 16;
+
+  // The table is kept at most half full so that probe sequences stay short.
+  static size_t MaxSizeForNumSlots(size_t num_slots) { return num_slots / 2; }
+
+  // Scrambles the hash so that the identity hash of integers (as provided by
+  // std::hash) spreads well over the table (Fibonacci hashing).
+  size_t GetFirstSlot(const T& key) const {
+    const uint64_t hash =
+        static_cast<uint64_t>(hash_(key)) * 0x9E3779B97F4A7C15ULL;
+    return static_cast<size_t>(hash >> hash_shift_);
+  }
+
+  // Grows the table so that it can hold at least "num_elements" elements, and
+  // reinserts the existing elements.
+  void Rehash(size_t num_elements) {
+    size_t num_slots = kMinNumSlots;
+    int log2_num_slots = 4;
+    while (MaxSizeForNumSlots(num_slots) < num_elements) {
+      num_slots *= 2;
+      ++log2_num_slots;
+    }
+    slots_.assign(num_slots, kEmptySlot);
+    slot_mask_ = num_slots - 1;
+    hash_shift_ = 64 - log2_num_slots;
+    for (size_t position = 0; position < elements_.size(); ++position) {
+      size_t slot = GetFirstSlot(elements_[position].first);
+      while (slots_[slot] != kEmptySlot) slot = (slot + 1) & slot_mask_;
+      slots_[slot] = position;
+    }
+  }
+
+  // The (key, index) pairs, in insertion order.
+  std::vector<value_type> elements_;
+  // The hash table: each slot contains either kEmptySlot or a position in
+  // elements_. The number of slots is always a power of two.
+  std::vector<int> slots_;
+  size_t slot_mask_ = 0;
+  int hash_shift_ = 64;
+  HashT hash_;
+  EqualT equal_;
+};
+
+template <typename T, typename HashT, typename EqualT>
+constexpr int FlatHashIndexMap<T, HashT, EqualT>::kEmptySlot;
+template <typename T, typename HashT, typename EqualT>
+constexpr size_t FlatHashIndexMap<T, HashT, EqualT>::kMinNumSlots;
+
+// Reserves memory in an index map, when the map supports it.
+template <typename MapT>
+auto ReserveIndexMap(MapT* map, size_t num_elements, int)
+    -> decltype(map->reserve(num_elements), void()) {
+  map->reserve(num_elements);
+}
+template <typename MapT>
+void ReserveIndexMap(MapT* map, size_t num_elements, ...) {}
+
 // A helper to deduce the type of map to use depending on whether CompareOrHashT
 // is a comparator or a hasher (prefer the latter).
 template <typename T, typename CompareOrHashT>
@@ -134,10 +280,10 @@ struct ConnectedComponentsTypeHelper {
   // SFINAE dispatchers that return the right kind of map depending on the
   // functor.
   template <typename U>
-  static std::unordered_map<T, int, CompareOrHashT> ReturnMap(
+  static FlatHashIndexMap<T, CompareOrHashT> ReturnMap(
       hash_by_ref<U, &U::operator()>*);
   template <typename U>
-  static std::unordered_map<T, int, CompareOrHashT> ReturnMap(
+  static FlatHashIndexMap<T, CompareOrHashT> ReturnMap(
       hash_by_value<U, &U::operator()>*);
   template <typename U>
   static std::map<T, int, CompareOrHashT> ReturnMap(...);
@@ -146,7 +292,12 @@ struct ConnectedComponentsTypeHelper {
 
 }  // namespace internal
 
-template <typename T, typename CompareOrHashT = std::less<T>>
+// "IndexMapT" is the map from nodes to their dense index. It is deduced from
+// "CompareOrHashT" and should not normally be specified; it can be set to e.g.
+// std::unordered_map<T, int, CompareOrHashT> to compare implementations.
+template <typename T, typename CompareOrHashT = std::less<T>,
+          typename IndexMapT = typename internal::ConnectedComponentsTypeHelper<
+              T, CompareOrHashT>::Map>
 class ConnectedComponentsFinder {
  public:
   // Constructs a connected components finder.
@@ -167,18 +318,37 @@ class ConnectedComponentsFinder {
                       LookupOrInsertNode<false>(node2));
   }
 
+  // Adds all the edges in "edges", as if by calling AddEdge() on each of them
+  // in order.
+  void AddEdges(const std::vector<std::pair<T, T>>& edges) {
+    AddEdges(edges.begin(), edges.end());
+  }
+  template <typename InputIterator>
+  void AddEdges(InputIterator begin, InputIterator end) {
+    for (; begin != end; ++begin) AddEdge(begin->first, begin->second);
+  }
+
+  // Reserves memory for "num_nodes" distinct nodes. This avoids growing the
+  // internal data structures when the number of nodes is known in advance.
+  void Reserve(int num_nodes) {
+    internal::ReserveIndexMap(&index_, num_nodes, 0);
+    delegate_.Reserve(num_nodes);
+  }
+
   // Returns true iff both nodes are in the same connected component.
   // Returns false if either node has not been already added with AddNode.
   bool Connected(T node1, T node2) {
-    return delegate_.Connected(FindWithDefault(index_, node1, -1),
-                               FindWithDefault(index_, node2, -1));
+    return delegate_.Connected(
+        cpu_instructions::FindWithDefault(index_, node1, -1),
+        cpu_instructions::FindWithDefault(index_, node2, -1));
   }
 
   // Finds the connected component containing a node, and returns the
   // total number of nodes in that component.  Returns zero iff the
   // node has not been already added with AddNode.
   int GetSize(T node) {
-    return delegate_.GetSize(FindWithDefault(index_, node, -1));
+    return delegate_.GetSize(
+        cpu_instructions::FindWithDefault(index_, node, -1));
   }
 
   // Finds all the connected components and assigns them to components.
@@ -236,8 +406,7 @@ class ConnectedComponentsFinder {
   }
 
   DenseConnectedComponentsFinder delegate_;
-  typename internal::ConnectedComponentsTypeHelper<T, CompareOrHashT>::Map
-      index_;
+  IndexMapT index_;
 };
 
 #endif  // UTIL_GRAPH_CONNECTED_COMPONENTS_H_
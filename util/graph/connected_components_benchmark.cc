@@ -0,0 +1,93 @@
+// Copyright 2016 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Compares the node index backends of ConnectedComponentsFinder on large
+// random graphs. Run with:
+//   bazel run -c opt //util/graph:connected_components_benchmark
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <random>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "util/graph/connected_components.h"
+
+namespace {
+
+using Node = int64_t;
+using Edges = std::vector<std::pair<Node, Node>>;
+
+using OrderedFinder = ConnectedComponentsFinder<Node, std::less<Node>>;
+using NodeHashMapFinder =
+    ConnectedComponentsFinder<Node, std::hash<Node>,
+                              std::unordered_map<Node, int, std::hash<Node>>>;
+using FlatHashMapFinder = ConnectedComponentsFinder<Node, std::hash<Node>>;
+
+// Returns "num_edges" random edges between num_edges / 2 distinct nodes. The
+// node values are spread over the whole 64-bit range, like fingerprints.
+Edges CreateRandomEdges(int num_edges) {
+  std::mt19937_64 generator(42);
+  std::vector<Node> nodes(num_edges / 2);
+  for (Node& node : nodes) node = generator();
+  std::uniform_int_distribution<size_t> node_distribution(0, nodes.size() - 1);
+  Edges edges;
+  edges.reserve(num_edges);
+  for (int i = 0; i < num_edges; ++i) {
+    edges.emplace_back(nodes[node_distribution(generator)],
+                       nodes[node_distribution(generator)]);
+  }
+  return edges;
+}
+
+template <typename FinderT, bool kReserve>
+void BM_FindConnectedComponents(benchmark::State& state) {
+  const int num_edges = state.range(0);
+  const Edges edges = CreateRandomEdges(num_edges);
+  while (state.KeepRunning()) {
+    FinderT finder;
+    if (kReserve) finder.Reserve(num_edges / 2);
+    finder.AddEdges(edges);
+    benchmark::DoNotOptimize(finder.FindConnectedComponents());
+  }
+  state.SetItemsProcessed(state.iterations() * num_edges);
+}
+
+BENCHMARK_TEMPLATE2(BM_FindConnectedComponents, OrderedFinder, false)
+    ->RangeMultiplier(4)
+    ->Range(1 << 20, 1 << 23)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE2(BM_FindConnectedComponents, NodeHashMapFinder, false)
+    ->RangeMultiplier(4)
+    ->Range(1 << 20, 1 << 23)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE2(BM_FindConnectedComponents, NodeHashMapFinder, true)
+    ->RangeMultiplier(4)
+    ->Range(1 << 20, 1 << 23)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE2(BM_FindConnectedComponents, FlatHashMapFinder, false)
+    ->RangeMultiplier(4)
+    ->Range(1 << 20, 1 << 23)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE2(BM_FindConnectedComponents, FlatHashMapFinder, true)
+    ->RangeMultiplier(4)
+    ->Range(1 << 20, 1 << 23)
+    ->Unit(benchmark::kMillisecond);
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,263 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "util/graph/connected_components.h"
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <set>
+#include <string>
+#include <type_traits>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+// A hash functor that maps all strings of the same length to the same value,
+// so that the keys collide in the hash table.
+struct StringLengthHash {
+  size_t operator()(const std::string& key) const { return key.size(); }
+};
+
+// A hash functor that sends all keys to the same slot.
+struct ConstantHash {
+  size_t operator()(int) const { return 0; }
+};
+
+using IntIndexMap = internal::FlatHashIndexMap<int, std::hash<int>>;
+
+TEST(FlatHashIndexMapTest, EmptyMap) {
+  const IntIndexMap map;
+  EXPECT_TRUE(map.empty());
+  EXPECT_EQ(map.size(), 0u);
+  EXPECT_TRUE(map.begin() == map.end());
+  EXPECT_TRUE(map.find(0) == map.end());
+}
+
+TEST(FlatHashIndexMapTest, EmplaceAndFindAcrossRehashes) {
+  // The table starts with 16 slots and doubles when it is half full, so this
+  // goes through several rehashes.
+  constexpr int kNumElements = 1000;
+  IntIndexMap map;
+  for (int i = 0; i < kNumElements; ++i) {
+    // Use keys that are not the same as the indices.
+    const auto result = map.emplace(3 * i + 7, i);
+    EXPECT_TRUE(result.second);
+    EXPECT_EQ(result.first->first, 3 * i + 7);
+    EXPECT_EQ(result.first->second, i);
+    EXPECT_EQ(map.size(), static_cast<size_t>(i + 1));
+  }
+  for (int i = 0; i < kNumElements; ++i) {
+    const auto it = map.find(3 * i + 7);
+    ASSERT_TRUE(it != map.end());
+    EXPECT_EQ(it->first, 3 * i + 7);
+    EXPECT_EQ(it->second, i);
+    EXPECT_TRUE(map.find(3 * i + 8) == map.end());
+  }
+}
+
+TEST(FlatHashIndexMapTest, EmplaceExistingKey) {
+  IntIndexMap map;
+  map.emplace(10, 0);
+  map.emplace(20, 1);
+  const auto result = map.emplace(10, map.size());
+  EXPECT_FALSE(result.second);
+  EXPECT_EQ(result.first->first, 10);
+  EXPECT_EQ(result.first->second, 0);
+  EXPECT_EQ(map.size(), 2u);
+}
+
+TEST(FlatHashIndexMapTest, IteratesInInsertionOrder) {
+  IntIndexMap map;
+  const std::vector<int> kKeys = {42, -1, 17, 0, 1000000};
+  for (const int key : kKeys) map.emplace(key, map.size());
+  std::vector<std::pair<int, int>> elements(map.begin(), map.end());
+  ASSERT_EQ(elements.size(), kKeys.size());
+  for (size_t i = 0; i < kKeys.size(); ++i) {
+    EXPECT_EQ(elements[i].first, kKeys[i]);
+    EXPECT_EQ(elements[i].second, static_cast<int>(i));
+  }
+}
+
+TEST(FlatHashIndexMapTest, Reserve) {
+  constexpr int kNumElements = 100;
+  IntIndexMap map;
+  map.reserve(kNumElements);
+  EXPECT_TRUE(map.empty());
+  for (int i = 0; i < kNumElements; ++i) map.emplace(i, i);
+  // Reserving less space than what is used does not lose any elements.
+  map.reserve(1);
+  EXPECT_EQ(map.size(), static_cast<size_t>(kNumElements));
+  for (int i = 0; i < kNumElements; ++i) {
+    const auto it = map.find(i);
+    ASSERT_TRUE(it != map.end());
+    EXPECT_EQ(it->second, i);
+  }
+  // Reserving more space rehashes the table, but keeps the elements.
+  map.reserve(10 * kNumElements);
+  EXPECT_EQ(map.size(), static_cast<size_t>(kNumElements));
+  for (int i = 0; i < kNumElements; ++i) {
+    const auto it = map.find(i);
+    ASSERT_TRUE(it != map.end());
+    EXPECT_EQ(it->second, i);
+  }
+}
+
+TEST(FlatHashIndexMapTest, CollidingHashes) {
+  internal::FlatHashIndexMap<int, ConstantHash> map;
+  constexpr int kNumElements = 50;
+  for (int i = 0; i < kNumElements; ++i) {
+    EXPECT_TRUE(map.emplace(i * i, i).second);
+  }
+  for (int i = 0; i < kNumElements; ++i) {
+    EXPECT_FALSE(map.emplace(i * i, map.size()).second);
+    const auto it = map.find(i * i);
+    ASSERT_TRUE(it != map.end());
+    EXPECT_EQ(it->second, i);
+  }
+  EXPECT_EQ(map.size(), static_cast<size_t>(kNumElements));
+  EXPECT_TRUE(map.find(2) == map.end());
+}
+
+TEST(FlatHashIndexMapTest, CollidingStrings) {
+  internal::FlatHashIndexMap<std::string, StringLengthHash> map;
+  const std::vector<std::string> kKeys = {"abc", "abd", "xyz", "ab", "a", ""};
+  for (const std::string& key : kKeys) {
+    EXPECT_TRUE(map.emplace(key, map.size()).second);
+  }
+  for (size_t i = 0; i < kKeys.size(); ++i) {
+    const auto it = map.find(kKeys[i]);
+    ASSERT_TRUE(it != map.end());
+    EXPECT_EQ(it->second, static_cast<int>(i));
+  }
+  EXPECT_TRUE(map.find("abe") == map.end());
+}
+
+TEST(ConnectedComponentsFinderTest, UsesFlatHashIndexMapWithHashFunctor) {
+  EXPECT_TRUE((std::is_same<internal::ConnectedComponentsTypeHelper<
+                                std::string, StringLengthHash>::Map,
+                            internal::FlatHashIndexMap<std::string,
+                                                       StringLengthHash>>::
+                   value));
+  EXPECT_TRUE(
+      (std::is_same<
+          internal::ConnectedComponentsTypeHelper<int, std::less<int>>::Map,
+          std::map<int, int, std::less<int>>>::value));
+}
+
+TEST(ConnectedComponentsFinderTest, WithCustomHashFunctor) {
+  ConnectedComponentsFinder<std::string, StringLengthHash> finder;
+  finder.Reserve(8);
+  finder.AddEdge("a", "b");
+  finder.AddEdge("b", "c");
+  finder.AddEdge("xx", "yy");
+  finder.AddNode("zzz");
+  finder.AddNode("a");
+
+  EXPECT_EQ(finder.GetNumberOfNodes(), 6);
+  EXPECT_EQ(finder.GetNumberOfComponents(), 3);
+  EXPECT_TRUE(finder.Connected("a", "c"));
+  EXPECT_TRUE(finder.Connected("yy", "xx"));
+  EXPECT_FALSE(finder.Connected("a", "xx"));
+  EXPECT_FALSE(finder.Connected("a", "unknown"));
+  EXPECT_EQ(finder.GetSize("b"), 3);
+  EXPECT_EQ(finder.GetSize("xx"), 2);
+  EXPECT_EQ(finder.GetSize("zzz"), 1);
+  EXPECT_EQ(finder.GetSize("unknown"), 0);
+
+  // The order of the two nodes of an edge in the index depends on the order in
+  // which the compiler evaluates the arguments of a call, so the nodes of each
+  // component are sorted before the comparison.
+  std::vector<std::vector<std::string>> components =
+      finder.FindConnectedComponents();
+  for (std::vector<std::string>& component : components) {
+    std::sort(component.begin(), component.end());
+  }
+  const std::vector<std::vector<std::string>> kExpectedComponents = {
+      {"a", "b", "c"}, {"xx", "yy"}, {"zzz"}};
+  EXPECT_EQ(components, kExpectedComponents);
+
+  std::vector<std::unordered_set<std::string, StringLengthHash>> component_sets;
+  finder.FindConnectedComponents(&component_sets);
+  ASSERT_EQ(component_sets.size(), 3u);
+  EXPECT_EQ(component_sets[0].size(), 3u);
+  EXPECT_EQ(component_sets[0].count("c"), 1u);
+  EXPECT_EQ(component_sets[1].count("yy"), 1u);
+  EXPECT_EQ(component_sets[2].count("zzz"), 1u);
+}
+
+TEST(ConnectedComponentsFinderTest, AddEdges) {
+  // A path 0 - 1 - ... - 99 and a cycle 100 - 101 - ... - 199 - 100, added in
+  // bulk so that the index is rehashed several times.
+  std::vector<std::pair<int, int>> edges;
+  for (int i = 0; i + 1 < 100; ++i) edges.emplace_back(i, i + 1);
+  for (int i = 100; i < 200; ++i) {
+    edges.emplace_back(i, i + 1 < 200 ? i + 1 : 100);
+  }
+  ConnectedComponentsFinder<int, std::hash<int>> finder;
+  finder.AddEdges(edges);
+
+  ConnectedComponentsFinder<int, std::hash<int>> one_by_one_finder;
+  for (const auto& edge : edges) {
+    one_by_one_finder.AddEdge(edge.first, edge.second);
+  }
+
+  EXPECT_EQ(finder.GetNumberOfNodes(), 200);
+  EXPECT_EQ(finder.GetNumberOfComponents(), 2);
+  EXPECT_TRUE(finder.Connected(0, 99));
+  EXPECT_TRUE(finder.Connected(150, 100));
+  EXPECT_FALSE(finder.Connected(99, 100));
+  EXPECT_EQ(finder.GetSize(42), 100);
+  EXPECT_EQ(finder.GetSize(142), 100);
+  EXPECT_EQ(finder.FindConnectedComponents(),
+            one_by_one_finder.FindConnectedComponents());
+
+  // Edges can also be added from an iterator range, e.g. a subset of the
+  // edges.
+  ConnectedComponentsFinder<int, std::hash<int>> partial_finder;
+  partial_finder.AddEdges(edges.begin(), edges.begin() + 10);
+  EXPECT_EQ(partial_finder.GetNumberOfNodes(), 11);
+  EXPECT_EQ(partial_finder.GetNumberOfComponents(), 1);
+}
+
+TEST(ConnectedComponentsFinderTest, WithComparator) {
+  ConnectedComponentsFinder<int> finder;
+  finder.AddEdges({{3, 1}, {5, 7}, {1, 2}});
+  finder.AddNode(9);
+  EXPECT_EQ(finder.GetNumberOfComponents(), 3);
+  std::vector<std::set<int>> components;
+  finder.FindConnectedComponents(&components);
+  const std::vector<std::set<int>> kExpectedComponents = {
+      {1, 2, 3}, {5, 7}, {9}};
+  EXPECT_EQ(components, kExpectedComponents);
+}
+
+TEST(DenseConnectedComponentsFinderTest, GetComponents) {
+  DenseConnectedComponentsFinder finder;
+  finder.SetNumberOfNodes(6);
+  finder.AddEdge(0, 3);
+  finder.AddEdge(4, 1);
+  finder.AddEdge(3, 5);
+  std::vector<int> offsets;
+  std::vector<int> nodes;
+  finder.GetComponents(&offsets, &nodes);
+  EXPECT_EQ(offsets, std::vector<int>({0, 3, 5, 6}));
+  EXPECT_EQ(nodes, std::vector<int>({0, 3, 5, 1, 4, 2}));
+}
+
+}  // namespace
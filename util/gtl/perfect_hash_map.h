@@ -0,0 +1,525 @@
+// Copyright 2016 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Contains a lookup table for static sets and maps with string keys. The hash
+// function of the table is a two-level perfect hash function (Fredman, Komlos
+// and Szemeredi) that is computed by the compiler; a table defined as
+//
+//   constexpr gtl::PerfectHashMapEntry<int> kEntries[] = {{"a", 1}, ...};
+//   constexpr auto kTable = gtl::MakePerfectHashTable(kEntries);
+//
+// is constant-initialized: it does not allocate any memory, it does not run
+// any code during the static initialization, and a lookup computes one hash of
+// the key and does at most one string comparison. Tables with duplicate keys
+// do not compile.
+//
+// The table keeps a pointer to the array of entries, so the array must have
+// static storage duration. The construction of the table takes a number of
+// steps that is quadratic in the number of entries; it is meant for tables
+// with up to a few hundred entries.
+
+#ifndef UTIL_GTL_PERFECT_HASH_MAP_H_
+#define UTIL_GTL_PERFECT_HASH_MAP_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+
+#include "strings/string_view.h"
+
+namespace cpu_instructions {
+namespace gtl {
+
+// An entry of a perfect hash map. This is an aggregate, so that tables of
+// entries can be constexpr.
+template <typename ValueType>
+struct PerfectHashMapEntry {
+  const char* key;
+  ValueType value;
+};
+
+namespace perfect_hash_internal {
+
+// A fixed-size array that can be used in constant expressions; unlike
+// std::array, its elements can be read in a constexpr function in C++11.
+template <typename ElementType, size_t kSize>
+struct ConstArray {
+  ElementType values[kSize];
+};
+
+// Returns the key of an entry of a perfect hash set or map.
+constexpr const char* KeyOf(const char* key) { return key; }
+template <typename ValueType>
+constexpr const char* KeyOf(const PerfectHashMapEntry<ValueType>& entry) {
+  return entry.key;
+}
+
+// The FNV-1a hash of a NUL-terminated string. The runtime version below must
+// compute the same value.
+constexpr uint64_t kFnvOffsetBasis = 0xcbf29ce484222325ULL;
+constexpr uint64_t kFnvPrime = 0x100000001b3ULL;
+constexpr uint64_t HashString(const char* str,
+                              uint64_t hash = kFnvOffsetBasis) {
+  return *str == '\0'
+             ? hash
+             : HashString(str + 1, (hash ^ static_cast<uint8_t>(*str)) *
+                                       kFnvPrime);
+}
+inline uint64_t HashString(StringPiece str) {
+  uint64_t hash = kFnvOffsetBasis;
+  for (const char c : str) {
+    hash = (hash ^ static_cast<uint8_t>(c)) * kFnvPrime;
+  }
+  return hash;
+}
+
+// Derives a new hash from 'hash' and 'seed', using the finalizer of
+// MurmurHash3. The finalizer is a bijection, so distinct hashes remain
+// distinct for all seeds.
+constexpr uint64_t MixShift(uint64_t value) { return value ^ (value >> 33); }
+constexpr uint64_t Mix(uint64_t hash, uint32_t seed) {
+  return MixShift(
+      MixShift(MixShift(hash ^ (seed * 0x9e3779b97f4a7c15ULL)) *
+               0xff51afd7ed558ccdULL) *
+      0xc4ceb9fe1a85ec53ULL);
+}
+
+// The position of a key in the first level of the table (the bucket) and in
+// the second level (the slot in the range of the bucket).
+constexpr uint32_t BucketOf(uint64_t hash, uint32_t seed, size_t num_buckets) {
+  return static_cast<uint32_t>(Mix(hash, seed) % num_buckets);
+}
+constexpr uint32_t SlotOf(uint64_t hash, uint32_t seed, size_t num_slots) {
+  return static_cast<uint32_t>(Mix(hash, ~seed) % num_slots);
+}
+
+// The maximal number of seeds tried at each level. A random seed succeeds with
+// probability at least 1/2, so this limit is reached only when the table has
+// duplicate keys.
+constexpr uint32_t kMaxNumSeeds = 64;
+
+// The total number of slots of a table with 'num_keys' keys is at most
+// kSlotsPerKey * num_keys.
+constexpr size_t kSlotsPerKey = 3;
+
+// Called when no perfect hash function can be found, which happens when the
+// keys are not unique. This function is not constexpr, so calling it during
+// the construction of a constexpr table is a compilation error.
+inline uint32_t NoPerfectHashFunctionFoundTheKeysMustBeUnique() { abort(); }
+
+// Index sequences with a logarithmic instantiation depth; std::index_sequence
+// is not available in C++11.
+template <size_t... kIndices>
+struct IndexSequence {};
+template <typename First, typename Second>
+struct ConcatIndexSequences;
+template <size_t... kFirst, size_t... kSecond>
+struct ConcatIndexSequences<IndexSequence<kFirst...>,
+                            IndexSequence<kSecond...>> {
+  using type = IndexSequence<kFirst..., (sizeof...(kFirst) + kSecond)...>;
+};
+template <size_t kSize>
+struct MakeIndexSequenceImpl {
+  using type = typename ConcatIndexSequences<
+      typename MakeIndexSequenceImpl<kSize / 2>::type,
+      typename MakeIndexSequenceImpl<kSize - kSize / 2>::type>::type;
+};
+template <>
+struct MakeIndexSequenceImpl<0> {
+  using type = IndexSequence<>;
+};
+template <>
+struct MakeIndexSequenceImpl<1> {
+  using type = IndexSequence<0>;
+};
+template <size_t kSize>
+using MakeIndexSequence = typename MakeIndexSequenceImpl<kSize>::type;
+
+}  // namespace perfect_hash_internal
+
+// A lookup table with a perfect hash function. EntryType is either 'const
+// char*' for sets, or PerfectHashMapEntry<ValueType> for maps. Instances must
+// be created with MakePerfectHashTable below.
+template <typename EntryType, size_t kNumEntries>
+class PerfectHashTable {
+ public:
+  static constexpr size_t kNumSlots =
+      perfect_hash_internal::kSlotsPerKey * kNumEntries;
+  using Offsets = perfect_hash_internal::ConstArray<uint32_t, kNumEntries + 1>;
+  using Seeds = perfect_hash_internal::ConstArray<uint32_t, kNumEntries>;
+  using Slots = perfect_hash_internal::ConstArray<int32_t, kNumSlots>;
+
+  // Use MakePerfectHashTable() instead of calling the constructor directly.
+  constexpr PerfectHashTable(const EntryType (&entries)[kNumEntries],
+                             uint32_t bucket_seed, const Offsets& offsets,
+                             const Seeds& slot_seeds, const Slots& slots)
+      : entries_(entries),
+        bucket_seed_(bucket_seed),
+        offsets_(offsets),
+        slot_seeds_(slot_seeds),
+        slots_(slots) {}
+
+  // Returns the index of the entry with the given key in the array of entries
+  // of the table, or -1 if there is no such entry.
+  int IndexOf(StringPiece key) const {
+    const uint64_t hash = perfect_hash_internal::HashString(key);
+    const uint32_t bucket =
+        perfect_hash_internal::BucketOf(hash, bucket_seed_, kNumEntries);
+    const uint32_t begin = offsets_.values[bucket];
+    const uint32_t num_slots = offsets_.values[bucket + 1] - begin;
+    if (num_slots == 0) return -1;
+    const uint32_t slot = perfect_hash_internal::SlotOf(
+        hash, slot_seeds_.values[bucket], num_slots);
+    const int index = slots_.values[begin + slot];
+    if (index < 0 || key != perfect_hash_internal::KeyOf(entries_[index])) {
+      return -1;
+    }
+    return index;
+  }
+
+  // Returns the entry with the given key, or nullptr if there is no such
+  // entry.
+  const EntryType* Find(StringPiece key) const {
+    const int index = IndexOf(key);
+    return index < 0 ? nullptr : &entries_[index];
+  }
+
+  // Returns true if the table contains an entry with the given key.
+  bool Contains(StringPiece key) const { return IndexOf(key) >= 0; }
+
+  constexpr size_t size() const { return kNumEntries; }
+  const EntryType* begin() const { return entries_; }
+  const EntryType* end() const { return entries_ + kNumEntries; }
+
+ private:
+  // The entries of the table, in the order in which they were defined.
+  const EntryType* entries_;
+
+  // The seed of the first level of the hash function, that assigns the keys to
+  // the buckets.
+  uint32_t bucket_seed_;
+
+  // The slots of the bucket i are offsets_[i] to offsets_[i + 1] - 1. A bucket
+  // with n keys has n^2 slots.
+  Offsets offsets_;
+
+  // The seeds of the second level of the hash function, that assigns the keys
+  // of a bucket to its slots.
+  Seeds slot_seeds_;
+
+  // The index of the entry in each slot, or -1 for empty slots.
+  Slots slots_;
+};
+
+template <typename EntryType, size_t kNumEntries>
+constexpr size_t PerfectHashTable<EntryType, kNumEntries>::kNumSlots;
+
+// A set of strings and a map with string keys.
+template <size_t kNumEntries>
+using PerfectHashSet = PerfectHashTable<const char*, kNumEntries>;
+template <typename ValueType, size_t kNumEntries>
+using PerfectHashMap =
+    PerfectHashTable<PerfectHashMapEntry<ValueType>, kNumEntries>;
+
+namespace perfect_hash_internal {
+
+// The construction of the table is split into stages. Each stage computes one
+// array and passes it to the next stage; the constexpr functions of C++11 can't
+// have local variables.
+
+template <size_t kSize>
+using Hashes = ConstArray<uint64_t, kSize>;
+template <size_t kSize>
+using Indices = ConstArray<uint32_t, kSize>;
+
+// Returns the number of elements in values[begin, end) that are equal to
+// 'value'.
+template <size_t kSize>
+constexpr uint32_t Count(const Indices<kSize>& values, uint32_t value,
+                         size_t begin, size_t end) {
+  return end - begin == 0
+             ? 0
+             : end - begin == 1
+                   ? (values.values[begin] == value ? 1 : 0)
+                   : Count(values, value, begin, (begin + end) / 2) +
+                         Count(values, value, (begin + end) / 2, end);
+}
+
+// Returns the sum of values[begin, end), optionally squaring the elements.
+template <size_t kSize>
+constexpr uint32_t Sum(const Indices<kSize>& values, bool squares, size_t begin,
+                       size_t end) {
+  return end - begin == 0
+             ? 0
+             : end - begin == 1
+                   ? values.values[begin] *
+                         (squares ? values.values[begin] : 1)
+                   : Sum(values, squares, begin, (begin + end) / 2) +
+                         Sum(values, squares, (begin + end) / 2, end);
+}
+
+// Returns the index of the element of values[begin, end) that is equal to
+// 'value'. There must be exactly one such element.
+template <size_t kSize>
+constexpr uint32_t Find(const Indices<kSize>& values, uint32_t value,
+                        size_t begin, size_t end) {
+  return end - begin == 0
+             ? 0
+             : end - begin == 1
+                   ? (values.values[begin] == value ? begin : 0)
+                   : Find(values, value, begin, (begin + end) / 2) +
+                         Find(values, value, (begin + end) / 2, end);
+}
+
+// Returns the index i of the last element of the sorted array values[begin,
+// end) such that values[i] <= value.
+template <size_t kSize>
+constexpr uint32_t FindLastNotGreater(const Indices<kSize>& values,
+                                      uint32_t value, size_t begin,
+                                      size_t end) {
+  return end - begin <= 1
+             ? begin
+             : values.values[(begin + end) / 2] <= value
+                   ? FindLastNotGreater(values, value, (begin + end) / 2, end)
+                   : FindLastNotGreater(values, value, begin,
+                                        (begin + end) / 2);
+}
+
+template <typename EntryType, size_t kNumEntries, size_t... kIndices>
+constexpr Hashes<kNumEntries> ComputeHashes(
+    const EntryType (&entries)[kNumEntries], IndexSequence<kIndices...>) {
+  return {{HashString(KeyOf(entries[kIndices]))...}};
+}
+
+template <size_t kNumEntries, size_t... kIndices>
+constexpr Indices<kNumEntries> ComputeBuckets(const Hashes<kNumEntries>& hashes,
+                                              uint32_t seed,
+                                              IndexSequence<kIndices...>) {
+  return {{BucketOf(hashes.values[kIndices], seed, kNumEntries)...}};
+}
+
+template <size_t kNumEntries, size_t... kIndices>
+constexpr Indices<kNumEntries> ComputeBucketSizes(
+    const Indices<kNumEntries>& buckets, IndexSequence<kIndices...>) {
+  return {{Count(buckets, kIndices, 0, kNumEntries)...}};
+}
+
+// Returns the prefix sums of 'values': the element i of the result is the sum
+// of the elements [0, i) of 'values', optionally squared.
+template <size_t kNumEntries, size_t... kIndices>
+constexpr Indices<kNumEntries + 1> ComputePrefixSums(
+    const Indices<kNumEntries>& values, bool squares,
+    IndexSequence<kIndices...>) {
+  return {{Sum(values, squares, 0, kIndices)...}};
+}
+
+// The position of each entry in the list of the entries sorted by bucket, and
+// the inverse permutation.
+template <size_t kNumEntries, size_t... kIndices>
+constexpr Indices<kNumEntries> ComputePositions(
+    const Indices<kNumEntries>& buckets,
+    const Indices<kNumEntries + 1>& bucket_begins,
+    IndexSequence<kIndices...>) {
+  return {{(bucket_begins.values[buckets.values[kIndices]] +
+            Count(buckets, buckets.values[kIndices], 0, kIndices))...}};
+}
+template <size_t kNumEntries, size_t... kIndices>
+constexpr Indices<kNumEntries> ComputeOrder(
+    const Indices<kNumEntries>& positions, IndexSequence<kIndices...>) {
+  return {{Find(positions, kIndices, 0, kNumEntries)...}};
+}
+
+// Returns true if the entries order[begin, end) of a bucket with 'size'
+// entries are all assigned to different slots by 'seed'. Checks the pairs
+// (first, second) with first < second in this range, starting from the given
+// pair.
+template <size_t kNumEntries>
+constexpr bool AreSlotsDistinct(const Hashes<kNumEntries>& hashes,
+                                const Indices<kNumEntries>& order,
+                                uint32_t seed, uint32_t size, uint32_t first,
+                                uint32_t second, uint32_t end) {
+  return first + 1 >= end
+             ? true
+             : second >= end
+                   ? AreSlotsDistinct(hashes, order, seed, size, first + 1,
+                                      first + 2, end)
+                   : SlotOf(hashes.values[order.values[first]], seed,
+                            size * size) !=
+                             SlotOf(hashes.values[order.values[second]], seed,
+                                    size * size) &&
+                         AreSlotsDistinct(hashes, order, seed, size, first,
+                                          second + 1, end);
+}
+
+// Returns the first seed >= 'seed' that assigns the entries of the bucket
+// order[begin, begin + size) to distinct slots.
+template <size_t kNumEntries>
+constexpr uint32_t FindSlotSeed(const Hashes<kNumEntries>& hashes,
+                                const Indices<kNumEntries>& order,
+                                uint32_t begin, uint32_t size, uint32_t seed) {
+  return seed >= kMaxNumSeeds
+             ? NoPerfectHashFunctionFoundTheKeysMustBeUnique()
+             : AreSlotsDistinct(hashes, order, seed, size, begin, begin + 1,
+                                begin + size)
+                   ? seed
+                   : FindSlotSeed(hashes, order, begin, size, seed + 1);
+}
+
+template <size_t kNumEntries, size_t... kIndices>
+constexpr Indices<kNumEntries> ComputeSlotSeeds(
+    const Hashes<kNumEntries>& hashes, const Indices<kNumEntries>& order,
+    const Indices<kNumEntries>& bucket_sizes,
+    const Indices<kNumEntries + 1>& bucket_begins,
+    IndexSequence<kIndices...>) {
+  return {{FindSlotSeed(hashes, order, bucket_begins.values[kIndices],
+                        bucket_sizes.values[kIndices], 0)...}};
+}
+
+// Returns the index of the entry in the slot 'slot' of the bucket whose
+// entries are order[begin, end), or -1 if the slot is empty.
+template <size_t kNumEntries>
+constexpr int32_t FindEntryInSlot(const Hashes<kNumEntries>& hashes,
+                                  const Indices<kNumEntries>& order,
+                                  uint32_t seed, uint32_t size, uint32_t slot,
+                                  uint32_t begin, uint32_t end) {
+  return begin >= end
+             ? -1
+             : SlotOf(hashes.values[order.values[begin]], seed, size * size) ==
+                       slot
+                   ? static_cast<int32_t>(order.values[begin])
+                   : FindEntryInSlot(hashes, order, seed, size, slot,
+                                     begin + 1, end);
+}
+
+// Returns the index of the entry in the slot 'slot' of the bucket 'bucket'.
+template <size_t kNumEntries>
+constexpr int32_t GetSlot(const Hashes<kNumEntries>& hashes,
+                          const Indices<kNumEntries>& order,
+                          const Indices<kNumEntries>& bucket_sizes,
+                          const Indices<kNumEntries + 1>& bucket_begins,
+                          const Indices<kNumEntries + 1>& offsets,
+                          const Indices<kNumEntries>& slot_seeds,
+                          uint32_t bucket, uint32_t slot) {
+  return FindEntryInSlot(hashes, order, slot_seeds.values[bucket],
+                         bucket_sizes.values[bucket],
+                         slot - offsets.values[bucket],
+                         bucket_begins.values[bucket],
+                         bucket_begins.values[bucket + 1]);
+}
+
+template <typename EntryType, size_t kNumEntries, size_t... kIndices>
+constexpr PerfectHashTable<EntryType, kNumEntries> MakeTable(
+    const EntryType (&entries)[kNumEntries], const Hashes<kNumEntries>& hashes,
+    uint32_t bucket_seed, const Indices<kNumEntries>& order,
+    const Indices<kNumEntries>& bucket_sizes,
+    const Indices<kNumEntries + 1>& bucket_begins,
+    const Indices<kNumEntries + 1>& offsets,
+    const Indices<kNumEntries>& slot_seeds, IndexSequence<kIndices...>) {
+  return PerfectHashTable<EntryType, kNumEntries>(
+      entries, bucket_seed, offsets, slot_seeds,
+      {{(kIndices >= offsets.values[kNumEntries]
+             ? -1
+             : GetSlot(hashes, order, bucket_sizes, bucket_begins, offsets,
+                       slot_seeds,
+                       FindLastNotGreater(offsets, kIndices, 0, kNumEntries),
+                       kIndices))...}});
+}
+
+template <typename EntryType, size_t kNumEntries>
+constexpr PerfectHashTable<EntryType, kNumEntries> MakeTableWithOrder(
+    const EntryType (&entries)[kNumEntries], const Hashes<kNumEntries>& hashes,
+    uint32_t bucket_seed, const Indices<kNumEntries>& order,
+    const Indices<kNumEntries>& bucket_sizes,
+    const Indices<kNumEntries + 1>& bucket_begins,
+    const Indices<kNumEntries + 1>& offsets) {
+  return MakeTable(
+      entries, hashes, bucket_seed, order, bucket_sizes, bucket_begins, offsets,
+      ComputeSlotSeeds(hashes, order, bucket_sizes, bucket_begins,
+                       MakeIndexSequence<kNumEntries>()),
+      MakeIndexSequence<kSlotsPerKey * kNumEntries>());
+}
+
+template <typename EntryType, size_t kNumEntries>
+constexpr PerfectHashTable<EntryType, kNumEntries> MakeTableWithBuckets(
+    const EntryType (&entries)[kNumEntries], const Hashes<kNumEntries>& hashes,
+    uint32_t bucket_seed, const Indices<kNumEntries>& buckets,
+    const Indices<kNumEntries>& bucket_sizes,
+    const Indices<kNumEntries + 1>& bucket_begins) {
+  return MakeTableWithOrder(
+      entries, hashes, bucket_seed,
+      ComputeOrder(ComputePositions(buckets, bucket_begins,
+                                    MakeIndexSequence<kNumEntries>()),
+                   MakeIndexSequence<kNumEntries>()),
+      bucket_sizes, bucket_begins,
+      ComputePrefixSums(bucket_sizes, true,
+                        MakeIndexSequence<kNumEntries + 1>()));
+}
+
+// Tries 'bucket_seed' for the first level of the hash function. The seed is
+// accepted if the table has at most kSlotsPerKey slots per key, otherwise the
+// next seed is tried.
+template <typename EntryType, size_t kNumEntries>
+constexpr PerfectHashTable<EntryType, kNumEntries> TryBucketSeed(
+    const EntryType (&entries)[kNumEntries], const Hashes<kNumEntries>& hashes,
+    uint32_t bucket_seed, const Indices<kNumEntries>& buckets,
+    const Indices<kNumEntries>& bucket_sizes) {
+  return Sum(bucket_sizes, true, 0, kNumEntries) <=
+                 kSlotsPerKey * kNumEntries
+             ? MakeTableWithBuckets(entries, hashes, bucket_seed, buckets,
+                                    bucket_sizes,
+                                    ComputePrefixSums(
+                                        bucket_sizes, false,
+                                        MakeIndexSequence<kNumEntries + 1>()))
+             : TryBucketSeed(
+                   entries, hashes,
+                   bucket_seed + 1 < kMaxNumSeeds
+                       ? bucket_seed + 1
+                       : NoPerfectHashFunctionFoundTheKeysMustBeUnique(),
+                   ComputeBuckets(hashes, bucket_seed + 1,
+                                  MakeIndexSequence<kNumEntries>()),
+                   ComputeBucketSizes(
+                       ComputeBuckets(hashes, bucket_seed + 1,
+                                      MakeIndexSequence<kNumEntries>()),
+                       MakeIndexSequence<kNumEntries>()));
+}
+
+template <typename EntryType, size_t kNumEntries>
+constexpr PerfectHashTable<EntryType, kNumEntries> MakeTableWithHashes(
+    const EntryType (&entries)[kNumEntries],
+    const Hashes<kNumEntries>& hashes) {
+  return TryBucketSeed(
+      entries, hashes, 0,
+      ComputeBuckets(hashes, 0, MakeIndexSequence<kNumEntries>()),
+      ComputeBucketSizes(
+          ComputeBuckets(hashes, 0, MakeIndexSequence<kNumEntries>()),
+          MakeIndexSequence<kNumEntries>()));
+}
+
+}  // namespace perfect_hash_internal
+
+// Creates a perfect hash table for 'entries'. The table refers to the array
+// of entries, so the array must outlive the table.
+template <typename EntryType, size_t kNumEntries>
+constexpr PerfectHashTable<EntryType, kNumEntries> MakePerfectHashTable(
+    const EntryType (&entries)[kNumEntries]) {
+  return perfect_hash_internal::MakeTableWithHashes(
+      entries, perfect_hash_internal::ComputeHashes(
+                   entries,
+                   perfect_hash_internal::MakeIndexSequence<kNumEntries>()));
+}
+
+}  // namespace gtl
+}  // namespace cpu_instructions
+
+#endif  // UTIL_GTL_PERFECT_HASH_MAP_H_
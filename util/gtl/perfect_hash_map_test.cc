@@ -0,0 +1,105 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "util/gtl/perfect_hash_map.h"
+
+#include <vector>
+#include "strings/str_cat.h"
+#include "strings/string.h"
+
+#include "gtest/gtest.h"
+
+namespace cpu_instructions {
+namespace gtl {
+namespace {
+
+constexpr PerfectHashMapEntry<int> kNumbers[] = {
+    {"one", 1}, {"two", 2}, {"three", 3}, {"four", 4}, {"five", 5}};
+constexpr auto kNumberMap = MakePerfectHashTable(kNumbers);
+
+constexpr const char* kColors[] = {"red", "green", "blue"};
+constexpr auto kColorSet = MakePerfectHashTable(kColors);
+
+constexpr const char* kSingleKey[] = {""};
+constexpr auto kSingleKeySet = MakePerfectHashTable(kSingleKey);
+
+// A table with a few hundred keys, similar in size to the largest tables in
+// the code base.
+#define PERFECT_HASH_TEST_KEYS_10(prefix)                                  \
+  prefix "0", prefix "1", prefix "2", prefix "3", prefix "4", prefix "5", \
+      prefix "6", prefix "7", prefix "8", prefix "9"
+#define PERFECT_HASH_TEST_KEYS_100(prefix)                                   \
+  PERFECT_HASH_TEST_KEYS_10(prefix "0"),                                     \
+      PERFECT_HASH_TEST_KEYS_10(prefix "1"),                                 \
+      PERFECT_HASH_TEST_KEYS_10(prefix "2"),                                 \
+      PERFECT_HASH_TEST_KEYS_10(prefix "3"),                                 \
+      PERFECT_HASH_TEST_KEYS_10(prefix "4"),                                 \
+      PERFECT_HASH_TEST_KEYS_10(prefix "5"),                                 \
+      PERFECT_HASH_TEST_KEYS_10(prefix "6"),                                 \
+      PERFECT_HASH_TEST_KEYS_10(prefix "7"),                                 \
+      PERFECT_HASH_TEST_KEYS_10(prefix "8"),                                 \
+      PERFECT_HASH_TEST_KEYS_10(prefix "9")
+constexpr const char* kManyKeys[] = {PERFECT_HASH_TEST_KEYS_100("a"),
+                                     PERFECT_HASH_TEST_KEYS_100("b"),
+                                     PERFECT_HASH_TEST_KEYS_100("c")};
+#undef PERFECT_HASH_TEST_KEYS_100
+#undef PERFECT_HASH_TEST_KEYS_10
+constexpr auto kManyKeysSet = MakePerfectHashTable(kManyKeys);
+
+TEST(PerfectHashTableTest, FindInMap) {
+  EXPECT_EQ(kNumberMap.size(), 5);
+  for (const auto& entry : kNumbers) {
+    const PerfectHashMapEntry<int>* const found = kNumberMap.Find(entry.key);
+    ASSERT_NE(found, nullptr) << entry.key;
+    EXPECT_EQ(found, &entry);
+    EXPECT_EQ(found->value, entry.value);
+  }
+  EXPECT_EQ(kNumberMap.IndexOf("three"), 2);
+  EXPECT_EQ(kNumberMap.Find(string("four"))->value, 4);
+
+  EXPECT_EQ(kNumberMap.Find("six"), nullptr);
+  EXPECT_EQ(kNumberMap.Find(""), nullptr);
+  EXPECT_EQ(kNumberMap.Find("on"), nullptr);
+  EXPECT_EQ(kNumberMap.Find("one "), nullptr);
+  EXPECT_EQ(kNumberMap.IndexOf("ONE"), -1);
+}
+
+TEST(PerfectHashTableTest, ContainsInSet) {
+  EXPECT_TRUE(kColorSet.Contains("red"));
+  EXPECT_TRUE(kColorSet.Contains("green"));
+  EXPECT_TRUE(kColorSet.Contains("blue"));
+  EXPECT_FALSE(kColorSet.Contains("yellow"));
+  EXPECT_FALSE(kColorSet.Contains(StringPiece("redx", 3).substr(0, 2)));
+
+  EXPECT_TRUE(kSingleKeySet.Contains(""));
+  EXPECT_FALSE(kSingleKeySet.Contains("a"));
+}
+
+TEST(PerfectHashTableTest, Iteration) {
+  std::vector<string> colors(kColorSet.begin(), kColorSet.end());
+  EXPECT_EQ(colors, std::vector<string>({"red", "green", "blue"}));
+}
+
+TEST(PerfectHashTableTest, ManyKeys) {
+  ASSERT_EQ(kManyKeysSet.size(), 300);
+  for (int i = 0; i < 300; ++i) {
+    EXPECT_EQ(kManyKeysSet.IndexOf(kManyKeys[i]), i) << kManyKeys[i];
+    EXPECT_FALSE(kManyKeysSet.Contains(StrCat(kManyKeys[i], "x")));
+  }
+  EXPECT_FALSE(kManyKeysSet.Contains("d00"));
+}
+
+}  // namespace
+}  // namespace gtl
+}  // namespace cpu_instructions